@@ -0,0 +1,30 @@
+#ifndef FWD_PROXY_BENCH_BENCHOPTIONS_H
+#define FWD_PROXY_BENCH_BENCHOPTIONS_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#include "../enum/SecurityType.h"
+
+namespace fwd_proxy::bench {
+    /**
+     * Load generator settings
+     */
+    struct BenchOptions {
+        std::string  address          { "127.0.0.1" };
+        int          port             { 9595 };
+        size_t       pairs            { 1000 };
+        SecurityType security         { SecurityType::UNSECURED }; //SECURED = a unique secret per pair
+        size_t       message_size     { 64 };    //bytes (>= 8, the first 8 carry the send time)
+        uint64_t     rate             { 100 };   //messages/s sent by each client (0 = as fast as possible)
+        uint64_t     duration_ms      { 10000 }; //measured load
+        uint64_t     warmup_ms        { 1000 };  //load before the measurement starts
+        uint64_t     setup_timeout_ms { 30000 }; //time allowed for all the clients to get READY
+        size_t       threads          { 1 };
+        size_t       connect_window   { 64 };    //clients per thread connected but not READY yet (keep it under the listen backlog)
+        bool         framed           { false }; //framed protocol (each message goes as 1 `DATA` frame)
+    };
+}
+
+#endif //FWD_PROXY_BENCH_BENCHOPTIONS_H
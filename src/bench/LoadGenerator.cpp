@@ -0,0 +1,582 @@
+#include "LoadGenerator.h"
+#include "../logger/Logger.h"
+#include "../proxy/FrameCursor.h"
+
+#include <algorithm>
+#include <queue>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define EPOLL_ARRAY_SIZE           1024
+#define EPOLL_PENDING_QUEUE_LENGTH   10 //size is ignored since Linux 2.6.8
+#define SETUP_POLL_TIMEOUT_MS        10
+#define LOAD_POLL_TIMEOUT_MS          1 //longest sleep while loaded
+#define DRAIN_TIME_MS               250 //receiving only, after the measured load
+#define IO_BUFFER_SIZE            65536
+#define TIMESTAMP_SIZE     sizeof( uint64_t )
+
+using namespace fwd_proxy::bench;
+
+/**
+ * Constructor
+ * @param options Bench options
+ */
+LoadGenerator::LoadGenerator( BenchOptions options ) :
+    _options( std::move( options ) ),
+    _interval_ns( _options.rate > 0 ? 1000000000 / _options.rate : 0 ),
+    _secret_prefix( "bench-" + std::to_string( ::getpid() ) + "-" ),
+    _ready( _options.framed ? proxy::FrameCursor::encode( FrameType::READY ) : std::string( "READY" ) ),
+    _frame_header( LoadGenerator::frameHeader( _options ) ),
+    _wire_size( _frame_header.size() + _options.message_size ),
+    _barrier( static_cast<ptrdiff_t>( std::max<size_t>( _options.threads, 1 ) + 1 ) ),
+    _setup_start( 0 ),
+    _load_start( 0 )
+{
+    const auto threads = std::max<size_t>( _options.threads, 1 );
+
+    _workers.resize( threads );
+
+    for( size_t pair = 0; pair < _options.pairs; ++pair ) { //both clients of a pair go to the same worker
+        auto & connections = _workers[ pair % threads ].connections;
+
+        connections.emplace_back().pair = pair;
+        connections.emplace_back().pair = pair;
+    }
+}
+
+/**
+ * Destructor
+ */
+LoadGenerator::~LoadGenerator() {
+    for( auto & worker : _workers ) {
+        if( worker.thread.joinable() ) {
+            worker.thread.join();
+        }
+
+        for( auto & connection : worker.connections ) {
+            if( connection.fd != -1 ) {
+                ::close( connection.fd );
+            }
+        }
+
+        if( worker.epoll_fd != -1 ) {
+            ::close( worker.epoll_fd );
+        }
+    }
+}
+
+/**
+ * Opens the clients, runs the load and collects the results (blocking)
+ * The clients stay connected until the generator is destroyed (so that an embedded server can be stopped first).
+ * @return Report
+ */
+LoadGenerator::Report_t LoadGenerator::run() {
+    Report_t report;
+
+    _setup_start = LoadGenerator::now();
+
+    for( auto & worker : _workers ) {
+        worker.thread = std::thread( [this, &worker]() { this->runWorker( worker ); } );
+    }
+
+    _barrier.arrive_and_wait(); //all the clients are READY or have failed
+    report.setup_us = ( LoadGenerator::now() - _setup_start ) / 1000;
+    _load_start     = LoadGenerator::now();
+    _barrier.arrive_and_wait();
+
+    for( auto & worker : _workers ) {
+        worker.thread.join();
+
+        report.clients_ready     += worker.ready;
+        report.clients_failed    += worker.failed;
+        report.disconnections    += worker.disconnections;
+        report.messages_sent     += worker.sent;
+        report.messages_received += worker.received;
+        report.bytes_received    += worker.bytes_received;
+        report.ready_us.merge( worker.ready_us->snapshot() );
+        report.latency_ns.merge( worker.latency_ns->snapshot() );
+    }
+
+    report.measured_us = _options.duration_ms * 1000;
+
+    return report;
+}
+
+/**
+ * [PRIVATE] Worker thread
+ * @param worker Worker
+ */
+void LoadGenerator::runWorker( Worker_t & worker ) {
+    if( ( worker.epoll_fd = ::epoll_create( EPOLL_PENDING_QUEUE_LENGTH ) ) == -1 ) {
+        LOG_ERROR( "[bench::LoadGenerator::runWorker(..)] Failed to create epoll file descriptor: " << ::strerror( errno ) );
+        worker.failed = worker.connections.size();
+    } else {
+        setupClients( worker );
+    }
+
+    _barrier.arrive_and_wait();
+    _barrier.arrive_and_wait(); //`_load_start` is set
+
+    if( worker.epoll_fd != -1 ) {
+        generateLoad( worker );
+    }
+}
+
+/**
+ * [PRIVATE] Opens the worker's clients a window at a time and waits for them to get READY
+ * @param worker Worker
+ */
+void LoadGenerator::setupClients( Worker_t & worker ) {
+    const auto         deadline = _setup_start + _options.setup_timeout_ms * 1000000;
+    const auto         window   = std::max<size_t>( _options.connect_window, 2 );
+    struct epoll_event events[EPOLL_ARRAY_SIZE];
+
+    while( worker.ready + worker.failed < worker.connections.size() && LoadGenerator::now() < deadline ) {
+        //Clients are opened by pairs so that a window can't fill up with clients waiting on unopened counterparts
+        while( worker.opened < worker.connections.size() && worker.opened - worker.ready - worker.failed + 2 <= window ) {
+            for( size_t i = 0; i < 2; ++i, ++worker.opened ) {
+                if( !openClient( worker, worker.opened, worker.connections[ worker.opened ].pair ) ) {
+                    closeClient( worker, worker.connections[ worker.opened ] );
+                    ++worker.failed;
+                }
+            }
+        }
+
+        const int event_count = ::epoll_wait( worker.epoll_fd, events, EPOLL_ARRAY_SIZE, SETUP_POLL_TIMEOUT_MS );
+
+        for( int i = 0; i < event_count; ++i ) {
+            auto & connection = worker.connections[ events[i].data.u32 ];
+            bool   success    = !( events[i].events & EPOLLERR );
+
+            if( success && connection.state == ConnectionState::CONNECTING && ( events[i].events & EPOLLOUT ) ) {
+                success = startHandshake( worker, connection );
+
+            } else if( success && connection.state == ConnectionState::HANDSHAKE && ( events[i].events & ( EPOLLIN | EPOLLRDHUP | EPOLLHUP ) ) ) {
+                success = receiveReady( worker, connection );
+            }
+
+            if( !success ) {
+                closeClient( worker, connection );
+                ++worker.failed;
+            }
+        }
+    }
+
+    for( auto & connection : worker.connections ) { //timed out
+        if( connection.state != ConnectionState::READY && connection.state != ConnectionState::CLOSED ) {
+            closeClient( worker, connection );
+            ++worker.failed;
+        }
+    }
+
+    worker.failed += worker.connections.size() - worker.opened; //never opened
+}
+
+/**
+ * [PRIVATE] Sends messages on the worker's READY clients and receives them until the end of the measured load
+ * Paced clients are kept in a min-heap by the time their next message is due, and the worker sleeps until the
+ * earliest one (ns precision). A client whose socket is full leaves the heap until it is writable again.
+ * @param worker Worker
+ */
+void LoadGenerator::generateLoad( Worker_t & worker ) {
+    typedef std::pair<uint64_t, uint32_t> Due_t; //send time (ns), connection index
+
+    const auto         start        = _load_start.load();
+    const auto         measure_from = start + _options.warmup_ms * 1000000;
+    const auto         measure_to   = measure_from + _options.duration_ms * 1000000;
+    const auto         drain_to     = measure_to + DRAIN_TIME_MS * 1000000ULL;
+    auto               buffer       = std::vector<char>( IO_BUFFER_SIZE );
+    auto               scratch      = std::vector<char>( std::max<size_t>( IO_BUFFER_SIZE, _wire_size ), 'x' );
+    auto               schedule     = std::priority_queue<Due_t, std::vector<Due_t>, std::greater<>>();
+    size_t             index        = 0;
+    struct epoll_event events[EPOLL_ARRAY_SIZE];
+
+    const auto send = [&]( Connection_t & connection, uint64_t now ) {
+        if( !sendMessages( worker, connection, scratch, now, measure_from, measure_to ) ) {
+            closeClient( worker, connection );
+            ++worker.disconnections;
+        } else if( _interval_ns > 0 ) {
+            connection.parked = !connection.writable;
+
+            if( !connection.parked ) {
+                schedule.emplace( connection.next_due, static_cast<uint32_t>( &connection - worker.connections.data() ) );
+            }
+        }
+    };
+
+    for( auto & connection : worker.connections ) { //edge-triggered from now on, sends spread over the first interval
+        if( connection.state == ConnectionState::READY ) {
+            struct epoll_event event {};
+
+            event.events        = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
+            event.data.u32      = static_cast<uint32_t>( &connection - worker.connections.data() );
+            connection.writable = true;
+            connection.next_due = start + _interval_ns * index++ / std::max<size_t>( worker.ready, 1 );
+
+            ::epoll_ctl( worker.epoll_fd, EPOLL_CTL_MOD, connection.fd, &event );
+
+            if( _interval_ns > 0 ) {
+                schedule.emplace( connection.next_due, static_cast<uint32_t>( event.data.u32 ) );
+            }
+        }
+    }
+
+    for( auto now = LoadGenerator::now(); now < drain_to; now = LoadGenerator::now() ) {
+        auto wait_ns = std::min<uint64_t>( drain_to - now, LOAD_POLL_TIMEOUT_MS * 1000000ULL );
+
+        if( _interval_ns > 0 && !schedule.empty() && now < measure_to ) {
+            wait_ns = std::min( wait_ns, schedule.top().first > now ? schedule.top().first - now : 0 );
+        }
+
+        const struct timespec timeout { static_cast<time_t>( wait_ns / 1000000000 ), static_cast<long>( wait_ns % 1000000000 ) };
+        const int             event_count = ::epoll_pwait2( worker.epoll_fd, events, EPOLL_ARRAY_SIZE, &timeout, nullptr );
+
+        now = LoadGenerator::now();
+
+        for( int i = 0; i < event_count; ++i ) {
+            auto & connection = worker.connections[ events[i].data.u32 ];
+
+            if( connection.state != ConnectionState::READY ) {
+                continue;
+            }
+
+            if( ( events[i].events & ( EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR ) ) &&
+                !receiveMessages( worker, connection, buffer, measure_from, measure_to ) )
+            {
+                closeClient( worker, connection );
+                ++worker.disconnections;
+                continue;
+            }
+
+            if( events[i].events & EPOLLOUT ) {
+                connection.writable = true;
+
+                if( connection.parked && now < measure_to ) { //back in the schedule with whatever is overdue
+                    send( connection, now );
+                }
+            }
+        }
+
+        if( now >= measure_to ) {
+            continue; //draining
+        }
+
+        if( _interval_ns > 0 ) {
+            while( !schedule.empty() && schedule.top().first <= now ) {
+                auto & connection = worker.connections[ schedule.top().second ];
+
+                schedule.pop();
+
+                if( connection.state == ConnectionState::READY ) {
+                    send( connection, now );
+                }
+            }
+
+        } else {
+            for( auto & connection : worker.connections ) {
+                if( connection.state == ConnectionState::READY && connection.writable ) {
+                    send( connection, now );
+                }
+            }
+        }
+    }
+}
+
+/**
+ * [PRIVATE] Starts connecting a client (non-blocking)
+ * @param worker Worker
+ * @param index Connection index in the worker
+ * @param pair Global pair index
+ * @return Success
+ */
+bool LoadGenerator::openClient( Worker_t & worker, size_t index, size_t pair ) {
+    auto &             connection = worker.connections[index];
+    struct sockaddr_in address {};
+    struct epoll_event event {};
+    int                yes { 1 };
+
+    address.sin_family = AF_INET;
+    address.sin_port   = htons( static_cast<uint16_t>( _options.port ) );
+
+    if( ::inet_pton( AF_INET, _options.address.c_str(), &address.sin_addr ) != 1 ) {
+        LOG_ERROR( "[bench::LoadGenerator::openClient(..)] Invalid address: " << _options.address );
+        return false; //EARLY RETURN
+    }
+
+    connection.pair       = pair;
+    connection.connect_at = LoadGenerator::now();
+
+    if( ( connection.fd = ::socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 ) ) == -1 ) {
+        LOG_ERROR( "[bench::LoadGenerator::openClient(..)] 'socket' error: " << ::strerror( errno ) );
+        return false; //EARLY RETURN
+    }
+
+    ::setsockopt( connection.fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof( int ) );
+
+    if( ::connect( connection.fd, ( struct sockaddr * ) &address, sizeof address ) == -1 && errno != EINPROGRESS ) {
+        LOG_WARNING( "[bench::LoadGenerator::openClient(..)] 'connect' error: " << ::strerror( errno ) );
+        return false; //EARLY RETURN
+    }
+
+    event.events   = EPOLLOUT;
+    event.data.u32 = static_cast<uint32_t>( index );
+
+    if( ::epoll_ctl( worker.epoll_fd, EPOLL_CTL_ADD, connection.fd, &event ) == -1 ) {
+        LOG_ERROR( "[bench::LoadGenerator::openClient(..)] 'epoll_ctl' error: " << ::strerror( errno ) );
+        return false; //EARLY RETURN
+    }
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Sends the handshake of a connected client
+ * @param worker Worker
+ * @param connection Client connection
+ * @return Success
+ */
+bool LoadGenerator::startHandshake( Worker_t & worker, Connection_t & connection ) {
+    int       error  = 0;
+    socklen_t length = sizeof( error );
+
+    if( ::getsockopt( connection.fd, SOL_SOCKET, SO_ERROR, &error, &length ) == -1 || error != 0 ) {
+        LOG_WARNING( "[bench::LoadGenerator::startHandshake(..)] Failed to connect: " << ::strerror( error ) );
+        return false; //EARLY RETURN
+    }
+
+    const auto handshake = ( _options.security == SecurityType::SECURED )
+                         ? ( _options.framed ? "AUTH3" : "AUTH1" ) + _secret_prefix + std::to_string( connection.pair ) + "\n"
+                         : std::string( _options.framed ? "AUTH2" : "AUTH0" );
+
+    if( ::send( connection.fd, handshake.data(), handshake.size(), MSG_NOSIGNAL ) != static_cast<ssize_t>( handshake.size() ) ) {
+        return false; //EARLY RETURN
+    }
+
+    struct epoll_event event {};
+
+    event.events     = EPOLLIN | EPOLLRDHUP;
+    event.data.u32   = static_cast<uint32_t>( &connection - worker.connections.data() );
+    connection.state = ConnectionState::HANDSHAKE;
+
+    return ::epoll_ctl( worker.epoll_fd, EPOLL_CTL_MOD, connection.fd, &event ) == 0;
+}
+
+/**
+ * [PRIVATE] Reads the server's `READY` (nothing past it is read)
+ * @param worker Worker
+ * @param connection Client connection
+ * @return Success
+ */
+bool LoadGenerator::receiveReady( Worker_t & worker, Connection_t & connection ) {
+    const auto ready = std::string_view( _ready );
+
+    char       buffer[proxy::FrameCursor::HEADER_SIZE]; //`READY` and its frame are the same size
+    const auto bytes = ::recv( connection.fd, buffer, ready.size() - connection.ready_matched, 0 );
+
+    if( bytes <= 0 ) {
+        return bytes == -1 && ( errno == EAGAIN || errno == EWOULDBLOCK ); //EARLY RETURN
+    }
+
+    if( ready.substr( connection.ready_matched, static_cast<size_t>( bytes ) ) != std::string_view( buffer, static_cast<size_t>( bytes ) ) ) {
+        return false; //EARLY RETURN
+    }
+
+    connection.ready_matched += static_cast<uint8_t>( bytes );
+
+    if( connection.ready_matched == ready.size() ) {
+        connection.state = ConnectionState::READY;
+        worker.ready_us->record( ( LoadGenerator::now() - connection.connect_at ) / 1000 );
+        ++worker.ready;
+    }
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Reads everything available on a client and records the messages sent within the measurement
+ * @param worker Worker
+ * @param connection Client connection
+ * @param buffer Read buffer
+ * @param measure_from Measurement start (ns)
+ * @param measure_to Measurement end (ns)
+ * @return Client still connected
+ */
+bool LoadGenerator::receiveMessages( Worker_t & worker, Connection_t & connection, std::vector<char> & buffer, uint64_t measure_from, uint64_t measure_to ) {
+    const auto size   = _wire_size;
+    const auto header = _frame_header.size();
+
+    while( true ) {
+        const auto bytes = ::recv( connection.fd, buffer.data(), buffer.size(), 0 );
+
+        if( bytes == 0 ) {
+            return false; //EARLY RETURN
+        }
+
+        if( bytes == -1 ) {
+            return errno == EAGAIN || errno == EWOULDBLOCK; //EARLY RETURN
+        }
+
+        const auto now    = LoadGenerator::now();
+        size_t     offset = 0;
+
+        while( offset < static_cast<size_t>( bytes ) ) {
+            const auto remaining = static_cast<size_t>( bytes ) - offset;
+            size_t     length;
+
+            if( connection.in_pos < header ) { //same for every message
+                length = std::min( header - connection.in_pos, remaining );
+            } else if( connection.in_pos < header + TIMESTAMP_SIZE ) {
+                length = std::min( header + TIMESTAMP_SIZE - connection.in_pos, remaining );
+                std::memcpy( reinterpret_cast<char *>( &connection.in_timestamp ) + ( connection.in_pos - header ), buffer.data() + offset, length );
+            } else {
+                length = std::min( size - connection.in_pos, remaining );
+            }
+
+            offset            += length;
+            connection.in_pos += length;
+
+            if( connection.in_pos == size ) {
+                const auto sent_at = connection.in_timestamp;
+
+                if( sent_at >= measure_from && sent_at < measure_to ) {
+                    worker.latency_ns->record( now > sent_at ? now - sent_at : 0 );
+                    worker.bytes_received += _options.message_size;
+                    ++worker.received;
+                }
+
+                connection.in_pos = 0;
+            }
+        }
+    }
+}
+
+/**
+ * [PRIVATE] Sends the messages a client is due to send (as many as the socket takes when unpaced)
+ * @param worker Worker
+ * @param connection Client connection
+ * @param scratch Buffer pre-filled with the message padding
+ * @param now Current time (ns)
+ * @param measure_from Measurement start (ns)
+ * @param measure_to Measurement end (ns)
+ * @return Client still connected
+ */
+bool LoadGenerator::sendMessages( Worker_t & worker, Connection_t & connection, std::vector<char> & scratch, uint64_t now, uint64_t measure_from, uint64_t measure_to ) {
+    const auto size = _wire_size;
+
+    if( !connection.pending.empty() ) { //finish the partially sent message first
+        const auto bytes = ::send( connection.fd, connection.pending.data(), connection.pending.size(), MSG_NOSIGNAL );
+
+        if( bytes == -1 ) {
+            connection.writable = false;
+            return errno == EAGAIN || errno == EWOULDBLOCK; //EARLY RETURN
+        }
+
+        connection.pending.erase( 0, static_cast<size_t>( bytes ) );
+
+        if( !connection.pending.empty() ) {
+            connection.writable = false;
+            return true; //EARLY RETURN
+        }
+    }
+
+    uint64_t count = scratch.size() / size;
+
+    if( _interval_ns > 0 ) {
+        if( now < connection.next_due ) {
+            return true; //EARLY RETURN
+        }
+
+        count = std::min( count, ( now - connection.next_due ) / _interval_ns + 1 );
+    }
+
+    for( uint64_t i = 0; i < count; ++i ) { //paced messages carry the time they were due, not the time they actually left
+        const uint64_t timestamp = ( _interval_ns > 0 ) ? connection.next_due + i * _interval_ns : now;
+
+        std::memcpy( scratch.data() + i * size, _frame_header.data(), _frame_header.size() );
+        std::memcpy( scratch.data() + i * size + _frame_header.size(), &timestamp, TIMESTAMP_SIZE );
+    }
+
+    const auto length = count * size;
+    const auto bytes  = ::send( connection.fd, scratch.data(), length, MSG_NOSIGNAL );
+
+    if( bytes == -1 ) {
+        connection.writable = false;
+        return errno == EAGAIN || errno == EWOULDBLOCK; //EARLY RETURN
+    }
+
+    const auto whole   = static_cast<size_t>( bytes ) / size;
+    const auto partial = static_cast<size_t>( bytes ) % size;
+    const auto started = whole + ( partial > 0 ? 1 : 0 );
+
+    if( partial > 0 ) {
+        connection.pending.assign( scratch.data() + whole * size + partial, size - partial );
+    }
+
+    if( static_cast<size_t>( bytes ) < length ) {
+        connection.writable = false;
+    }
+
+    for( size_t i = 0; i < started; ++i ) {
+        const uint64_t timestamp = ( _interval_ns > 0 ) ? connection.next_due + i * _interval_ns : now;
+
+        if( timestamp >= measure_from && timestamp < measure_to ) {
+            ++worker.sent;
+        }
+    }
+
+    if( _interval_ns > 0 ) {
+        connection.next_due += started * _interval_ns;
+    }
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Closes a client
+ * @param worker Worker
+ * @param connection Client connection
+ */
+void LoadGenerator::closeClient( Worker_t & worker, Connection_t & connection ) {
+    if( connection.fd != -1 ) {
+        ::epoll_ctl( worker.epoll_fd, EPOLL_CTL_DEL, connection.fd, nullptr );
+        ::close( connection.fd );
+        connection.fd = -1;
+    }
+
+    connection.state = ConnectionState::CLOSED;
+}
+
+/**
+ * [PRIVATE] Gets the current time on the clock used for the timestamps
+ * @return Monotonic time in ns
+ */
+uint64_t LoadGenerator::now() {
+    struct timespec ts {};
+
+    ::clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return static_cast<uint64_t>( ts.tv_sec ) * 1000000000 + static_cast<uint64_t>( ts.tv_nsec );
+}
+
+/**
+ * [PRIVATE] Gets the header every message starts with (all messages have the same size)
+ * @param options Bench options
+ * @return `DATA` frame header when framed, empty string otherwise
+ */
+std::string LoadGenerator::frameHeader( const BenchOptions & options ) {
+    if( !options.framed ) {
+        return {}; //EARLY RETURN
+    }
+
+    auto header = std::string( proxy::FrameCursor::HEADER_SIZE, '\0' );
+
+    proxy::FrameCursor::encodeHeader( FrameType::DATA, static_cast<uint32_t>( options.message_size ), header.data() );
+
+    return header;
+}
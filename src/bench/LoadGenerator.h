@@ -0,0 +1,111 @@
+#ifndef FWD_PROXY_BENCH_LOADGENERATOR_H
+#define FWD_PROXY_BENCH_LOADGENERATOR_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <barrier>
+#include <atomic>
+
+#include "../metrics/Histogram.h"
+#include "BenchOptions.h"
+
+namespace fwd_proxy::bench {
+    /**
+     * End-to-end load generator for the proxy
+     * Clients are opened in pairs (anonymous or with a unique secret per pair) and split across threads,
+     * each driving its share through its own epoll instance. Once every client is READY (or has failed),
+     * all of them send fixed size messages at the configured rate. Each message starts with the time it
+     * was due to be sent so that the receiving end can measure the one-way latency, including any time
+     * spent queued behind a backed up connection (no coordinated omission).
+     */
+    class LoadGenerator {
+      public:
+        struct Report_t {
+            size_t                         clients_ready     { 0 };
+            size_t                         clients_failed    { 0 };
+            size_t                         disconnections    { 0 }; //during the load
+            uint64_t                       setup_us          { 0 }; //until every client was READY or had failed
+            metrics::Histogram::Snapshot_t ready_us;                //connection to READY, by client
+            uint64_t                       measured_us       { 0 };
+            uint64_t                       messages_sent     { 0 };
+            uint64_t                       messages_received { 0 };
+            uint64_t                       bytes_received    { 0 };
+            metrics::Histogram::Snapshot_t latency_ns;              //one-way, by message
+        };
+
+        explicit LoadGenerator( BenchOptions options );
+        LoadGenerator( const LoadGenerator & ) = delete;
+        ~LoadGenerator();
+
+        LoadGenerator & operator =( const LoadGenerator & ) = delete;
+
+        Report_t run();
+
+      private:
+        typedef int FileDescriptor_t;
+
+        enum class ConnectionState : uint8_t {
+            CONNECTING = 0,
+            HANDSHAKE,
+            READY,
+            CLOSED,
+        };
+
+        struct Connection_t {
+            FileDescriptor_t fd            { -1 };
+            ConnectionState  state         { ConnectionState::CONNECTING };
+            size_t           pair          { 0 };     //global pair index
+            uint8_t          ready_matched { 0 };     //bytes of `_ready` received so far
+            bool             writable      { false };
+            bool             parked        { false }; //out of the send schedule until writable
+            uint64_t         connect_at    { 0 };     //ns
+            uint64_t         next_due      { 0 };     //send time of the next message (ns)
+            std::string      pending;                 //unsent end of a partially sent message
+            size_t           in_pos        { 0 };     //position in the message being received
+            uint64_t         in_timestamp  { 0 };
+        };
+
+        struct Worker_t {
+            FileDescriptor_t                    epoll_fd       { -1 };
+            std::vector<Connection_t>           connections;
+            size_t                              opened         { 0 };
+            size_t                              ready          { 0 };
+            size_t                              failed         { 0 };
+            size_t                              disconnections { 0 };
+            uint64_t                            sent           { 0 };
+            uint64_t                            received       { 0 };
+            uint64_t                            bytes_received { 0 };
+            std::unique_ptr<metrics::Histogram> ready_us       { std::make_unique<metrics::Histogram>() };
+            std::unique_ptr<metrics::Histogram> latency_ns     { std::make_unique<metrics::Histogram>() };
+            std::thread                         thread;
+        };
+
+        const BenchOptions    _options;
+        const uint64_t        _interval_ns; //between 2 messages of a client (0 = no pacing)
+        const std::string     _secret_prefix;
+        const std::string     _ready;        //server's `READY` (plain or as a frame)
+        const std::string     _frame_header; //prefix of every message (empty unless framed)
+        const size_t          _wire_size;    //message size including `_frame_header`
+        std::vector<Worker_t> _workers;
+        std::barrier<>        _barrier;     //workers + caller, between setup and load
+        uint64_t              _setup_start; //ns
+        std::atomic<uint64_t> _load_start;  //ns
+
+        void runWorker( Worker_t & worker );
+        void setupClients( Worker_t & worker );
+        void generateLoad( Worker_t & worker );
+        bool openClient( Worker_t & worker, size_t index, size_t pair );
+        bool startHandshake( Worker_t & worker, Connection_t & connection );
+        bool receiveReady( Worker_t & worker, Connection_t & connection );
+        bool receiveMessages( Worker_t & worker, Connection_t & connection, std::vector<char> & buffer, uint64_t measure_from, uint64_t measure_to );
+        bool sendMessages( Worker_t & worker, Connection_t & connection, std::vector<char> & scratch, uint64_t now, uint64_t measure_from, uint64_t measure_to );
+        void closeClient( Worker_t & worker, Connection_t & connection );
+
+        static uint64_t    now();
+        static std::string frameHeader( const BenchOptions & options );
+    };
+}
+
+#endif //FWD_PROXY_BENCH_LOADGENERATOR_H
@@ -0,0 +1,326 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <csignal>
+#include <getopt.h>
+
+#include <sys/resource.h>
+
+#include "enum/SecurityType.h"
+#include "enum/ForwardingMode.h"
+#include "enum/IoBackend.h"
+#include "enum/TcpProfile.h"
+#include "enum/LogLevel.h"
+#include "bench/BenchOptions.h"
+#include "bench/LoadGenerator.h"
+#include "proxy/Server.h"
+#include "logger/Logger.h"
+
+#define FDS_PER_PAIR 4 //2 clients + their 2 server-side connections when embedded
+
+void printHelp();
+void printReport( const fwd_proxy::bench::BenchOptions & options, const fwd_proxy::bench::LoadGenerator::Report_t & report );
+bool raiseFileLimit( rlim_t needed );
+
+int main( int argc, char **argv ) {
+    using namespace fwd_proxy;
+
+    signal( SIGPIPE, SIG_IGN ); //writes to a closed socket are handled as errors instead
+
+    //Process CLI arguments
+    const static struct option long_options[] = {
+        {"address",        required_argument, nullptr, 'A'},
+        {"port",           required_argument, nullptr, 'p'},
+        {"pairs",          required_argument, nullptr, 'n'},
+        {"secrets",        no_argument,       nullptr, 'S'},
+        {"size",           required_argument, nullptr, 'z'},
+        {"rate",           required_argument, nullptr, 'r'},
+        {"duration",       required_argument, nullptr, 't'},
+        {"warmup",         required_argument, nullptr, 'W'},
+        {"threads",        required_argument, nullptr, 'j'},
+        {"connect-window", required_argument, nullptr, 'c'},
+        {"external",       no_argument,       nullptr, 'x'},
+        {"forwarding",     required_argument, nullptr, 'f'},
+        {"workers",        required_argument, nullptr, 'w'},
+        {"backend",        required_argument, nullptr, 'b'},
+        {"framed",         no_argument,       nullptr, 'F'},
+        {"coalesce-us",    required_argument, nullptr, 'C'},
+        {"tcp-profile",    required_argument, nullptr, 'T'},
+        {"log-level",      required_argument, nullptr, 'l'},
+        {"help",           no_argument,       nullptr, 'h'},
+        {nullptr,          0,                 nullptr,  0 },
+    };
+
+    bool    error          = false;
+    bool    external       = false;
+    int     option         = -1;
+    int     option_index   =  0;
+    auto    options        = bench::BenchOptions();
+    auto    server_options = proxy::ServerOptions();
+
+    logger::Logger::setLevel( LogLevel::WARNING ); //the server logs every connection at INFO
+
+    while( ( option = getopt_long( argc, argv, "A:p:n:Sz:r:t:W:j:c:xf:w:b:FC:T:l:h", long_options, &option_index) ) != -1 ) {
+        switch( option ) {
+            case 'A': {
+                options.address = std::string( optarg );
+            } break;
+
+            case 'p': {
+                options.port = static_cast<int>( std::strtol( optarg, nullptr, 10 ) );
+            } break;
+
+            case 'n': {
+                options.pairs = std::strtoul( optarg, nullptr, 10 );
+            } break;
+
+            case 'S': {
+                options.security = SecurityType::SECURED;
+            } break;
+
+            case 'z': {
+                options.message_size = std::strtoul( optarg, nullptr, 10 );
+
+                if( options.message_size < sizeof( uint64_t ) ) {
+                    std::cerr << "Error: messages need at least " << sizeof( uint64_t ) << " bytes for their timestamp." << std::endl;
+                    error = true;
+                }
+            } break;
+
+            case 'r': {
+                options.rate = std::strtoull( optarg, nullptr, 10 );
+            } break;
+
+            case 't': {
+                options.duration_ms = std::strtoull( optarg, nullptr, 10 ) * 1000;
+            } break;
+
+            case 'W': {
+                options.warmup_ms = std::strtoull( optarg, nullptr, 10 ) * 1000;
+            } break;
+
+            case 'j': {
+                options.threads = std::strtoul( optarg, nullptr, 10 );
+            } break;
+
+            case 'c': {
+                options.connect_window = std::strtoul( optarg, nullptr, 10 );
+            } break;
+
+            case 'x': {
+                external = true;
+            } break;
+
+            case 'f': {
+                auto mode = std::string( optarg );
+
+                if( mode == "copy" ) {
+                    server_options.forwarding_mode = ForwardingMode::COPY;
+                } else if( mode == "splice" ) {
+                    server_options.forwarding_mode = ForwardingMode::SPLICE;
+                } else {
+                    error = true;
+                    printHelp();
+                }
+            } break;
+
+            case 'w': {
+                server_options.proxy_workers = std::strtoul( optarg, nullptr, 10 );
+            } break;
+
+            case 'b': {
+                auto backend = std::string( optarg );
+
+                if( backend == "epoll" ) {
+                    server_options.io_backend = IoBackend::EPOLL;
+                } else if( backend == "io_uring" ) {
+                    server_options.io_backend = IoBackend::IO_URING;
+                } else {
+                    error = true;
+                    printHelp();
+                }
+            } break;
+
+            case 'F': {
+                options.framed = true;
+            } break;
+
+            case 'C': {
+                server_options.coalesce_us = std::strtoull( optarg, nullptr, 10 );
+            } break;
+
+            case 'T': {
+                auto profile = std::string( optarg );
+
+                if( profile == "kernel" ) {
+                    server_options.socket_tuning = proxy::SocketTuning::profile( TcpProfile::KERNEL );
+                } else if( profile == "latency" ) {
+                    server_options.socket_tuning = proxy::SocketTuning::profile( TcpProfile::LATENCY );
+                } else if( profile == "bulk" ) {
+                    server_options.socket_tuning = proxy::SocketTuning::profile( TcpProfile::BULK );
+                } else {
+                    error = true;
+                    printHelp();
+                }
+            } break;
+
+            case 'l': {
+                auto level = std::string( optarg );
+
+                if( level == "trace" ) {
+                    logger::Logger::setLevel( LogLevel::TRACE );
+                } else if( level == "debug" ) {
+                    logger::Logger::setLevel( LogLevel::DEBUG );
+                } else if( level == "info" ) {
+                    logger::Logger::setLevel( LogLevel::INFO );
+                } else if( level == "warning" ) {
+                    logger::Logger::setLevel( LogLevel::WARNING );
+                } else if( level == "error" ) {
+                    logger::Logger::setLevel( LogLevel::ERROR );
+                } else if( level == "off" ) {
+                    logger::Logger::setLevel( LogLevel::OFF );
+                } else {
+                    error = true;
+                    printHelp();
+                }
+            } break;
+
+            case 'h': {
+                printHelp();
+                exit( EXIT_SUCCESS );
+            } break;
+
+            case '?': [[fallthrough]];
+            default: {
+                error = true;
+                printHelp();
+            } break;
+        }
+
+        option_index = 0;
+    }
+
+    if( error ) {
+        exit( EXIT_FAILURE );
+    }
+
+    if( !raiseFileLimit( options.pairs * FDS_PER_PAIR + 1024 ) ) {
+        std::cerr << "Warning: the open file limit is too low for " << options.pairs << " pairs (see `ulimit -n`)." << std::endl;
+    }
+
+    //Get started...
+    logger::Logger::instance().start();
+
+    std::unique_ptr<proxy::Server> server;
+
+    if( !external ) {
+        server = std::make_unique<proxy::Server>( options.port, server_options );
+
+        if( !server->start() ) {
+            std::cerr << "Error: failed to start the embedded server on port " << options.port << std::endl;
+            logger::Logger::instance().stop();
+            exit( EXIT_FAILURE );
+        }
+    }
+
+    std::cout << "Target : " << options.address << ":" << options.port << ( external ? " (external)" : " (embedded)" ) << "\n"
+              << "Pairs  : " << options.pairs << ( options.security == SecurityType::SECURED ? " (a secret each)" : " (anonymous)" )
+              << ( options.framed ? ", framed" : "" ) << "\n"
+              << "Load   : " << options.message_size << " B messages, ";
+
+    if( options.rate > 0 ) {
+        std::cout << options.rate << " msg/s per client";
+    } else {
+        std::cout << "unpaced";
+    }
+
+    std::cout << ", " << options.duration_ms / 1000 << " s (+" << options.warmup_ms / 1000 << " s warm-up) on "
+              << options.threads << " thread(s)" << std::endl;
+
+    auto generator = bench::LoadGenerator( options );
+    auto report    = generator.run();
+
+    if( server ) { //before the clients disconnect
+        server->stop();
+        server.reset();
+    }
+
+    logger::Logger::instance().stop();
+    printReport( options, report );
+
+    return report.clients_ready > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Prints CLI help
+ */
+void printHelp() {
+    std::cout << "Usage:\n"
+              << "  -A, --address <address>     Set the proxy address (default: 127.0.0.1)\n"
+              << "  -p, --port <port>           Set the proxy port (default: 9595)\n"
+              << "  -n, --pairs <n>             Set the number of client pairs (default: 1000)\n"
+              << "  -S, --secrets               Give each pair its own secret (default: anonymous)\n"
+              << "  -z, --size <bytes>          Set the message size (>= 8, default: 64)\n"
+              << "  -r, --rate <n>              Set the messages sent per second by each client (0 = unpaced, default: 100)\n"
+              << "  -t, --duration <s>          Set the measured load duration (default: 10)\n"
+              << "  -W, --warmup <s>            Set the load duration before measuring (default: 1)\n"
+              << "  -j, --threads <n>           Set the number of load threads (default: 1)\n"
+              << "  -c, --connect-window <n>    Set the clients per thread connecting at the same time (default: 64)\n"
+              << "  -x, --external              Use an already running proxy instead of starting one in-process\n"
+              << "  -f, --forwarding <fwd>      Set the forwarding method (copy/splice, default: splice - embedded only)\n"
+              << "  -w, --workers <n>           Set the number of proxy workers (default: 1 per CPU - embedded only)\n"
+              << "  -b, --backend <backend>     Set the I/O backend (epoll/io_uring, default: epoll - embedded only)\n"
+              << "  -F, --framed                Use the framed protocol (each message is sent as 1 frame)\n"
+              << "  -C, --coalesce-us <us>      Set how long framed writes may be held back to coalesce them (default: 0 - embedded only)\n"
+              << "  -T, --tcp-profile <profile> Set the TCP settings of the accepted sockets (kernel/latency/bulk, default: kernel - embedded only)\n"
+              << "  -l, --log-level <level>     Set the lowest level logged (trace/debug/info/warning/error/off, default: warning)\n"
+              << std::endl;
+}
+
+/**
+ * Prints the bench results
+ * @param options Bench options
+ * @param report Load generator report
+ */
+void printReport( const fwd_proxy::bench::BenchOptions & options, const fwd_proxy::bench::LoadGenerator::Report_t & report ) {
+    const auto setup_s    = static_cast<double>( report.setup_us ) / 1e6;
+    const auto measured_s = static_cast<double>( report.measured_us ) / 1e6;
+    const auto pairs      = report.clients_ready / 2;
+    const auto us         = [&report]( double q ) { return static_cast<double>( report.latency_ns.quantile( q ) ) / 1e3; };
+    const auto ms         = [&report]( double q ) { return static_cast<double>( report.ready_us.quantile( q ) ) / 1e3; };
+
+    std::cout << std::fixed << std::setprecision( 1 )
+              << "\n"
+              << "Clients    : " << report.clients_ready << " READY, " << report.clients_failed << " failed, "
+              << report.disconnections << " disconnected during the load\n"
+              << "Pair setup : " << pairs << " pairs in " << std::setprecision( 3 ) << setup_s << " s ("
+              << std::setprecision( 1 ) << ( setup_s > 0 ? static_cast<double>( pairs ) / setup_s : 0 ) << " pairs/s)\n"
+              << "To READY   : p50 " << ms( 0.5 ) << " ms | p99 " << ms( 0.99 ) << " ms | p999 " << ms( 0.999 ) << " ms | max " << ms( 1 ) << " ms\n"
+              << "Sent       : " << report.messages_sent << " msgs (" << static_cast<double>( report.messages_sent ) / measured_s << " msg/s)\n"
+              << "Received   : " << report.messages_received << " msgs (" << static_cast<double>( report.messages_received ) / measured_s << " msg/s, "
+              << std::setprecision( 2 ) << static_cast<double>( report.bytes_received ) / measured_s / ( 1024 * 1024 ) << " MiB/s)\n"
+              << std::setprecision( 1 )
+              << "Latency    : p50 " << us( 0.5 ) << " us | p99 " << us( 0.99 ) << " us | p999 " << us( 0.999 ) << " us | max " << us( 1 ) << " us"
+              << ( options.rate > 0 ? "" : " (unpaced: includes queueing)" )
+              << std::endl;
+}
+
+/**
+ * Raises the soft limit on open files (up to the hard limit)
+ * @param needed File descriptors needed
+ * @return Limit high enough
+ */
+bool raiseFileLimit( rlim_t needed ) {
+    struct rlimit limit {};
+
+    if( ::getrlimit( RLIMIT_NOFILE, &limit ) == -1 ) {
+        return false; //EARLY RETURN
+    }
+
+    if( limit.rlim_cur < needed ) {
+        limit.rlim_cur = std::min( needed, limit.rlim_max );
+        ::setrlimit( RLIMIT_NOFILE, &limit );
+    }
+
+    return limit.rlim_cur >= needed;
+}
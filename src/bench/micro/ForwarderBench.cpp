@@ -0,0 +1,70 @@
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "enum/ForwardingMode.h"
+#include "proxy/Forwarder.h"
+#include "SocketPair.h"
+
+using namespace fwd_proxy;
+
+#define FORWARD_BUDGET 1048576 //same as the proxy workers
+
+/**
+ * Single pair, one direction: a message written by the source client is forwarded over the proxy's 2 socket ends
+ * and read back in full by the destination client (the forwarder is driven as many times as the message needs)
+ * Args: forwarding mode (0 = copy, 1 = splice), message size
+ */
+static void BM_ForwardPair( benchmark::State & state ) {
+    const auto mode      = ( state.range( 0 ) == 0 ? ForwardingMode::COPY : ForwardingMode::SPLICE );
+    const auto size      = static_cast<size_t>( state.range( 1 ) );
+    auto       src       = bench::micro::SocketPair();
+    auto       dst       = bench::micro::SocketPair();
+    auto       forwarder = proxy::Forwarder( mode );
+    auto       message   = std::vector<char>( size, 'x' );
+    auto       received  = std::vector<char>( size );
+    size_t     calls     = 0;
+
+    if( !src.valid() || !dst.valid() ) {
+        state.SkipWithError( "socketpair(..) failed" );
+        return; //EARLY RETURN
+    }
+
+    for( auto _ : state ) {
+        size_t sent = 0;
+        size_t read = 0;
+
+        while( read < size ) {
+            if( sent < size ) {
+                const auto bytes = ::send( src.peer, message.data() + sent, size - sent, 0 );
+
+                sent += ( bytes > 0 ? static_cast<size_t>( bytes ) : 0 );
+            }
+
+            const auto result = forwarder.forward( src.local, dst.local, FORWARD_BUDGET );
+
+            ++calls;
+
+            if( result.last_read == 0 || result.write_errno != 0 ) {
+                state.SkipWithError( "forwarding failed" );
+                return; //EARLY RETURN
+            }
+
+            if( forwarder.pending() > 0 ) { //destination pushed back
+                forwarder.flush( dst.local );
+            }
+
+            for( ssize_t bytes = 1; bytes > 0 && read < size; ) {
+                bytes = ::recv( dst.peer, received.data() + read, size - read, 0 );
+                read += ( bytes > 0 ? static_cast<size_t>( bytes ) : 0 );
+            }
+        }
+    }
+
+    state.SetBytesProcessed( static_cast<int64_t>( state.iterations() * size ) );
+    state.counters[ "calls/msg" ] = static_cast<double>( calls ) / static_cast<double>( state.iterations() );
+    state.counters[ "buffer" ]    = static_cast<double>( forwarder.size() );
+    state.SetLabel( mode == ForwardingMode::COPY ? "copy" : ( forwarder.splicing() ? "splice" : "splice (fell back to copy)" ) );
+}
+
+BENCHMARK( BM_ForwardPair )->ArgNames( { "splice", "size" } )->ArgsProduct( { { 0, 1 }, { 64, 4096, 65536 } } );
@@ -0,0 +1,91 @@
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "proxy/Handshake.h"
+#include "proxy/HandshakeParser.h"
+#include "SocketPair.h"
+
+using namespace fwd_proxy;
+
+namespace {
+    /**
+     * Builds a handshake
+     * @param secret_length Secret length (0 for an anonymous `AUTH0` handshake)
+     * @return Handshake bytes
+     */
+    std::string makeHandshake( size_t secret_length ) {
+        return ( secret_length == 0 ? std::string( "AUTH0" ) : "AUTH1" + std::string( secret_length, 's' ) + "\n" );
+    }
+}
+
+/**
+ * Parsing alone (no syscalls): a complete handshake fed in `range(1)` segments
+ * Args: secret length, segments
+ */
+static void BM_HandshakeProcess( benchmark::State & state ) {
+    const auto   handshake = makeHandshake( static_cast<size_t>( state.range( 0 ) ) );
+    const auto   segments  = static_cast<size_t>( state.range( 1 ) );
+    const size_t step      = ( handshake.size() + segments - 1 ) / segments;
+
+    for( auto _ : state ) {
+        proxy::HandshakeParser parser;
+        proxy::FrameCursor     frames;
+        HandshakeState         result = HandshakeState::INIT;
+
+        for( size_t pos = 0; pos < handshake.size(); pos += step ) {
+            const auto length = std::min( step, handshake.size() - pos );
+
+            result = proxy::Handshake::process( -1, parser, frames, handshake.data() + pos, static_cast<ssize_t>( length ) );
+        }
+
+        benchmark::DoNotOptimize( result );
+    }
+
+    state.SetItemsProcessed( static_cast<int64_t>( state.iterations() ) );
+}
+
+/**
+ * Receive + parse over a socketpair: the client sends its handshake in `range(1)` segments, each picked up by a
+ * separate receive as it would be on separate readiness events
+ * Args: secret length, segments
+ */
+static void BM_HandshakeReceive( benchmark::State & state ) {
+    const auto   handshake = makeHandshake( static_cast<size_t>( state.range( 0 ) ) );
+    const auto   segments  = static_cast<size_t>( state.range( 1 ) );
+    const size_t step      = ( handshake.size() + segments - 1 ) / segments;
+    auto         sockets   = bench::micro::SocketPair();
+
+    if( !sockets.valid() ) {
+        state.SkipWithError( "socketpair(..) failed" );
+        return; //EARLY RETURN
+    }
+
+    for( auto _ : state ) {
+        proxy::HandshakeParser parser;
+        proxy::FrameCursor     frames;
+        HandshakeState         result = HandshakeState::INIT;
+
+        for( size_t pos = 0; pos < handshake.size(); pos += step ) {
+            const auto length = std::min( step, handshake.size() - pos );
+
+            if( ::send( sockets.peer, handshake.data() + pos, length, 0 ) != static_cast<ssize_t>( length ) ) {
+                state.SkipWithError( "send(..) failed" );
+                return; //EARLY RETURN
+            }
+
+            result = proxy::Handshake::receive( sockets.local, parser, frames );
+        }
+
+        if( result != HandshakeState::READY ) {
+            state.SkipWithError( "handshake incomplete" );
+            return; //EARLY RETURN
+        }
+    }
+
+    state.SetItemsProcessed( static_cast<int64_t>( state.iterations() ) );
+}
+
+BENCHMARK( BM_HandshakeProcess )->ArgNames( { "secret", "segments" } )->ArgsProduct( { { 0, 32, 64 }, { 1, 4 } } );
+BENCHMARK( BM_HandshakeReceive )->ArgNames( { "secret", "segments" } )->ArgsProduct( { { 0, 32, 64 }, { 1, 4 } } );
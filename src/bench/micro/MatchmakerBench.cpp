@@ -0,0 +1,76 @@
+#include <benchmark/benchmark.h>
+
+#include "proxy/Matchmaker.h"
+
+using namespace fwd_proxy;
+
+#define FIRST_FD 16 //clear of the standard streams (the matchmaker never touches the file descriptors)
+
+/**
+ * Pairing with `range(0)` other clients already waiting, each on its own secret:
+ * a client arrives and waits, then its counterpart arrives and takes it
+ */
+static void BM_MatchmakerPair( benchmark::State & state ) {
+    const auto waiting    = static_cast<int>( state.range( 0 ) );
+    auto       matchmaker = proxy::Matchmaker( static_cast<size_t>( waiting ) + FIRST_FD + 2 );
+
+    for( int i = 0; i < waiting; ++i ) {
+        matchmaker.match( FIRST_FD + 2 + i, static_cast<proxy::Matchmaker::Secret_t>( i + 1 ) );
+    }
+
+    for( auto _ : state ) {
+        matchmaker.match( FIRST_FD, 0 );
+        benchmark::DoNotOptimize( matchmaker.match( FIRST_FD + 1, 0 ) );
+    }
+
+    state.SetItemsProcessed( static_cast<int64_t>( state.iterations() ) );
+}
+
+/**
+ * Anonymous clients arriving in bursts of `range(0)` before any counterpart shows up (deep queue on a single secret),
+ * then each paired in arrival order
+ */
+static void BM_MatchmakerBurst( benchmark::State & state ) {
+    const auto burst      = static_cast<int>( state.range( 0 ) );
+    auto       matchmaker = proxy::Matchmaker( static_cast<size_t>( burst ) * 2 + FIRST_FD );
+
+    for( auto _ : state ) {
+        for( int i = 0; i < burst; ++i ) {
+            matchmaker.match( FIRST_FD + i, 0 );
+        }
+
+        for( int i = 0; i < burst; ++i ) {
+            benchmark::DoNotOptimize( matchmaker.match( FIRST_FD + burst + i, 0 ) );
+        }
+    }
+
+    state.SetItemsProcessed( static_cast<int64_t>( state.iterations() ) * burst );
+}
+
+/**
+ * Waiting client leaving (timeout/disconnection) from a queue of `range(0)` clients sharing its secret, then
+ * re-queued (i.e. an orphaned client coming back) so that the queue length stays steady
+ */
+static void BM_MatchmakerRemove( benchmark::State & state ) {
+    const auto queued     = static_cast<int>( state.range( 0 ) );
+    auto       matchmaker = proxy::Matchmaker( static_cast<size_t>( queued ) + FIRST_FD );
+    int        next       = 0;
+
+    for( int i = 0; i < queued; ++i ) {
+        matchmaker.match( FIRST_FD + i, 0 );
+    }
+
+    for( auto _ : state ) {
+        const auto fd = FIRST_FD + ( next * 7919 ) % queued; //spread across the queue
+
+        matchmaker.remove( fd );
+        matchmaker.match( fd, 0 );
+        next = ( next + 1 ) % queued;
+    }
+
+    state.SetItemsProcessed( static_cast<int64_t>( state.iterations() ) );
+}
+
+BENCHMARK( BM_MatchmakerPair )->ArgName( "waiting" )->RangeMultiplier( 16 )->Range( 1, 65536 );
+BENCHMARK( BM_MatchmakerBurst )->ArgName( "burst" )->RangeMultiplier( 16 )->Range( 16, 65536 );
+BENCHMARK( BM_MatchmakerRemove )->ArgName( "queued" )->RangeMultiplier( 16 )->Range( 16, 65536 );
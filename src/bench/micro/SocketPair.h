@@ -0,0 +1,39 @@
+#ifndef FWD_PROXY_BENCH_MICRO_SOCKETPAIR_H
+#define FWD_PROXY_BENCH_MICRO_SOCKETPAIR_H
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+namespace fwd_proxy::bench::micro {
+    /**
+     * Connected pair of non-blocking local stream sockets (`peer` stands for the remote client, `local` for the proxy's end)
+     */
+    struct SocketPair {
+        int peer  { -1 };
+        int local { -1 };
+
+        SocketPair() {
+            int fds[2] = { -1, -1 };
+
+            if( ::socketpair( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds ) == 0 ) {
+                peer  = fds[0];
+                local = fds[1];
+            }
+        }
+
+        SocketPair( const SocketPair & ) = delete;
+        SocketPair & operator =( const SocketPair & ) = delete;
+
+        ~SocketPair() {
+            if( peer  != -1 ) { ::close( peer );  }
+            if( local != -1 ) { ::close( local ); }
+        }
+
+        [[nodiscard]] bool valid() const {
+            return peer != -1 && local != -1;
+        }
+    };
+}
+
+#endif //FWD_PROXY_BENCH_MICRO_SOCKETPAIR_H
@@ -0,0 +1,24 @@
+#include <csignal>
+
+#include <benchmark/benchmark.h>
+
+#include "enum/LogLevel.h"
+#include "logger/Logger.h"
+
+int main( int argc, char **argv ) {
+    using namespace fwd_proxy;
+
+    signal( SIGPIPE, SIG_IGN );
+    logger::Logger::setLevel( LogLevel::OFF ); //the units log every disconnection/malformed handshake
+
+    benchmark::Initialize( &argc, argv );
+
+    if( benchmark::ReportUnrecognizedArguments( argc, argv ) ) {
+        return EXIT_FAILURE;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    return EXIT_SUCCESS;
+}
@@ -1,8 +1,15 @@
 #include "Client.h"
 
 #include <iostream>
+#include <chrono>
+#include <cstring>
 
 #include <unistd.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
@@ -14,6 +21,12 @@
 #define EPOLL_ARRAY_SIZE            10
 #define EPOLL_PENDING_QUEUE_LENGTH  10 //size is ignored since Linux 2.6.8
 #define INPUT_BUFFER_SIZE          512
+#define OUT_QUEUE_SIZE            4096 //chunks handed over to the I/O thread but not picked up yet
+#define WRITEV_MAX_CHUNKS           64 //iovec entries per `writev` (< IOV_MAX)
+#define STREAM_CHUNK_SIZE      1048576 //max bytes per `sendfile`/`splice` when streaming
+#define STREAM_BUFFER_SIZE      262144 //when streaming through user space
+#define PEER_LEFT_NOTICE    "DISCONNECTED" //sent by the server when the counterpart leaves
+#define PEER_LEFT_NOTICE_LEN        12
 
 using namespace fwd_proxy::client;
 
@@ -22,14 +35,26 @@ using namespace fwd_proxy::client;
  * @param address Server address
  * @param port Port
  * @param timeout_s Connection timeout in seconds (default = 30s)
+ * @param framed Flag to use the framed protocol (messages keep their boundaries, server notices come as control frames)
+ * @param compressed Flag to compress the messages with the counterpart (framed protocol only, see `PayloadCodec`)
+ * @param tuning TCP settings for the connection (default = kernel defaults)
+ * @param tls TLS context to connect with (default = cleartext)
  */
-Client::Client( std::string address, int port, int timeout_s ) :
+Client::Client( std::string address, int port, int timeout_s, bool framed, bool compressed, proxy::SocketTuning tuning, std::shared_ptr<const proxy::TlsContext> tls ) :
     _timeout( timeout_s ),
     _address( std::move( address ) ),
     _port( std::to_string( port ) ),
     _security( SecurityType::UNSECURED ),
+    _framed( framed || compressed ),
+    _compressed( compressed ),
+    _tuning( tuning ),
+    _tls( std::move( tls ) ),
     _run_flag( false ),
     _connection_state( HandshakeState::INIT ),
+    _out_queue( OUT_QUEUE_SIZE ),
+    _out_signalled( false ),
+    _out_offset( 0 ),
+    _socket_events( 0 ),
     _socket_fd( -1 ),
     _epoll_fd( -1 ),
     _unblock_event_fd( -1 )
@@ -41,15 +66,27 @@ Client::Client( std::string address, int port, int timeout_s ) :
  * @param port Port
  * @param secret Secret
  * @param timeout_s Connection timeout in seconds (default = 30s)
+ * @param framed Flag to use the framed protocol (messages keep their boundaries, server notices come as control frames)
+ * @param compressed Flag to compress the messages with the counterpart (framed protocol only, see `PayloadCodec`)
+ * @param tuning TCP settings for the connection (default = kernel defaults)
+ * @param tls TLS context to connect with (default = cleartext)
  */
-Client::Client( std::string address, int port, std::string secret, int timeout_s ) :
+Client::Client( std::string address, int port, std::string secret, int timeout_s, bool framed, bool compressed, proxy::SocketTuning tuning, std::shared_ptr<const proxy::TlsContext> tls ) :
     _timeout( timeout_s ),
     _address( std::move( address ) ),
     _port( std::to_string( port ) ),
     _secret( std::move( secret ) ),
     _security( SecurityType::SECURED ),
+    _framed( framed || compressed ),
+    _compressed( compressed ),
+    _tuning( tuning ),
+    _tls( std::move( tls ) ),
     _run_flag( false ),
     _connection_state( HandshakeState::INIT ),
+    _out_queue( OUT_QUEUE_SIZE ),
+    _out_signalled( false ),
+    _out_offset( 0 ),
+    _socket_events( 0 ),
     _socket_fd( -1 ),
     _epoll_fd( -1 ),
     _unblock_event_fd( -1 )
@@ -72,6 +109,73 @@ bool Client::connect() {
         return false; //EARLY RETURN
     }
 
+    if( !open() ) {
+        return false; //EARLY RETURN
+    }
+
+    _socket_events = EPOLLIN;
+    _out_offset    = 0;
+    _out_chunks.clear();
+    _in_frame.clear();
+
+    if( _compressed && !( _codec = std::make_unique<PayloadCodec>() )->valid() ) {
+        std::cerr << "[client::Client::connect()] failed to set up the compression streams." << std::endl;
+        closeFileDescriptors();
+        return false; //EARLY RETURN
+    }
+
+    _run_flag      = true;
+    _io_worker_th  = std::thread( [ this ]() { runEventLoop(); } );
+
+    return _run_flag;
+}
+
+/**
+ * Connect to server and stream raw bytes to/from the paired client until the transfer is over
+ * (blocking - runs on the calling thread instead of the interactive I/O thread)
+ * Input from regular files is sent with `sendfile`, from pipes with `splice` and from anything else
+ * (i.e. a terminal) through a buffer. What is received is written out as-is. Since the server tells
+ * a client that its counterpart left in-band, a trailing `DISCONNECTED` is taken as the end of the
+ * transfer and not written out.
+ * @param in_fd Input file descriptor to send (-1 for none)
+ * @param out_fd Output file descriptor for what is received (-1 to discard it)
+ * @return Success (false when the connection failed or the counterpart left before the input was sent)
+ */
+bool Client::stream( FileDescriptor_t in_fd, FileDescriptor_t out_fd ) {
+    if( _run_flag ) {
+        std::cerr << "[client::Client::stream(..)] already connected - disconnect first." << std::endl;
+        return false; //EARLY RETURN
+    }
+
+    if( !open() ) {
+        return false; //EARLY RETURN
+    }
+
+    auto       transfer = Transfer_t { in_fd, out_fd };
+    const auto start    = std::chrono::steady_clock::now();
+    bool       success  = runTransfer( transfer );
+    const auto elapsed  = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+    if( success && transfer.sending ) {
+        std::clog << "[client::Client::stream(..)] counterpart left before the input was sent." << std::endl;
+        success = false;
+    }
+
+    std::clog << "Sent " << transfer.bytes_sent << " bytes, received " << transfer.bytes_received << " bytes in "
+              << elapsed << " s (" << static_cast<double>( transfer.bytes_sent + transfer.bytes_received ) / ( 1024 * 1024 ) / std::max( elapsed, 1e-9 )
+              << " MiB/s)" << std::endl;
+
+    _connection_state = HandshakeState::DCN;
+    closeFileDescriptors();
+
+    return success;
+}
+
+/**
+ * [PRIVATE] Connects to the server and completes the handshake
+ * @return Success (paired and READY)
+ */
+bool Client::open() {
     _connection_state = HandshakeState::INIT;
 
     int               err_val          = 0;
@@ -83,19 +187,25 @@ bool Client::connect() {
     hints.ai_socktype = SOCK_STREAM;
 
     if( ( err_val = ::getaddrinfo( _address.c_str(), _port.c_str(), &hints, &server_info ) ) != 0 ) {
-        std::cerr << "[client::Client::connect()] getaddrinfo: " << ::gai_strerror( err_val ) << std::endl;
+        std::cerr << "[client::Client::open()] getaddrinfo: " << ::gai_strerror( err_val ) << std::endl;
         return false; //EARLY RETURN
     }
 
     for( curr_server_info = server_info; curr_server_info != nullptr; curr_server_info = curr_server_info->ai_next ) {
         if( ( _socket_fd = ::socket( curr_server_info->ai_family, curr_server_info->ai_socktype, curr_server_info->ai_protocol ) ) == -1 ) {
-            ::perror( "[client::Client::connect()] error" );
+            ::perror( "[client::Client::open()] error" );
+            continue;
+        }
+
+        if( !_tuning.apply( _socket_fd ) ) { //before the handshake negotiates the window
+            ::close( _socket_fd );
+            std::cerr << "[client::Client::open()] failed to apply the TCP settings" << std::endl;
             continue;
         }
 
         if( ::connect( _socket_fd, curr_server_info->ai_addr, curr_server_info->ai_addrlen ) == -1 ) {
             ::close( _socket_fd );
-            ::perror( "[client::Client::connect()] error" );
+            ::perror( "[client::Client::open()] error" );
             continue;
         }
 
@@ -103,7 +213,7 @@ bool Client::connect() {
     }
 
     if( curr_server_info == nullptr ) {
-        std::cerr << "[client::Client::connect()] failed to connect to " << _address << ":" << _port << std::endl;
+        std::cerr << "[client::Client::open()] failed to connect to " << _address << ":" << _port << std::endl;
         return false; //EARLY RETURN
     }
 
@@ -117,15 +227,20 @@ bool Client::connect() {
     }
 
     ::freeaddrinfo( server_info );
+
+    if( _tls && !secure() ) { //whilst still blocking
+        goto failed;
+    }
+
     ::fcntl( _socket_fd, F_SETFL, O_NONBLOCK ); //non-blocking so we can 'poll'
 
     if( ( _epoll_fd = epoll_create( EPOLL_PENDING_QUEUE_LENGTH ) ) == -1 ) {
-        std::cerr << "[client::Client::connect()] Failed to create epoll file descriptor." << std::endl;
+        std::cerr << "[client::Client::open()] Failed to create epoll file descriptor." << std::endl;
         goto failed;
     }
 
     if( ( _unblock_event_fd = ::eventfd( 0, EFD_NONBLOCK ) ) == -1 ) {
-        std::cerr << "[client::Client::connect()] Failed to create 'event unblocking' epoll file descriptor." << std::endl;
+        std::cerr << "[client::Client::open()] Failed to create 'event unblocking' epoll file descriptor." << std::endl;
         goto failed;
     }
 
@@ -136,25 +251,23 @@ bool Client::connect() {
     }
 
     if( _security == SecurityType::SECURED ) {
-        Client::send( _socket_fd, "AUTH1" + _secret );
+        Client::send( _socket_fd, ( _compressed ? "AUTH5" : _framed ? "AUTH3" : "AUTH1" ) + _secret + "\n" ); //secret is whitespace-terminated
         _connection_state = HandshakeState::AUTH1;
     } else {
-        Client::send( _socket_fd, "AUTH0" );
+        Client::send( _socket_fd, ( _compressed ? "AUTH4" : _framed ? "AUTH2" : "AUTH0" ) );
         _connection_state = HandshakeState::AUTH0;
     }
 
-    std::cout << "connected to <" << address << ">" << std::endl;
+    std::clog << "connected to <" << address << ">" << std::endl;
 
     if( !waitForReadyState( _timeout ) ) {
-        std::cout << "Pairing to another client timed out." << std::endl;
+        std::clog << "Pairing to another client timed out." << std::endl;
         goto failed;
     }
 
     _connection_state = HandshakeState::READY;
-    _run_flag         = true;
-    _io_worker_th     = std::thread( [ this ]() { runEventLoop(); } );
 
-    return _run_flag;
+    return true;
 
     failed: {
         closeFileDescriptors();
@@ -162,15 +275,64 @@ bool Client::connect() {
     };
 }
 
+/**
+ * [PRIVATE] Runs the TLS handshake on the connected (blocking) socket then leaves the records to the kernel
+ * (the server's certificate has to be issued by the context's CA for the address connected to)
+ * @return Success
+ */
+bool Client::secure() {
+    auto session = _tls->connect( _socket_fd, _address );
+
+    if( !session ) {
+        return false; //EARLY RETURN
+    }
+
+    struct timeval timeout { _timeout, 0 };
+
+    ::setsockopt( _socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) ); //bounds the handshake
+    ::setsockopt( _socket_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+
+    const auto state = proxy::TlsContext::handshake( session );
+
+    timeout = {};
+
+    ::setsockopt( _socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+    ::setsockopt( _socket_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+
+    if( state != TlsState::OFFLOADED ) { //`WANT_*` = timed out
+        std::cerr << "[client::Client::secure()] TLS handshake with " << _address << ":" << _port << " failed." << std::endl;
+        return false; //EARLY RETURN
+    }
+
+    std::clog << "TLS established (records offloaded to the kernel)" << std::endl;
+
+    return true;
+}
 
 /**
  * Send a string to the server (buffered)
+ * The string is handed over to the I/O thread as a chunk through a lock-free queue; the I/O thread is only woken
+ * up when it isn't already due to pick up chunks. Callers only ever wait (yielding) when the I/O thread is
+ * `OUT_QUEUE_SIZE` chunks behind picking them up - how much is waiting for the socket doesn't matter.
+ * With the framed protocol each string goes out as 1 `DATA` frame (compressed ones are encoded by the I/O thread).
  * @param str String
  */
 void Client::send( const std::string &str ) {
-    if( _run_flag ) {
-        std::lock_guard<std::mutex> guard( _out_buffer_mutex );
-        _out_buffer.insert( _out_buffer.end(), str.begin(), str.end() );
+    if( !_run_flag || str.empty() ) {
+        return; //EARLY RETURN
+    }
+
+    const auto chunk = ( _framed && !_compressed ? proxy::FrameCursor::encode( FrameType::DATA, str ) : str );
+
+    while( !_out_queue.tryPush( chunk ) ) {
+        if( !_run_flag ) {
+            return; //EARLY RETURN
+        }
+
+        std::this_thread::yield();
+    }
+
+    if( !_out_signalled.exchange( true, std::memory_order_acq_rel ) ) {
         Client::signalEvent( _unblock_event_fd );
     }
 }
@@ -189,6 +351,14 @@ bool Client::disconnect() {
         Client::signalEvent( _unblock_event_fd );
 
         _io_worker_th.join();
+
+        if( _codec ) {
+            const auto & stats = _codec->stats();
+
+            std::clog << "Compression: " << stats.bytes_in << " bytes sent as " << stats.bytes_out
+                      << " (" << stats.frames_stored << " frames stored, " << stats.frames_dropped << " dropped)" << std::endl;
+        }
+
         ::shutdown( _socket_fd, SHUT_WR );
         closeFileDescriptors();
 
@@ -200,6 +370,7 @@ bool Client::disconnect() {
 
 /**
  * [PRIVATE] Run the client event loop
+ * (output is written as soon as it is picked up and, if the socket can't take it all, on EPOLLOUT from there on)
  */
 void Client::runEventLoop() {
     std::cout << "Ready for input..." << std::endl;
@@ -207,39 +378,375 @@ void Client::runEventLoop() {
     while( _run_flag ) {
         struct epoll_event event_buff[EPOLL_ARRAY_SIZE];
         char               in_buffer [INPUT_BUFFER_SIZE];
+        bool               writable = false;
 
         int event_count = epoll_wait( _epoll_fd, event_buff, EPOLL_ARRAY_SIZE, -1 );
 
-        for( int i = 0; i < event_count; ++i ) { //IN
+        for( int i = 0; i < event_count; ++i ) {
             if( event_buff[i].data.fd == _unblock_event_fd ) {
-                continue; //skip
+                uint64_t count = 0;
+
+                if( ::read( _unblock_event_fd, &count, sizeof( count ) ) == -1 && errno != EAGAIN ) {
+                    ::perror( "[client::Client::runEventLoop()] error" );
+                }
+
+                collectOutput();
+                writable |= ( ( _socket_events & EPOLLOUT ) == 0 ); //else: the socket was full last time so wait for EPOLLOUT
+                continue;
+            }
+
+            if( event_buff[i].events & EPOLLOUT ) { //OUT
+                writable = true;
             }
 
-            auto in_bytes = ::recv( event_buff[i].data.fd, in_buffer, ( INPUT_BUFFER_SIZE - 1 ), 0 );
+            if( event_buff[i].events & EPOLLIN ) { //IN
+                auto in_bytes = ::recv( event_buff[i].data.fd, in_buffer, ( INPUT_BUFFER_SIZE - 1 ), 0 );
+
+                if( in_bytes > 0 && _framed ) {
+                    if( !receiveFrames( in_buffer, static_cast<size_t>( in_bytes ) ) ) {
+                        std::cerr << "[client::Client::runEventLoop()] malformed frame received." << std::endl;
+                    }
 
-            if( in_bytes > 0 ) {
-                std::cout << "[client::Client::runEventLoop()] "
-                          << "(" << _connection_state << ") received: " << std::string( in_buffer, in_bytes )
+                } else if( in_bytes > 0 ) {
+                    std::cout << "[client::Client::runEventLoop()] "
+                              << "(" << _connection_state << ") received: " << std::string( in_buffer, in_bytes )
+                              << std::endl;
+                }
+            }
+        }
+
+        if( writable && !flushOutput() ) {
+            ::perror( "[client::Client::runEventLoop()] error" );
+        }
+
+        const uint32_t events = ( _out_chunks.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT );
+
+        if( events != _socket_events && Client::modifyEPOLL( _epoll_fd, _socket_fd, EPOLL_CTL_MOD, events ) ) {
+            _socket_events = events;
+        }
+    }
+
+    std::cout << "Exiting runEventLoop()..." << std::endl;
+}
+
+/**
+ * [PRIVATE] Prints the frames received with the framed protocol, decoding compressed payloads (I/O thread only)
+ * @param data Bytes received
+ * @param length Number of bytes
+ * @return Well-formed state (false when a header was malformed, the rest of the bytes being dropped)
+ */
+bool Client::receiveFrames( const char * data, size_t length ) {
+    _in_frame.append( data, length );
+
+    size_t      pos = 0;
+    std::string decoded;
+
+    while( _in_frame.size() - pos >= proxy::FrameCursor::HEADER_SIZE ) {
+        auto     type    = FrameType::DATA;
+        uint32_t payload = 0;
+
+        if( !proxy::FrameCursor::decodeHeader( &_in_frame[ pos ], type, payload ) ) {
+            _in_frame.clear();
+            return false; //EARLY RETURN
+        }
+
+        if( _in_frame.size() - pos < proxy::FrameCursor::HEADER_SIZE + payload ) {
+            break; //rest comes later
+        }
+
+        const auto body = std::string_view( &_in_frame[ pos + proxy::FrameCursor::HEADER_SIZE ], payload );
+
+        if( type == FrameType::DATA && _codec ) {
+            if( !_codec->decode( body, decoded ) ) {
+                std::cerr << "[client::Client::receiveFrames(..)] undecodable payload dropped." << std::endl;
+
+            } else if( !decoded.empty() ) { //else: from a previous counterpart
+                std::cout << "[client::Client::receiveFrames(..)] "
+                          << "(" << _connection_state << ") received: " << decoded
                           << std::endl;
             }
+
+        } else if( type == FrameType::DATA ) {
+            std::cout << "[client::Client::receiveFrames(..)] "
+                      << "(" << _connection_state << ") received: " << body
+                      << std::endl;
+        } else {
+            if( type == FrameType::READY && _codec ) { //new counterpart
+                _codec->reset();
+            }
+
+            std::cout << "[client::Client::receiveFrames(..)] "
+                      << "(" << _connection_state << ") server notice: " << type
+                      << std::endl;
         }
 
-        { //OUT //TODO maybe dump that into separate send worker thread?
-            std::lock_guard<std::mutex> guard( _out_buffer_mutex );
+        pos += proxy::FrameCursor::HEADER_SIZE + payload;
+    }
 
-            if( !_out_buffer.empty() ) {
-                auto out_bytes = ::send( _socket_fd, &_out_buffer[0], _out_buffer.size(), 0 );
+    _in_frame.erase( 0, pos );
 
-                if( out_bytes == -1 ) {
-                    ::perror( "[client::Client::runEventLoop()] error" );
+    return true;
+}
+
+/**
+ * [PRIVATE] Moves the chunks handed over by `send(..)` callers to the back of the output (I/O thread only)
+ * (compressed messages are encoded and framed here so that the streams are only ever used by this thread)
+ */
+void Client::collectOutput() {
+    std::string chunk;
+
+    _out_signalled.exchange( false, std::memory_order_acq_rel ); //before popping so that any later push signals again
+
+    while( _out_queue.tryPop( chunk ) ) {
+        if( _codec ) {
+            _out_chunks.emplace_back( proxy::FrameCursor::encode( FrameType::DATA, _codec->encode( chunk ) ) );
+        } else {
+            _out_chunks.emplace_back( std::move( chunk ) );
+        }
+    }
+}
+
+/**
+ * [PRIVATE] Writes as much of the output as the socket takes, several chunks per `writev` (I/O thread only)
+ * @return Success (false on socket error with `errno` set)
+ */
+bool Client::flushOutput() {
+    while( !_out_chunks.empty() ) {
+        struct iovec iov[WRITEV_MAX_CHUNKS];
+        int          iov_count = 0;
+        size_t       offset    = _out_offset;
+
+        for( auto it = _out_chunks.begin(); it != _out_chunks.end() && iov_count < WRITEV_MAX_CHUNKS; ++it, ++iov_count ) {
+            iov[iov_count].iov_base = it->data() + offset;
+            iov[iov_count].iov_len  = it->size() - offset;
+            offset                  = 0;
+        }
+
+        auto out_bytes = ::writev( _socket_fd, iov, iov_count );
+
+        if( out_bytes == -1 ) {
+            return ( errno == EAGAIN || errno == EWOULDBLOCK ); //EARLY RETURN
+        }
+
+        auto written = static_cast<size_t>( out_bytes );
+
+        while( written > 0 ) { //drop what was fully written, remember where the first partially written chunk is at
+            const auto left = _out_chunks.front().size() - _out_offset;
+
+            if( written < left ) {
+                _out_offset += written;
+                return true; //EARLY RETURN (socket full)
+            }
+
+            written -= left;
+            _out_offset = 0;
+            _out_chunks.pop_front();
+        }
+    }
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Moves bytes between the input/output and the socket until the connection ends (streaming)
+ * (the input is done once it reaches EOF and the socket is shut for writing, at which point the server closes it)
+ * @param transfer Transfer state
+ * @return Error-less completion
+ */
+bool Client::runTransfer( Transfer_t & transfer ) {
+    struct epoll_event event_buff[EPOLL_ARRAY_SIZE];
+    uint32_t           socket_events = EPOLLIN;
+    uint32_t           input_events  = 0;
+
+    transfer.sending = ( transfer.in_fd != -1 );
+    transfer.input   = ( transfer.sending ? Client::inputKind( transfer.in_fd ) : InputKind::FILE );
+
+    transfer.out_buffer.resize( STREAM_BUFFER_SIZE );
+
+    if( transfer.input == InputKind::STREAM ) {
+        transfer.in_buffer.resize( STREAM_BUFFER_SIZE );
+    }
+
+    if( transfer.sending && transfer.input != InputKind::FILE ) { //not for i.e. character devices that epoll doesn't support
+        struct epoll_event event = {};
+
+        event.events  = EPOLLIN;
+        event.data.fd = transfer.in_fd;
+
+        transfer.input_polled = ( ::epoll_ctl( _epoll_fd, EPOLL_CTL_ADD, transfer.in_fd, &event ) == 0 );
+        input_events          = ( transfer.input_polled ? static_cast<uint32_t>( EPOLLIN ) : 0U );
+    }
+
+    transfer.input_ready = !transfer.input_polled;
+
+    while( transfer.receiving ) {
+        bool progress = false;
+
+        if( transfer.sending && transfer.socket_writable && ( transfer.input_ready || transfer.in_pos < transfer.in_len ) ) {
+            const auto bytes = sendInput( transfer );
+
+            if( bytes == 0 ) { //end of input
+                transfer.sending = false;
+                ::shutdown( _socket_fd, SHUT_WR );
+
+            } else if( bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK ) {
+                ::perror( "[client::Client::runTransfer(..)] error" );
+                return false; //EARLY RETURN
+            }
+
+            progress = ( bytes >= 0 );
+        }
+
+        const auto bytes = receiveOutput( transfer );
+
+        if( bytes == 0 ) { //connection closed or counterpart left
+            transfer.receiving = false;
+            continue;
+
+        } else if( bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK ) {
+            ::perror( "[client::Client::runTransfer(..)] error" );
+            return false; //EARLY RETURN
+        }
+
+        if( progress || bytes > 0 ) {
+            continue;
+        }
+
+        //Nothing moved: wait for whichever end held things up
+        const uint32_t socket_wanted = EPOLLIN | ( transfer.sending && !transfer.socket_writable ? static_cast<uint32_t>( EPOLLOUT ) : 0U );
+        const uint32_t input_wanted  = ( transfer.input_polled && transfer.sending && !transfer.input_ready ? static_cast<uint32_t>( EPOLLIN ) : 0U );
+
+        if( socket_wanted != socket_events && Client::modifyEPOLL( _epoll_fd, _socket_fd, EPOLL_CTL_MOD, socket_wanted ) ) {
+            socket_events = socket_wanted;
+        }
+
+        if( input_wanted != input_events ) { //removed rather than muted as a closed pipe reports EPOLLHUP regardless
+            Client::modifyEPOLL( _epoll_fd, transfer.in_fd, ( input_wanted ? EPOLL_CTL_ADD : EPOLL_CTL_DEL ), input_wanted );
+            input_events = input_wanted;
+        }
+
+        const int event_count = epoll_wait( _epoll_fd, event_buff, EPOLL_ARRAY_SIZE, -1 );
+
+        for( int i = 0; i < event_count; ++i ) {
+            if( event_buff[i].data.fd == _socket_fd && ( event_buff[i].events & ( EPOLLOUT | EPOLLERR ) ) ) {
+                transfer.socket_writable = true;
+
+            } else if( event_buff[i].data.fd == transfer.in_fd ) {
+                transfer.input_ready = true;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Sends the next part of the input (streaming)
+ * @param transfer Transfer state
+ * @return Bytes sent (0 at the end of the input, -1 on error with `errno` set - EAGAIN when either end held things up)
+ */
+ssize_t Client::sendInput( Transfer_t & transfer ) {
+    ssize_t bytes = -1;
+
+    switch( transfer.input ) {
+        case InputKind::FILE: {
+            if( ( bytes = ::sendfile( _socket_fd, transfer.in_fd, nullptr, STREAM_CHUNK_SIZE ) ) == -1 && errno == EAGAIN ) {
+                transfer.socket_writable = false;
+            }
+        } break;
+
+        case InputKind::PIPE: {
+            if( ( bytes = ::splice( transfer.in_fd, nullptr, _socket_fd, nullptr, STREAM_CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_MORE | SPLICE_F_NONBLOCK ) ) == -1 && errno == EAGAIN ) {
+                int available = 0; //tells which end was not ready
+
+                if( ::ioctl( transfer.in_fd, FIONREAD, &available ) == 0 && available > 0 ) {
+                    transfer.socket_writable = false;
                 } else {
-                    _out_buffer.erase( _out_buffer.begin(), _out_buffer.begin() + out_bytes );
+                    transfer.input_ready = !transfer.input_polled;
+                }
+
+                errno = EAGAIN;
+            }
+        } break;
+
+        case InputKind::STREAM: {
+            if( transfer.in_pos == transfer.in_len ) {
+                if( ( bytes = ::read( transfer.in_fd, transfer.in_buffer.data(), transfer.in_buffer.size() ) ) <= 0 ) {
+                    if( bytes == -1 && errno == EAGAIN ) {
+                        transfer.input_ready = !transfer.input_polled;
+                    }
+
+                    return bytes; //EARLY RETURN
+                }
+
+                transfer.in_pos      = 0;
+                transfer.in_len      = static_cast<size_t>( bytes );
+                transfer.input_ready = !transfer.input_polled; //epoll tells when there is more
+            }
+
+            if( ( bytes = ::send( _socket_fd, &transfer.in_buffer[transfer.in_pos], transfer.in_len - transfer.in_pos, 0 ) ) == -1 ) {
+                if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+                    transfer.socket_writable = false;
                 }
+
+                return -1; //EARLY RETURN
             }
+
+            transfer.in_pos += static_cast<size_t>( bytes );
+        } break;
+    }
+
+    if( bytes > 0 ) {
+        transfer.bytes_sent += static_cast<uint64_t>( bytes );
+    }
+
+    return bytes;
+}
+
+/**
+ * [PRIVATE] Receives what is available on the socket and writes it out (streaming)
+ * The last bytes received are held back until more arrive or the connection closes so that the notice sent by
+ * the server when the counterpart leaves isn't written out (and ends the transfer when nothing follows it).
+ * @param transfer Transfer state
+ * @return Bytes received (0 when the transfer is over, -1 on error with `errno` set - EAGAIN when nothing is available)
+ */
+ssize_t Client::receiveOutput( Transfer_t & transfer ) {
+    auto &     buffer = transfer.out_buffer;
+    const auto bytes  = ::recv( _socket_fd, &buffer[transfer.held], buffer.size() - transfer.held, 0 );
+
+    if( bytes == -1 && ( errno == EAGAIN || errno == EWOULDBLOCK ) && Client::peerLeft( transfer ) ) {
+        transfer.bytes_received -= PEER_LEFT_NOTICE_LEN;
+        return 0; //EARLY RETURN
+    }
+
+    if( bytes == 0 ) { //connection closed
+        if( Client::peerLeft( transfer ) ) {
+            transfer.bytes_received -= PEER_LEFT_NOTICE_LEN;
+
+        } else if( !Client::writeOut( transfer.out_fd, buffer.data(), transfer.held ) ) {
+            return -1; //EARLY RETURN
         }
+
+        return 0; //EARLY RETURN
     }
 
-    std::cout << "Exiting runEventLoop()..." << std::endl;
+    if( bytes < 0 ) {
+        return bytes; //EARLY RETURN
+    }
+
+    const size_t total = transfer.held + static_cast<size_t>( bytes );
+    const size_t keep  = std::min( total, static_cast<size_t>( PEER_LEFT_NOTICE_LEN ) );
+
+    if( !Client::writeOut( transfer.out_fd, buffer.data(), total - keep ) ) {
+        return -1; //EARLY RETURN
+    }
+
+    std::memmove( buffer.data(), &buffer[total - keep], keep );
+
+    transfer.held            = keep;
+    transfer.bytes_received += static_cast<uint64_t>( bytes );
+
+    return bytes;
 }
 
 /**
@@ -251,12 +758,16 @@ void Client::closeFileDescriptors() {
     }
 
     if( _socket_fd != -1 ) {
-        ::close( _epoll_fd );
+        ::close( _socket_fd );
     }
 
     if( _epoll_fd != -1 ) {
         ::close( _epoll_fd );
     }
+
+    _unblock_event_fd = -1;
+    _socket_fd        = -1;
+    _epoll_fd         = -1;
 }
 
 /**
@@ -300,6 +811,62 @@ ssize_t Client::send( Client::FileDescriptor_t socket_fd, const std::string &msg
     return out_bytes;
 }
 
+/**
+ * [PRIVATE] Picks how to send from an input file descriptor
+ * @param fd Input file descriptor
+ * @return Input kind
+ */
+Client::InputKind Client::inputKind( FileDescriptor_t fd ) {
+    struct stat info {};
+
+    if( ::fstat( fd, &info ) == -1 ) {
+        return InputKind::STREAM; //EARLY RETURN
+    }
+
+    if( S_ISREG( info.st_mode ) ) {
+        return InputKind::FILE; //EARLY RETURN
+    }
+
+    return ( S_ISFIFO( info.st_mode ) ? InputKind::PIPE : InputKind::STREAM );
+}
+
+/**
+ * [PRIVATE] Checks if the bytes held back are the notice sent by the server when the counterpart left
+ * @param transfer Transfer state
+ * @return Notice received
+ */
+bool Client::peerLeft( const Transfer_t & transfer ) {
+    return transfer.held == PEER_LEFT_NOTICE_LEN && std::memcmp( transfer.out_buffer.data(), PEER_LEFT_NOTICE, PEER_LEFT_NOTICE_LEN ) == 0;
+}
+
+/**
+ * [PRIVATE] Writes bytes out in full (waiting on the output when it pushes back)
+ * @param fd Output file descriptor (-1 to discard)
+ * @param data Bytes
+ * @param length Number of bytes
+ * @return Success
+ */
+bool Client::writeOut( FileDescriptor_t fd, const char * data, size_t length ) {
+    while( fd != -1 && length > 0 ) {
+        const auto bytes = ::write( fd, data, length );
+
+        if( bytes == -1 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) {
+            struct pollfd poll_fd { fd, POLLOUT, 0 };
+            ::poll( &poll_fd, 1, -1 );
+            continue;
+        }
+
+        if( bytes == -1 ) {
+            return false; //EARLY RETURN
+        }
+
+        data   += bytes;
+        length -= static_cast<size_t>( bytes );
+    }
+
+    return true;
+}
+
 /**
  * [PRIVATE] Signal an event to unblock `epoll_wait`
  * @param event_fd Event file descriptor
@@ -344,7 +911,7 @@ bool Client::modifyEPOLL( Client::FileDescriptor_t epoll_fd, Client::FileDescrip
  */
 bool Client::waitForReadyState( int timeout_s ) {
     struct epoll_event  event_buff[EPOLL_ARRAY_SIZE];
-    static const size_t BUFFER_SIZE = 5;
+    static const size_t BUFFER_SIZE = 5; //`READY`, or the header of a `READY` frame
     char                in_buffer[BUFFER_SIZE];
     bool                ready_flag = false;
 
@@ -355,9 +922,14 @@ bool Client::waitForReadyState( int timeout_s ) {
             continue; //skip
         }
 
-        auto in_bytes = ::recv( event_buff[i].data.fd, in_buffer, BUFFER_SIZE, 0 );
+        auto     in_bytes = ::recv( event_buff[i].data.fd, in_buffer, BUFFER_SIZE, 0 );
+        auto     type     = FrameType::DATA;
+        uint32_t payload  = 0;
+
+        if( in_bytes > 0 && _framed ) {
+            ready_flag = ( static_cast<size_t>( in_bytes ) == BUFFER_SIZE && proxy::FrameCursor::decodeHeader( in_buffer, type, payload ) && type == FrameType::READY );
 
-        if( in_bytes > 0 ) {
+        } else if( in_bytes > 0 ) {
             if( std::string( in_buffer, 5 ) == "READY" ) {
                 ready_flag = true;
             } //else: drop
@@ -3,20 +3,28 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <thread>
-#include <mutex>
+#include <atomic>
+#include <memory>
 
 #include "../enum/SecurityType.h"
 #include "../enum/HandshakeState.h"
+#include "../container/MpscQueue.h"
+#include "../proxy/FrameCursor.h"
+#include "../proxy/SocketTuning.h"
+#include "../proxy/TlsContext.h"
+#include "PayloadCodec.h"
 
 namespace fwd_proxy::client {
     class Client {
       public:
-        Client( std::string address, int port, int timeout_s = 30 );
-        Client( std::string address, int port, std::string secret, int timeout_s = 30 );
+        Client( std::string address, int port, int timeout_s = 30, bool framed = false, bool compressed = false, proxy::SocketTuning tuning = {}, std::shared_ptr<const proxy::TlsContext> tls = {} );
+        Client( std::string address, int port, std::string secret, int timeout_s = 30, bool framed = false, bool compressed = false, proxy::SocketTuning tuning = {}, std::shared_ptr<const proxy::TlsContext> tls = {} );
         ~Client();
 
         bool connect();
+        bool stream( int in_fd, int out_fd );
         void send( const std::string & str );
         bool disconnect();
 
@@ -24,23 +32,66 @@ namespace fwd_proxy::client {
         typedef std::string Secret_t;
         typedef int         FileDescriptor_t;
 
-        const int          _timeout;
-        const std::string  _address;
-        const std::string  _port;
-        const Secret_t     _secret;
-        const SecurityType _security;
+        enum class InputKind : uint8_t {
+            FILE = 0, //`sendfile`
+            PIPE,     //`splice`
+            STREAM,   //`read` + `send` (i.e. a terminal)
+        };
+
+        struct Transfer_t {
+            FileDescriptor_t  in_fd           { -1 };
+            FileDescriptor_t  out_fd          { -1 };    //-1 to discard what is received
+            InputKind         input           { InputKind::FILE };
+            bool              sending         { false }; //input left to send
+            bool              receiving       { true };  //connection still up
+            bool              input_polled    { false }; //input readiness comes from epoll (else it is always taken as readable)
+            bool              input_ready     { false };
+            bool              socket_writable { true };
+            std::vector<char> in_buffer       {};        //`InputKind::STREAM` input read but not sent yet
+            size_t            in_pos          { 0 };
+            size_t            in_len          { 0 };
+            std::vector<char> out_buffer      {};        //received bytes, the first `held` are held back in case they are the server's notice
+            size_t            held            { 0 };
+            uint64_t          bytes_sent      { 0 };
+            uint64_t          bytes_received  { 0 };
+        };
+
+        const int                 _timeout;
+        const std::string         _address;
+        const std::string         _port;
+        const Secret_t            _secret;
+        const SecurityType        _security;
+        const bool                _framed;     //framed protocol (`AUTH2`/`AUTH3`)
+        const bool                _compressed; //compressed framed protocol (`AUTH4`/`AUTH5`)
+        const proxy::SocketTuning _tuning; //TCP settings (applied before connecting)
+
+        const std::shared_ptr<const proxy::TlsContext> _tls; //nullptr = cleartext
 
         std::atomic_bool   _run_flag;
         FileDescriptor_t   _unblock_event_fd;
         std::thread        _io_worker_th;
-        std::mutex         _out_buffer_mutex;
-        std::vector<char>  _out_buffer;
         HandshakeState     _connection_state;
 
+        container::MpscQueue<std::string> _out_queue;     //chunks handed over by `send(..)` callers
+        std::atomic_bool                  _out_signalled; //wake-up pending for chunks in `_out_queue`
+        std::deque<std::string>           _out_chunks;    //chunks being written out (I/O thread only)
+        size_t                            _out_offset;    //bytes of the front chunk already written
+        uint32_t                          _socket_events; //epoll events currently registered for the socket
+        std::string                       _in_frame;      //start of a frame received but not complete yet (framed only)
+        std::unique_ptr<PayloadCodec>     _codec;         //payload (de)compression (compressed only - I/O thread)
+
         FileDescriptor_t   _socket_fd;
         FileDescriptor_t   _epoll_fd;
 
+        bool open();
+        bool secure();
         void runEventLoop();
+        void collectOutput();
+        bool flushOutput();
+        bool receiveFrames( const char * data, size_t length );
+        bool runTransfer( Transfer_t & transfer );
+        ssize_t sendInput( Transfer_t & transfer );
+        ssize_t receiveOutput( Transfer_t & transfer );
 
         bool waitForReadyState( int timeout_s );
         void closeFileDescriptors();
@@ -48,6 +99,9 @@ namespace fwd_proxy::client {
 
 
         static ssize_t send( FileDescriptor_t socket_fd, const std::string & msg );
+        static InputKind inputKind( FileDescriptor_t fd );
+        static bool peerLeft( const Transfer_t & transfer );
+        static bool writeOut( FileDescriptor_t fd, const char * data, size_t length );
         static void signalEvent( FileDescriptor_t event_fd );
         static bool modifyEPOLL( FileDescriptor_t epoll_fd, FileDescriptor_t fd, int operation, uint32_t  event_flags );
     };
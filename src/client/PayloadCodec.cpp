@@ -0,0 +1,249 @@
+#include "PayloadCodec.h"
+
+#include <algorithm>
+
+#include <zlib.h>
+
+#include "../proxy/FrameCursor.h"
+
+#define PAYLOAD_STORED             0x00
+#define PAYLOAD_DEFLATED           0x01
+#define PAYLOAD_RESET              0x02 //deflate stream restarts with this payload
+#define DEFLATE_WINDOW_BITS         -15 //raw deflate (no zlib header/trailer), 32KiB history
+#define DEFLATE_MEM_LEVEL             8
+#define FLUSH_TRAILER_SIZE            4 //`00 00 FF FF` ending each flushed block, left out of the payload
+#define ADAPTIVE_WINDOW           65536 //input bytes over which the ratio is checked
+#define ADAPTIVE_RATIO_PERCENT       90 //deflating stops when the window shrinks to no less than this
+#define ADAPTIVE_PROBE_DISTANCE 1048576 //input bytes sent stored before deflating is tried again
+#define INFLATE_CHUNK_MIN          4096
+
+using namespace fwd_proxy::client;
+
+namespace {
+    const unsigned char FLUSH_TRAILER[FLUSH_TRAILER_SIZE] = { 0x00, 0x00, 0xFF, 0xFF };
+}
+
+/**
+ * Constructor (check `valid()` for success)
+ */
+PayloadCodec::PayloadCodec() :
+    _deflater( new z_stream {}, StreamDeleter_t { false } ),
+    _inflater( new z_stream {}, StreamDeleter_t { true } ),
+    _deflating( true ),
+    _reset_pending( true ), //1st deflated payload flagged (a counterpart re-queued from an earlier pairing awaits it)
+    _awaiting_reset( false ),
+    _window_in( 0 ),
+    _window_out( 0 ),
+    _probe_at( 0 )
+{
+    if( ::deflateInit2( _deflater.get(), Z_BEST_SPEED, Z_DEFLATED, DEFLATE_WINDOW_BITS, DEFLATE_MEM_LEVEL, Z_DEFAULT_STRATEGY ) != Z_OK ) {
+        delete _deflater.release();
+    }
+
+    if( ::inflateInit2( _inflater.get(), DEFLATE_WINDOW_BITS ) != Z_OK ) {
+        delete _inflater.release();
+    }
+}
+
+/**
+ * Destructor
+ */
+PayloadCodec::~PayloadCodec() = default;
+
+/**
+ * Checks the streams were set up
+ * @return Valid state
+ */
+bool PayloadCodec::valid() const {
+    return _deflater && _inflater;
+}
+
+/**
+ * Gets the statistics
+ * @return Byte and frame counts since construction
+ */
+const PayloadCodec::Stats_t & PayloadCodec::stats() const {
+    return _stats;
+}
+
+/**
+ * Encodes an outgoing payload
+ * @param data Message
+ * @return Payload to send in a `DATA` frame
+ */
+std::string PayloadCodec::encode( std::string_view data ) {
+    auto payload = std::string( 1, static_cast<char>( PAYLOAD_STORED ) );
+
+    if( !_deflating && _stats.bytes_in >= _probe_at ) { //probe
+        _deflating  = true;
+        _window_in  = 0;
+        _window_out = 0;
+    }
+
+    _stats.bytes_in += data.size();
+
+    if( !_deflating || !_deflater ) {
+        payload.append( data );
+        _stats.bytes_out += payload.size();
+        ++_stats.frames_stored;
+        return payload; //EARLY RETURN
+    }
+
+    if( _reset_pending ) {
+        ::deflateReset( _deflater.get() );
+        payload[0]     = static_cast<char>( PAYLOAD_DEFLATED | PAYLOAD_RESET );
+        _reset_pending = false;
+    } else {
+        payload[0] = static_cast<char>( PAYLOAD_DEFLATED );
+    }
+
+    _deflater->next_in  = reinterpret_cast<Bytef *>( const_cast<char *>( data.data() ) );
+    _deflater->avail_in = static_cast<uInt>( data.size() );
+
+    size_t length = payload.size();
+
+    do { //the flush is complete once there is output space left
+        payload.resize( length + ::deflateBound( _deflater.get(), _deflater->avail_in ) + FLUSH_TRAILER_SIZE + 1 );
+
+        _deflater->next_out  = reinterpret_cast<Bytef *>( payload.data() + length );
+        _deflater->avail_out = static_cast<uInt>( payload.size() - length );
+
+        if( ::deflate( _deflater.get(), Z_SYNC_FLUSH ) == Z_STREAM_ERROR ) {
+            _deflater.reset(); //stored from now on (the counterpart's stream is left as it was)
+            payload.assign( 1, static_cast<char>( PAYLOAD_STORED ) ).append( data );
+            _stats.bytes_out += payload.size();
+            ++_stats.frames_stored;
+            return payload; //EARLY RETURN
+        }
+
+        length = payload.size() - _deflater->avail_out;
+
+    } while( _deflater->avail_out == 0 );
+
+    payload.resize( length - FLUSH_TRAILER_SIZE );
+
+    _stats.bytes_out += payload.size();
+    _window_in       += data.size();
+    _window_out      += payload.size();
+
+    if( _window_in >= ADAPTIVE_WINDOW ) {
+        if( _window_out * 100 >= _window_in * ADAPTIVE_RATIO_PERCENT ) { //incompressible
+            _deflating = false;
+            _probe_at  = _stats.bytes_in + ADAPTIVE_PROBE_DISTANCE;
+        }
+
+        _window_in  = 0;
+        _window_out = 0;
+    }
+
+    return payload;
+}
+
+/**
+ * Decodes an incoming payload
+ * @param payload Payload of a `DATA` frame
+ * @param data Message (empty when the payload belongs to a previous counterpart's stream and was dropped)
+ * @return Success (false when the payload can't be decoded, deflated payloads being dropped until the next reset)
+ */
+bool PayloadCodec::decode( std::string_view payload, std::string & data ) {
+    data.clear();
+
+    if( payload.empty() ) {
+        return false; //EARLY RETURN
+    }
+
+    const auto flags = static_cast<uint8_t>( payload[0] );
+
+    payload.remove_prefix( 1 );
+
+    if( ( flags & PAYLOAD_DEFLATED ) == 0 ) {
+        data.assign( payload );
+        return true; //EARLY RETURN
+    }
+
+    if( !_inflater ) {
+        return false; //EARLY RETURN
+    }
+
+    if( flags & PAYLOAD_RESET ) {
+        ::inflateReset( _inflater.get() );
+        _awaiting_reset = false;
+
+    } else if( _awaiting_reset ) {
+        ++_stats.frames_dropped;
+        return true; //EARLY RETURN
+    }
+
+    const size_t chunk  = std::max<size_t>( payload.size() * 4, INFLATE_CHUNK_MIN );
+    size_t       length = 0;
+
+    for( int part = 0; part < 2; ++part ) { //payload then the flush trailer left out by the sender
+        if( part == 0 ) {
+            _inflater->next_in  = reinterpret_cast<Bytef *>( const_cast<char *>( payload.data() ) );
+            _inflater->avail_in = static_cast<uInt>( payload.size() );
+        } else {
+            _inflater->next_in  = const_cast<Bytef *>( FLUSH_TRAILER );
+            _inflater->avail_in = FLUSH_TRAILER_SIZE;
+        }
+
+        do {
+            if( length == data.size() ) {
+                if( length > proxy::FrameCursor::PAYLOAD_MAX ) {
+                    break; //failed below
+                }
+
+                data.resize( std::min<size_t>( length + chunk, proxy::FrameCursor::PAYLOAD_MAX + 1 ) );
+            }
+
+            _inflater->next_out  = reinterpret_cast<Bytef *>( data.data() + length );
+            _inflater->avail_out = static_cast<uInt>( data.size() - length );
+
+            const auto ret = ::inflate( _inflater.get(), Z_SYNC_FLUSH );
+
+            length = data.size() - _inflater->avail_out;
+
+            if( ret != Z_OK && ret != Z_BUF_ERROR ) { //the stream never ends
+                length = proxy::FrameCursor::PAYLOAD_MAX + 1;
+                break;
+            }
+
+        } while( _inflater->avail_in > 0 || _inflater->avail_out == 0 );
+
+        if( length > proxy::FrameCursor::PAYLOAD_MAX ) {
+            data.clear();
+            _awaiting_reset = true;
+            return false; //EARLY RETURN
+        }
+    }
+
+    data.resize( length );
+
+    return true;
+}
+
+/**
+ * Restarts both directions from an empty history (counterpart changed)
+ * The next deflated payload sent is flagged as a restart and deflated payloads received are dropped
+ * until one flagged as a restart arrives.
+ */
+void PayloadCodec::reset() {
+    _deflating      = true;
+    _reset_pending  = true;
+    _awaiting_reset = true;
+    _window_in      = 0;
+    _window_out     = 0;
+}
+
+/**
+ * [PRIVATE] Frees a zlib stream
+ * @param stream Stream
+ */
+void PayloadCodec::StreamDeleter_t::operator ()( z_stream_s * stream ) const {
+    if( inflating ) {
+        ::inflateEnd( stream );
+    } else {
+        ::deflateEnd( stream );
+    }
+
+    delete stream;
+}
@@ -0,0 +1,63 @@
+#ifndef FWD_PROXY_CLIENT_PAYLOADCODEC_H
+#define FWD_PROXY_CLIENT_PAYLOADCODEC_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+
+struct z_stream_s;
+
+namespace fwd_proxy::client {
+    /**
+     * Streaming compression of the `DATA` payloads of a compressed framed pairing (1 deflate stream per direction)
+     * Each payload is `[flags:1][data]`: the data is either stored as is or is the next part of the sender's
+     * deflate stream, flushed so that the frame decodes on its own arrival. History carries over between frames
+     * so that redundant messages shrink to a few bytes. Compression is adaptive: when a window of input barely
+     * shrinks the data goes stored (without touching the stream) until it is probed again further on.
+     * Both directions restart from an empty history when the counterpart changes (see `reset()`).
+     */
+    class PayloadCodec {
+      public:
+        struct Stats_t {
+            uint64_t bytes_in       { 0 }; //payload bytes given to `encode(..)`
+            uint64_t bytes_out      { 0 }; //encoded bytes (flags included)
+            uint64_t frames_stored  { 0 };
+            uint64_t frames_dropped { 0 }; //received from a previous counterpart
+        };
+
+        PayloadCodec();
+        PayloadCodec( const PayloadCodec & ) = delete;
+        ~PayloadCodec();
+
+        PayloadCodec & operator =( const PayloadCodec & ) = delete;
+
+        [[nodiscard]] bool valid() const;
+        [[nodiscard]] const Stats_t & stats() const;
+
+        std::string encode( std::string_view data );
+        bool decode( std::string_view payload, std::string & data );
+        void reset();
+
+      private:
+        struct StreamDeleter_t {
+            bool inflating { false };
+
+            void operator ()( z_stream_s * stream ) const;
+        };
+
+        typedef std::unique_ptr<z_stream_s, StreamDeleter_t> Stream_t;
+
+        Stream_t _deflater;
+        Stream_t _inflater;
+        bool     _deflating;      //else: sending stored until `_probe_at`
+        bool     _reset_pending;  //next deflated payload restarts the stream
+        bool     _awaiting_reset; //deflated payloads are dropped until 1 restarts the stream
+        uint64_t _window_in;      //deflated bytes of the current window
+        uint64_t _window_out;
+        uint64_t _probe_at;       //`Stats_t::bytes_in` at which deflating is tried again
+        Stats_t  _stats;
+    };
+}
+
+#endif //FWD_PROXY_CLIENT_PAYLOADCODEC_H
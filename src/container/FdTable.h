@@ -0,0 +1,203 @@
+#ifndef FWD_PROXY_CONTAINER_FDTABLE_H
+#define FWD_PROXY_CONTAINER_FDTABLE_H
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace fwd_proxy::container {
+    /**
+     * Table of records keyed by file descriptor
+     * File descriptors index a compact array (8 bytes each, grows by doubling) pointing into dense record slots
+     * that are recycled once erased, so memory follows the number of records rather than the highest file
+     * descriptor seen (which is shared by every table of the process). Each file descriptor carries a generation
+     * counter bumped when its record is erased so that a `Handle_t` kept around for a file descriptor that was
+     * since closed and re-used can be detected as stale.
+     * @tparam T Record type
+     */
+    template<typename T> class FdTable {
+      public:
+        struct Handle_t {
+            int      fd;
+            uint32_t generation;
+        };
+
+        explicit FdTable( size_t capacity = 0 );
+
+        T & insert( int fd, T record = {} );
+        bool erase( int fd );
+
+        [[nodiscard]] T * find( int fd );
+        [[nodiscard]] const T * find( int fd ) const;
+        [[nodiscard]] T * find( const Handle_t & handle );
+        [[nodiscard]] T & at( int fd );
+        [[nodiscard]] bool contains( int fd ) const;
+        [[nodiscard]] Handle_t handle( int fd ) const;
+        [[nodiscard]] size_t size() const;
+
+        template<typename Fn> void forEach( Fn fn );
+
+      private:
+        static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+        struct Index_t {
+            uint32_t slot       { NO_SLOT };
+            uint32_t generation { 0 };
+        };
+
+        std::vector<Index_t>  _index;      //by file descriptor
+        std::vector<T>        _slots;      //records (contiguous, erased ones are kept for re-use)
+        std::vector<uint32_t> _free_slots;
+    };
+
+    /**
+     * Constructor
+     * @param capacity Number of file descriptors and records to reserve upfront (file descriptors 0..capacity-1)
+     */
+    template<typename T> FdTable<T>::FdTable( size_t capacity ) :
+        _index( capacity )
+    {
+        _slots.reserve( capacity );
+    }
+
+    /**
+     * Inserts a record, replacing any already there
+     * @param fd File descriptor
+     * @param record Record
+     * @return Stored record
+     */
+    template<typename T> T & FdTable<T>::insert( int fd, T record ) {
+        const auto index = static_cast<size_t>( fd );
+
+        if( index >= _index.size() ) {
+            _index.resize( std::max( index + 1, _index.size() * 2 ) );
+        }
+
+        auto & entry = _index[ index ];
+
+        if( entry.slot == NO_SLOT ) {
+            if( _free_slots.empty() ) {
+                entry.slot = static_cast<uint32_t>( _slots.size() );
+                _slots.emplace_back( std::move( record ) );
+                return _slots.back(); //EARLY RETURN
+            }
+
+            entry.slot = _free_slots.back();
+            _free_slots.pop_back();
+        }
+
+        _slots[ entry.slot ] = std::move( record );
+
+        return _slots[ entry.slot ];
+    }
+
+    /**
+     * Erases a record (invalidates handles issued for it)
+     * @param fd File descriptor
+     * @return Existence state (false when there was nothing to erase)
+     */
+    template<typename T> bool FdTable<T>::erase( int fd ) {
+        if( !contains( fd ) ) {
+            return false; //EARLY RETURN
+        }
+
+        auto & entry = _index[ static_cast<size_t>( fd ) ];
+
+        _slots[ entry.slot ] = T {};
+        _free_slots.push_back( entry.slot );
+        entry.slot = NO_SLOT;
+        ++entry.generation;
+
+        return true;
+    }
+
+    /**
+     * Finds a record
+     * @param fd File descriptor
+     * @return Pointer to record (nullptr when not found)
+     */
+    template<typename T> T * FdTable<T>::find( int fd ) {
+        return ( contains( fd ) ? &_slots[ _index[ static_cast<size_t>( fd ) ].slot ] : nullptr );
+    }
+
+    /**
+     * Finds a record
+     * @param fd File descriptor
+     * @return Pointer to record (nullptr when not found)
+     */
+    template<typename T> const T * FdTable<T>::find( int fd ) const {
+        return ( contains( fd ) ? &_slots[ _index[ static_cast<size_t>( fd ) ].slot ] : nullptr );
+    }
+
+    /**
+     * Finds a record from a handle
+     * @param handle Record handle
+     * @return Pointer to record (nullptr when not found or the handle is stale)
+     */
+    template<typename T> T * FdTable<T>::find( const Handle_t & handle ) {
+        if( !contains( handle.fd ) || _index[ static_cast<size_t>( handle.fd ) ].generation != handle.generation ) {
+            return nullptr; //EARLY RETURN
+        }
+
+        return &_slots[ _index[ static_cast<size_t>( handle.fd ) ].slot ];
+    }
+
+    /**
+     * Gets a record
+     * @param fd File descriptor
+     * @return Record
+     * @throws std::out_of_range when not found
+     */
+    template<typename T> T & FdTable<T>::at( int fd ) {
+        if( !contains( fd ) ) {
+            throw std::out_of_range( "[container::FdTable<T>::at( " + std::to_string( fd ) + " )] No record for file descriptor." );
+        }
+
+        return _slots[ _index[ static_cast<size_t>( fd ) ].slot ];
+    }
+
+    /**
+     * Checks if a record exists for a file descriptor
+     * @param fd File descriptor
+     * @return Existence state
+     */
+    template<typename T> bool FdTable<T>::contains( int fd ) const {
+        return fd >= 0 && static_cast<size_t>( fd ) < _index.size() && _index[ static_cast<size_t>( fd ) ].slot != NO_SLOT;
+    }
+
+    /**
+     * Gets a handle to the current record of a file descriptor
+     * @param fd File descriptor
+     * @return Handle
+     */
+    template<typename T> typename FdTable<T>::Handle_t FdTable<T>::handle( int fd ) const {
+        const auto index = static_cast<size_t>( fd );
+        return Handle_t { fd, ( fd >= 0 && index < _index.size() ? _index[ index ].generation : 0 ) };
+    }
+
+    /**
+     * Gets the number of records
+     * @return Record count
+     */
+    template<typename T> size_t FdTable<T>::size() const {
+        return _slots.size() - _free_slots.size();
+    }
+
+    /**
+     * Calls a function on each record (by file descriptor)
+     * @tparam Fn Function type
+     * @param fn Function with a `( int fd, T & record )` signature
+     */
+    template<typename T> template<typename Fn> void FdTable<T>::forEach( Fn fn ) {
+        for( size_t i = 0; i < _index.size(); ++i ) {
+            if( _index[i].slot != NO_SLOT ) {
+                fn( static_cast<int>( i ), _slots[ _index[i].slot ] );
+            }
+        }
+    }
+}
+
+#endif //FWD_PROXY_CONTAINER_FDTABLE_H
@@ -0,0 +1,233 @@
+#include "InternTable.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#define INDEX_SIZE_MIN      16 //power of 2
+#define FNV_OFFSET_BASIS    14695981039346656037ULL
+#define FNV_PRIME           1099511628211ULL
+
+using namespace fwd_proxy::container;
+
+/**
+ * Constructor
+ * @param capacity Number of distinct strings to make room for upfront
+ */
+InternTable::InternTable( size_t capacity ) :
+    _index( std::max( static_cast<size_t>( INDEX_SIZE_MIN ), std::bit_ceil( capacity * 2 ) ), INVALID_HANDLE ),
+    _size( 0 )
+{
+    _entries.reserve( capacity );
+}
+
+/**
+ * Interns a string (or adds a reference to it if already there)
+ * @param str String
+ * @return Handle (to give back with `release(..)`)
+ */
+InternTable::Handle_t InternTable::acquire( std::string_view str ) {
+    const auto hash = InternTable::computeHash( str );
+    auto       slot = indexSlot( str, hash );
+
+    if( _index[ slot ] != INVALID_HANDLE ) {
+        ++_entries[ _index[ slot ] ].references;
+        return _index[ slot ]; //EARLY RETURN
+    }
+
+    if( ( _size + 1 ) * 2 > _index.size() ) {
+        growIndex();
+        slot = indexSlot( str, hash );
+    }
+
+    Handle_t handle;
+
+    if( !_free_handles.empty() ) {
+        handle = _free_handles.back();
+        _free_handles.pop_back();
+    } else {
+        handle = static_cast<Handle_t>( _entries.size() );
+        _entries.emplace_back();
+    }
+
+    _entries[ handle ] = Entry_t { hash, store( str ), static_cast<uint32_t>( str.size() ), 1 };
+    _index[ slot ]     = handle;
+    ++_size;
+
+    return handle;
+}
+
+/**
+ * Removes a reference to an interned string (the string is dropped with its last reference)
+ * @param handle Handle
+ * @return Success (false when the handle wasn't in use)
+ */
+bool InternTable::release( Handle_t handle ) {
+    if( handle >= _entries.size() || _entries[ handle ].references == 0 ) {
+        return false; //EARLY RETURN
+    }
+
+    auto & entry = _entries[ handle ];
+
+    if( --entry.references == 0 ) {
+        eraseFromIndex( handle );
+
+        if( entry.length > 0 ) {
+            if( entry.length >= _free_blocks.size() ) {
+                _free_blocks.resize( entry.length + 1 );
+            }
+
+            _free_blocks[ entry.length ].emplace_back( entry.offset );
+        }
+
+        _free_handles.emplace_back( handle );
+        --_size;
+    }
+
+    return true;
+}
+
+/**
+ * Finds the handle of an interned string
+ * @param str String
+ * @return Handle (`INVALID_HANDLE` when not interned)
+ */
+InternTable::Handle_t InternTable::find( std::string_view str ) const {
+    return _index[ indexSlot( str, InternTable::computeHash( str ) ) ];
+}
+
+/**
+ * Gets an interned string
+ * @param handle Handle
+ * @return String (only valid until the next `acquire(..)`)
+ */
+std::string_view InternTable::view( Handle_t handle ) const {
+    const auto & entry = _entries[ handle ];
+    return { _arena.data() + entry.offset, entry.length };
+}
+
+/**
+ * Gets the number of distinct strings interned
+ * @return String count
+ */
+size_t InternTable::size() const {
+    return _size;
+}
+
+/**
+ * Gets the upper bound of the handles issued so far
+ * @return Handle upper bound (exclusive)
+ */
+size_t InternTable::capacity() const {
+    return _entries.size();
+}
+
+/**
+ * Hashes a string (64-bit FNV-1a)
+ * @param str String
+ * @return Hash
+ */
+uint64_t InternTable::computeHash( std::string_view str ) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for( const auto ch : str ) {
+        hash ^= static_cast<uint8_t>( ch );
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/**
+ * [PRIVATE] Looks up a string in the index
+ * @param str String
+ * @param hash String's hash
+ * @return Index slot holding the string's handle or, when not interned, the empty slot where it would go
+ */
+size_t InternTable::indexSlot( std::string_view str, uint64_t hash ) const {
+    const auto mask = _index.size() - 1;
+
+    for( auto slot = static_cast<size_t>( hash ) & mask; ; slot = ( slot + 1 ) & mask ) {
+        const auto handle = _index[ slot ];
+
+        if( handle == INVALID_HANDLE ) {
+            return slot; //EARLY RETURN
+        }
+
+        const auto & entry = _entries[ handle ];
+
+        if( entry.hash == hash && entry.length == str.size() && std::memcmp( _arena.data() + entry.offset, str.data(), str.size() ) == 0 ) {
+            return slot; //EARLY RETURN
+        }
+    }
+}
+
+/**
+ * [PRIVATE] Copies a string into the arena (re-using the space of a released string of the same length when possible)
+ * @param str String
+ * @return Offset of the string in the arena
+ */
+uint32_t InternTable::store( std::string_view str ) {
+    uint32_t offset;
+
+    if( str.size() < _free_blocks.size() && !_free_blocks[ str.size() ].empty() ) {
+        offset = _free_blocks[ str.size() ].back();
+        _free_blocks[ str.size() ].pop_back();
+    } else {
+        offset = static_cast<uint32_t>( _arena.size() );
+        _arena.resize( _arena.size() + str.size() );
+    }
+
+    std::memcpy( _arena.data() + offset, str.data(), str.size() );
+
+    return offset;
+}
+
+/**
+ * [PRIVATE] Doubles the size of the index (re-using the stored hashes)
+ */
+void InternTable::growIndex() {
+    auto       index = std::vector<Handle_t>( _index.size() * 2, INVALID_HANDLE );
+    const auto mask  = index.size() - 1;
+
+    for( const auto handle : _index ) {
+        if( handle != INVALID_HANDLE ) {
+            auto slot = static_cast<size_t>( _entries[ handle ].hash ) & mask;
+
+            while( index[ slot ] != INVALID_HANDLE ) {
+                slot = ( slot + 1 ) & mask;
+            }
+
+            index[ slot ] = handle;
+        }
+    }
+
+    _index.swap( index );
+}
+
+/**
+ * [PRIVATE] Removes a handle from the index (backward shift deletion so that no tombstones are needed)
+ * @param handle Handle
+ */
+void InternTable::eraseFromIndex( Handle_t handle ) {
+    const auto mask = _index.size() - 1;
+    auto       hole = static_cast<size_t>( _entries[ handle ].hash ) & mask;
+
+    while( _index[ hole ] != handle ) {
+        hole = ( hole + 1 ) & mask;
+    }
+
+    for( auto slot = ( hole + 1 ) & mask; _index[ slot ] != INVALID_HANDLE; slot = ( slot + 1 ) & mask ) {
+        const auto home = static_cast<size_t>( _entries[ _index[ slot ] ].hash ) & mask;
+
+        const bool stays = ( hole <= slot ? ( hole < home && home <= slot )   //home in (hole, slot]: probe chain unbroken
+                                          : ( hole < home || home <= slot ) );
+
+        if( !stays ) {
+            _index[ hole ] = _index[ slot ];
+            hole           = slot;
+        }
+    }
+
+    _index[ hole ] = INVALID_HANDLE;
+}
@@ -0,0 +1,56 @@
+#ifndef FWD_PROXY_CONTAINER_INTERNTABLE_H
+#define FWD_PROXY_CONTAINER_INTERNTABLE_H
+
+#include <vector>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+namespace fwd_proxy::container {
+    /**
+     * Reference counted table of interned strings identified by small integer handles
+     * Each distinct string is stored once in a shared arena along with its precomputed hash. Lookups go
+     * through an open addressing index so that they never allocate. The handle and arena space of a
+     * string are recycled when its last reference is released.
+     */
+    class InternTable {
+      public:
+        typedef uint32_t Handle_t;
+
+        static constexpr Handle_t INVALID_HANDLE = UINT32_MAX;
+
+        explicit InternTable( size_t capacity = 0 );
+
+        Handle_t acquire( std::string_view str );
+        bool release( Handle_t handle );
+
+        [[nodiscard]] Handle_t find( std::string_view str ) const;
+        [[nodiscard]] std::string_view view( Handle_t handle ) const;
+        [[nodiscard]] size_t size() const;
+        [[nodiscard]] size_t capacity() const;
+
+        static uint64_t computeHash( std::string_view str );
+
+      private:
+        struct Entry_t {
+            uint64_t hash       { 0 };
+            uint32_t offset     { 0 }; //position of the string in the arena
+            uint32_t length     { 0 };
+            uint32_t references { 0 }; //0 when the handle is free
+        };
+
+        std::vector<Entry_t>               _entries;      //indexed by handle
+        std::vector<Handle_t>              _free_handles;
+        std::vector<char>                  _arena;
+        std::vector<std::vector<uint32_t>> _free_blocks;  //arena offsets of released strings, by length
+        std::vector<Handle_t>              _index;        //linear probing (`INVALID_HANDLE` for empty slots)
+        size_t                             _size;
+
+        [[nodiscard]] size_t indexSlot( std::string_view str, uint64_t hash ) const;
+        uint32_t store( std::string_view str );
+        void growIndex();
+        void eraseFromIndex( Handle_t handle );
+    };
+}
+
+#endif //FWD_PROXY_CONTAINER_INTERNTABLE_H
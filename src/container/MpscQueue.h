@@ -0,0 +1,140 @@
+#ifndef FWD_PROXY_CONTAINER_MPSCQUEUE_H
+#define FWD_PROXY_CONTAINER_MPSCQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+namespace fwd_proxy::container {
+    /**
+     * Bounded lock-free multi-producer/single-consumer queue (sequence-numbered ring of cells)
+     * @tparam T Element type
+     */
+    template<typename T> class MpscQueue {
+      public:
+        explicit MpscQueue( size_t capacity );
+        MpscQueue( const MpscQueue & ) = delete;
+
+        MpscQueue & operator =( const MpscQueue & ) = delete;
+
+        bool tryPush( const T & value );
+        bool tryPush( T && value );
+        bool tryPop( T & value );
+
+        [[nodiscard]] size_t capacity() const;
+
+      private:
+        struct Cell_t {
+            std::atomic<size_t> sequence;
+            T                   value;
+        };
+
+        static constexpr size_t CACHE_LINE_SIZE = 64;
+
+        const size_t                                   _mask;
+        std::unique_ptr<Cell_t[]>                      _cells;
+        alignas( CACHE_LINE_SIZE ) std::atomic<size_t> _enqueue_pos;
+        alignas( CACHE_LINE_SIZE ) std::atomic<size_t> _dequeue_pos;
+
+        static size_t roundUpPow2( size_t n );
+    };
+
+    /**
+     * Constructor
+     * @param capacity Maximum number of elements (rounded up to the next power of 2)
+     */
+    template<typename T> MpscQueue<T>::MpscQueue( size_t capacity ) :
+        _mask( roundUpPow2( capacity ) - 1 ),
+        _cells( std::make_unique<Cell_t[]>( _mask + 1 ) ),
+        _enqueue_pos( 0 ),
+        _dequeue_pos( 0 )
+    {
+        for( size_t i = 0; i <= _mask; ++i ) {
+            _cells[i].sequence.store( i, std::memory_order_relaxed );
+        }
+    }
+
+    /**
+     * Pushes a copy of an element (safe to call from multiple threads)
+     * @param value Element
+     * @return Success (false when full)
+     */
+    template<typename T> bool MpscQueue<T>::tryPush( const T & value ) {
+        return tryPush( T( value ) );
+    }
+
+    /**
+     * Pushes an element (safe to call from multiple threads)
+     * @param value Element (only moved from on success, so a push can be retried with it when full)
+     * @return Success (false when full)
+     */
+    template<typename T> bool MpscQueue<T>::tryPush( T && value ) {
+        auto pos = _enqueue_pos.load( std::memory_order_relaxed );
+
+        while( true ) {
+            auto &     cell = _cells[ pos & _mask ];
+            const auto seq  = cell.sequence.load( std::memory_order_acquire );
+            const auto diff = static_cast<std::ptrdiff_t>( seq ) - static_cast<std::ptrdiff_t>( pos );
+
+            if( diff == 0 ) {
+                if( _enqueue_pos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+                    cell.value = std::move( value );
+                    cell.sequence.store( pos + 1, std::memory_order_release );
+                    return true; //EARLY RETURN
+                }
+
+            } else if( diff < 0 ) {
+                return false; //EARLY RETURN (full)
+
+            } else {
+                pos = _enqueue_pos.load( std::memory_order_relaxed );
+            }
+        }
+    }
+
+    /**
+     * Pops an element (single consumer thread only)
+     * @param value Element to move the popped value into
+     * @return Success (false when empty)
+     */
+    template<typename T> bool MpscQueue<T>::tryPop( T & value ) {
+        const auto pos  = _dequeue_pos.load( std::memory_order_relaxed );
+        auto &     cell = _cells[ pos & _mask ];
+        const auto seq  = cell.sequence.load( std::memory_order_acquire );
+
+        if( static_cast<std::ptrdiff_t>( seq ) - static_cast<std::ptrdiff_t>( pos + 1 ) < 0 ) {
+            return false; //EARLY RETURN (empty)
+        }
+
+        value = std::move( cell.value );
+        cell.sequence.store( pos + _mask + 1, std::memory_order_release );
+        _dequeue_pos.store( pos + 1, std::memory_order_relaxed );
+
+        return true;
+    }
+
+    /**
+     * Gets the queue's capacity
+     * @return Capacity
+     */
+    template<typename T> size_t MpscQueue<T>::capacity() const {
+        return _mask + 1;
+    }
+
+    /**
+     * [PRIVATE] Rounds up to the next power of 2
+     * @param n Value
+     * @return Power of 2 >= n
+     */
+    template<typename T> size_t MpscQueue<T>::roundUpPow2( size_t n ) {
+        size_t pow2 = 2;
+
+        while( pow2 < n ) {
+            pow2 <<= 1;
+        }
+
+        return pow2;
+    }
+}
+
+#endif //FWD_PROXY_CONTAINER_MPSCQUEUE_H
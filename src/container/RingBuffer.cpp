@@ -0,0 +1,266 @@
+#include "RingBuffer.h"
+
+#include <algorithm>
+#include <utility>
+#include <cstring>
+
+#include <sys/uio.h>
+
+using namespace fwd_proxy::container;
+
+/**
+ * Default constructor (no capacity)
+ */
+RingBuffer::RingBuffer() :
+    RingBuffer( 0 )
+{}
+
+/**
+ * Constructor
+ * @param capacity Capacity in bytes (rounded up to the next power of 2)
+ */
+RingBuffer::RingBuffer( size_t capacity ) :
+    _capacity( RingBuffer::nextPowerOf2( capacity ) ),
+    _head( 0 ),
+    _tail( 0 )
+{}
+
+/**
+ * Move-constructor
+ * @param buffer RingBuffer to move over
+ */
+RingBuffer::RingBuffer( RingBuffer && buffer ) noexcept :
+    _capacity( std::exchange( buffer._capacity, 0 ) ),
+    _data( std::move( buffer._data ) ),
+    _head( std::exchange( buffer._head, 0 ) ),
+    _tail( std::exchange( buffer._tail, 0 ) )
+{}
+
+/**
+ * Move-assignment operator
+ * @param buffer RingBuffer to move over
+ * @return Moved-to RingBuffer
+ */
+RingBuffer & RingBuffer::operator =( RingBuffer && buffer ) noexcept {
+    if( this != &buffer ) {
+        _capacity = std::exchange( buffer._capacity, 0 );
+        _data     = std::move( buffer._data );
+        _head     = std::exchange( buffer._head, 0 );
+        _tail     = std::exchange( buffer._tail, 0 );
+    }
+
+    return *this;
+}
+
+/**
+ * Gets the number of bytes buffered
+ * @return Byte count
+ */
+size_t RingBuffer::size() const {
+    return _tail - _head;
+}
+
+/**
+ * Gets the buffer's capacity
+ * @return Capacity in bytes
+ */
+size_t RingBuffer::capacity() const {
+    return _capacity;
+}
+
+/**
+ * Gets the space left in the buffer
+ * @return Free space in bytes
+ */
+size_t RingBuffer::freeSpace() const {
+    return _capacity - size();
+}
+
+/**
+ * Checks if the buffer is empty
+ * @return Empty state
+ */
+bool RingBuffer::empty() const {
+    return _tail == _head;
+}
+
+/**
+ * Checks if the buffer is full
+ * @return Full state
+ */
+bool RingBuffer::full() const {
+    return size() == _capacity;
+}
+
+/**
+ * Copies bytes into the buffer
+ * @param data Source
+ * @param length Number of bytes in source
+ * @return Number of bytes buffered (less than `length` when there isn't enough space)
+ */
+size_t RingBuffer::write( const char * data, size_t length ) {
+    allocate();
+
+    const auto count  = std::min( length, freeSpace() );
+    const auto offset = ( _tail & ( _capacity - 1 ) );
+    const auto first  = std::min( count, _capacity - offset );
+
+    std::memcpy( &_data[ offset ], data, first );
+    std::memcpy( &_data[ 0 ], data + first, count - first );
+    _tail += count;
+
+    return count;
+}
+
+/**
+ * Copies bytes out of the buffer
+ * @param data Destination
+ * @param length Size of destination
+ * @return Number of bytes copied
+ */
+size_t RingBuffer::read( char * data, size_t length ) {
+    const auto count  = std::min( length, size() );
+    const auto offset = ( _head & ( _capacity - 1 ) );
+    const auto first  = std::min( count, _capacity - offset );
+
+    if( count > 0 ) {
+        std::memcpy( data, &_data[ offset ], first );
+        std::memcpy( data + first, &_data[ 0 ], count - first );
+        _head += count;
+    }
+
+    return count;
+}
+
+/**
+ * Gets the contiguous run of buffered bytes starting at an offset (for inspection in place)
+ * @param offset Offset from the oldest buffered byte
+ * @param data Set to the start of the run
+ * @return Number of contiguous bytes (0 when `offset` is past the buffered bytes)
+ */
+size_t RingBuffer::span( size_t offset, const char ** data ) const {
+    if( offset >= size() ) {
+        return 0; //EARLY RETURN
+    }
+
+    const auto position = ( ( _head + offset ) & ( _capacity - 1 ) );
+
+    *data = &_data[ position ];
+
+    return std::min( size() - offset, _capacity - position );
+}
+
+/**
+ * Reads from a file descriptor straight into the buffer's free space (`readv`)
+ * @param fd File descriptor
+ * @return Bytes read (0 on EOF or when full, -1 on error with `errno` set)
+ */
+ssize_t RingBuffer::readFrom( int fd ) {
+    allocate();
+
+    if( full() ) {
+        return 0; //EARLY RETURN
+    }
+
+    const auto   free_bytes = freeSpace();
+    const auto   offset     = ( _tail & ( _capacity - 1 ) );
+    const auto   first      = std::min( free_bytes, _capacity - offset );
+    struct iovec iov[2]     = { { &_data[ offset ], first }, { &_data[ 0 ], free_bytes - first } };
+
+    auto bytes = ::readv( fd, iov, ( free_bytes > first ? 2 : 1 ) );
+
+    if( bytes > 0 ) {
+        _tail += bytes;
+    }
+
+    return bytes;
+}
+
+/**
+ * Writes buffered bytes to a file descriptor (`writev`)
+ * @param fd File descriptor
+ * @return Bytes written (-1 on error with `errno` set)
+ */
+ssize_t RingBuffer::writeTo( int fd ) {
+    if( empty() ) {
+        return 0; //EARLY RETURN
+    }
+
+    const auto   used   = size();
+    const auto   offset = ( _head & ( _capacity - 1 ) );
+    const auto   first  = std::min( used, _capacity - offset );
+    struct iovec iov[2] = { { &_data[ offset ], first }, { &_data[ 0 ], used - first } };
+
+    auto bytes = ::writev( fd, iov, ( used > first ? 2 : 1 ) );
+
+    if( bytes > 0 ) {
+        _head += bytes;
+
+        if( empty() ) { //realign so the next read gets a single contiguous block
+            _head = _tail = 0;
+        }
+    }
+
+    return bytes;
+}
+
+/**
+ * Changes the buffer's capacity whilst keeping its content
+ * @param capacity New capacity in bytes (rounded up to the next power of 2)
+ * @return Success (false when the content doesn't fit)
+ */
+bool RingBuffer::resize( size_t capacity ) {
+    const auto new_capacity = RingBuffer::nextPowerOf2( capacity );
+
+    if( new_capacity == _capacity ) {
+        return true; //EARLY RETURN
+    }
+
+    if( size() > new_capacity ) {
+        return false; //EARLY RETURN
+    }
+
+    if( _data ) {
+        auto       data  = std::make_unique_for_overwrite<char[]>( new_capacity );
+        const auto count = read( data.get(), size() );
+
+        _data = std::move( data );
+        _head = 0;
+        _tail = count;
+    }
+
+    _capacity = new_capacity;
+
+    return true;
+}
+
+/**
+ * Drops all buffered bytes
+ */
+void RingBuffer::clear() {
+    _head = _tail = 0;
+}
+
+/**
+ * [PRIVATE] Allocates storage if not already done
+ */
+void RingBuffer::allocate() {
+    if( !_data && _capacity > 0 ) {
+        _data = std::make_unique_for_overwrite<char[]>( _capacity );
+    }
+}
+
+/**
+ * [PRIVATE] Rounds up to a power of 2
+ * @param n Value
+ * @return Smallest power of 2 >= `n` (0 when `n` is 0)
+ */
+size_t RingBuffer::nextPowerOf2( size_t n ) {
+    size_t value = ( n > 0 ? 1 : 0 );
+
+    while( value < n ) {
+        value <<= 1;
+    }
+
+    return value;
+}
@@ -0,0 +1,48 @@
+#ifndef FWD_PROXY_CONTAINER_RINGBUFFER_H
+#define FWD_PROXY_CONTAINER_RINGBUFFER_H
+
+#include <memory>
+#include <cstddef>
+#include <sys/types.h>
+
+namespace fwd_proxy::container {
+    /**
+     * Fixed capacity byte ring buffer with scatter/gather I/O (storage is allocated on first use)
+     */
+    class RingBuffer {
+      public:
+        RingBuffer();
+        explicit RingBuffer( size_t capacity );
+        RingBuffer( const RingBuffer & ) = delete;
+        RingBuffer( RingBuffer && buffer ) noexcept;
+
+        RingBuffer & operator =( const RingBuffer & ) = delete;
+        RingBuffer & operator =( RingBuffer && buffer ) noexcept;
+
+        [[nodiscard]] size_t size() const;
+        [[nodiscard]] size_t capacity() const;
+        [[nodiscard]] size_t freeSpace() const;
+        [[nodiscard]] bool empty() const;
+        [[nodiscard]] bool full() const;
+
+        size_t write( const char * data, size_t length );
+        size_t read( char * data, size_t length );
+        size_t span( size_t offset, const char ** data ) const;
+        ssize_t readFrom( int fd );
+        ssize_t writeTo( int fd );
+        bool resize( size_t capacity );
+        void clear();
+
+      private:
+        size_t                  _capacity;
+        std::unique_ptr<char[]> _data;
+        size_t                  _head; //read position (monotonic)
+        size_t                  _tail; //write position (monotonic)
+
+        void allocate();
+
+        static size_t nextPowerOf2( size_t n );
+    };
+}
+
+#endif //FWD_PROXY_CONTAINER_RINGBUFFER_H
@@ -0,0 +1,169 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <ctime>
+
+using namespace fwd_proxy::container;
+
+/**
+ * Constructor
+ * @param tick_ms Resolution of the wheel in ms (deadlines are rounded up to it)
+ * @param capacity Number of timer IDs to make room for upfront (0..capacity-1)
+ */
+TimerWheel::TimerWheel( uint64_t tick_ms, size_t capacity ) :
+    _tick_ms( std::max( tick_ms, static_cast<uint64_t>( 1 ) ) ),
+    _current_tick( TimerWheel::now() / _tick_ms ),
+    _nodes( capacity ),
+    _heads(),
+    _size( 0 )
+{
+    _heads.fill( NONE );
+}
+
+/**
+ * Schedules a timer (replaces the one already scheduled with the same ID)
+ * @param id Timer ID
+ * @param deadline_ms Time at which it expires in ms (on the `now()` clock)
+ */
+void TimerWheel::schedule( TimerId_t id, uint64_t deadline_ms ) {
+    static constexpr uint64_t HORIZON = ( 1ULL << ( SLOT_BITS * LEVELS ) ) - 1;
+
+    if( id >= _nodes.size() ) {
+        _nodes.resize( std::max( static_cast<size_t>( id ) + 1, _nodes.size() * 2 ) );
+    }
+
+    cancel( id );
+
+    const auto expiry = ( deadline_ms + _tick_ms - 1 ) / _tick_ms; //rounded up so it never fires early
+
+    _nodes[ id ].expiry = std::clamp( expiry, _current_tick + 1, _current_tick + HORIZON );
+
+    link( id );
+    ++_size;
+}
+
+/**
+ * Cancels a timer
+ * @param id Timer ID
+ * @return Existence state (false when it wasn't scheduled)
+ */
+bool TimerWheel::cancel( TimerId_t id ) {
+    if( !scheduled( id ) ) {
+        return false; //EARLY RETURN
+    }
+
+    unlink( id );
+
+    return true;
+}
+
+/**
+ * Checks if a timer is scheduled
+ * @param id Timer ID
+ * @return Scheduled state
+ */
+bool TimerWheel::scheduled( TimerId_t id ) const {
+    return id < _nodes.size() && _nodes[ id ].slot != NO_SLOT;
+}
+
+/**
+ * Gets the number of timers scheduled
+ * @return Timer count
+ */
+size_t TimerWheel::size() const {
+    return _size;
+}
+
+/**
+ * Gets the wheel's resolution
+ * @return Tick length in ms
+ */
+uint64_t TimerWheel::tick() const {
+    return _tick_ms;
+}
+
+/**
+ * Gets the current time on the clock used for the deadlines
+ * @return Monotonic time in ms
+ */
+uint64_t TimerWheel::now() {
+    struct timespec ts {};
+
+    ::clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return static_cast<uint64_t>( ts.tv_sec ) * 1000 + static_cast<uint64_t>( ts.tv_nsec ) / 1000000;
+}
+
+/**
+ * [PRIVATE] Inserts a timer in the slot matching its expiry (level picked from the distance to the current tick)
+ * @param id Timer ID
+ */
+void TimerWheel::link( TimerId_t id ) {
+    auto &     node  = _nodes[ id ];
+    const auto delta = node.expiry - _current_tick;
+    unsigned   level = 0;
+
+    while( level + 1 < LEVELS && delta >= ( 1ULL << ( SLOT_BITS * ( level + 1 ) ) ) ) {
+        ++level;
+    }
+
+    const auto slot = static_cast<uint16_t>( level * SLOTS + ( ( node.expiry >> ( SLOT_BITS * level ) ) & ( SLOTS - 1 ) ) );
+
+    node.slot = slot;
+    node.prev = NONE;
+    node.next = _heads[ slot ];
+
+    if( node.next != NONE ) {
+        _nodes[ node.next ].prev = id;
+    }
+
+    _heads[ slot ] = id;
+}
+
+/**
+ * [PRIVATE] Removes a timer from its slot
+ * @param id Timer ID
+ */
+void TimerWheel::unlink( TimerId_t id ) {
+    auto & node = _nodes[ id ];
+
+    if( node.prev != NONE ) {
+        _nodes[ node.prev ].next = node.next;
+    } else {
+        _heads[ node.slot ] = node.next;
+    }
+
+    if( node.next != NONE ) {
+        _nodes[ node.next ].prev = node.prev;
+    }
+
+    node.slot = NO_SLOT;
+    node.prev = NONE;
+    node.next = NONE;
+    --_size;
+}
+
+/**
+ * [PRIVATE] Re-distributes the timers of the upper level slots whose turn starts at the current tick
+ */
+void TimerWheel::cascade() {
+    for( unsigned level = LEVELS - 1; level > 0; --level ) {
+        const auto shift = SLOT_BITS * level;
+
+        if( ( _current_tick & ( ( 1ULL << shift ) - 1 ) ) != 0 ) {
+            continue; //lower wheel hasn't completed a turn
+        }
+
+        auto & head = _heads[ level * SLOTS + ( ( _current_tick >> shift ) & ( SLOTS - 1 ) ) ];
+        auto   id   = head;
+
+        head = NONE;
+
+        while( id != NONE ) {
+            const auto next = _nodes[ id ].next;
+
+            link( id );
+            id = next;
+        }
+    }
+}
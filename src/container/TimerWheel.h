@@ -0,0 +1,88 @@
+#ifndef FWD_PROXY_CONTAINER_TIMERWHEEL_H
+#define FWD_PROXY_CONTAINER_TIMERWHEEL_H
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace fwd_proxy::container {
+    /**
+     * Hierarchical timing wheel (4 levels of 64 slots) of timers identified by small integers (e.g. file descriptors)
+     * Scheduling, re-scheduling and cancelling are O(1): timers are kept in intrusive lists, 1 per slot, and are
+     * cascaded down a level each time the wheel below completes a turn. There is at most 1 timer per ID.
+     * Deadlines beyond the wheel's horizon (64^4 ticks) are clamped to it.
+     */
+    class TimerWheel {
+      public:
+        typedef uint32_t TimerId_t;
+
+        explicit TimerWheel( uint64_t tick_ms, size_t capacity = 0 );
+
+        void schedule( TimerId_t id, uint64_t deadline_ms );
+        bool cancel( TimerId_t id );
+
+        [[nodiscard]] bool scheduled( TimerId_t id ) const;
+        [[nodiscard]] size_t size() const;
+        [[nodiscard]] uint64_t tick() const;
+
+        template<typename Fn> void advance( uint64_t now_ms, Fn on_expiry );
+
+        static uint64_t now();
+
+      private:
+        static constexpr unsigned  LEVELS    = 4;
+        static constexpr unsigned  SLOT_BITS = 6;
+        static constexpr unsigned  SLOTS     = 1U << SLOT_BITS;
+        static constexpr uint32_t  NONE      = UINT32_MAX;
+        static constexpr uint16_t  NO_SLOT   = UINT16_MAX;
+
+        struct Node_t {
+            uint64_t expiry { 0 }; //tick
+            uint32_t prev   { NONE };
+            uint32_t next   { NONE };
+            uint16_t slot   { NO_SLOT }; //level * SLOTS + slot (`NO_SLOT` when not scheduled)
+        };
+
+        const uint64_t                           _tick_ms;
+        uint64_t                                 _current_tick;
+        std::vector<Node_t>                      _nodes; //indexed by ID
+        std::array<uint32_t, LEVELS * SLOTS>     _heads;
+        size_t                                   _size;
+
+        void link( TimerId_t id );
+        void unlink( TimerId_t id );
+        void cascade();
+    };
+
+    /**
+     * Moves the wheel forward, firing the timers that expired on the way
+     * (timers are unscheduled before their callback so it can safely schedule/cancel any timer)
+     * @tparam Fn Function type
+     * @param now_ms Current time in ms (same clock as the deadlines, e.g. `now()`)
+     * @param on_expiry Function with a `( TimerId_t id )` signature
+     */
+    template<typename Fn> void TimerWheel::advance( uint64_t now_ms, Fn on_expiry ) {
+        const uint64_t target = now_ms / _tick_ms;
+
+        if( _size == 0 && _current_tick < target ) {
+            _current_tick = target; //nothing to fire or cascade on the way
+        }
+
+        while( _current_tick < target ) {
+            ++_current_tick;
+            cascade();
+
+            auto & head = _heads[ _current_tick & ( SLOTS - 1 ) ];
+
+            while( head != NONE ) {
+                const auto id = head;
+
+                unlink( id );
+                on_expiry( id );
+            }
+        }
+    }
+}
+
+#endif //FWD_PROXY_CONTAINER_TIMERWHEEL_H
@@ -0,0 +1,16 @@
+#include "ForwardingMode.h"
+
+/**
+ * Output stream operator
+ * @param os Output stream
+ * @param mode ForwardingMode enum
+ * @return Output stream
+ */
+std::ostream & fwd_proxy::operator <<( std::ostream &os, fwd_proxy::ForwardingMode mode ) {
+    switch( mode ) {
+        case ForwardingMode::COPY  : { os << "copy";   } break;
+        case ForwardingMode::SPLICE: { os << "splice"; } break;
+    }
+
+    return os;
+}
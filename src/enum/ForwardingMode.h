@@ -0,0 +1,15 @@
+#ifndef FWD_PROXY_ENUM_FORWARDINGMODE_H
+#define FWD_PROXY_ENUM_FORWARDINGMODE_H
+
+#include <ostream>
+
+namespace fwd_proxy {
+    enum class ForwardingMode {
+        COPY = 0, //`recv` into user-space buffer then `send`
+        SPLICE,   //`splice` through a kernel pipe (falls back to COPY when not possible)
+    };
+
+    std::ostream & operator <<( std::ostream & os, ForwardingMode mode );
+}
+
+#endif //FWD_PROXY_ENUM_FORWARDINGMODE_H
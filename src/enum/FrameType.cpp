@@ -0,0 +1,17 @@
+#include "FrameType.h"
+
+/**
+ * Output stream operator
+ * @param os Output stream
+ * @param type FrameType enum
+ * @return Output stream
+ */
+std::ostream & fwd_proxy::operator <<( std::ostream &os, fwd_proxy::FrameType type ) {
+    switch( type ) {
+        case FrameType::DATA        : { os << "DATA";         } break;
+        case FrameType::READY       : { os << "READY";        } break;
+        case FrameType::DISCONNECTED: { os << "DISCONNECTED"; } break;
+    }
+
+    return os;
+}
@@ -0,0 +1,17 @@
+#ifndef FWD_PROXY_ENUM_FRAMETYPE_H
+#define FWD_PROXY_ENUM_FRAMETYPE_H
+
+#include <ostream>
+#include <cstdint>
+
+namespace fwd_proxy {
+    enum class FrameType : uint8_t {
+        DATA = 0,     //client payload (the only type clients may send)
+        READY,        //proxy -> client: paired with a counterpart
+        DISCONNECTED, //proxy -> client: counterpart left
+    };
+
+    std::ostream & operator <<( std::ostream & os, FrameType type );
+}
+
+#endif //FWD_PROXY_ENUM_FRAMETYPE_H
@@ -0,0 +1,16 @@
+#include "IoBackend.h"
+
+/**
+ * Output stream operator
+ * @param os Output stream
+ * @param backend IoBackend enum
+ * @return Output stream
+ */
+std::ostream & fwd_proxy::operator <<( std::ostream &os, fwd_proxy::IoBackend backend ) {
+    switch( backend ) {
+        case IoBackend::EPOLL   : { os << "epoll";    } break;
+        case IoBackend::IO_URING: { os << "io_uring"; } break;
+    }
+
+    return os;
+}
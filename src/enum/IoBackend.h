@@ -0,0 +1,15 @@
+#ifndef FWD_PROXY_ENUM_IOBACKEND_H
+#define FWD_PROXY_ENUM_IOBACKEND_H
+
+#include <ostream>
+
+namespace fwd_proxy {
+    enum class IoBackend {
+        EPOLL = 0, //readiness via `epoll_wait` then 1 syscall per operation
+        IO_URING,  //batched submissions and completions via io_uring
+    };
+
+    std::ostream & operator <<( std::ostream & os, IoBackend backend );
+}
+
+#endif //FWD_PROXY_ENUM_IOBACKEND_H
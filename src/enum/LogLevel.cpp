@@ -0,0 +1,20 @@
+#include "LogLevel.h"
+
+/**
+ * Output stream operator
+ * @param os Output stream
+ * @param level LogLevel enum
+ * @return Output stream
+ */
+std::ostream & fwd_proxy::operator <<( std::ostream &os, fwd_proxy::LogLevel level ) {
+    switch( level ) {
+        case LogLevel::TRACE  : { os << "TRACE";   } break;
+        case LogLevel::DEBUG  : { os << "DEBUG";   } break;
+        case LogLevel::INFO   : { os << "INFO";    } break;
+        case LogLevel::WARNING: { os << "WARNING"; } break;
+        case LogLevel::ERROR  : { os << "ERROR";   } break;
+        case LogLevel::OFF    : { os << "OFF";     } break;
+    }
+
+    return os;
+}
@@ -0,0 +1,19 @@
+#ifndef FWD_PROXY_ENUM_LOGLEVEL_H
+#define FWD_PROXY_ENUM_LOGLEVEL_H
+
+#include <ostream>
+
+namespace fwd_proxy {
+    enum class LogLevel {
+        TRACE = 0, //per message/payload diagnostics
+        DEBUG,     //state changes (handshakes, buffers, etc.)
+        INFO,      //connections, pairings, start/stop
+        WARNING,   //recoverable issues (fallbacks, etc.)
+        ERROR,     //failures
+        OFF,       //nothing is logged
+    };
+
+    std::ostream & operator <<( std::ostream & os, LogLevel level );
+}
+
+#endif //FWD_PROXY_ENUM_LOGLEVEL_H
@@ -0,0 +1,18 @@
+#include "ShardPolicy.h"
+
+/**
+ * Output stream operator
+ * @param os Output stream
+ * @param policy ShardPolicy enum
+ * @return Output stream
+ */
+std::ostream & fwd_proxy::operator <<( std::ostream &os, fwd_proxy::ShardPolicy policy ) {
+    switch( policy ) {
+        case ShardPolicy::LEAST_LOADED: { os << "least-loaded"; } break;
+        case ShardPolicy::HASH        : { os << "hash";         } break;
+        case ShardPolicy::ROUND_ROBIN : { os << "round-robin";  } break;
+        case ShardPolicy::INCOMING_CPU: { os << "incoming-cpu"; } break;
+    }
+
+    return os;
+}
@@ -0,0 +1,17 @@
+#ifndef FWD_PROXY_ENUM_SHARDPOLICY_H
+#define FWD_PROXY_ENUM_SHARDPOLICY_H
+
+#include <ostream>
+
+namespace fwd_proxy {
+    enum class ShardPolicy {
+        LEAST_LOADED = 0, //proxy worker with the least pairings
+        HASH,             //proxy worker picked from a hash of the pair's file descriptors
+        ROUND_ROBIN,      //proxy workers picked in turn
+        INCOMING_CPU,     //proxy worker pinned to the CPU (else NUMA node) receiving the pair's packets
+    };
+
+    std::ostream & operator <<( std::ostream & os, ShardPolicy policy );
+}
+
+#endif //FWD_PROXY_ENUM_SHARDPOLICY_H
@@ -0,0 +1,17 @@
+#include "TcpProfile.h"
+
+/**
+ * Output stream operator
+ * @param os Output stream
+ * @param profile TcpProfile enum
+ * @return Output stream
+ */
+std::ostream & fwd_proxy::operator <<( std::ostream &os, fwd_proxy::TcpProfile profile ) {
+    switch( profile ) {
+        case TcpProfile::KERNEL : { os << "kernel";  } break;
+        case TcpProfile::LATENCY: { os << "latency"; } break;
+        case TcpProfile::BULK   : { os << "bulk";    } break;
+    }
+
+    return os;
+}
@@ -0,0 +1,16 @@
+#ifndef FWD_PROXY_ENUM_TCPPROFILE_H
+#define FWD_PROXY_ENUM_TCPPROFILE_H
+
+#include <ostream>
+
+namespace fwd_proxy {
+    enum class TcpProfile {
+        KERNEL = 0, //kernel defaults (Nagle's algorithm, auto-tuned buffers)
+        LATENCY,    //no Nagle, quick ACKs, little unsent data queued in the kernel
+        BULK,       //large fixed socket buffers
+    };
+
+    std::ostream & operator <<( std::ostream & os, TcpProfile profile );
+}
+
+#endif //FWD_PROXY_ENUM_TCPPROFILE_H
@@ -0,0 +1,18 @@
+#include "TlsState.h"
+
+/**
+ * Output stream operator
+ * @param os Output stream
+ * @param state TlsState enum
+ * @return Output stream
+ */
+std::ostream & fwd_proxy::operator <<( std::ostream &os, fwd_proxy::TlsState state ) {
+    switch( state ) {
+        case TlsState::WANT_READ : { os << "WANT_READ";  } break;
+        case TlsState::WANT_WRITE: { os << "WANT_WRITE"; } break;
+        case TlsState::OFFLOADED : { os << "OFFLOADED";  } break;
+        case TlsState::FAILED    : { os << "FAILED";     } break;
+    }
+
+    return os;
+}
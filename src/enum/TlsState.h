@@ -0,0 +1,17 @@
+#ifndef FWD_PROXY_ENUM_TLSSTATE_H
+#define FWD_PROXY_ENUM_TLSSTATE_H
+
+#include <ostream>
+
+namespace fwd_proxy {
+    enum class TlsState {
+        WANT_READ = 0, //handshake waiting on the socket being readable
+        WANT_WRITE,    //handshake waiting on the socket being writable
+        OFFLOADED,     //handshake done, records encrypted/decrypted by the kernel from now on
+        FAILED,
+    };
+
+    std::ostream & operator <<( std::ostream & os, TlsState state );
+}
+
+#endif //FWD_PROXY_ENUM_TLSSTATE_H
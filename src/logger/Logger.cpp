@@ -0,0 +1,416 @@
+#include "Logger.h"
+
+#include <algorithm>
+#include <utility>
+#include <chrono>
+#include <cinttypes>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+
+#include <unistd.h>
+
+#define THREAD_QUEUE_SIZE     1024 //messages buffered per thread before dropping
+#define WRITER_INTERVAL_MS      10 //max wait between batches when idle
+#define TRUNCATION_MARKER    "..."
+
+using namespace fwd_proxy::logger;
+
+/**
+ * Constructor
+ * @param per_second Number of messages allowed per second
+ */
+RateLimiter::RateLimiter( uint32_t per_second ) :
+    _limit( per_second ),
+    _count( 0 ),
+    _window( -1 ),
+    _suppressed( 0 )
+{}
+
+/**
+ * Checks if a message can go through (counts it as suppressed otherwise)
+ * @return Allowed state
+ */
+bool RateLimiter::allow() {
+    const auto now = std::chrono::duration_cast<std::chrono::seconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+
+    if( now != _window ) {
+        _window = now;
+        _count  = 0;
+    }
+
+    if( _count < _limit ) {
+        ++_count;
+        return true; //EARLY RETURN
+    }
+
+    ++_suppressed;
+    return false;
+}
+
+/**
+ * Gets and resets the number of messages suppressed since the last call
+ * @return Suppressed message count
+ */
+uint64_t RateLimiter::takeSuppressed() {
+    return std::exchange( _suppressed, 0 );
+}
+
+/**
+ * Gets the logger instance (never destroyed so it can be used until the very end of the process)
+ * @return Logger
+ */
+Logger & Logger::instance() {
+    static auto * logger = new Logger();
+    return *logger;
+}
+
+/**
+ * [PRIVATE] Constructor
+ */
+Logger::Logger() :
+    _run_flag( false ),
+    _async( false )
+{}
+
+/**
+ * Starts the background writer thread
+ * @return Success (false when already running)
+ */
+bool Logger::start() {
+    if( _run_flag.exchange( true ) ) {
+        return false; //EARLY RETURN
+    }
+
+    _writer_th = std::thread( [this]() { this->runWriter(); } );
+    _async     = true;
+
+    return true;
+}
+
+/**
+ * Stops the background writer thread once all queued messages are written (logging becomes synchronous)
+ */
+void Logger::stop() {
+    if( _run_flag ) {
+        _async    = false;
+        _run_flag = false;
+        _writer_cv.notify_one();
+        _writer_th.join();
+
+        auto batch = std::vector<Entry_t>();
+        auto out   = std::string();
+        auto err   = std::string();
+
+        collect( batch ); //queued by threads that saw `_async` just before it was cleared
+
+        std::lock_guard<std::mutex> lock( _sync_mutex );
+        Logger::write( batch, out, err );
+    }
+}
+
+/**
+ * Sets the runtime logging level
+ * @param level Lowest level logged
+ */
+void Logger::setLevel( LogLevel level ) {
+    _level.store( static_cast<int>( level ), std::memory_order_relaxed );
+}
+
+/**
+ * Gets the runtime logging level
+ * @return Lowest level logged
+ */
+fwd_proxy::LogLevel Logger::level() {
+    return static_cast<LogLevel>( _level.load( std::memory_order_relaxed ) );
+}
+
+/**
+ * Checks if a level is enabled at runtime
+ * @param level Log level
+ * @return Enabled state
+ */
+bool Logger::enabled( LogLevel level ) {
+    return level != LogLevel::OFF && static_cast<int>( level ) >= _level.load( std::memory_order_relaxed );
+}
+
+/**
+ * Starts a new message on the calling thread (`commit()` must follow)
+ * @param level Message level
+ * @return Stream to format the message into
+ */
+std::ostream & Logger::line( LogLevel level ) {
+    auto & line = Logger::threadLine();
+
+    line.entry.level = level;
+    line.buffer.reset( line.entry.text, MESSAGE_MAX_LEN );
+    line.stream.clear();
+
+    return line.stream;
+}
+
+/**
+ * Queues the message started with `line(..)` on the calling thread
+ */
+void Logger::commit() {
+    auto & logger = Logger::instance();
+    auto & line   = Logger::threadLine();
+
+    line.entry.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::system_clock::now().time_since_epoch() ).count();
+    line.entry.length    = line.buffer.length();
+
+    if( logger._async ) {
+        auto & buffer = Logger::threadBuffer();
+
+        line.entry.thread_id = buffer.thread_id;
+
+        if( buffer.queue.tryPush( line.entry ) ) {
+            return; //EARLY RETURN
+        }
+
+        buffer.dropped.fetch_add( 1, std::memory_order_relaxed );
+
+    } else {
+        auto out = std::string();
+        auto err = std::string();
+
+        line.entry.thread_id = Logger::threadBuffer().thread_id;
+
+        std::lock_guard<std::mutex> lock( logger._sync_mutex );
+        Logger::write( { line.entry }, out, err );
+    }
+}
+
+/**
+ * [PRIVATE] Runs the background writer loop
+ */
+void Logger::runWriter() {
+    auto batch = std::vector<Entry_t>();
+    auto out   = std::string();
+    auto err   = std::string();
+
+    while( true ) {
+        const bool running = _run_flag;
+
+        collect( batch );
+
+        if( !batch.empty() ) {
+            Logger::write( batch, out, err );
+            batch.clear();
+
+        } else if( running ) {
+            std::unique_lock<std::mutex> lock( _writer_mutex );
+            _writer_cv.wait_for( lock, std::chrono::milliseconds( WRITER_INTERVAL_MS ) );
+
+        } else {
+            break; //everything queued before `stop()` has been written
+        }
+    }
+}
+
+/**
+ * [PRIVATE] Takes all the messages queued by the threads
+ * @param batch Container to append the messages to
+ */
+void Logger::collect( std::vector<Entry_t> & batch ) {
+    std::lock_guard<std::mutex> lock( _buffers_mutex );
+
+    for( auto & buffer : _buffers ) {
+        Entry_t entry {};
+
+        while( buffer->queue.tryPop( entry ) ) {
+            batch.emplace_back( entry );
+        }
+
+        if( const auto dropped = buffer->dropped.exchange( 0, std::memory_order_relaxed ) ) {
+            entry           = {};
+            entry.timestamp = batch.empty() ? 0 : batch.back().timestamp;
+            entry.level     = LogLevel::WARNING;
+            entry.thread_id = buffer->thread_id;
+            entry.length    = std::snprintf( entry.text, MESSAGE_MAX_LEN, "[logger::Logger] %" PRIu64 " messages dropped (queue full)", dropped );
+            entry.length    = std::min( entry.length, static_cast<uint32_t>( MESSAGE_MAX_LEN - 1 ) );
+            batch.emplace_back( entry );
+        }
+    }
+
+    std::stable_sort( batch.begin(), batch.end(), []( const Entry_t & a, const Entry_t & b ) { return a.timestamp < b.timestamp; } );
+}
+
+/**
+ * [PRIVATE] Gives the calling thread a message queue, reusing one left by an exited thread when there is any
+ * (what it still holds is drained by the writer as usual, each message carrying its own thread ID)
+ * @return Thread's message queue
+ */
+Logger::ThreadBuffer_t * Logger::registerThread() {
+    std::lock_guard<std::mutex> lock( _buffers_mutex );
+
+    for( auto & buffer : _buffers ) {
+        if( !buffer->in_use ) {
+            buffer->in_use = true;
+            return buffer.get(); //EARLY RETURN
+        }
+    }
+
+    _buffers.emplace_back( std::make_unique<ThreadBuffer_t>( _buffers.size(), THREAD_QUEUE_SIZE ) );
+
+    return _buffers.back().get();
+}
+
+/**
+ * [PRIVATE] Makes the message queue of an exiting thread available to the next thread registering
+ * @param buffer Thread's message queue
+ */
+void Logger::releaseThread( ThreadBuffer_t * buffer ) {
+    std::lock_guard<std::mutex> lock( _buffers_mutex );
+    buffer->in_use = false;
+}
+
+/**
+ * [PRIVATE] Gets the message being built on the calling thread
+ * @return Thread's line
+ */
+Logger::Line_t & Logger::threadLine() {
+    return Logger::threadBuffer().line;
+}
+
+/**
+ * [PRIVATE] Gets the message queue of the calling thread
+ * @return Thread's message queue
+ */
+Logger::ThreadBuffer_t & Logger::threadBuffer() {
+    static thread_local ThreadBuffer_t * buffer = nullptr; //trivially destructible on purpose
+
+    if( buffer == nullptr ) { //a thread logging once its release ran gets a buffer that is never recycled
+        buffer = Logger::instance().registerThread();
+
+        static thread_local ThreadRelease_t release { &buffer };
+    }
+
+    return *buffer;
+}
+
+/**
+ * [PRIVATE] Writes messages to stdout/stderr (1 `write` per stream per batch)
+ * @param batch Messages
+ * @param out Scratch string for stdout
+ * @param err Scratch string for stderr
+ */
+void Logger::write( const std::vector<Entry_t> & batch, std::string & out, std::string & err ) {
+    out.clear();
+    err.clear();
+
+    for( const auto & entry : batch ) {
+        Logger::format( entry, ( entry.level >= LogLevel::WARNING ? err : out ) );
+    }
+
+    Logger::writeAll( STDOUT_FILENO, out );
+    Logger::writeAll( STDERR_FILENO, err );
+}
+
+/**
+ * [PRIVATE] Formats a message as a line of text
+ * @param entry Message
+ * @param out String to append the line to
+ */
+void Logger::format( const Entry_t & entry, std::string & out ) {
+    static constexpr const char * LEVELS[] = { "TRACE", "DEBUG", "INFO ", "WARN ", "ERROR", "OFF  " };
+
+    const auto    seconds = static_cast<time_t>( entry.timestamp / 1000000000 );
+    const auto    millis  = static_cast<int>( ( entry.timestamp / 1000000 ) % 1000 );
+    struct tm     time {};
+    char          prefix[64];
+
+    ::localtime_r( &seconds, &time );
+
+    const auto length = std::snprintf( prefix, sizeof( prefix ), "%02d:%02d:%02d.%03d %s #%u ",
+                                       time.tm_hour, time.tm_min, time.tm_sec, millis,
+                                       LEVELS[ static_cast<int>( entry.level ) ], entry.thread_id );
+
+    out.append( prefix, std::max( length, 0 ) );
+    out.append( entry.text, entry.length );
+
+    if( entry.length == MESSAGE_MAX_LEN ) {
+        out.append( TRUNCATION_MARKER );
+    }
+
+    out.push_back( '\n' );
+}
+
+/**
+ * [PRIVATE] Writes a whole string to a file descriptor
+ * @param fd File descriptor
+ * @param str String
+ */
+void Logger::writeAll( int fd, const std::string & str ) {
+    size_t offset = 0;
+
+    while( offset < str.size() ) {
+        const auto bytes = ::write( fd, str.data() + offset, str.size() - offset );
+
+        if( bytes <= 0 ) {
+            if( bytes == -1 && errno == EINTR ) {
+                continue;
+            }
+
+            return; //EARLY RETURN (nowhere to report it)
+        }
+
+        offset += bytes;
+    }
+}
+
+/**
+ * Constructor
+ * @param id Thread ID (logger assigned)
+ * @param capacity Queue capacity
+ */
+Logger::ThreadBuffer_t::ThreadBuffer_t( uint32_t id, size_t capacity ) :
+    thread_id( id ),
+    queue( capacity ),
+    dropped( 0 ),
+    line(),
+    in_use( true )
+{}
+
+/**
+ * Destructor (thread exit)
+ */
+Logger::ThreadRelease_t::~ThreadRelease_t() {
+    Logger::instance().releaseThread( std::exchange( *buffer, nullptr ) );
+}
+
+/**
+ * Sets the area to format into
+ * @param begin Start of the area
+ * @param size Size of the area
+ */
+void Logger::LineBuffer::reset( char * begin, size_t size ) {
+    setp( begin, begin + size );
+}
+
+/**
+ * Gets the number of characters formatted
+ * @return Length
+ */
+size_t Logger::LineBuffer::length() const {
+    return static_cast<size_t>( pptr() - pbase() );
+}
+
+/**
+ * [PROTECTED] Drops characters past the end of the area (truncation)
+ * @param ch Character
+ * @return Not EOF (so the stream doesn't error)
+ */
+Logger::LineBuffer::int_type Logger::LineBuffer::overflow( int_type ch ) {
+    return traits_type::not_eof( ch );
+}
+
+/**
+ * Constructor
+ */
+Logger::Line_t::Line_t() :
+    entry(),
+    buffer(),
+    stream( &buffer )
+{}
@@ -0,0 +1,190 @@
+#ifndef FWD_PROXY_LOGGER_LOGGER_H
+#define FWD_PROXY_LOGGER_LOGGER_H
+
+#include <ostream>
+#include <streambuf>
+#include <memory>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+#include "../enum/LogLevel.h"
+#include "../container/MpscQueue.h"
+
+#ifndef FWD_PROXY_LOG_LEVEL
+    #define FWD_PROXY_LOG_LEVEL 0 //lowest `LogLevel` compiled in (statements below it are elided)
+#endif
+
+/**
+ * Logs a message (e.g.: `LOG_AT( LogLevel::INFO, "client " << fd << " connected" )`)
+ * Statements below `FWD_PROXY_LOG_LEVEL` are discarded at compile-time and the message is only formatted when
+ * its level is enabled at runtime. Formatting happens on the calling thread, the output on the logger's thread.
+ */
+#define LOG_AT( level, msg )                                                       \
+    do {                                                                           \
+        if constexpr( static_cast<int>( level ) >= FWD_PROXY_LOG_LEVEL ) {         \
+            if( ::fwd_proxy::logger::Logger::enabled( level ) ) {                  \
+                ::fwd_proxy::logger::Logger::line( level ) << msg;                 \
+                ::fwd_proxy::logger::Logger::commit();                             \
+            }                                                                      \
+        }                                                                          \
+    } while( false )
+
+/**
+ * Logs 1 in every `n` messages from the call site (per thread)
+ */
+#define LOG_EVERY_N( level, n, msg )                                               \
+    do {                                                                           \
+        if constexpr( static_cast<int>( level ) >= FWD_PROXY_LOG_LEVEL ) {         \
+            static thread_local uint64_t log_sample_count_ = 0;                    \
+            if( ::fwd_proxy::logger::Logger::enabled( level ) &&                   \
+                ( log_sample_count_++ % ( n ) ) == 0 )                             \
+            {                                                                      \
+                ::fwd_proxy::logger::Logger::line( level )                         \
+                    << msg << " [sampled 1/" << ( n ) << "]";                      \
+                ::fwd_proxy::logger::Logger::commit();                             \
+            }                                                                      \
+        }                                                                          \
+    } while( false )
+
+/**
+ * Logs at most `n` messages per second from the call site (per thread)
+ */
+#define LOG_PER_SECOND( level, n, msg )                                            \
+    do {                                                                           \
+        if constexpr( static_cast<int>( level ) >= FWD_PROXY_LOG_LEVEL ) {         \
+            static thread_local ::fwd_proxy::logger::RateLimiter log_limiter_( n );\
+            if( ::fwd_proxy::logger::Logger::enabled( level ) &&                   \
+                log_limiter_.allow() )                                             \
+            {                                                                      \
+                auto & log_os_ = ::fwd_proxy::logger::Logger::line( level );       \
+                log_os_ << msg;                                                    \
+                if( const auto log_suppressed_ = log_limiter_.takeSuppressed() ) { \
+                    log_os_ << " [" << log_suppressed_ << " more suppressed]";     \
+                }                                                                  \
+                ::fwd_proxy::logger::Logger::commit();                             \
+            }                                                                      \
+        }                                                                          \
+    } while( false )
+
+#define LOG_TRACE( msg )   LOG_AT( ::fwd_proxy::LogLevel::TRACE, msg )
+#define LOG_DEBUG( msg )   LOG_AT( ::fwd_proxy::LogLevel::DEBUG, msg )
+#define LOG_INFO( msg )    LOG_AT( ::fwd_proxy::LogLevel::INFO, msg )
+#define LOG_WARNING( msg ) LOG_AT( ::fwd_proxy::LogLevel::WARNING, msg )
+#define LOG_ERROR( msg )   LOG_AT( ::fwd_proxy::LogLevel::ERROR, msg )
+
+namespace fwd_proxy::logger {
+    /**
+     * Per call site message budget over 1 second windows
+     */
+    class RateLimiter {
+      public:
+        explicit RateLimiter( uint32_t per_second );
+
+        bool allow();
+        uint64_t takeSuppressed();
+
+      private:
+        const uint32_t _limit;
+        uint32_t       _count;
+        int64_t        _window; //current 1s window (seconds on the steady clock)
+        uint64_t       _suppressed;
+    };
+
+    /**
+     * Asynchronous leveled logger
+     * Each thread formats its messages into its own lock-free queue which a background thread drains
+     * in batches (ordered by time) to stdout (TRACE..INFO) and stderr (WARNING..ERROR). When the
+     * background thread isn't running messages are written synchronously instead.
+     * Per-thread state is recycled by the threads started later once its owner exits (the writer draining what
+     * it left) and is otherwise never freed, so logging keeps working during static destruction.
+     */
+    class Logger {
+      public:
+        static Logger & instance();
+
+        bool start();
+        void stop();
+
+        static void setLevel( LogLevel level );
+        [[nodiscard]] static LogLevel level();
+        [[nodiscard]] static bool enabled( LogLevel level );
+
+        static std::ostream & line( LogLevel level );
+        static void commit();
+
+      private:
+        static constexpr size_t MESSAGE_MAX_LEN = 232;
+
+        struct Entry_t {
+            int64_t  timestamp; //ns since epoch
+            LogLevel level;
+            uint32_t thread_id;
+            uint32_t length;
+            char     text[MESSAGE_MAX_LEN];
+        };
+
+        class LineBuffer : public std::streambuf { //formats straight into an `Entry_t` (truncates)
+          public:
+            void reset( char * begin, size_t size );
+            [[nodiscard]] size_t length() const;
+
+          protected:
+            int_type overflow( int_type ch ) override;
+        };
+
+        struct Line_t {
+            Line_t();
+
+            Entry_t      entry;
+            LineBuffer   buffer;
+            std::ostream stream;
+        };
+
+        struct ThreadBuffer_t {
+            explicit ThreadBuffer_t( uint32_t id, size_t capacity );
+
+            const uint32_t                thread_id; //of the slot (reused along with it)
+            container::MpscQueue<Entry_t> queue;     //used single producer
+            std::atomic<uint64_t>         dropped;
+            Line_t                        line;      //message being built
+            bool                          in_use;    //owned by a running thread (guarded by `_buffers_mutex`)
+        };
+
+        struct ThreadRelease_t { //hands the calling thread's buffer back when it exits
+            ThreadBuffer_t ** buffer { nullptr };
+
+            ~ThreadRelease_t();
+        };
+
+        inline static std::atomic<int> _level { static_cast<int>( LogLevel::INFO ) };
+
+        std::atomic_bool                             _run_flag;
+        std::atomic_bool                             _async;
+        std::thread                                  _writer_th;
+        std::mutex                                   _writer_mutex;
+        std::condition_variable                      _writer_cv;
+        std::mutex                                   _buffers_mutex;
+        std::vector<std::unique_ptr<ThreadBuffer_t>> _buffers; //recycled, so as many as threads running at once
+        std::mutex                                   _sync_mutex; //synchronous writes only
+
+        Logger();
+
+        void runWriter();
+        void collect( std::vector<Entry_t> & batch );
+        ThreadBuffer_t * registerThread();
+        void releaseThread( ThreadBuffer_t * buffer );
+
+        static Line_t & threadLine();
+        static ThreadBuffer_t & threadBuffer();
+        static void write( const std::vector<Entry_t> & batch, std::string & out, std::string & err );
+        static void format( const Entry_t & entry, std::string & out );
+        static void writeAll( int fd, const std::string & str );
+    };
+}
+
+#endif //FWD_PROXY_LOGGER_LOGGER_H
@@ -1,20 +1,34 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <vector>
+#include <cstring>
 #include <csignal>
 #include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
 
 #include "enum/AppMode.h"
 #include "enum/SecurityType.h"
+#include "enum/ForwardingMode.h"
+#include "enum/ShardPolicy.h"
+#include "enum/IoBackend.h"
+#include "enum/TcpProfile.h"
+#include "enum/LogLevel.h"
 #include "client/Client.h"
 #include "proxy/Server.h"
+#include "proxy/CpuAffinity.h"
+#include "logger/Logger.h"
 
-#define DEFAULT_PORT   9595
-#define DEFAULT_ADDR   "127.0.0.1"
-#define CLIENT_TIMEOUT 10
+#define DEFAULT_PORT         9595
+#define DEFAULT_ADDR         "127.0.0.1"
+#define CLIENT_TIMEOUT       10
+#define SERVER_INPUT_POLL_MS 100 //how often the console loop checks for a hand-off
 
 void printHelp();
 void handleClientInput();
+int openStreamFile( const std::string & path, bool output );
 void handleServerInput();
 void handleSignal( int signo, siginfo_t * info, void * context );
 
@@ -34,11 +48,38 @@ int main( int argc, char **argv ) {
 
     sigaction( SIGINT, &signal_handler, NULL );
     sigaction( SIGTERM, &signal_handler, NULL );
+    signal( SIGPIPE, SIG_IGN ); //writes to a closed socket are handled as errors instead
 
     //Process CLI arguments
     const static struct option long_options[] = {
-        {"mode",   required_argument, nullptr, 'm'},
-        {"secret", required_argument, nullptr, 's'},
+        {"mode",              required_argument, nullptr, 'm'},
+        {"secret",            required_argument, nullptr, 's'},
+        {"forwarding",        required_argument, nullptr, 'f'},
+        {"workers",           required_argument, nullptr, 'w'},
+        {"sharding",          required_argument, nullptr, 'd'},
+        {"backend",           required_argument, nullptr, 'b'},
+        {"log-level",         required_argument, nullptr, 'l'},
+        {"acceptors",         required_argument, nullptr, 'a'},
+        {"handshake-timeout", required_argument, nullptr, 'H'},
+        {"pairing-timeout",   required_argument, nullptr, 'P'},
+        {"idle-timeout",      required_argument, nullptr, 'I'},
+        {"orphan-grace",      required_argument, nullptr, 'G'},
+        {"metrics-port",      required_argument, nullptr, 'M'},
+        {"input",             required_argument, nullptr, 'i'},
+        {"output",            required_argument, nullptr, 'o'},
+        {"framed",            no_argument,       nullptr, 'F'},
+        {"coalesce-us",       required_argument, nullptr, 'C'},
+        {"tcp-profile",       required_argument, nullptr, 'T'},
+        {"tcp-option",        required_argument, nullptr, 'O'},
+        {"backlog",           required_argument, nullptr, 'B'},
+        {"affinity",          required_argument, nullptr, 'A'},
+        {"handoff",           required_argument, nullptr, 'R'},
+        {"groups",            no_argument,       nullptr, 'g'},
+        {"tls-cert",          required_argument, nullptr, 'c'},
+        {"tls-key",           required_argument, nullptr, 'k'},
+        {"tls-ca",            required_argument, nullptr, 'V'},
+        {"compress",          no_argument,       nullptr, 'Z'},
+        {nullptr,             0,                 nullptr,  0 },
     };
 
     if( argc < 2 ) {
@@ -52,9 +93,17 @@ int main( int argc, char **argv ) {
     AppMode app_mode     = AppMode::UNDEFINED;
     auto    security     = SecurityType::UNSECURED;
     auto    secret       = std::string();
+    auto    options      = proxy::ServerOptions();
     int     port         = DEFAULT_PORT;
-
-    while( ( option = getopt_long( argc, argv, "m:s:", long_options, &option_index) ) != -1 ) {
+    auto    input_path   = std::string(); //streaming client
+    auto    output_path  = std::string();
+    bool    framed       = false;
+    bool    compressed   = false; //framed client: payloads compressed end to end with the counterpart
+    auto    tcp_profile  = TcpProfile::KERNEL;
+    auto    tcp_options  = std::vector<std::string>(); //overrides of the profile's settings
+    auto    tls_ca_path  = std::string(); //client: TLS with the server's certificate verified against this CA
+
+    while( ( option = getopt_long( argc, argv, "m:s:f:w:d:b:l:a:H:P:I:G:M:i:o:FC:T:O:B:A:R:gc:k:V:Z", long_options, &option_index) ) != -1 ) {
         switch( option ) {
             case 'm': {
                 auto mode = std::string( optarg );
@@ -72,6 +121,183 @@ int main( int argc, char **argv ) {
                 security = SecurityType::SECURED;
             } break;
 
+            case 'f': {
+                auto mode = std::string( optarg );
+
+                if( mode == "copy" ) {
+                    options.forwarding_mode = ForwardingMode::COPY;
+                } else if( mode == "splice" ) {
+                    options.forwarding_mode = ForwardingMode::SPLICE;
+                } else {
+                    error = true;
+                    printHelp();
+                }
+            } break;
+
+            case 'w': {
+                options.proxy_workers = std::strtoul( optarg, nullptr, 10 );
+            } break;
+
+            case 'd': {
+                auto policy = std::string( optarg );
+
+                if( policy == "least-loaded" ) {
+                    options.shard_policy = ShardPolicy::LEAST_LOADED;
+                } else if( policy == "hash" ) {
+                    options.shard_policy = ShardPolicy::HASH;
+                } else if( policy == "round-robin" ) {
+                    options.shard_policy = ShardPolicy::ROUND_ROBIN;
+                } else if( policy == "incoming-cpu" ) {
+                    options.shard_policy = ShardPolicy::INCOMING_CPU;
+                } else {
+                    error = true;
+                    printHelp();
+                }
+            } break;
+
+            case 'b': {
+                auto backend = std::string( optarg );
+
+                if( backend == "epoll" ) {
+                    options.io_backend = IoBackend::EPOLL;
+                } else if( backend == "io_uring" ) {
+                    options.io_backend = IoBackend::IO_URING;
+                } else {
+                    error = true;
+                    printHelp();
+                }
+            } break;
+
+            case 'l': {
+                auto level = std::string( optarg );
+
+                if( level == "trace" ) {
+                    logger::Logger::setLevel( LogLevel::TRACE );
+                } else if( level == "debug" ) {
+                    logger::Logger::setLevel( LogLevel::DEBUG );
+                } else if( level == "info" ) {
+                    logger::Logger::setLevel( LogLevel::INFO );
+                } else if( level == "warning" ) {
+                    logger::Logger::setLevel( LogLevel::WARNING );
+                } else if( level == "error" ) {
+                    logger::Logger::setLevel( LogLevel::ERROR );
+                } else if( level == "off" ) {
+                    logger::Logger::setLevel( LogLevel::OFF );
+                } else {
+                    error = true;
+                    printHelp();
+                }
+            } break;
+
+            case 'a': {
+                options.acceptors = std::strtoul( optarg, nullptr, 10 );
+            } break;
+
+            case 'H': {
+                options.handshake_timeout_ms = std::strtoull( optarg, nullptr, 10 ) * 1000;
+            } break;
+
+            case 'P': {
+                options.pairing_timeout_ms = std::strtoull( optarg, nullptr, 10 ) * 1000;
+            } break;
+
+            case 'I': {
+                options.idle_timeout_ms = std::strtoull( optarg, nullptr, 10 ) * 1000;
+            } break;
+
+            case 'G': {
+                options.orphan_grace_ms = std::strtoull( optarg, nullptr, 10 ) * 1000;
+            } break;
+
+            case 'M': {
+                options.metrics_port = static_cast<int>( std::strtol( optarg, nullptr, 10 ) );
+            } break;
+
+            case 'i': {
+                input_path = std::string( optarg );
+            } break;
+
+            case 'o': {
+                output_path = std::string( optarg );
+            } break;
+
+            case 'F': {
+                framed = true;
+            } break;
+
+            case 'C': {
+                options.coalesce_us = std::strtoull( optarg, nullptr, 10 );
+            } break;
+
+            case 'T': {
+                auto profile = std::string( optarg );
+
+                if( profile == "kernel" ) {
+                    tcp_profile = TcpProfile::KERNEL;
+                } else if( profile == "latency" ) {
+                    tcp_profile = TcpProfile::LATENCY;
+                } else if( profile == "bulk" ) {
+                    tcp_profile = TcpProfile::BULK;
+                } else {
+                    error = true;
+                    printHelp();
+                }
+            } break;
+
+            case 'O': {
+                tcp_options.emplace_back( optarg );
+            } break;
+
+            case 'B': {
+                options.listen_backlog = static_cast<int>( std::strtol( optarg, nullptr, 10 ) );
+            } break;
+
+            case 'A': {
+                const auto affinity  = std::string( optarg );
+                const auto separator = affinity.find( '=' );
+                const auto role      = affinity.substr( 0, separator );
+                auto       cpus      = std::vector<int>();
+
+                if( separator == std::string::npos || !proxy::CpuAffinity::parse( affinity.substr( separator + 1 ), cpus ) ) {
+                    error = true;
+                    printHelp();
+                } else if( role == "acceptors" ) {
+                    options.acceptor_cpus = std::move( cpus );
+                } else if( role == "pending" ) {
+                    options.pending_cpus = std::move( cpus );
+                } else if( role == "workers" ) {
+                    options.worker_cpus = std::move( cpus );
+                } else {
+                    error = true;
+                    printHelp();
+                }
+            } break;
+
+            case 'R': {
+                options.handoff_path = std::string( optarg );
+            } break;
+
+            case 'g': {
+                options.group_channels = true;
+            } break;
+
+            case 'c': {
+                options.tls_cert_path = std::string( optarg );
+            } break;
+
+            case 'k': {
+                options.tls_key_path = std::string( optarg );
+            } break;
+
+            case 'V': {
+                tls_ca_path = std::string( optarg );
+            } break;
+
+            case 'Z': {
+                framed     = true;
+                compressed = true;
+            } break;
+
             case '?': [[fallthrough]];
             default: {
                 error = true;
@@ -86,11 +312,56 @@ int main( int argc, char **argv ) {
         exit( EXIT_FAILURE );
     }
 
-    std::cout << "Mode  : " << app_mode << "\n"
-              << "Secret: " << secret << "\n"
-              << "Port  : " << port << std::endl;
+    options.socket_tuning = proxy::SocketTuning::profile( tcp_profile );
+
+    for( const auto & tcp_option : tcp_options ) {
+        if( !options.socket_tuning.set( tcp_option ) ) {
+            std::cerr << "Error: invalid TCP option '" << tcp_option << "'." << std::endl;
+            exit( EXIT_FAILURE );
+        }
+    }
+
+    if( !options.handoff_path.empty() && options.io_backend == IoBackend::IO_URING ) {
+        std::cerr << "Error: hot restart (-R) is only supported by the epoll backend." << std::endl;
+        exit( EXIT_FAILURE );
+    }
+
+    if( options.group_channels && options.io_backend == IoBackend::IO_URING ) {
+        std::cerr << "Error: group channels (-g) are only supported by the epoll backend." << std::endl;
+        exit( EXIT_FAILURE );
+    }
+
+    if( options.tls_cert_path.empty() != options.tls_key_path.empty() ) {
+        std::cerr << "Error: TLS needs both a certificate (-c) and its private key (-k)." << std::endl;
+        exit( EXIT_FAILURE );
+    }
+
+    if( !options.tls_cert_path.empty() && options.io_backend == IoBackend::IO_URING ) {
+        std::cerr << "Error: TLS (-c/-k) is only supported by the epoll backend." << std::endl;
+        exit( EXIT_FAILURE );
+    }
+
+    const bool streaming = !input_path.empty() || !output_path.empty();
+
+    if( streaming && framed ) {
+        std::cerr << "Error: streaming (-i/-o) uses the raw protocol and can't be framed (-F) or compressed (-Z)." << std::endl;
+        exit( EXIT_FAILURE );
+    }
+
+    ( streaming ? std::clog : std::cout ) << "Mode  : " << app_mode << ( streaming ? " (streaming)" : "" ) << "\n"
+                                          << "Secret: " << secret << "\n"
+                                          << "Port  : " << port << std::endl;
 
     //Get started...
+    logger::Logger::instance().start();
+    std::atexit( []() { logger::Logger::instance().stop(); } ); //runs before the instances are destroyed (logged synchronously)
+
+    auto tls_context = std::shared_ptr<const proxy::TlsContext>();
+
+    if( app_mode == AppMode::CLIENT && !tls_ca_path.empty() && !( tls_context = proxy::TlsContext::client( tls_ca_path ) ) ) {
+        exit( EXIT_FAILURE );
+    }
+
     switch( app_mode ) {
         case AppMode::UNDEFINED: {
             std::cerr << "Error: application mode (server/client) not defined!" << std::endl;
@@ -98,15 +369,36 @@ int main( int argc, char **argv ) {
         } break;
 
         case AppMode::CLIENT: {
+            if( streaming ) {
+                const int in_fd  = ( input_path.empty()  ? -1 : openStreamFile( input_path, false ) );
+                const int out_fd = ( output_path.empty() ? -1 : openStreamFile( output_path, true ) );
+
+                if( ( !input_path.empty() && in_fd == -1 ) || ( !output_path.empty() && out_fd == -1 ) ) {
+                    exit( EXIT_FAILURE );
+                }
+
+                client_instance = ( security == SecurityType::SECURED
+                                    ? std::make_unique<client::Client>( DEFAULT_ADDR, port, secret, CLIENT_TIMEOUT, false, false, options.socket_tuning, tls_context )
+                                    : std::make_unique<client::Client>( DEFAULT_ADDR, port, CLIENT_TIMEOUT, false, false, options.socket_tuning, tls_context ) );
+
+                const bool success = client_instance->stream( in_fd, out_fd );
+
+                if( out_fd > STDERR_FILENO ) {
+                    ::close( out_fd );
+                }
+
+                return ( success ? EXIT_SUCCESS : EXIT_FAILURE );
+            }
+
             if( security == SecurityType::SECURED ) {
-                client_instance = std::make_unique<client::Client>( DEFAULT_ADDR, port, secret, CLIENT_TIMEOUT );
+                client_instance = std::make_unique<client::Client>( DEFAULT_ADDR, port, secret, CLIENT_TIMEOUT, framed, compressed, options.socket_tuning, tls_context );
 
                 if( client_instance->connect() ) {
                     handleClientInput();
                 }
 
             } else {
-                client_instance = std::make_unique<client::Client>( DEFAULT_ADDR, port, CLIENT_TIMEOUT );
+                client_instance = std::make_unique<client::Client>( DEFAULT_ADDR, port, CLIENT_TIMEOUT, framed, compressed, options.socket_tuning, tls_context );
 
                 if( client_instance->connect() ) {
                     handleClientInput();
@@ -115,7 +407,7 @@ int main( int argc, char **argv ) {
         } break;
 
         case AppMode::PROXY: {
-            server_instance = std::make_unique<proxy::Server>( port );
+            server_instance = std::make_unique<proxy::Server>( port, options );
 
             if( server_instance->start() ) {
                 handleServerInput();
@@ -131,8 +423,41 @@ int main( int argc, char **argv ) {
  */
 void printHelp() {
     std::cout << "Usage:\n"
-              << "  -m, --mode <mode>       Set the mode (server/client)\n"
-              << "  -s, --secret <secret>   Set the secret (optional - client only)\n"
+              << "  -m, --mode <mode>           Set the mode (server/client)\n"
+              << "  -s, --secret <secret>       Set the secret (optional - client only)\n"
+              << "  -f, --forwarding <fwd>      Set the forwarding method (copy/splice, default: splice - server only)\n"
+              << "  -w, --workers <n>           Set the number of proxy workers (default: 1 per CPU - server only)\n"
+              << "  -d, --sharding <policy>     Set how pairings are assigned to proxy workers\n"
+              << "                              (least-loaded/hash/round-robin/incoming-cpu, default: least-loaded - server only)\n"
+              << "  -b, --backend <backend>     Set the I/O backend (epoll/io_uring, default: epoll - server only)\n"
+              << "  -l, --log-level <level>     Set the lowest level logged (trace/debug/info/warning/error/off, default: info)\n"
+              << "  -a, --acceptors <n>         Set the number of connection acceptors (SO_REUSEPORT, default: 1 - server only)\n"
+              << "  -H, --handshake-timeout <s> Set the time allowed to complete the handshake (0 = none, default: 10 - server only)\n"
+              << "  -P, --pairing-timeout <s>   Set the time allowed to wait for a counterpart (0 = none, default: 300 - server only)\n"
+              << "  -I, --idle-timeout <s>      Set the time a pairing can go without traffic (0 = none, default: 3600 - server only)\n"
+              << "  -G, --orphan-grace <s>      Set the time a client left by its counterpart waits for a new one\n"
+              << "                              (0 = disconnect it, default: 30 - server only)\n"
+              << "  -M, --metrics-port <port>   Serve Prometheus metrics on http://127.0.0.1:<port>/metrics (server only)\n"
+              << "  -i, --input <file>          Stream a file ('-' for stdin) to the paired client instead of chatting (client only)\n"
+              << "  -o, --output <file>         Write what the paired client streams to a file ('-' for stdout) (client only)\n"
+              << "  -F, --framed                Use the framed protocol (length-prefixed messages, control frames - client only)\n"
+              << "  -C, --coalesce-us <us>      Set how long small writes of framed pairings can be held back to be coalesced\n"
+              << "                              (0 = write as soon as read, default: 0 - server only)\n"
+              << "  -T, --tcp-profile <profile> Set the TCP settings of the client sockets (kernel/latency/bulk, default: kernel)\n"
+              << "  -O, --tcp-option <opt=val>  Override a TCP setting of the profile (repeatable): nodelay=0|1, quickack=0|1,\n"
+              << "                              rcvbuf=<bytes>, sndbuf=<bytes>, notsent-lowat=<bytes>, keepalive=<idle>[:<intvl>[:<cnt>]] (s)\n"
+              << "  -B, --backlog <n>           Set the listen backlog of each acceptor (default: 100 - server only)\n"
+              << "  -A, --affinity <role=cpus>  Pin a role's threads to a CPU list, e.g. workers=2-7 (repeatable - server only)\n"
+              << "                              acceptors/workers: 1 CPU each in turn, pending: the whole list\n"
+              << "  -R, --handoff <path>        Take over from the server running on the Unix socket <path> (if any), then accept\n"
+              << "                              the next hot restart there (epoll only - server only)\n"
+              << "  -g, --groups                Let framed clients sharing a secret join 1 channel where each message goes to\n"
+              << "                              every other member instead of pairing them (epoll only - server only)\n"
+              << "  -c, --tls-cert <pem>        Accept clients over TLS with this certificate (chain), offloaded to the kernel\n"
+              << "                              (needs -k and the 'tls' kernel module, epoll only - server only)\n"
+              << "  -k, --tls-key <pem>         Set the private key of the TLS certificate (server only)\n"
+              << "  -V, --tls-ca <pem>          Connect over TLS, verifying the server's certificate against this CA (client only)\n"
+              << "  -Z, --compress              Compress the messages with the counterpart, adaptively (implies -F - client only)\n"
               << std::endl;
 }
 
@@ -150,15 +475,39 @@ void handleClientInput() {
 }
 
 /**
- * Watch for console key input
+ * Opens a file to stream from/to
+ * @param path File path ('-' for stdin/stdout)
+ * @param output Open for writing (created/truncated)
+ * @return File descriptor (-1 on failure)
+ */
+int openStreamFile( const std::string & path, bool output ) {
+    if( path == "-" ) {
+        return ( output ? STDOUT_FILENO : STDIN_FILENO ); //EARLY RETURN
+    }
+
+    const int fd = ( output ? ::open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 )
+                            : ::open( path.c_str(), O_RDONLY | O_CLOEXEC ) );
+
+    if( fd == -1 ) {
+        std::cerr << "Error: cannot open '" << path << "': " << ::strerror( errno ) << std::endl;
+    }
+
+    return fd;
+}
+
+/**
+ * Watch for console key input (until the server hands over to a new process)
  */
 void handleServerInput() {
     std::cout << "Press 'q' to exit." << std::endl;
 
-    char key = 0;
+    struct pollfd input { STDIN_FILENO, POLLIN, 0 };
+    char          key = 0;
 
-    while( key != 'q' ) {
-        std::cin >> key;
+    while( key != 'q' && !fwd_proxy::server_instance->handedOff() ) {
+        if( ::poll( &input, 1, SERVER_INPUT_POLL_MS ) > 0 && !( std::cin >> key ) ) {
+            input.fd = -1; //stdin closed: wait for a signal or a hand-off
+        }
     }
 }
 
@@ -0,0 +1,208 @@
+#include "AdminServer.h"
+#include "../logger/Logger.h"
+
+#include <cstring>
+#include <string_view>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAX_CONNECTION_REQUESTS     16
+#define REQUEST_BUFFER_SIZE       4096
+#define REQUEST_TIMEOUT_MS        1000
+
+using namespace fwd_proxy::metrics;
+
+/**
+ * Constructor
+ * @param port Port (bound on 127.0.0.1 only)
+ * @param render Function returning the metrics in the Prometheus text format (called on the admin thread)
+ */
+AdminServer::AdminServer( int port, Render_t render ) :
+    _port( port ),
+    _render( std::move( render ) ),
+    _run_flag( false ),
+    _socket_fd( -1 ),
+    _unblock_event_fd( -1 )
+{}
+
+/**
+ * Destructor
+ */
+AdminServer::~AdminServer() {
+    stop();
+    closeFileDescriptors();
+}
+
+/**
+ * Starts listening
+ * @return Success
+ */
+bool AdminServer::start() {
+    struct sockaddr_in address {};
+    int                yes { 1 };
+
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons( static_cast<uint16_t>( _port ) );
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+    if( ( _socket_fd = ::socket( AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0 ) ) == -1 ) {
+        LOG_ERROR( "[metrics::AdminServer::start()] 'socket' error: " << ::strerror( errno ) );
+        return false; //EARLY RETURN
+    }
+
+    if( ::setsockopt( _socket_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int) ) == -1 ||
+        ::bind( _socket_fd, ( struct sockaddr * ) &address, sizeof address ) == -1 ||
+        ::listen( _socket_fd, MAX_CONNECTION_REQUESTS ) == -1 )
+    {
+        LOG_ERROR( "[metrics::AdminServer::start()] Failed to listen on 127.0.0.1:" << _port << ": " << ::strerror( errno ) );
+        closeFileDescriptors();
+        return false; //EARLY RETURN
+    }
+
+    if( ( _unblock_event_fd = ::eventfd( 0, EFD_NONBLOCK ) ) == -1 ) {
+        LOG_ERROR( "[metrics::AdminServer::start()] Failed to create 'event unblocking' file descriptor." );
+        closeFileDescriptors();
+        return false; //EARLY RETURN
+    }
+
+    LOG_INFO( "[metrics::AdminServer::start()] Serving metrics on http://127.0.0.1:" << _port << "/metrics" );
+
+    _run_flag = true;
+    _thread   = std::thread( [this]() { this->runEventLoop(); } );
+
+    return true;
+}
+
+/**
+ * Stops listening
+ */
+void AdminServer::stop() {
+    if( _run_flag ) {
+        const uint64_t one = 1;
+
+        _run_flag = false;
+
+        if( ::write( _unblock_event_fd, &one, sizeof( uint64_t ) ) != sizeof( uint64_t ) ) {
+            LOG_ERROR( "[metrics::AdminServer::stop()] error: " << ::strerror( errno ) );
+        }
+
+        _thread.join();
+    }
+}
+
+/**
+ * [PRIVATE] Accepts and serves scrape requests until stopped
+ */
+void AdminServer::runEventLoop() {
+    struct pollfd fds[2] = { { _socket_fd, POLLIN, 0 }, { _unblock_event_fd, POLLIN, 0 } };
+
+    while( _run_flag ) {
+        if( ::poll( fds, 2, -1 ) == -1 ) {
+            if( errno != EINTR ) {
+                LOG_ERROR( "[metrics::AdminServer::runEventLoop()] error: " << ::strerror( errno ) );
+            }
+
+            continue;
+        }
+
+        if( !( fds[0].revents & POLLIN ) ) {
+            continue;
+        }
+
+        const FileDescriptor_t client_fd = ::accept4( _socket_fd, nullptr, nullptr, SOCK_CLOEXEC );
+
+        if( client_fd == -1 ) {
+            LOG_ERROR( "[metrics::AdminServer::runEventLoop()] error: " << ::strerror( errno ) );
+            continue;
+        }
+
+        handleRequest( client_fd );
+        ::close( client_fd );
+    }
+
+    LOG_DEBUG( "Exiting AdminServer::runEventLoop()" );
+}
+
+/**
+ * [PRIVATE] Reads a request and sends back the metrics (or a 404 for anything but `GET /metrics`)
+ * @param client_fd Client file descriptor
+ */
+void AdminServer::handleRequest( FileDescriptor_t client_fd ) {
+    struct timeval timeout { REQUEST_TIMEOUT_MS / 1000, ( REQUEST_TIMEOUT_MS % 1000 ) * 1000 };
+    char           buffer[REQUEST_BUFFER_SIZE];
+    size_t         length = 0;
+
+    ::setsockopt( client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout );
+    ::setsockopt( client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout );
+
+    while( length < sizeof( buffer ) && std::string_view( buffer, length ).find( "\r\n\r\n" ) == std::string_view::npos ) {
+        const auto bytes = ::recv( client_fd, buffer + length, sizeof( buffer ) - length, 0 );
+
+        if( bytes <= 0 ) {
+            return; //EARLY RETURN
+        }
+
+        length += static_cast<size_t>( bytes );
+    }
+
+    const auto request = std::string_view( buffer, length );
+    std::string body;
+    std::string status;
+
+    if( request.starts_with( "GET /metrics " ) || request.starts_with( "GET /metrics?" ) ) {
+        status = "200 OK";
+        body   = _render();
+    } else {
+        status = "404 Not Found";
+        body   = "Not Found\n";
+    }
+
+    AdminServer::sendAll( client_fd, "HTTP/1.1 " + status + "\r\n"
+                                     "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                     "Content-Length: " + std::to_string( body.size() ) + "\r\n"
+                                     "Connection: close\r\n"
+                                     "\r\n" + body );
+}
+
+/**
+ * [PRIVATE] Closes any opened private file descriptor
+ */
+void AdminServer::closeFileDescriptors() {
+    if( _socket_fd != -1 ) {
+        ::close( _socket_fd );
+        _socket_fd = -1;
+    }
+
+    if( _unblock_event_fd != -1 ) {
+        ::close( _unblock_event_fd );
+        _unblock_event_fd = -1;
+    }
+}
+
+/**
+ * [PRIVATE] Sends a whole response (blocking)
+ * @param client_fd Client file descriptor
+ * @param data Bytes to send
+ * @return Success
+ */
+bool AdminServer::sendAll( FileDescriptor_t client_fd, const std::string & data ) {
+    size_t sent = 0;
+
+    while( sent < data.size() ) {
+        const auto bytes = ::send( client_fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL );
+
+        if( bytes == -1 ) {
+            LOG_ERROR( "[metrics::AdminServer::sendAll(..)] error: " << ::strerror( errno ) );
+            return false; //EARLY RETURN
+        }
+
+        sent += static_cast<size_t>( bytes );
+    }
+
+    return true;
+}
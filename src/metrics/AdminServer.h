@@ -0,0 +1,44 @@
+#ifndef FWD_PROXY_METRICS_ADMINSERVER_H
+#define FWD_PROXY_METRICS_ADMINSERVER_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+namespace fwd_proxy::metrics {
+    /**
+     * Minimal HTTP endpoint on the loopback interface serving the metrics (`GET /metrics`) for Prometheus to scrape
+     * Requests are handled one at a time on the server's own thread so that nothing is added to the proxy's hot paths.
+     */
+    class AdminServer {
+      public:
+        typedef int                           FileDescriptor_t;
+        typedef std::function<std::string()> Render_t;
+
+        AdminServer( int port, Render_t render );
+        AdminServer( const AdminServer & ) = delete;
+        ~AdminServer();
+
+        AdminServer & operator =( const AdminServer & ) = delete;
+
+        bool start();
+        void stop();
+
+      private:
+        const int        _port;
+        const Render_t   _render;
+        std::atomic_bool _run_flag;
+        FileDescriptor_t _socket_fd;
+        FileDescriptor_t _unblock_event_fd;
+        std::thread      _thread;
+
+        void runEventLoop();
+        void handleRequest( FileDescriptor_t client_fd );
+        void closeFileDescriptors();
+
+        static bool sendAll( FileDescriptor_t client_fd, const std::string & data );
+    };
+}
+
+#endif //FWD_PROXY_METRICS_ADMINSERVER_H
@@ -0,0 +1,60 @@
+#ifndef FWD_PROXY_METRICS_COUNTER_H
+#define FWD_PROXY_METRICS_COUNTER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace fwd_proxy::metrics {
+    /**
+     * Monotonic counter owned by a single thread (lock-free: plain relaxed load/store, no read-modify-write)
+     * Any thread can read it. The value seen may lag behind by the increments still in flight.
+     */
+    class Counter {
+      public:
+        /**
+         * Adds to the counter (owner thread only)
+         * @param n Increment
+         */
+        void add( uint64_t n = 1 ) {
+            _value.store( _value.load( std::memory_order_relaxed ) + n, std::memory_order_relaxed );
+        }
+
+        /**
+         * Gets the counter's value (any thread)
+         * @return Value
+         */
+        [[nodiscard]] uint64_t value() const {
+            return _value.load( std::memory_order_relaxed );
+        }
+
+      private:
+        std::atomic<uint64_t> _value { 0 };
+    };
+
+    /**
+     * Instantaneous value owned by a single thread (any thread can read it)
+     */
+    class Gauge {
+      public:
+        /**
+         * Sets the gauge (owner thread only)
+         * @param value Value
+         */
+        void set( uint64_t value ) {
+            _value.store( value, std::memory_order_relaxed );
+        }
+
+        /**
+         * Gets the gauge's value (any thread)
+         * @return Value
+         */
+        [[nodiscard]] uint64_t value() const {
+            return _value.load( std::memory_order_relaxed );
+        }
+
+      private:
+        std::atomic<uint64_t> _value { 0 };
+    };
+}
+
+#endif //FWD_PROXY_METRICS_COUNTER_H
@@ -0,0 +1,135 @@
+#include "Histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <ctime>
+
+using namespace fwd_proxy::metrics;
+
+/**
+ * Constructor
+ */
+Histogram::Histogram() :
+    _sum( 0 )
+{
+    for( auto & count : _counts ) {
+        count.store( 0, std::memory_order_relaxed );
+    }
+}
+
+/**
+ * Records a value (owner thread only)
+ * @param value Value
+ */
+void Histogram::record( uint64_t value ) {
+    auto & bucket = _counts[ Histogram::bucketIndex( value ) ];
+
+    bucket.store( bucket.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+    _sum.store( _sum.load( std::memory_order_relaxed ) + value, std::memory_order_relaxed );
+}
+
+/**
+ * Copies the histogram's current state (any thread)
+ * @return Snapshot (its count is summed from the buckets so that quantiles stay consistent)
+ */
+Histogram::Snapshot_t Histogram::snapshot() const {
+    Snapshot_t snapshot;
+
+    snapshot.counts.resize( BUCKETS );
+    snapshot.sum = _sum.load( std::memory_order_relaxed );
+
+    for( size_t i = 0; i < BUCKETS; ++i ) {
+        snapshot.counts[i]  = _counts[i].load( std::memory_order_relaxed );
+        snapshot.count     += snapshot.counts[i];
+    }
+
+    return snapshot;
+}
+
+/**
+ * Gets the bucket a value falls into
+ * @param value Value
+ * @return Bucket index
+ */
+size_t Histogram::bucketIndex( uint64_t value ) {
+    value = std::min( value, static_cast<uint64_t>( ( 1ULL << MAX_VALUE_BITS ) - 1 ) );
+
+    if( value < SUB_BUCKETS ) {
+        return value; //EARLY RETURN
+    }
+
+    const unsigned msb   = std::bit_width( value ) - 1;
+    const unsigned shift = msb - SUB_BUCKET_BITS;
+
+    return ( msb - SUB_BUCKET_BITS + 1 ) * SUB_BUCKETS + ( ( value >> shift ) & ( SUB_BUCKETS - 1 ) );
+}
+
+/**
+ * Gets the highest value falling into a bucket
+ * @param index Bucket index
+ * @return Value
+ */
+uint64_t Histogram::bucketUpperBound( size_t index ) {
+    if( index < SUB_BUCKETS ) {
+        return index; //EARLY RETURN
+    }
+
+    const auto     group = index / SUB_BUCKETS;
+    const auto     sub   = index % SUB_BUCKETS;
+    const unsigned shift = group - 1;
+    const uint64_t lower = ( 1ULL << ( shift + SUB_BUCKET_BITS ) ) | ( static_cast<uint64_t>( sub ) << shift );
+
+    return lower + ( 1ULL << shift ) - 1;
+}
+
+/**
+ * Gets the current time on the clock used for latencies
+ * @return Monotonic time in µs
+ */
+uint64_t Histogram::now() {
+    struct timespec ts {};
+
+    ::clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return static_cast<uint64_t>( ts.tv_sec ) * 1000000 + static_cast<uint64_t>( ts.tv_nsec ) / 1000;
+}
+
+/**
+ * Adds another snapshot's counts to this one (e.g. to combine per-thread histograms)
+ * @param other Snapshot
+ */
+void Histogram::Snapshot_t::merge( const Snapshot_t & other ) {
+    counts.resize( std::max( counts.size(), other.counts.size() ), 0 );
+
+    for( size_t i = 0; i < other.counts.size(); ++i ) {
+        counts[i] += other.counts[i];
+    }
+
+    count += other.count;
+    sum   += other.sum;
+}
+
+/**
+ * Estimates a quantile
+ * @param q Quantile (0..1)
+ * @return Upper bound of the bucket holding the quantile (0 when empty)
+ */
+uint64_t Histogram::Snapshot_t::quantile( double q ) const {
+    if( count == 0 ) {
+        return 0; //EARLY RETURN
+    }
+
+    const auto rank       = std::clamp( static_cast<uint64_t>( std::ceil( q * static_cast<double>( count ) ) ), static_cast<uint64_t>( 1 ), count );
+    uint64_t   cumulative = 0;
+
+    for( size_t i = 0; i < counts.size(); ++i ) {
+        cumulative += counts[i];
+
+        if( cumulative >= rank ) {
+            return Histogram::bucketUpperBound( i ); //EARLY RETURN
+        }
+    }
+
+    return Histogram::bucketUpperBound( counts.size() - 1 );
+}
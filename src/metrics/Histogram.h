@@ -0,0 +1,52 @@
+#ifndef FWD_PROXY_METRICS_HISTOGRAM_H
+#define FWD_PROXY_METRICS_HISTOGRAM_H
+
+#include <array>
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace fwd_proxy::metrics {
+    /**
+     * HDR-style log-linear histogram owned by a single thread (lock-free, any thread can take a snapshot)
+     * Values below 32 each get their own bucket. Above that, every power of 2 is split into 32 linear
+     * sub-buckets, so any value is known to within ~3% of its magnitude. Values past 2^40 are clamped.
+     */
+    class Histogram {
+      public:
+        static constexpr unsigned SUB_BUCKET_BITS = 5;
+        static constexpr unsigned MAX_VALUE_BITS  = 40;
+        static constexpr size_t   SUB_BUCKETS     = 1U << SUB_BUCKET_BITS;
+        static constexpr size_t   BUCKETS         = ( MAX_VALUE_BITS - SUB_BUCKET_BITS + 1 ) * SUB_BUCKETS;
+
+        struct Snapshot_t {
+            std::vector<uint64_t> counts; //by bucket
+            uint64_t              count { 0 };
+            uint64_t              sum   { 0 };
+
+            void merge( const Snapshot_t & other );
+
+            [[nodiscard]] uint64_t quantile( double q ) const;
+        };
+
+        Histogram();
+        Histogram( const Histogram & ) = delete;
+
+        Histogram & operator =( const Histogram & ) = delete;
+
+        void record( uint64_t value );
+
+        [[nodiscard]] Snapshot_t snapshot() const;
+
+        static size_t bucketIndex( uint64_t value );
+        static uint64_t bucketUpperBound( size_t index );
+        static uint64_t now();
+
+      private:
+        std::array<std::atomic<uint64_t>, BUCKETS> _counts;
+        std::atomic<uint64_t>                      _sum;
+    };
+}
+
+#endif //FWD_PROXY_METRICS_HISTOGRAM_H
@@ -0,0 +1,55 @@
+#ifndef FWD_PROXY_METRICS_METRICS_H
+#define FWD_PROXY_METRICS_METRICS_H
+
+#include "Counter.h"
+#include "Histogram.h"
+
+namespace fwd_proxy::metrics {
+    /**
+     * Connection thread metrics (1 set per listener)
+     */
+    struct AcceptorMetrics {
+        Counter accepted;
+        Counter dropped;   //pending thread's queue was full
+        Counter errors;
+    };
+
+    /**
+     * Pending thread metrics (handshakes and matchmaking)
+     */
+    struct PendingMetrics {
+        Counter   handshakes_ready;
+        Counter   handshakes_malformed;
+        Counter   handshakes_disconnected;
+        Counter   handshakes_timed_out;
+        Counter   handshakes_tls_failed; //TLS handshake failed or couldn't be offloaded to the kernel
+        Counter   pairing_timeouts;
+        Counter   pairs;
+        Counter   requeued;          //clients handed back after their counterpart left
+        Gauge     pending_clients;
+        Histogram handshake_to_pair; //µs
+    };
+
+    /**
+     * Proxy worker metrics (forwarding)
+     */
+    struct WorkerMetrics {
+        Counter   pairs_opened;
+        Counter   pairs_closed;
+        Counter   idle_timeouts;
+        Counter   bytes;
+        Counter   messages;          //reads (epoll) or receive completions (io_uring) that returned data
+        Counter   read_eagain;
+        Counter   write_eagain;
+        Counter   buffer_stalls;     //receives that ran out of provided buffers (io_uring)
+        Counter   coalesced_flushes; //held writes flushed once their latency budget ran out (framed pairings)
+        Counter   malformed_frames;  //framed pairings closed because a client sent a malformed frame
+        Counter   members_joined;    //clients that joined a group channel
+        Counter   slow_members;      //group members dropped for falling too far behind
+        Counter   errors;
+        Histogram forward_latency;   //µs from the wake-up with data to it being written to the counterpart
+        Histogram pair_bytes;        //bytes forwarded over the lifetime of each pairing (both ways)
+    };
+}
+
+#endif //FWD_PROXY_METRICS_METRICS_H
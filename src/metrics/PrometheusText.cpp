@@ -0,0 +1,85 @@
+#include "PrometheusText.h"
+
+#include <utility>
+
+using namespace fwd_proxy::metrics;
+
+/**
+ * Declares a metric family
+ * @param name Metric name
+ * @param type Metric type (counter/gauge/summary)
+ * @param help Description
+ * @return Builder
+ */
+PrometheusText & PrometheusText::family( std::string_view name, std::string_view type, std::string_view help ) {
+    _out << "# HELP " << name << " " << help << "\n"
+         << "# TYPE " << name << " " << type << "\n";
+
+    return *this;
+}
+
+/**
+ * Adds a counter/gauge sample
+ * @param name Metric name
+ * @param labels Labels
+ * @param value Value
+ * @return Builder
+ */
+PrometheusText & PrometheusText::sample( std::string_view name, std::string_view labels, uint64_t value ) {
+    writeName( name, labels );
+    _out << " " << value << "\n";
+
+    return *this;
+}
+
+/**
+ * Adds the samples of a summary (quantiles, sum and count) from a histogram
+ * @param name Metric name
+ * @param labels Labels
+ * @param snapshot Histogram snapshot
+ * @param scale Factor converting the recorded values to the metric's unit (e.g. 1e-6 for µs to seconds)
+ * @return Builder
+ */
+PrometheusText & PrometheusText::summary( std::string_view name, std::string_view labels, const Histogram::Snapshot_t & snapshot, double scale ) {
+    static constexpr std::pair<std::string_view, double> QUANTILES[] = { { "0.5", 0.5 }, { "0.9", 0.9 }, { "0.99", 0.99 }, { "0.999", 0.999 } };
+
+    for( const auto & [ label, quantile ] : QUANTILES ) {
+        writeName( name, labels, label );
+        _out << " " << static_cast<double>( snapshot.quantile( quantile ) ) * scale << "\n";
+    }
+
+    writeName( std::string( name ) + "_sum", labels );
+    _out << " " << static_cast<double>( snapshot.sum ) * scale << "\n";
+    writeName( std::string( name ) + "_count", labels );
+    _out << " " << snapshot.count << "\n";
+
+    return *this;
+}
+
+/**
+ * Gets the exposition text
+ * @return Text
+ */
+std::string PrometheusText::str() const {
+    return _out.str();
+}
+
+/**
+ * [PRIVATE] Writes a sample's name and labels
+ * @param name Metric name
+ * @param labels Labels
+ * @param quantile Quantile label value (summaries only)
+ */
+void PrometheusText::writeName( std::string_view name, std::string_view labels, std::string_view quantile ) {
+    _out << name;
+
+    if( !labels.empty() || !quantile.empty() ) {
+        _out << "{" << labels;
+
+        if( !quantile.empty() ) {
+            _out << ( labels.empty() ? "" : "," ) << "quantile=\"" << quantile << "\"";
+        }
+
+        _out << "}";
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef FWD_PROXY_METRICS_PROMETHEUSTEXT_H
+#define FWD_PROXY_METRICS_PROMETHEUSTEXT_H
+
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <cstdint>
+
+#include "Histogram.h"
+
+namespace fwd_proxy::metrics {
+    /**
+     * Builder for the Prometheus text exposition format (v0.0.4)
+     * Each metric family is declared once with `family(..)` followed by all of its samples.
+     * Labels are passed pre-formatted (e.g. `worker="0"`, empty for none).
+     */
+    class PrometheusText {
+      public:
+        PrometheusText & family( std::string_view name, std::string_view type, std::string_view help );
+        PrometheusText & sample( std::string_view name, std::string_view labels, uint64_t value );
+        PrometheusText & summary( std::string_view name, std::string_view labels, const Histogram::Snapshot_t & snapshot, double scale = 1 );
+
+        [[nodiscard]] std::string str() const;
+
+      private:
+        std::ostringstream _out;
+
+        void writeName( std::string_view name, std::string_view labels, std::string_view quantile = {} );
+    };
+}
+
+#endif //FWD_PROXY_METRICS_PROMETHEUSTEXT_H
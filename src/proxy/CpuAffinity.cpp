@@ -0,0 +1,173 @@
+#include "CpuAffinity.h"
+#include "../logger/Logger.h"
+
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+
+#include <sched.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#define SYSFS_NODE_PATH "/sys/devices/system/node/node"
+#define MAX_NODES       1024
+
+using namespace fwd_proxy::proxy;
+
+/**
+ * Parses a CPU list
+ * @param list CPU list (e.g. "0-3,8,10-11")
+ * @param cpus Container to append the CPUs to (in the order listed)
+ * @return Success
+ */
+bool CpuAffinity::parse( const std::string & list, std::vector<int> & cpus ) {
+    const char * it = list.c_str();
+
+    while( *it != '\0' ) {
+        char     * end   = nullptr;
+        const auto first = std::strtol( it, &end, 10 );
+        auto       last  = first;
+
+        if( end == it || first < 0 || first >= CPU_SETSIZE ) {
+            return false; //EARLY RETURN
+        }
+
+        if( *end == '-' ) {
+            it   = end + 1;
+            last = std::strtol( it, &end, 10 );
+
+            if( end == it || last < first || last >= CPU_SETSIZE ) {
+                return false; //EARLY RETURN
+            }
+        }
+
+        for( auto cpu = first; cpu <= last; ++cpu ) {
+            cpus.emplace_back( static_cast<int>( cpu ) );
+        }
+
+        if( *end == ',' ) {
+            ++end;
+        } else if( *end != '\0' ) {
+            return false; //EARLY RETURN
+        }
+
+        it = end;
+    }
+
+    return !cpus.empty();
+}
+
+/**
+ * Pins the calling thread to a set of CPUs
+ * @param cpus CPUs (empty = left alone)
+ * @return Success
+ */
+bool CpuAffinity::pin( const std::vector<int> & cpus ) {
+    if( cpus.empty() ) {
+        return true; //EARLY RETURN
+    }
+
+    cpu_set_t set;
+
+    CPU_ZERO( &set );
+
+    for( const auto cpu : cpus ) {
+        CPU_SET( cpu, &set );
+    }
+
+    if( const auto err = ::pthread_setaffinity_np( ::pthread_self(), sizeof( set ), &set ); err != 0 ) {
+        LOG_ERROR( "[proxy::CpuAffinity::pin(..)] Failed to pin thread: " << ::strerror( err ) );
+        return false; //EARLY RETURN
+    }
+
+    return true;
+}
+
+/**
+ * Pins the calling thread to a CPU
+ * @param cpu CPU (-1 = left alone)
+ * @return Success
+ */
+bool CpuAffinity::pin( int cpu ) {
+    return ( cpu < 0 ) || CpuAffinity::pin( std::vector<int>( 1, cpu ) );
+}
+
+/**
+ * Gets the CPUs the process is allowed to run on
+ * @return CPUs (ascending)
+ */
+std::vector<int> CpuAffinity::allowed() {
+    std::vector<int> cpus;
+    cpu_set_t        set;
+
+    CPU_ZERO( &set );
+
+    if( ::sched_getaffinity( 0, sizeof( set ), &set ) == 0 ) {
+        for( int cpu = 0; cpu < CPU_SETSIZE; ++cpu ) {
+            if( CPU_ISSET( cpu, &set ) ) {
+                cpus.emplace_back( cpu );
+            }
+        }
+    }
+
+    return cpus;
+}
+
+/**
+ * Gets the NUMA node of a CPU
+ * @param cpu CPU
+ * @return Node (0 when unknown)
+ */
+int CpuAffinity::node( int cpu ) {
+    static const auto topology = CpuAffinity::readTopology(); //node by CPU
+
+    return ( cpu >= 0 && static_cast<size_t>( cpu ) < topology.size() ) ? topology[ static_cast<size_t>( cpu ) ] : 0;
+}
+
+/**
+ * Gets the CPU that last processed a socket's incoming packets (`SO_INCOMING_CPU`)
+ * @param socket_fd Socket file descriptor
+ * @return CPU (-1 when unknown)
+ */
+int CpuAffinity::incomingCpu( int socket_fd ) {
+    int       cpu    = -1;
+    socklen_t length = sizeof( cpu );
+
+    if( ::getsockopt( socket_fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &length ) == -1 ) {
+        return -1; //EARLY RETURN
+    }
+
+    return cpu;
+}
+
+/**
+ * [PRIVATE] Reads which NUMA node each CPU belongs to from sysfs
+ * @return Node by CPU
+ */
+std::vector<int> CpuAffinity::readTopology() {
+    std::vector<int> topology;
+    int              missing = 0; //node numbers can have gaps
+
+    for( int node = 0; node < MAX_NODES && missing < 8; ++node ) {
+        auto file = std::ifstream( SYSFS_NODE_PATH + std::to_string( node ) + "/cpulist" );
+        auto list = std::string();
+        auto cpus = std::vector<int>();
+
+        if( !file || !std::getline( file, list ) || !CpuAffinity::parse( list, cpus ) ) {
+            ++missing;
+            continue;
+        }
+
+        missing = 0;
+
+        for( const auto cpu : cpus ) {
+            if( static_cast<size_t>( cpu ) >= topology.size() ) {
+                topology.resize( static_cast<size_t>( cpu ) + 1, 0 );
+            }
+
+            topology[ static_cast<size_t>( cpu ) ] = node;
+        }
+    }
+
+    return topology;
+}
@@ -0,0 +1,26 @@
+#ifndef FWD_PROXY_PROXY_CPUAFFINITY_H
+#define FWD_PROXY_PROXY_CPUAFFINITY_H
+
+#include <string>
+#include <vector>
+
+namespace fwd_proxy::proxy {
+    /**
+     * Thread placement helpers: CPU lists, pinning and the NUMA node of each CPU
+     * (the topology is read from sysfs, so single-node hosts and containers without it see 1 node)
+     */
+    class CpuAffinity {
+      public:
+        static bool parse( const std::string & list, std::vector<int> & cpus );
+        static bool pin( const std::vector<int> & cpus );
+        static bool pin( int cpu );
+        static std::vector<int> allowed();
+        static int node( int cpu );
+        static int incomingCpu( int socket_fd );
+
+      private:
+        static std::vector<int> readTopology();
+    };
+}
+
+#endif //FWD_PROXY_PROXY_CPUAFFINITY_H
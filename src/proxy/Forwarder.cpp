@@ -0,0 +1,298 @@
+#include "Forwarder.h"
+#include "../logger/Logger.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define BUFFER_SIZE_MIN            512 //pipe/buffer size bounds (adapted to the direction's throughput)
+#define BUFFER_SIZE_MAX         262144
+#define BUFFER_SHRINK_EVENTS        16 //consecutive under-used read events before shrinking
+
+using namespace fwd_proxy::proxy;
+
+/**
+ * Constructor (unused direction, i.e. when the I/O backend brings its own buffers)
+ */
+Forwarder::Forwarder() :
+    _size( 0 ),
+    _quiet_events( 0 ),
+    _framed( false )
+{}
+
+/**
+ * Constructor
+ * @param mode Forwarding mode (falls back to copying when the pipe cannot be created)
+ * @param framed Flag to track the frames sent by the source (forces copying)
+ */
+Forwarder::Forwarder( ForwardingMode mode, bool framed ) :
+    _buffer( BUFFER_SIZE_MIN ),
+    _size( BUFFER_SIZE_MIN ),
+    _quiet_events( 0 ),
+    _framed( framed )
+{
+    if( mode == ForwardingMode::SPLICE && !framed ) {
+        _pipe = SplicePipe( BUFFER_SIZE_MIN );
+
+        if( !_pipe.valid() ) {
+            LOG_WARNING( "[proxy::Forwarder::Forwarder(..)] error: " << ::strerror( errno ) << " (falling back to copy)" );
+        }
+    }
+}
+
+/**
+ * Moves bytes from the source to the destination until the source is drained, the destination pushes back
+ * or the budget is spent (the pipe/buffer size is then adapted to how much was read)
+ * @param src_fd Source file descriptor
+ * @param dst_fd Destination file descriptor
+ * @param budget Max bytes read before yielding
+ * @param hold Bytes to accumulate before writing to the destination (0 to write as soon as read)
+ * @return Result
+ */
+Forwarder::Result_t Forwarder::forward( FileDescriptor_t src_fd, FileDescriptor_t dst_fd, size_t budget, size_t hold ) {
+    Result_t result;
+
+    do {
+        result.last_read  = fill( src_fd );
+        result.read_errno = ( result.last_read < 0 ? errno : 0 );
+
+        if( result.last_read > 0 ) {
+            result.bytes += static_cast<size_t>( result.last_read );
+            result.reads += 1;
+        }
+
+        if( _frames.malformed() ) {
+            result.malformed = true;
+            break;
+        }
+
+        if( pending() < hold && !saturated() ) {
+            continue; //coalesced with what comes next (or flushed by the caller)
+        }
+
+        if( flush( dst_fd ) == -1 ) {
+            if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+                ++result.write_eagain;
+            } else {
+                result.write_errno = errno;
+            }
+        }
+    } while( result.last_read > 0 && result.write_errno == 0 && result.bytes < budget );
+
+    adapt( result.bytes );
+
+    return result;
+}
+
+/**
+ * Reads the bytes available from the source into the pipe/buffer (single read)
+ * @param src_fd Source file descriptor
+ * @return Number of bytes read (0 on disconnect, -1 on error with `errno` set - EAGAIN when saturated)
+ */
+ssize_t Forwarder::fill( FileDescriptor_t src_fd ) {
+    ssize_t in_bytes = -1;
+
+    if( saturated() ) {
+        errno = EAGAIN;
+        return -1; //EARLY RETURN
+    }
+
+    if( _pipe.valid() ) {
+        in_bytes = _pipe.fill( src_fd );
+
+        if( in_bytes == -1 && errno == EINVAL && _pipe.buffered() == 0 ) { //splicing not supported for this source
+            LOG_WARNING( "[proxy::Forwarder::fill(..)] "
+                         << "Cannot splice from " << src_fd << ", falling back to copy." );
+
+            _pipe.close();
+        }
+    }
+
+    if( !_pipe.valid() ) {
+        const auto offset = _buffer.size();
+
+        in_bytes = _buffer.readFrom( src_fd );
+
+        for( size_t tracked = 0; _framed && in_bytes > 0 && tracked < static_cast<size_t>( in_bytes ); ) {
+            const char * data   = nullptr;
+            const auto   length = std::min( _buffer.span( offset + tracked, &data ), static_cast<size_t>( in_bytes ) - tracked );
+
+            track( data, length );
+            tracked += length;
+        }
+    }
+
+    return in_bytes;
+}
+
+/**
+ * Writes as much as possible of the pipe/buffer to the destination
+ * @param dst_fd Destination file descriptor
+ * @return Number of bytes written (0 when nothing is pending, -1 on error with `errno` set)
+ */
+ssize_t Forwarder::flush( FileDescriptor_t dst_fd ) {
+    if( pending() == 0 ) {
+        return 0; //EARLY RETURN
+    }
+
+    return ( _pipe.valid() ? _pipe.drain( dst_fd ) : _buffer.writeTo( dst_fd ) );
+}
+
+/**
+ * Grows/shrinks the pipe/buffer based on how much was read in one event
+ * (doubles when the read filled the current size, halves after a run of events that used less than a quarter of it)
+ * @param in_bytes Bytes read from the source during the event
+ */
+void Forwarder::adapt( size_t in_bytes ) {
+    size_t size = _size;
+
+    if( in_bytes >= _size ) {
+        size          = std::min( _size * 2, static_cast<size_t>( BUFFER_SIZE_MAX ) );
+        _quiet_events = 0;
+
+    } else if( in_bytes < _size / 4 ) {
+        if( ++_quiet_events >= BUFFER_SHRINK_EVENTS ) {
+            size          = std::max( _size / 2, static_cast<size_t>( BUFFER_SIZE_MIN ) );
+            _quiet_events = 0;
+        }
+
+    } else {
+        _quiet_events = 0;
+    }
+
+    if( size != _size && ( _pipe.valid() ? _pipe.resize( size ) : _buffer.resize( size ) ) ) {
+        _size = size; //else: try again on a later event (i.e.: too much still buffered to shrink)
+    }
+}
+
+/**
+ * Moves the frame tracking over bytes read from the source by other means (i.e. the I/O backend's own buffers)
+ * @param data Bytes read
+ * @param length Number of bytes
+ * @return Well-formed state (false once the source sent a malformed frame)
+ */
+bool Forwarder::track( const char * data, size_t length ) {
+    return !_framed || _frames.consume( data, length );
+}
+
+/**
+ * Drops whatever is waiting to be written to the destination (i.e. the source sent a malformed frame)
+ */
+void Forwarder::discard() {
+    if( _pipe.valid() ) {
+        _pipe.close(); //bytes in flight go with it
+    }
+
+    _buffer.clear();
+}
+
+/**
+ * Takes whatever is waiting to be written to the destination out of the pipe/buffer (i.e. to hand it over)
+ * @return Bytes
+ */
+std::string Forwarder::extract() {
+    auto bytes = std::string( pending(), '\0' );
+    auto count = static_cast<size_t>( 0 );
+
+    while( count < bytes.size() ) {
+        const auto chunk = ( _pipe.valid() ? _pipe.read( bytes.data() + count, bytes.size() - count )
+                                           : static_cast<ssize_t>( _buffer.read( bytes.data() + count, bytes.size() - count ) ) );
+
+        if( chunk <= 0 ) {
+            LOG_ERROR( "[proxy::Forwarder::extract()] error: " << ( chunk < 0 ? ::strerror( errno ) : "pipe drained early" ) );
+            break;
+        }
+
+        count += static_cast<size_t>( chunk );
+    }
+
+    bytes.resize( count );
+
+    return bytes;
+}
+
+/**
+ * Fills the (empty) pipe/buffer with bytes to write to the destination and picks up the frame tracking where
+ * it was left (i.e. bytes handed over from another process)
+ * @param bytes Bytes read from the source but not written yet
+ * @param frames Position in the frames read from the source (framed only)
+ * @return Success (false when the bytes don't fit)
+ */
+bool Forwarder::preload( std::string_view bytes, const FrameCursor & frames ) {
+    const auto size = std::max( _size, bytes.size() );
+
+    _frames = frames;
+
+    if( bytes.empty() ) {
+        return true; //EARLY RETURN
+    }
+
+    if( _pipe.valid() && ( !_pipe.resize( size ) || _pipe.write( bytes.data(), bytes.size() ) != static_cast<ssize_t>( bytes.size() ) ) ) {
+        LOG_WARNING( "[proxy::Forwarder::preload(..)] Cannot fill the pipe, falling back to copy." );
+        _pipe.close();
+    }
+
+    if( !_pipe.valid() && ( !_buffer.resize( size ) || _buffer.write( bytes.data(), bytes.size() ) != bytes.size() ) ) {
+        return false; //EARLY RETURN
+    }
+
+    _size = size;
+
+    return true;
+}
+
+/**
+ * Gets the number of bytes waiting to be written to the destination
+ * @return Byte count
+ */
+size_t Forwarder::pending() const {
+    return ( _pipe.valid() ? _pipe.buffered() : _buffer.size() );
+}
+
+/**
+ * Checks if there is no more room to read into
+ * @return Saturated state
+ */
+bool Forwarder::saturated() const {
+    return ( _pipe.valid() ? _pipe.buffered() >= _pipe.capacity() : _buffer.full() );
+}
+
+/**
+ * Gets the current pipe/buffer size
+ * @return Size in bytes
+ */
+size_t Forwarder::size() const {
+    return _size;
+}
+
+/**
+ * Checks if bytes are moved through a kernel pipe
+ * @return Splicing state
+ */
+bool Forwarder::splicing() const {
+    return _pipe.valid();
+}
+
+/**
+ * Checks if the source's frames are tracked
+ * @return Framed state
+ */
+bool Forwarder::framed() const {
+    return _framed;
+}
+
+/**
+ * Checks if the bytes read from the source so far end on a frame boundary
+ * (i.e. the destination can be handed a control frame once they are written)
+ * @return Boundary state (always true when not framed)
+ */
+bool Forwarder::atFrameBoundary() const {
+    return !_framed || _frames.boundary();
+}
+
+/**
+ * Gets the position in the frames read from the source
+ * @return Frame cursor (at the start when not framed)
+ */
+const FrameCursor & Forwarder::frames() const {
+    return _frames;
+}
@@ -0,0 +1,70 @@
+#ifndef FWD_PROXY_PROXY_FORWARDER_H
+#define FWD_PROXY_PROXY_FORWARDER_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <sys/types.h>
+
+#include "../enum/ForwardingMode.h"
+#include "../container/RingBuffer.h"
+#include "SplicePipe.h"
+#include "FrameCursor.h"
+
+namespace fwd_proxy::proxy {
+    /**
+     * One direction of a pairing (`src -> dst`): bytes read from the source wait in a kernel pipe when splicing
+     * (or a user space ring buffer when copying) until the destination takes them. The pipe/buffer size follows
+     * the direction's throughput between `BUFFER_SIZE_MIN` and `BUFFER_SIZE_MAX`. Framed directions always copy so
+     * that the frames can be tracked as they are read, and can hold small writes back to coalesce them.
+     */
+    class Forwarder {
+      public:
+        typedef int FileDescriptor_t;
+
+        struct Result_t {
+            size_t  bytes        { 0 }; //read from the source
+            size_t  reads        { 0 }; //reads that returned bytes
+            ssize_t last_read    { 0 }; //result of the last read (0 when the source disconnected, -1 with `read_errno` set)
+            int     read_errno   { 0 };
+            int     write_errno  { 0 }; //set when writing to the destination failed (other than EAGAIN)
+            size_t  write_eagain { 0 };
+            bool    malformed    { false }; //the source sent a malformed frame (nothing was written past it)
+        };
+
+        Forwarder();
+        explicit Forwarder( ForwardingMode mode, bool framed = false );
+        Forwarder( const Forwarder & ) = delete;
+        Forwarder( Forwarder && forwarder ) noexcept = default;
+
+        Forwarder & operator =( const Forwarder & ) = delete;
+        Forwarder & operator =( Forwarder && forwarder ) noexcept = default;
+
+        Result_t forward( FileDescriptor_t src_fd, FileDescriptor_t dst_fd, size_t budget, size_t hold = 0 );
+        ssize_t fill( FileDescriptor_t src_fd );
+        ssize_t flush( FileDescriptor_t dst_fd );
+        void adapt( size_t in_bytes );
+        bool track( const char * data, size_t length );
+        void discard();
+        std::string extract();
+        bool preload( std::string_view bytes, const FrameCursor & frames );
+
+        [[nodiscard]] size_t pending() const;
+        [[nodiscard]] bool saturated() const;
+        [[nodiscard]] size_t size() const;
+        [[nodiscard]] bool splicing() const;
+        [[nodiscard]] bool framed() const;
+        [[nodiscard]] bool atFrameBoundary() const;
+        [[nodiscard]] const FrameCursor & frames() const;
+
+      private:
+        SplicePipe            _pipe;         //invalid when copying
+        container::RingBuffer _buffer;       //used when copying
+        size_t                _size;         //current pipe/buffer size
+        unsigned              _quiet_events; //consecutive read events that used only a fraction of `_size`
+        bool                  _framed;
+        FrameCursor           _frames;       //position in the frames read from the source (framed only)
+    };
+}
+
+#endif //FWD_PROXY_PROXY_FORWARDER_H
@@ -0,0 +1,177 @@
+#include "FrameCursor.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace fwd_proxy::proxy;
+
+/**
+ * Constructor
+ */
+FrameCursor::FrameCursor() :
+    _header(),
+    _header_length( 0 ),
+    _malformed( false ),
+    _payload_left( 0 ),
+    _frames( 0 )
+{}
+
+/**
+ * Moves the cursor over bytes of the stream
+ * @param data Bytes (following the ones already consumed)
+ * @param length Number of bytes
+ * @return Well-formed state (false once a header with a type other than `DATA` or an oversized length was seen)
+ */
+bool FrameCursor::consume( const char * data, size_t length ) {
+    size_t i = 0;
+
+    while( i < length && !_malformed ) {
+        if( _header_length < HEADER_SIZE ) {
+            const auto chunk = std::min( HEADER_SIZE - _header_length, length - i );
+
+            std::memcpy( &_header[ _header_length ], data + i, chunk );
+            _header_length += chunk;
+            i              += chunk;
+
+            if( _header_length == HEADER_SIZE ) {
+                FrameType type = FrameType::DATA;
+
+                if( !FrameCursor::decodeHeader( _header, type, _payload_left ) || type != FrameType::DATA ) {
+                    _malformed = true;
+                    break;
+                }
+            }
+
+        } else {
+            const auto chunk = std::min( static_cast<size_t>( _payload_left ), length - i );
+
+            _payload_left -= chunk;
+            i             += chunk;
+        }
+
+        if( _header_length == HEADER_SIZE && _payload_left == 0 ) {
+            _header_length = 0;
+            ++_frames;
+        }
+    }
+
+    return !_malformed;
+}
+
+/**
+ * Saves the position in the current frame (i.e. to carry on in another process)
+ * @param state Destination (`STATE_SIZE` bytes: `[header length:1][header:5][payload left:4 BE]`)
+ */
+void FrameCursor::save( char * state ) const {
+    state[0] = static_cast<char>( _header_length );
+    std::memcpy( state + 1, _header, HEADER_SIZE );
+    state[6] = static_cast<char>( ( _payload_left >> 24 ) & 0xFF );
+    state[7] = static_cast<char>( ( _payload_left >> 16 ) & 0xFF );
+    state[8] = static_cast<char>( ( _payload_left >>  8 ) & 0xFF );
+    state[9] = static_cast<char>( _payload_left & 0xFF );
+}
+
+/**
+ * Restores a position saved by `save(..)` (the frame count starts over)
+ * @param state Source (`STATE_SIZE` bytes)
+ * @return Success (false when the state is inconsistent)
+ */
+bool FrameCursor::restore( const char * state ) {
+    const auto     header_length = static_cast<uint8_t>( state[0] );
+    const uint32_t payload_left  = ( static_cast<uint32_t>( static_cast<uint8_t>( state[6] ) ) << 24 )
+                                 | ( static_cast<uint32_t>( static_cast<uint8_t>( state[7] ) ) << 16 )
+                                 | ( static_cast<uint32_t>( static_cast<uint8_t>( state[8] ) ) <<  8 )
+                                 |   static_cast<uint32_t>( static_cast<uint8_t>( state[9] ) );
+    FrameType      type          = FrameType::DATA;
+    uint32_t       length        = 0;
+
+    if( header_length > HEADER_SIZE ||
+        ( header_length == HEADER_SIZE && ( !FrameCursor::decodeHeader( state + 1, type, length ) || type != FrameType::DATA || payload_left == 0 || payload_left > length ) ) ||
+        ( header_length < HEADER_SIZE && payload_left != 0 ) )
+    {
+        return false; //EARLY RETURN
+    }
+
+    std::memcpy( _header, state + 1, HEADER_SIZE );
+    _header_length = header_length;
+    _payload_left  = payload_left;
+    _malformed     = false;
+    _frames        = 0;
+
+    return true;
+}
+
+/**
+ * Checks if the bytes consumed so far end on a frame boundary
+ * @return Boundary state
+ */
+bool FrameCursor::boundary() const {
+    return _header_length == 0 && !_malformed;
+}
+
+/**
+ * Checks if the stream was found malformed
+ * @return Malformed state
+ */
+bool FrameCursor::malformed() const {
+    return _malformed;
+}
+
+/**
+ * Gets the number of complete frames consumed so far
+ * @return Frame count
+ */
+uint64_t FrameCursor::frames() const {
+    return _frames;
+}
+
+/**
+ * Encodes a frame
+ * @param type Frame type
+ * @param payload Payload (up to `PAYLOAD_MAX` bytes)
+ * @return Frame bytes
+ */
+std::string FrameCursor::encode( FrameType type, std::string_view payload ) {
+    std::string frame( HEADER_SIZE + payload.size(), '\0' );
+
+    FrameCursor::encodeHeader( type, static_cast<uint32_t>( payload.size() ), frame.data() );
+    std::memcpy( frame.data() + HEADER_SIZE, payload.data(), payload.size() );
+
+    return frame;
+}
+
+/**
+ * Encodes a frame header
+ * @param type Frame type
+ * @param length Payload length
+ * @param header Destination (`HEADER_SIZE` bytes)
+ */
+void FrameCursor::encodeHeader( FrameType type, uint32_t length, char * header ) {
+    header[0] = static_cast<char>( type );
+    header[1] = static_cast<char>( ( length >> 24 ) & 0xFF );
+    header[2] = static_cast<char>( ( length >> 16 ) & 0xFF );
+    header[3] = static_cast<char>( ( length >>  8 ) & 0xFF );
+    header[4] = static_cast<char>( length & 0xFF );
+}
+
+/**
+ * Decodes a frame header
+ * @param header Source (`HEADER_SIZE` bytes)
+ * @param type Frame type (set on success)
+ * @param length Payload length (set on success)
+ * @return Success (false for an unknown type or a length over `PAYLOAD_MAX`)
+ */
+bool FrameCursor::decodeHeader( const char * header, FrameType & type, uint32_t & length ) {
+    const auto * bytes = reinterpret_cast<const uint8_t *>( header );
+    const auto   value = ( static_cast<uint32_t>( bytes[1] ) << 24 ) | ( static_cast<uint32_t>( bytes[2] ) << 16 )
+                       | ( static_cast<uint32_t>( bytes[3] ) <<  8 ) |   static_cast<uint32_t>( bytes[4] );
+
+    if( bytes[0] > static_cast<uint8_t>( FrameType::DISCONNECTED ) || value > PAYLOAD_MAX ) {
+        return false; //EARLY RETURN
+    }
+
+    type   = static_cast<FrameType>( bytes[0] );
+    length = value;
+
+    return true;
+}
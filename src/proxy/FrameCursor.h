@@ -0,0 +1,47 @@
+#ifndef FWD_PROXY_PROXY_FRAMECURSOR_H
+#define FWD_PROXY_PROXY_FRAMECURSOR_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+#include "../enum/FrameType.h"
+
+namespace fwd_proxy::proxy {
+    /**
+     * Tracks the frame boundaries in a byte stream sent by a framed client (`[type:1][length:4 BE][payload]`)
+     * Bytes can be fed as they pass in any split without being copied (only a partial header is kept between
+     * calls) so that the stream can be checked as it is forwarded and cut on a frame boundary. Clients may only
+     * send `DATA` frames: control frames are sent by the proxy.
+     */
+    class FrameCursor {
+      public:
+        static constexpr size_t   HEADER_SIZE = 5;
+        static constexpr uint32_t PAYLOAD_MAX = 16777216;
+        static constexpr size_t   STATE_SIZE  = HEADER_SIZE + 5; //see `save(..)`
+
+        FrameCursor();
+
+        bool consume( const char * data, size_t length );
+        void save( char * state ) const;
+        bool restore( const char * state );
+
+        [[nodiscard]] bool boundary() const;
+        [[nodiscard]] bool malformed() const;
+        [[nodiscard]] uint64_t frames() const;
+
+        static std::string encode( FrameType type, std::string_view payload = {} );
+        static void encodeHeader( FrameType type, uint32_t length, char * header );
+        static bool decodeHeader( const char * header, FrameType & type, uint32_t & length );
+
+      private:
+        char     _header[HEADER_SIZE]; //header of the frame in progress
+        uint8_t  _header_length;       //bytes of `_header` received (`HEADER_SIZE` once into the payload)
+        bool     _malformed;
+        uint32_t _payload_left;
+        uint64_t _frames;              //complete frames seen
+    };
+}
+
+#endif //FWD_PROXY_PROXY_FRAMECURSOR_H
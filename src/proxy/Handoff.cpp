@@ -0,0 +1,425 @@
+#include "Handoff.h"
+#include "../logger/Logger.h"
+
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define HANDOFF_MAGIC        "FWDP"
+#define HANDOFF_MAGIC_LEN    4
+#define HANDOFF_VERSION      1
+#define HANDOFF_CHUNK_SIZE   65536 //pending bytes per `BYTES` record (well under the socket buffer)
+#define HANDOFF_FDS_MAX      2     //file descriptors per record
+#define PAIRING_FRAMED       0x01  //protocol flags of a `PAIRING` record (first byte)
+#define PAIRING_COMPRESSED   0x02
+
+using namespace fwd_proxy::proxy;
+
+/**
+ * Constructor
+ * @param channel_fd Connected channel socket (owned: closed with the instance)
+ */
+Handoff::Handoff( FileDescriptor_t channel_fd ) :
+    _channel_fd( channel_fd ),
+    _greeted( false )
+{}
+
+/**
+ * Destructor
+ */
+Handoff::~Handoff() {
+    if( _channel_fd != -1 ) {
+        ::close( _channel_fd );
+    }
+}
+
+/**
+ * Sends a listening socket
+ * @param listener_fd Listening socket file descriptor
+ * @return Success
+ */
+bool Handoff::sendListener( FileDescriptor_t listener_fd ) {
+    return sendRecord( Record::LISTENER, {}, &listener_fd, 1 );
+}
+
+/**
+ * Sends a pending client
+ * @param client Pending client
+ * @return Success
+ */
+bool Handoff::sendPending( const Pending_t & client ) {
+    auto body = std::string( 1, static_cast<char>( client.handshake.size() ) ) + client.handshake;
+
+    body.resize( body.size() + FrameCursor::STATE_SIZE );
+    client.frames.save( body.data() + body.size() - FrameCursor::STATE_SIZE );
+
+    return sendRecord( Record::PENDING, body, &client.fd, 1 );
+}
+
+/**
+ * Sends a pairing followed by its pending bytes
+ * @param pairing Client pairing
+ * @return Success
+ */
+bool Handoff::sendPairing( const Pairing_t & pairing ) {
+    auto body = std::string();
+
+    body.push_back( static_cast<char>( ( pairing.framed ? PAIRING_FRAMED : 0 ) | ( pairing.compressed ? PAIRING_COMPRESSED : 0 ) ) );
+    body.push_back( static_cast<char>( pairing.secret.size() ) );
+    body.append( pairing.secret );
+
+    for( const auto & frames : pairing.frames ) {
+        body.resize( body.size() + FrameCursor::STATE_SIZE );
+        frames.save( body.data() + body.size() - FrameCursor::STATE_SIZE );
+    }
+
+    for( const auto & pending : pairing.pending ) {
+        const auto length = static_cast<uint32_t>( pending.size() );
+
+        body.push_back( static_cast<char>( ( length >> 24 ) & 0xFF ) );
+        body.push_back( static_cast<char>( ( length >> 16 ) & 0xFF ) );
+        body.push_back( static_cast<char>( ( length >>  8 ) & 0xFF ) );
+        body.push_back( static_cast<char>( length & 0xFF ) );
+    }
+
+    if( !sendRecord( Record::PAIRING, body, pairing.fds, 2 ) ) {
+        return false; //EARLY RETURN
+    }
+
+    for( const auto & pending : pairing.pending ) {
+        for( size_t offset = 0; offset < pending.size(); offset += HANDOFF_CHUNK_SIZE ) {
+            if( !sendRecord( Record::BYTES, pending.substr( offset, HANDOFF_CHUNK_SIZE ) ) ) {
+                return false; //EARLY RETURN
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Tells the successor that everything was sent
+ * @return Success
+ */
+bool Handoff::finish() {
+    return sendRecord( Record::END, {} );
+}
+
+/**
+ * Receives everything a server hands over (blocking)
+ * @param snapshot Container for what was received (complete records only, even on failure)
+ * @return Success (false when the channel broke or the records didn't make sense)
+ */
+bool Handoff::receive( Snapshot_t & snapshot ) {
+    auto type = Record::HELLO;
+    auto body = std::string();
+    auto fds  = std::vector<FileDescriptor_t>();
+
+    if( !receiveRecord( type, body, fds ) || type != Record::HELLO ||
+        body != std::string( HANDOFF_MAGIC ) + static_cast<char>( HANDOFF_VERSION ) )
+    {
+        LOG_ERROR( "[proxy::Handoff::receive(..)] Unexpected greeting from the running server." );
+        return false; //EARLY RETURN
+    }
+
+    while( receiveRecord( type, body, fds ) ) {
+        switch( type ) {
+            case Record::LISTENER: {
+                if( fds.size() != 1 ) {
+                    break;
+                }
+
+                snapshot.listeners.emplace_back( fds[0] );
+                fds.clear();
+            } continue;
+
+            case Record::PENDING: {
+                auto       client           = Pending_t();
+                const auto handshake_length = body.empty() ? 0 : static_cast<size_t>( static_cast<uint8_t>( body[0] ) );
+
+                if( fds.size() != 1 || body.size() != 1 + handshake_length + FrameCursor::STATE_SIZE ||
+                    !client.frames.restore( body.data() + 1 + handshake_length ) )
+                {
+                    break;
+                }
+
+                client.fd        = fds[0];
+                client.handshake = body.substr( 1, handshake_length );
+                snapshot.pending.emplace_back( std::move( client ) );
+                fds.clear();
+            } continue;
+
+            case Record::PAIRING: {
+                auto       pairing       = Pairing_t();
+                const auto secret_length = body.size() < 2 ? 0 : static_cast<size_t>( static_cast<uint8_t>( body[1] ) );
+                const auto frames_offset = 2 + secret_length;
+                const auto length_offset = frames_offset + 2 * FrameCursor::STATE_SIZE;
+                uint32_t   lengths[2]    = { 0, 0 };
+
+                if( fds.size() != 2 || body.size() != length_offset + 2 * sizeof( uint32_t ) ||
+                    !pairing.frames[0].restore( body.data() + frames_offset ) ||
+                    !pairing.frames[1].restore( body.data() + frames_offset + FrameCursor::STATE_SIZE ) )
+                {
+                    break;
+                }
+
+                for( size_t i = 0; i < 2; ++i ) {
+                    for( size_t b = 0; b < sizeof( uint32_t ); ++b ) {
+                        lengths[i] = ( lengths[i] << 8 ) | static_cast<uint8_t>( body[ length_offset + i * sizeof( uint32_t ) + b ] );
+                    }
+                }
+
+                pairing.fds[0]     = fds[0];
+                pairing.fds[1]     = fds[1];
+                pairing.framed     = ( ( body[0] & PAIRING_FRAMED ) != 0 );
+                pairing.compressed = ( ( body[0] & PAIRING_COMPRESSED ) != 0 );
+                pairing.secret     = body.substr( 2, secret_length );
+                fds.clear();
+
+                if( !receiveBytes( pairing.pending[0], lengths[0] ) || !receiveBytes( pairing.pending[1], lengths[1] ) ) {
+                    ::close( pairing.fds[0] );
+                    ::close( pairing.fds[1] );
+                    return false; //EARLY RETURN
+                }
+
+                snapshot.pairings.emplace_back( std::move( pairing ) );
+            } continue;
+
+            case Record::END: {
+                return true; //EARLY RETURN
+            }
+
+            default: break;
+        }
+
+        LOG_ERROR( "[proxy::Handoff::receive(..)] Malformed record (type " << static_cast<int>( type ) << ")." );
+
+        for( const auto fd : fds ) {
+            ::close( fd );
+        }
+
+        return false; //EARLY RETURN
+    }
+
+    return false;
+}
+
+/**
+ * Creates the Unix socket a successor connects to (replacing any left at the path)
+ * @param path Socket path (only the user running the server can connect)
+ * @return Listening socket file descriptor (-1 on failure)
+ */
+Handoff::FileDescriptor_t Handoff::listen( const std::string & path ) {
+    struct sockaddr_un address {};
+
+    if( path.size() >= sizeof( address.sun_path ) ) {
+        LOG_ERROR( "[proxy::Handoff::listen( " << path << " )] Path too long." );
+        return -1; //EARLY RETURN
+    }
+
+    address.sun_family = AF_UNIX;
+    std::memcpy( address.sun_path, path.c_str(), path.size() );
+
+    const auto socket_fd = ::socket( AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+
+    if( socket_fd == -1 ) {
+        LOG_ERROR( "[proxy::Handoff::listen( " << path << " )] 'socket' error: " << ::strerror( errno ) );
+        return -1; //EARLY RETURN
+    }
+
+    ::unlink( path.c_str() ); //left behind by the predecessor
+
+    const auto mask = ::umask( 0077 );
+
+    if( ::bind( socket_fd, reinterpret_cast<struct sockaddr *>( &address ), sizeof( address ) ) == -1 || ::listen( socket_fd, 1 ) == -1 ) {
+        LOG_ERROR( "[proxy::Handoff::listen( " << path << " )] error: " << ::strerror( errno ) );
+        ::umask( mask );
+        ::close( socket_fd );
+        return -1; //EARLY RETURN
+    }
+
+    ::umask( mask );
+
+    return socket_fd;
+}
+
+/**
+ * Accepts a successor on the Unix socket
+ * @param listener_fd Listening socket file descriptor
+ * @return Channel socket file descriptor (-1 on failure or when the peer runs as another user)
+ */
+Handoff::FileDescriptor_t Handoff::accept( FileDescriptor_t listener_fd ) {
+    const auto channel_fd = ::accept4( listener_fd, nullptr, nullptr, SOCK_CLOEXEC );
+
+    if( channel_fd == -1 ) {
+        if( errno != EAGAIN && errno != EWOULDBLOCK ) {
+            LOG_ERROR( "[proxy::Handoff::accept(..)] error: " << ::strerror( errno ) );
+        }
+
+        return -1; //EARLY RETURN
+    }
+
+    struct ucred credentials {};
+    socklen_t    length = sizeof( credentials );
+
+    if( ::getsockopt( channel_fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length ) == -1 || credentials.uid != ::geteuid() ) {
+        LOG_WARNING( "[proxy::Handoff::accept(..)] Refused hand-off to a process of another user (pid " << credentials.pid << ")." );
+        ::close( channel_fd );
+        return -1; //EARLY RETURN
+    }
+
+    return channel_fd;
+}
+
+/**
+ * Connects to a running server's Unix socket
+ * @param path Socket path
+ * @return Channel socket file descriptor (-1 when no server is listening there)
+ */
+Handoff::FileDescriptor_t Handoff::connect( const std::string & path ) {
+    struct sockaddr_un address {};
+
+    if( path.size() >= sizeof( address.sun_path ) ) {
+        return -1; //EARLY RETURN
+    }
+
+    address.sun_family = AF_UNIX;
+    std::memcpy( address.sun_path, path.c_str(), path.size() );
+
+    const auto socket_fd = ::socket( AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0 );
+
+    if( socket_fd == -1 ) {
+        return -1; //EARLY RETURN
+    }
+
+    if( ::connect( socket_fd, reinterpret_cast<struct sockaddr *>( &address ), sizeof( address ) ) == -1 ) {
+        ::close( socket_fd );
+        return -1; //EARLY RETURN
+    }
+
+    return socket_fd;
+}
+
+/**
+ * [PRIVATE] Sends a record (greeting the successor first)
+ * @param type Record type
+ * @param body Record body
+ * @param fds File descriptors to attach (duplicated into the successor)
+ * @param fd_count Number of file descriptors
+ * @return Success
+ */
+bool Handoff::sendRecord( Record type, const std::string & body, const FileDescriptor_t * fds, size_t fd_count ) {
+    if( !_greeted ) {
+        _greeted = true;
+
+        if( !sendRecord( Record::HELLO, std::string( HANDOFF_MAGIC ) + static_cast<char>( HANDOFF_VERSION ) ) ) {
+            return false; //EARLY RETURN
+        }
+    }
+
+    char          tag              = static_cast<char>( type );
+    struct iovec  iov[2]           = { { &tag, 1 }, { const_cast<char *>( body.data() ), body.size() } };
+    struct msghdr message          {};
+    char          control[CMSG_SPACE( sizeof( FileDescriptor_t ) * HANDOFF_FDS_MAX )] {};
+
+    message.msg_iov    = iov;
+    message.msg_iovlen = 2;
+
+    if( fd_count > 0 ) {
+        message.msg_control    = control;
+        message.msg_controllen = CMSG_SPACE( sizeof( FileDescriptor_t ) * fd_count );
+
+        auto * cmsg = CMSG_FIRSTHDR( &message );
+
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type  = SCM_RIGHTS;
+        cmsg->cmsg_len   = CMSG_LEN( sizeof( FileDescriptor_t ) * fd_count );
+        std::memcpy( CMSG_DATA( cmsg ), fds, sizeof( FileDescriptor_t ) * fd_count );
+    }
+
+    while( ::sendmsg( _channel_fd, &message, MSG_NOSIGNAL ) == -1 ) {
+        if( errno != EINTR ) {
+            LOG_ERROR( "[proxy::Handoff::sendRecord(..)] error: " << ::strerror( errno ) );
+            return false; //EARLY RETURN
+        }
+    }
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Receives a record (blocking)
+ * @param type Record type
+ * @param body Record body
+ * @param fds Container for the file descriptors attached (close-on-exec)
+ * @return Success
+ */
+bool Handoff::receiveRecord( Record & type, std::string & body, std::vector<FileDescriptor_t> & fds ) {
+    char          buffer[HANDOFF_CHUNK_SIZE + 512];
+    char          control[CMSG_SPACE( sizeof( FileDescriptor_t ) * HANDOFF_FDS_MAX )] {};
+    struct iovec  iov     { buffer, sizeof( buffer ) };
+    struct msghdr message {};
+    ssize_t       bytes   = -1;
+
+    message.msg_iov        = &iov;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control;
+    message.msg_controllen = sizeof( control );
+
+    while( ( bytes = ::recvmsg( _channel_fd, &message, MSG_CMSG_CLOEXEC ) ) == -1 && errno == EINTR );
+
+    for( auto * cmsg = CMSG_FIRSTHDR( &message ); bytes > 0 && cmsg != nullptr; cmsg = CMSG_NXTHDR( &message, cmsg ) ) {
+        if( cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS ) {
+            const auto count = ( cmsg->cmsg_len - CMSG_LEN( 0 ) ) / sizeof( FileDescriptor_t );
+            const auto first = fds.size();
+
+            fds.resize( first + count );
+            std::memcpy( fds.data() + first, CMSG_DATA( cmsg ), count * sizeof( FileDescriptor_t ) );
+        }
+    }
+
+    if( bytes <= 0 || ( message.msg_flags & ( MSG_TRUNC | MSG_CTRUNC ) ) ) {
+        if( bytes == -1 ) {
+            LOG_ERROR( "[proxy::Handoff::receiveRecord(..)] error: " << ::strerror( errno ) );
+        }
+
+        return false; //EARLY RETURN
+    }
+
+    type = static_cast<Record>( buffer[0] );
+    body.assign( buffer + 1, static_cast<size_t>( bytes ) - 1 );
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Receives the pending bytes following a pairing
+ * @param bytes Container for the bytes
+ * @param length Number of bytes to receive
+ * @return Success
+ */
+bool Handoff::receiveBytes( std::string & bytes, size_t length ) {
+    auto type = Record::BYTES;
+    auto body = std::string();
+    auto fds  = std::vector<FileDescriptor_t>();
+
+    bytes.reserve( length );
+
+    while( bytes.size() < length ) {
+        if( !receiveRecord( type, body, fds ) || type != Record::BYTES || !fds.empty() || bytes.size() + body.size() > length ) {
+            for( const auto fd : fds ) {
+                ::close( fd );
+            }
+
+            LOG_ERROR( "[proxy::Handoff::receiveBytes(..)] Pending bytes of a pairing missing." );
+            return false; //EARLY RETURN
+        }
+
+        bytes.append( body );
+    }
+
+    return true;
+}
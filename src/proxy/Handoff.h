@@ -0,0 +1,79 @@
+#ifndef FWD_PROXY_PROXY_HANDOFF_H
+#define FWD_PROXY_PROXY_HANDOFF_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "FrameCursor.h"
+
+namespace fwd_proxy::proxy {
+    /**
+     * Channel between a running server and the process taking over from it (hot restart)
+     * The successor connects to the server's Unix socket (`SOCK_SEQPACKET`) and is sent the listening sockets,
+     * the pending clients and the pairings as records, with their file descriptors attached (`SCM_RIGHTS`).
+     * Clients stay connected throughout: the sockets are only ever duplicated into the successor. Bytes read
+     * from a client but not forwarded yet follow their pairing in chunks.
+     */
+    class Handoff {
+      public:
+        typedef int FileDescriptor_t;
+
+        struct Pending_t {
+            FileDescriptor_t fd { -1 };
+            std::string      handshake {}; //bytes of the handshake received so far (whole handshake once complete)
+            FrameCursor      frames    {}; //position in the frames dropped whilst waiting (framed only)
+        };
+
+        struct Pairing_t {
+            FileDescriptor_t fds[2]     { -1, -1 };
+            std::string      secret;
+            bool             framed     { false };
+            bool             compressed { false }; //frame payloads compressed end to end (framed only)
+            std::string      pending[2];           //bytes read from `fds[i]` not written to the other client yet
+            FrameCursor      frames[2];            //position in the frames sent by `fds[i]` (framed only)
+        };
+
+        struct Snapshot_t {
+            std::vector<FileDescriptor_t> listeners;
+            std::vector<Pending_t>        pending;
+            std::vector<Pairing_t>        pairings;
+        };
+
+        explicit Handoff( FileDescriptor_t channel_fd );
+        Handoff( const Handoff & ) = delete;
+        ~Handoff();
+
+        Handoff & operator =( const Handoff & ) = delete;
+
+        bool sendListener( FileDescriptor_t listener_fd );
+        bool sendPending( const Pending_t & client );
+        bool sendPairing( const Pairing_t & pairing );
+        bool finish();
+        bool receive( Snapshot_t & snapshot );
+
+        static FileDescriptor_t listen( const std::string & path );
+        static FileDescriptor_t accept( FileDescriptor_t listener_fd );
+        static FileDescriptor_t connect( const std::string & path );
+
+      private:
+        enum class Record : uint8_t {
+            HELLO = 0, //protocol version
+            LISTENER,
+            PENDING,
+            PAIRING,
+            BYTES,     //chunk of a pairing's pending bytes
+            END,
+        };
+
+        FileDescriptor_t _channel_fd;
+        bool             _greeted; //`HELLO` sent
+
+        bool sendRecord( Record type, const std::string & body, const FileDescriptor_t * fds = nullptr, size_t fd_count = 0 );
+        bool receiveRecord( Record & type, std::string & body, std::vector<FileDescriptor_t> & fds );
+        bool receiveBytes( std::string & bytes, size_t length );
+    };
+}
+
+#endif //FWD_PROXY_PROXY_HANDOFF_H
@@ -0,0 +1,144 @@
+#include "Handshake.h"
+#include "../logger/Logger.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/socket.h>
+
+#define INPUT_BUFFER_SIZE          512
+#define LOGGED_CONTENT_MAX_LEN      32 //unexpected handshake bytes shown in the logs
+
+using namespace fwd_proxy::proxy;
+
+/**
+ * Receives and processes the handshake bytes available for a client
+ * @param client_fd Client file descriptor
+ * @param handshake Client's handshake parser
+ * @param frames Frames sent past the handshake (framed clients only)
+ * @return Handshake state post-processing
+ */
+fwd_proxy::HandshakeState Handshake::receive( FileDescriptor_t client_fd, HandshakeParser & handshake, FrameCursor & frames ) {
+    char buffer[INPUT_BUFFER_SIZE];
+
+    const auto bytes = Handshake::rcv( client_fd, buffer, sizeof( buffer ) );
+
+    if( bytes == -1 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) {
+        return handshake.state(); //EARLY RETURN (spurious wake-up)
+    }
+
+    return Handshake::process( client_fd, handshake, frames, buffer, bytes );
+}
+
+/**
+ * Process the bytes received from a client during its handshake
+ * (anything received past the handshake before the client is paired is dropped, frame by frame for framed clients)
+ * @param client_fd Client file descriptor
+ * @param handshake Client's handshake parser
+ * @param frames    Frames sent past the handshake (framed clients only)
+ * @param buffer    Bytes received
+ * @param bytes     Number of bytes received (-1 on error with `errno` set)
+ * @return Handshake state post-processing (`DCN` when the client disconnected or sent a malformed handshake/frame)
+ */
+fwd_proxy::HandshakeState Handshake::process( FileDescriptor_t client_fd, HandshakeParser & handshake, FrameCursor & frames, const char * buffer, ssize_t bytes ) {
+    if( bytes <= 0 ) {
+        LOG_INFO( "[proxy::Handshake::process(..)] "
+                  << "Client " << client_fd << " disconnected" );
+        return HandshakeState::DCN; //EARLY RETURN
+    }
+
+    if( handshake.complete() ) {
+        return Handshake::skipFrames( client_fd, handshake, frames, buffer, static_cast<size_t>( bytes ) ); //EARLY RETURN
+    }
+
+    const auto prev_state = handshake.state();
+    const auto consumed   = handshake.feed( buffer, static_cast<size_t>( bytes ) );
+
+    if( handshake.state() == HandshakeState::AUTH1 && Handshake::drained( client_fd ) ) { //unterminated `AUTH1` secret
+        handshake.endSecret();
+    }
+
+    if( handshake.failed() ) {
+        LOG_WARNING( "[proxy::Handshake::process(..)] "
+                     << "Unexpected handshake content (" << bytes << " bytes) sent from client " << client_fd << ": "
+                     << std::string_view( buffer, std::min( static_cast<size_t>( bytes ), static_cast<size_t>( LOGGED_CONTENT_MAX_LEN ) ) ) );
+        Handshake::send( client_fd, "WTF?" );
+
+    } else if( handshake.complete() && !handshake.secret().empty() ) {
+        LOG_DEBUG( "[proxy::Handshake::process(..)] "
+                   << "Client " << client_fd << " secret: " << handshake.secret() );
+    }
+
+    if( handshake.state() != prev_state ) {
+        LOG_DEBUG( "[proxy::Handshake::process(..)] Client " << client_fd << " handshake state: " << handshake.state() );
+    }
+
+    if( handshake.complete() ) {
+        return Handshake::skipFrames( client_fd, handshake, frames, buffer + consumed, static_cast<size_t>( bytes ) - consumed ); //EARLY RETURN
+    }
+
+    return handshake.state();
+}
+
+/**
+ * [PRIVATE] Drops what a client sent past its handshake whilst waiting to be paired
+ * @param client_fd Client file descriptor
+ * @param handshake Client's (complete) handshake parser
+ * @param frames    Frames sent past the handshake (moved over the dropped bytes for framed clients)
+ * @param buffer    Bytes received
+ * @param bytes     Number of bytes received
+ * @return Handshake state post-processing (`DCN` when a framed client sent a malformed frame)
+ */
+fwd_proxy::HandshakeState Handshake::skipFrames( FileDescriptor_t client_fd, const HandshakeParser & handshake, FrameCursor & frames, const char * buffer, size_t bytes ) {
+    if( !handshake.framed() || frames.consume( buffer, bytes ) ) {
+        return HandshakeState::READY; //EARLY RETURN
+    }
+
+    LOG_WARNING( "[proxy::Handshake::skipFrames(..)] "
+                 << "Malformed frame sent from client " << client_fd );
+
+    return HandshakeState::DCN;
+}
+
+/**
+ * [PRIVATE] Sends a message to a client file descriptor
+ * @param client_fd Client file descriptor
+ * @param msg Message string to send
+ * @return Success
+ */
+bool Handshake::send( FileDescriptor_t client_fd, const std::string &msg ) {
+    if( ::send( client_fd, msg.c_str(), msg.size(), 0 ) == -1 ) {
+        LOG_ERROR( "[proxy::Handshake::send(..)] error: " << ::strerror( errno ) );
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Checks if everything a client sent so far was received
+ * @param client_fd Client file descriptor
+ * @return Drained state
+ */
+bool Handshake::drained( FileDescriptor_t client_fd ) {
+    char ch = 0;
+
+    return ::recv( client_fd, &ch, 1, MSG_PEEK | MSG_DONTWAIT ) == -1 && ( errno == EAGAIN || errno == EWOULDBLOCK );
+}
+
+/**
+ * [PRIVATE] Receive characters from stream
+ * @param client_fd Client file descriptor
+ * @param buffer Buffer
+ * @param buffer_size Buffer length
+ * @return Number of bytes
+ */
+ssize_t Handshake::rcv( FileDescriptor_t client_fd, char * buffer, size_t buffer_size ) {
+    auto bytes = ::recv( client_fd, buffer, buffer_size, 0 );
+
+    if( bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK ) {
+        LOG_ERROR( "[proxy::Handshake::rcv(..)] error: " << ::strerror( errno ) );
+    }
+
+    return bytes;
+}
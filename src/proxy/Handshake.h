@@ -0,0 +1,31 @@
+#ifndef FWD_PROXY_PROXY_HANDSHAKE_H
+#define FWD_PROXY_PROXY_HANDSHAKE_H
+
+#include <string>
+#include <sys/types.h>
+
+#include "../enum/HandshakeState.h"
+#include "HandshakeParser.h"
+#include "FrameCursor.h"
+
+namespace fwd_proxy::proxy {
+    /**
+     * Handshake step of a pending client: receives what the client sent and runs it through its parser
+     * (kept apart from the server's event loops so that it can be driven on its own, i.e. from a benchmark)
+     */
+    class Handshake {
+      public:
+        typedef int FileDescriptor_t;
+
+        static HandshakeState receive( FileDescriptor_t client_fd, HandshakeParser & handshake, FrameCursor & frames );
+        static HandshakeState process( FileDescriptor_t client_fd, HandshakeParser & handshake, FrameCursor & frames, const char * buffer, ssize_t bytes );
+
+      private:
+        static HandshakeState skipFrames( FileDescriptor_t client_fd, const HandshakeParser & handshake, FrameCursor & frames, const char * buffer, size_t bytes );
+        static bool send( FileDescriptor_t client_fd, const std::string & msg );
+        static ssize_t rcv( FileDescriptor_t client_fd, char * buffer, size_t buffer_size );
+        static bool drained( FileDescriptor_t client_fd );
+    };
+}
+
+#endif //FWD_PROXY_PROXY_HANDSHAKE_H
@@ -0,0 +1,206 @@
+#include "HandshakeParser.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define AUTH_TOKEN_PREFIX     "AUTH"
+#define AUTH_TOKEN_PREFIX_LEN 4
+
+using namespace fwd_proxy::proxy;
+
+/**
+ * Constructor
+ */
+HandshakeParser::HandshakeParser() :
+    _state( HandshakeState::INIT ),
+    _token_matched( 0 ),
+    _secret_length( 0 ),
+    _framed( false ),
+    _compressed( false ),
+    _secret()
+{}
+
+/**
+ * Feeds received bytes to the parser
+ * @param data Bytes received
+ * @param length Number of bytes
+ * @return Number of bytes consumed (less than `length` when the handshake ended before the last byte)
+ */
+size_t HandshakeParser::feed( const char * data, size_t length ) {
+    size_t i = 0;
+
+    while( i < length && _state == HandshakeState::INIT ) {
+        const char ch = data[i++];
+
+        if( _token_matched < AUTH_TOKEN_PREFIX_LEN ) {
+            if( ch != AUTH_TOKEN_PREFIX[ _token_matched ] ) {
+                _state = HandshakeState::DCN;
+            } else {
+                ++_token_matched;
+            }
+
+        } else if( ch == '0' || ch == '2' || ch == '4' ) {
+            _state      = HandshakeState::READY;
+            _framed     = ( ch != '0' );
+            _compressed = ( ch == '4' );
+
+        } else if( ch == '1' || ch == '3' || ch == '5' ) {
+            _state      = HandshakeState::AUTH1;
+            _framed     = ( ch != '1' );
+            _compressed = ( ch == '5' );
+
+        } else {
+            _state = HandshakeState::DCN;
+        }
+    }
+
+    if( _state == HandshakeState::AUTH1 && i < length ) {
+        const auto * begin = data + i;
+        const auto * end   = data + length;
+        const auto * term  = std::find_if( begin, end, []( char ch ) {
+            return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t' || ch == '\v' || ch == '\f';
+        } );
+
+        const auto chunk = static_cast<size_t>( term - begin );
+
+        if( _secret_length + chunk > SECRET_MAX_LEN ) {
+            _state = HandshakeState::DCN;
+            return length; //EARLY RETURN
+        }
+
+        std::memcpy( &_secret[ _secret_length ], begin, chunk );
+        _secret_length += chunk;
+        i              += chunk;
+
+        if( term != end ) { //terminator (consumed)
+            ++i;
+            _state = ( _secret_length > 0 ? HandshakeState::READY : HandshakeState::DCN );
+        }
+    }
+
+    return i;
+}
+
+/**
+ * Ends an `AUTH1` secret at the last byte fed (original protocol: the secret is the rest of the segment)
+ * Framed handshakes only came with terminated secrets so they are left waiting for the terminator.
+ * @return Completion state
+ */
+bool HandshakeParser::endSecret() {
+    if( _state == HandshakeState::AUTH1 && !_framed && _secret_length > 0 ) {
+        _state = HandshakeState::READY;
+    }
+
+    return complete();
+}
+
+/**
+ * Marks the handshake as complete without parsing anything (i.e.: client authenticated on an earlier pairing)
+ * @param framed Flag for the framed protocol (negotiated by the earlier handshake)
+ * @param compressed Flag for compressed frame payloads (negotiated by the earlier handshake)
+ */
+void HandshakeParser::skip( bool framed, bool compressed ) {
+    _state      = HandshakeState::READY;
+    _framed     = framed;
+    _compressed = compressed;
+}
+
+/**
+ * Gets the handshake state
+ * @return State (`READY` once complete, `DCN` when the input was malformed)
+ */
+fwd_proxy::HandshakeState HandshakeParser::state() const {
+    return _state;
+}
+
+/**
+ * Checks if the handshake completed
+ * @return Completion state
+ */
+bool HandshakeParser::complete() const {
+    return _state == HandshakeState::READY;
+}
+
+/**
+ * Checks if the input was malformed
+ * @return Failure state
+ */
+bool HandshakeParser::failed() const {
+    return _state == HandshakeState::DCN;
+}
+
+/**
+ * Gets the secret
+ * @return Secret (empty for anonymous clients; only valid as long as the parser)
+ */
+std::string_view HandshakeParser::secret() const {
+    return { _secret, _secret_length };
+}
+
+/**
+ * Checks if the client asked for the framed protocol
+ * @return Framed state
+ */
+bool HandshakeParser::framed() const {
+    return _framed;
+}
+
+/**
+ * Checks if the client compresses the payload of its frames (only paired with a client that does too)
+ * @return Compressed state
+ */
+bool HandshakeParser::compressed() const {
+    return _compressed;
+}
+
+/**
+ * Rebuilds the bytes of the handshake consumed so far (i.e. to replay them to another parser)
+ * @return Handshake bytes (whitespace terminating a secret is normalised to a line feed)
+ */
+std::string HandshakeParser::received() const {
+    switch( _state ) {
+        case HandshakeState::INIT: {
+            return std::string( AUTH_TOKEN_PREFIX, _token_matched ); //EARLY RETURN
+        }
+
+        case HandshakeState::AUTH1: {
+            return std::string( AUTH_TOKEN_PREFIX ) + HandshakeParser::token( true, _framed, _compressed ) + std::string( _secret, _secret_length ); //EARLY RETURN
+        }
+
+        case HandshakeState::READY: {
+            return HandshakeParser::compose( secret(), _framed, _compressed ); //EARLY RETURN
+        }
+
+        default: {
+            return {}; //EARLY RETURN
+        }
+    }
+}
+
+/**
+ * Composes a complete handshake
+ * @param secret Secret (empty for anonymous clients)
+ * @param framed Flag for the framed protocol
+ * @param compressed Flag for compressed frame payloads (framed protocol only)
+ * @return Handshake bytes
+ */
+std::string HandshakeParser::compose( std::string_view secret, bool framed, bool compressed ) {
+    if( secret.empty() ) {
+        return std::string( AUTH_TOKEN_PREFIX ) + HandshakeParser::token( false, framed, compressed ); //EARLY RETURN
+    }
+
+    return std::string( AUTH_TOKEN_PREFIX ) + HandshakeParser::token( true, framed, compressed ) + std::string( secret ) + '\n';
+}
+
+/**
+ * [PRIVATE] Gets the digit following `AUTH` for a handshake
+ * @param secret Flag for a client with a secret
+ * @param framed Flag for the framed protocol
+ * @param compressed Flag for compressed frame payloads (framed protocol only)
+ * @return Digit
+ */
+char HandshakeParser::token( bool secret, bool framed, bool compressed ) {
+    const char base = ( compressed && framed ? '4' : ( framed ? '2' : '0' ) );
+
+    return static_cast<char>( base + ( secret ? 1 : 0 ) );
+}
@@ -0,0 +1,53 @@
+#ifndef FWD_PROXY_PROXY_HANDSHAKEPARSER_H
+#define FWD_PROXY_PROXY_HANDSHAKEPARSER_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+#include "../enum/HandshakeState.h"
+
+namespace fwd_proxy::proxy {
+    /**
+     * Incremental parser for the client handshake (`AUTH0` or `AUTH1<secret><whitespace>`, `AUTH2`/`AUTH3` for the framed protocol,
+     * `AUTH4`/`AUTH5` for the framed protocol with compressed payloads)
+     * Bytes can be fed as they arrive in any split: the progress through the `AUTHx` token and the secret
+     * received so far are kept between calls. Parsing stops at the end of the handshake so that whatever
+     * follows it in the same segment is left to the caller. Nothing is allocated.
+     * `AUTH1` clients of the original protocol send their secret unterminated, in 1 segment: the caller ends
+     * it with `endSecret()` once the bytes received are drained.
+     */
+    class HandshakeParser {
+      public:
+        static constexpr size_t SECRET_MAX_LEN = 64;
+
+        HandshakeParser();
+
+        size_t feed( const char * data, size_t length );
+        void skip( bool framed = false, bool compressed = false );
+        bool endSecret();
+
+        [[nodiscard]] HandshakeState state() const;
+        [[nodiscard]] bool complete() const;
+        [[nodiscard]] bool failed() const;
+        [[nodiscard]] std::string_view secret() const;
+        [[nodiscard]] bool framed() const;
+        [[nodiscard]] bool compressed() const;
+        [[nodiscard]] std::string received() const;
+
+        static std::string compose( std::string_view secret, bool framed, bool compressed = false );
+
+      private:
+        HandshakeState _state;         //INIT -> (AUTH1 ->) READY, or DCN on malformed input
+        uint8_t        _token_matched; //bytes of the `AUTHx` token matched so far
+        uint8_t        _secret_length;
+        bool           _framed;        //client asked for the framed protocol (`AUTH2`-`AUTH5`)
+        bool           _compressed;    //client compresses the payload of its frames (`AUTH4`/`AUTH5`)
+        char           _secret[SECRET_MAX_LEN];
+
+        static char token( bool secret, bool framed, bool compressed );
+    };
+}
+
+#endif //FWD_PROXY_PROXY_HANDSHAKEPARSER_H
@@ -0,0 +1,369 @@
+#include "IoUring.h"
+#include "../logger/Logger.h"
+
+#include <atomic>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+
+using namespace fwd_proxy::proxy;
+
+/**
+ * Constructor (check `valid()` for success)
+ * @param entries Number of submission queue entries
+ */
+IoUring::IoUring( unsigned entries ) :
+    _ring_fd( -1 ),
+    _params( {} ),
+    _sq_ptr( MAP_FAILED ),
+    _sq_size( 0 ),
+    _cq_ptr( MAP_FAILED ),
+    _cq_size( 0 ),
+    _sqes( static_cast<struct io_uring_sqe *>( MAP_FAILED ) ),
+    _sq_head( nullptr ),
+    _sq_tail( nullptr ),
+    _sq_mask( 0 ),
+    _sqe_tail( 0 ),
+    _cq_head( nullptr ),
+    _cq_tail( nullptr ),
+    _cq_mask( 0 ),
+    _cqes( nullptr ),
+    _buf_ring( static_cast<struct io_uring_buf_ring *>( MAP_FAILED ) ),
+    _buf_ring_size( 0 ),
+    _buf_group_id( 0 ),
+    _buf_count( 0 ),
+    _buf_size( 0 ),
+    _buf_tail( 0 )
+{
+    _params.flags      = IORING_SETUP_CQSIZE;
+    _params.cq_entries = entries * 4; //multishot operations post many completions per submission
+
+    if( ( _ring_fd = static_cast<int>( ::syscall( __NR_io_uring_setup, entries, &_params ) ) ) < 0 ) {
+        LOG_ERROR( "[proxy::IoUring::IoUring(..)] 'io_uring_setup' error: " << ::strerror( errno ) );
+        _ring_fd = -1;
+        return; //EARLY RETURN
+    }
+
+    _sq_size = _params.sq_off.array + _params.sq_entries * sizeof( unsigned );
+    _cq_size = _params.cq_off.cqes + _params.cq_entries * sizeof( struct io_uring_cqe );
+
+    if( _params.features & IORING_FEAT_SINGLE_MMAP ) {
+        _sq_size = _cq_size = std::max( _sq_size, _cq_size );
+    }
+
+    _sq_ptr = ::mmap( nullptr, _sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING );
+
+    if( _sq_ptr == MAP_FAILED ) {
+        LOG_ERROR( "[proxy::IoUring::IoUring(..)] 'mmap' error: " << ::strerror( errno ) );
+        return; //EARLY RETURN
+    }
+
+    if( _params.features & IORING_FEAT_SINGLE_MMAP ) {
+        _cq_ptr = _sq_ptr;
+    } else {
+        _cq_ptr = ::mmap( nullptr, _cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_CQ_RING );
+
+        if( _cq_ptr == MAP_FAILED ) {
+            LOG_ERROR( "[proxy::IoUring::IoUring(..)] 'mmap' error: " << ::strerror( errno ) );
+            return; //EARLY RETURN
+        }
+    }
+
+    _sqes = static_cast<struct io_uring_sqe *>( ::mmap( nullptr,
+                                                        _params.sq_entries * sizeof( struct io_uring_sqe ),
+                                                        PROT_READ | PROT_WRITE,
+                                                        MAP_SHARED | MAP_POPULATE,
+                                                        _ring_fd,
+                                                        IORING_OFF_SQES ) );
+
+    if( _sqes == MAP_FAILED ) {
+        LOG_ERROR( "[proxy::IoUring::IoUring(..)] 'mmap' error: " << ::strerror( errno ) );
+        return; //EARLY RETURN
+    }
+
+    auto * sq = static_cast<char *>( _sq_ptr );
+    auto * cq = static_cast<char *>( _cq_ptr );
+
+    _sq_head  = reinterpret_cast<unsigned *>( sq + _params.sq_off.head );
+    _sq_tail  = reinterpret_cast<unsigned *>( sq + _params.sq_off.tail );
+    _sq_mask  = *reinterpret_cast<unsigned *>( sq + _params.sq_off.ring_mask );
+    _sqe_tail = *_sq_tail;
+    _cq_head  = reinterpret_cast<unsigned *>( cq + _params.cq_off.head );
+    _cq_tail  = reinterpret_cast<unsigned *>( cq + _params.cq_off.tail );
+    _cq_mask  = *reinterpret_cast<unsigned *>( cq + _params.cq_off.ring_mask );
+    _cqes     = reinterpret_cast<struct io_uring_cqe *>( cq + _params.cq_off.cqes );
+
+    auto * sq_array = reinterpret_cast<unsigned *>( sq + _params.sq_off.array );
+
+    for( unsigned i = 0; i < _params.sq_entries; ++i ) { //SQE slots are always used in ring order
+        sq_array[i] = i;
+    }
+}
+
+/**
+ * Destructor
+ */
+IoUring::~IoUring() {
+    if( _buf_ring != MAP_FAILED ) {
+        ::munmap( _buf_ring, _buf_ring_size );
+    }
+
+    if( _sqes != MAP_FAILED ) {
+        ::munmap( _sqes, _params.sq_entries * sizeof( struct io_uring_sqe ) );
+    }
+
+    if( _cq_ptr != MAP_FAILED && _cq_ptr != _sq_ptr ) {
+        ::munmap( _cq_ptr, _cq_size );
+    }
+
+    if( _sq_ptr != MAP_FAILED ) {
+        ::munmap( _sq_ptr, _sq_size );
+    }
+
+    if( _ring_fd != -1 ) {
+        ::close( _ring_fd );
+    }
+}
+
+/**
+ * Checks the ring was set up successfully
+ * @return Valid state
+ */
+bool IoUring::valid() const {
+    return _ring_fd != -1 && _sqes != MAP_FAILED;
+}
+
+/**
+ * Registers a provided buffer ring and fills it with buffers
+ * @param group_id Buffer group ID to use in `prepareRecvMultishot(..)`
+ * @param buffer_count Number of buffers (power of 2)
+ * @param buffer_size Size of each buffer
+ * @return Success
+ */
+bool IoUring::registerBufferRing( uint16_t group_id, uint16_t buffer_count, uint32_t buffer_size ) {
+    _buf_ring_size = buffer_count * sizeof( struct io_uring_buf );
+    _buf_ring      = static_cast<struct io_uring_buf_ring *>( ::mmap( nullptr, _buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 ) );
+
+    if( _buf_ring == MAP_FAILED ) {
+        LOG_ERROR( "[proxy::IoUring::registerBufferRing(..)] 'mmap' error: " << ::strerror( errno ) );
+        return false; //EARLY RETURN
+    }
+
+    struct io_uring_buf_reg reg = {};
+
+    reg.ring_addr    = reinterpret_cast<uint64_t>( _buf_ring );
+    reg.ring_entries = buffer_count;
+    reg.bgid         = group_id;
+
+    if( ::syscall( __NR_io_uring_register, _ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1 ) < 0 ) {
+        LOG_ERROR( "[proxy::IoUring::registerBufferRing(..)] 'io_uring_register' error: " << ::strerror( errno ) );
+        return false; //EARLY RETURN
+    }
+
+    _buf_group_id = group_id;
+    _buf_count    = buffer_count;
+    _buf_size     = buffer_size;
+    _buf_tail     = 0;
+    _buffers      = std::make_unique_for_overwrite<char[]>( static_cast<size_t>( buffer_count ) * buffer_size );
+
+    for( uint16_t bid = 0; bid < buffer_count; ++bid ) {
+        returnBuffer( bid );
+    }
+
+    return true;
+}
+
+/**
+ * Gets a provided buffer
+ * @param buffer_id Buffer ID (from the completion flags)
+ * @return Pointer to the start of the buffer
+ */
+char * IoUring::buffer( uint16_t buffer_id ) const {
+    return &_buffers[ static_cast<size_t>( buffer_id ) * _buf_size ];
+}
+
+/**
+ * Gives a provided buffer back to the kernel once its content has been consumed
+ * @param buffer_id Buffer ID
+ */
+void IoUring::returnBuffer( uint16_t buffer_id ) {
+    //N.B.: not using `_buf_ring->bufs` as `__DECLARE_FLEX_ARRAY` offsets it by the size of an empty struct in C++
+    auto & buf = reinterpret_cast<struct io_uring_buf *>( _buf_ring )[ _buf_tail & ( _buf_count - 1 ) ];
+
+    buf.addr = reinterpret_cast<uint64_t>( buffer( buffer_id ) );
+    buf.len  = _buf_size;
+    buf.bid  = buffer_id;
+
+    std::atomic_ref<uint16_t>( _buf_ring->tail ).store( ++_buf_tail, std::memory_order_release );
+}
+
+/**
+ * Queues a multishot accept (accepted sockets are non-blocking)
+ * @param fd Listening socket file descriptor
+ * @param user_data User data for the completions
+ */
+void IoUring::prepareAcceptMultishot( int fd, uint64_t user_data ) {
+    auto * sqe = nextSQE();
+
+    sqe->opcode       = IORING_OP_ACCEPT;
+    sqe->fd           = fd;
+    sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data    = user_data;
+}
+
+/**
+ * Queues a single receive into a given buffer
+ * @param fd Socket file descriptor
+ * @param buffer Buffer
+ * @param length Buffer length
+ * @param user_data User data for the completion
+ */
+void IoUring::prepareRecv( int fd, void * buffer, size_t length, uint64_t user_data ) {
+    auto * sqe = nextSQE();
+
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = fd;
+    sqe->addr      = reinterpret_cast<uint64_t>( buffer );
+    sqe->len       = static_cast<uint32_t>( length );
+    sqe->user_data = user_data;
+}
+
+/**
+ * Queues a multishot receive into buffers picked from the provided buffer ring
+ * @param fd Socket file descriptor
+ * @param user_data User data for the completions
+ */
+void IoUring::prepareRecvMultishot( int fd, uint64_t user_data ) {
+    auto * sqe = nextSQE();
+
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = fd;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = _buf_group_id;
+    sqe->user_data = user_data;
+}
+
+/**
+ * Queues a send (retried by the kernel until all bytes are sent)
+ * @param fd Socket file descriptor
+ * @param buffer Buffer
+ * @param length Number of bytes to send
+ * @param user_data User data for the completion
+ * @param link Flag to link the next queued operation to this one (i.e.: runs only after this one succeeds)
+ */
+void IoUring::prepareSend( int fd, const void * buffer, size_t length, uint64_t user_data, bool link ) {
+    auto * sqe = nextSQE();
+
+    sqe->opcode    = IORING_OP_SEND;
+    sqe->fd        = fd;
+    sqe->addr      = reinterpret_cast<uint64_t>( buffer );
+    sqe->len       = static_cast<uint32_t>( length );
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    sqe->flags     = ( link ? IOSQE_IO_LINK : 0 );
+    sqe->user_data = user_data;
+}
+
+/**
+ * Queues a read
+ * @param fd File descriptor
+ * @param buffer Buffer
+ * @param length Buffer length
+ * @param user_data User data for the completion
+ */
+void IoUring::prepareRead( int fd, void * buffer, size_t length, uint64_t user_data ) {
+    auto * sqe = nextSQE();
+
+    sqe->opcode    = IORING_OP_READ;
+    sqe->fd        = fd;
+    sqe->addr      = reinterpret_cast<uint64_t>( buffer );
+    sqe->len       = static_cast<uint32_t>( length );
+    sqe->off       = static_cast<uint64_t>( -1 ); //current file position
+    sqe->user_data = user_data;
+}
+
+/**
+ * Queues the cancellation of all operations pending on a file descriptor
+ * @param fd File descriptor
+ * @param user_data User data for the completion
+ */
+void IoUring::prepareCancel( int fd, uint64_t user_data ) {
+    auto * sqe = nextSQE();
+
+    sqe->opcode       = IORING_OP_ASYNC_CANCEL;
+    sqe->fd           = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data    = user_data;
+}
+
+/**
+ * Gets the number of operations that can still be queued before the submission queue is full
+ * (a linked chain must fit in it since queuing past that point submits the chain's head on its own)
+ * @return Free submission queue entries
+ */
+unsigned IoUring::freeSQEs() const {
+    return _params.sq_entries - ( _sqe_tail - std::atomic_ref<unsigned>( *_sq_head ).load( std::memory_order_acquire ) );
+}
+
+/**
+ * Submits the queued operations
+ * @param wait_count Number of completions to wait for
+ * @return Number of operations submitted (-1 on error with `errno` set)
+ */
+int IoUring::submit( unsigned wait_count ) {
+    const auto to_submit = _sqe_tail - *_sq_tail;
+
+    std::atomic_ref<unsigned>( *_sq_tail ).store( _sqe_tail, std::memory_order_release );
+
+    int ret;
+
+    do {
+        ret = static_cast<int>( ::syscall( __NR_io_uring_enter, _ring_fd, to_submit, wait_count, ( wait_count > 0 ? IORING_ENTER_GETEVENTS : 0 ), nullptr, 0 ) );
+    } while( ret == -1 && errno == EINTR );
+
+    return ret;
+}
+
+/**
+ * Processes the available completions
+ * @param callback Callback to call for each completion
+ * @return Number of completions processed
+ */
+unsigned IoUring::processCompletions( const CompletionCallback_t & callback ) {
+    unsigned count = 0;
+
+    while( true ) {
+        auto       head = *_cq_head;
+        const auto tail = std::atomic_ref<unsigned>( *_cq_tail ).load( std::memory_order_acquire );
+
+        if( head == tail ) {
+            return count; //EARLY RETURN
+        }
+
+        for( ; head != tail; ++head, ++count ) {
+            const auto cqe = _cqes[ head & _cq_mask ]; //copy so the slot can be released before callback side effects
+            std::atomic_ref<unsigned>( *_cq_head ).store( head + 1, std::memory_order_release );
+            callback( cqe );
+        }
+    }
+}
+
+/**
+ * [PRIVATE] Gets the next free submission queue entry (submits queued ones when full)
+ * @return Zeroed submission queue entry
+ */
+struct io_uring_sqe * IoUring::nextSQE() {
+    while( _sqe_tail - std::atomic_ref<unsigned>( *_sq_head ).load( std::memory_order_acquire ) >= _params.sq_entries ) {
+        submit();
+    }
+
+    auto * sqe = &_sqes[ _sqe_tail & _sq_mask ];
+    ++_sqe_tail;
+    std::memset( sqe, 0, sizeof( struct io_uring_sqe ) );
+
+    return sqe;
+}
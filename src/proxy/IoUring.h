@@ -0,0 +1,71 @@
+#ifndef FWD_PROXY_PROXY_IOURING_H
+#define FWD_PROXY_PROXY_IOURING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <functional>
+
+#include <linux/io_uring.h>
+
+namespace fwd_proxy::proxy {
+    /**
+     * Minimal io_uring wrapper (raw syscalls) with a single provided buffer ring
+     */
+    class IoUring {
+      public:
+        typedef std::function<void( const struct io_uring_cqe & )> CompletionCallback_t;
+
+        explicit IoUring( unsigned entries );
+        IoUring( const IoUring & ) = delete;
+        ~IoUring();
+
+        IoUring & operator =( const IoUring & ) = delete;
+
+        [[nodiscard]] bool valid() const;
+
+        bool registerBufferRing( uint16_t group_id, uint16_t buffer_count, uint32_t buffer_size );
+        [[nodiscard]] char * buffer( uint16_t buffer_id ) const;
+        void returnBuffer( uint16_t buffer_id );
+
+        void prepareAcceptMultishot( int fd, uint64_t user_data );
+        void prepareRecv( int fd, void * buffer, size_t length, uint64_t user_data );
+        void prepareRecvMultishot( int fd, uint64_t user_data );
+        void prepareSend( int fd, const void * buffer, size_t length, uint64_t user_data, bool link );
+        void prepareRead( int fd, void * buffer, size_t length, uint64_t user_data );
+        void prepareCancel( int fd, uint64_t user_data );
+
+        [[nodiscard]] unsigned freeSQEs() const;
+        int submit( unsigned wait_count = 0 );
+        unsigned processCompletions( const CompletionCallback_t & callback );
+
+      private:
+        int                     _ring_fd;
+        struct io_uring_params  _params;
+        void *                  _sq_ptr;
+        size_t                  _sq_size;
+        void *                  _cq_ptr;
+        size_t                  _cq_size;
+        struct io_uring_sqe *   _sqes;
+        unsigned *              _sq_head;
+        unsigned *              _sq_tail;
+        unsigned                _sq_mask;
+        unsigned                _sqe_tail; //local tail (published on `submit(..)`)
+        unsigned *              _cq_head;
+        unsigned *              _cq_tail;
+        unsigned                _cq_mask;
+        struct io_uring_cqe *   _cqes;
+
+        struct io_uring_buf_ring * _buf_ring;
+        size_t                     _buf_ring_size;
+        uint16_t                   _buf_group_id;
+        uint16_t                   _buf_count;
+        uint32_t                   _buf_size;
+        uint16_t                   _buf_tail;
+        std::unique_ptr<char[]>    _buffers;
+
+        struct io_uring_sqe * nextSQE();
+    };
+}
+
+#endif //FWD_PROXY_PROXY_IOURING_H
@@ -0,0 +1,99 @@
+#include "Matchmaker.h"
+
+#include <algorithm>
+
+using namespace fwd_proxy::proxy;
+
+/**
+ * Constructor
+ * @param capacity Initial number of file descriptor slots (grows as needed)
+ */
+Matchmaker::Matchmaker( size_t capacity ) :
+    _candidates( capacity ),
+    _queues( capacity )
+{}
+
+/**
+ * Pairs a client with the longest waiting client sharing its secret and protocol
+ * (or queues it to wait for a counterpart when there is none)
+ * @param fd Client file descriptor (not already waiting)
+ * @param secret Handle of the client's secret
+ * @param framed Flag for a client using the framed protocol (only paired with another framed client)
+ * @param compressed Flag for a framed client compressing its payloads (only paired with another such client)
+ * @return Counterpart file descriptor, no longer waiting (-1 when `fd` was queued instead)
+ */
+Matchmaker::FileDescriptor_t Matchmaker::match( FileDescriptor_t fd, Secret_t secret, bool framed, bool compressed ) {
+    const auto index = static_cast<size_t>( secret ) * 3 + ( framed ? ( compressed ? 2 : 1 ) : 0 );
+
+    if( index >= _queues.size() ) {
+        _queues.resize( std::max( index + 1, _queues.size() * 2 ) );
+    }
+
+    auto &     queue        = _queues[ index ];
+    const auto candidate_fd = queue.head;
+
+    if( candidate_fd != -1 ) {
+        remove( candidate_fd );
+        return candidate_fd; //EARLY RETURN
+    }
+
+    _candidates.insert( fd, Candidate_t { static_cast<uint32_t>( index ), queue.tail, -1 } );
+
+    if( queue.tail != -1 ) {
+        _candidates.at( queue.tail ).next = fd;
+    } else {
+        queue.head = fd;
+    }
+
+    queue.tail = fd;
+
+    return -1;
+}
+
+/**
+ * Removes a client from the queue of clients waiting to be paired with the same secret and protocol
+ * @param fd Client file descriptor
+ * @return Removed (false when it was not waiting)
+ */
+bool Matchmaker::remove( FileDescriptor_t fd ) {
+    const auto * candidate = _candidates.find( fd );
+
+    if( candidate == nullptr ) {
+        return false; //EARLY RETURN
+    }
+
+    auto & queue = _queues[ candidate->queue ];
+
+    if( candidate->prev != -1 ) {
+        _candidates.at( candidate->prev ).next = candidate->next;
+    } else {
+        queue.head = candidate->next;
+    }
+
+    if( candidate->next != -1 ) {
+        _candidates.at( candidate->next ).prev = candidate->prev;
+    } else {
+        queue.tail = candidate->prev;
+    }
+
+    _candidates.erase( fd );
+
+    return true;
+}
+
+/**
+ * Checks if a client is waiting for a counterpart
+ * @param fd Client file descriptor
+ * @return Waiting state
+ */
+bool Matchmaker::waiting( FileDescriptor_t fd ) const {
+    return _candidates.contains( fd );
+}
+
+/**
+ * Gets the number of clients waiting for a counterpart
+ * @return Client count
+ */
+size_t Matchmaker::size() const {
+    return _candidates.size();
+}
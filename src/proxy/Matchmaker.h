@@ -0,0 +1,48 @@
+#ifndef FWD_PROXY_PROXY_MATCHMAKER_H
+#define FWD_PROXY_PROXY_MATCHMAKER_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "../container/FdTable.h"
+#include "../container/InternTable.h"
+
+namespace fwd_proxy::proxy {
+    /**
+     * Ready set of the clients waiting for a counterpart
+     * Clients are kept in a FIFO per secret and protocol (intrusive links in a table indexed by file descriptor)
+     * so that a newly ready client is paired with the longest waiting client sharing its secret and protocol
+     * in O(1), and one that leaves is unlinked in O(1) from wherever it is in its queue.
+     */
+    class Matchmaker {
+      public:
+        typedef int                              FileDescriptor_t;
+        typedef container::InternTable::Handle_t Secret_t;
+
+        explicit Matchmaker( size_t capacity = 0 );
+
+        FileDescriptor_t match( FileDescriptor_t fd, Secret_t secret, bool framed = false, bool compressed = false );
+        bool remove( FileDescriptor_t fd );
+
+        [[nodiscard]] bool waiting( FileDescriptor_t fd ) const;
+        [[nodiscard]] size_t size() const;
+
+      private:
+        struct Candidate_t {
+            uint32_t         queue { 0 };  //index in `_queues`
+            FileDescriptor_t prev  { -1 }; //links in the queue of the clients sharing the same secret and protocol
+            FileDescriptor_t next  { -1 };
+        };
+
+        struct Queue_t {
+            FileDescriptor_t head { -1 };
+            FileDescriptor_t tail { -1 };
+        };
+
+        container::FdTable<Candidate_t> _candidates;
+        std::vector<Queue_t>            _queues; //indexed by secret then protocol (grows as needed)
+    };
+}
+
+#endif //FWD_PROXY_PROXY_MATCHMAKER_H
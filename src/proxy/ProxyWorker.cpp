@@ -0,0 +1,1779 @@
+#include "ProxyWorker.h"
+#include "../logger/Logger.h"
+#include "CpuAffinity.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#define EPOLL_PENDING_QUEUE_LENGTH  10 //size is ignored since Linux 2.6.8
+#define EPOLL_ARRAY_SIZE            10
+#define FORWARD_BUDGET         1048576 //max bytes forwarded per read event before yielding to other clients
+#define TRACE_LOGS_PER_SECOND      100 //per thread, per call site
+#define PAIRING_QUEUE_SIZE        1024
+#define RESUME_RETRY_US           1000 //back-off of a hot restart while the hand-over queue is full
+#define PAIRING_TABLE_SIZE        1024 //initial number of file descriptors and records (grows as needed)
+#define URING_QUEUE_DEPTH          256
+#define URING_BUFFER_GROUP           0
+#define URING_BUFFER_COUNT         256 //power of 2
+#define URING_BUFFER_SIZE        16384
+#define TIMER_TICK_MS              100 //idle timeout resolution
+#define COALESCE_MAX_BYTES       16384 //held bytes of a framed pairing written without waiting for the latency budget
+#define MEMBER_READ_SIZE         65536 //bytes read from a group member per event
+#define MEMBER_QUEUE_HIGH       262144 //bytes queued to a group member from which its channel isn't read from until it catches up
+#define MEMBER_QUEUE_MAX       4194304 //bytes queued to a group member above which it is dropped for falling behind
+#define MEMBER_STALL_MS           5000 //time a group member can hold its channel back before it is dropped
+#define MEMBER_WRITEV_MAX           64 //queued messages per `writev` (< IOV_MAX)
+#define PEER_LEFT_NOTICE    "DISCONNECTED" //sent to a raw client when its counterpart leaves
+
+using namespace fwd_proxy::proxy;
+
+/**
+ * Constructor
+ * @param id Worker ID
+ * @param options Server options
+ * @param hand_back Callback (called from the worker's thread) to give back a client whose counterpart left, and the secret
+ *                  reference of each client closed (clients are just closed when not set or when the callback fails)
+ */
+ProxyWorker::ProxyWorker( size_t id, const ServerOptions & options, HandBack_t hand_back ) :
+    _id( id ),
+    _cpu( options.worker_cpus.empty() ? -1 : options.worker_cpus[ id % options.worker_cpus.size() ] ),
+    _options( options ),
+    _hand_back( std::move( hand_back ) ),
+    _run_flag( false ),
+    _pair_count( 0 ),
+    _member_count( 0 ),
+    _epoll_fd( -1 ),
+    _unblock_event_fd( -1 ),
+    _timer_fd( -1 ),
+    _incoming_pairings( PAIRING_QUEUE_SIZE ),
+    _pairings( PAIRING_TABLE_SIZE ),
+    _idle_timers( TIMER_TICK_MS, PAIRING_TABLE_SIZE ),
+    _now( container::TimerWheel::now() ),
+    _wake_time( _now * 1000 ),
+    _incoming_members( PAIRING_QUEUE_SIZE ),
+    _member_buffer( MEMBER_READ_SIZE ),
+    _ready( std::make_shared<const std::string>( FrameCursor::encode( FrameType::READY ) ) ),
+    _disconnected( std::make_shared<const std::string>( FrameCursor::encode( FrameType::DISCONNECTED ) ) ),
+    _wake_count( 0 ),
+    _timer_expirations( 0 )
+{}
+
+/**
+ * Destructor
+ */
+ProxyWorker::~ProxyWorker() {
+    stop();
+
+    PairingRequest_t request {};
+
+    while( _incoming_pairings.tryPop( request ) ) { //never picked up
+        ::close( request.fd1 );
+        ::close( request.fd2 );
+    }
+
+    MemberRequest_t member {};
+
+    while( _incoming_members.tryPop( member ) ) {
+        ::close( member.fd );
+    }
+
+    closeFileDescriptors();
+}
+
+/**
+ * Starts the worker thread
+ * @return Success
+ */
+bool ProxyWorker::start() {
+    if( ( _epoll_fd = ::epoll_create( EPOLL_PENDING_QUEUE_LENGTH ) ) == -1 ) {
+        LOG_ERROR( "[proxy::ProxyWorker::start()] Failed to create epoll file descriptor (worker #" << _id << ")." );
+        closeFileDescriptors();
+        return false; //EARLY RETURN
+    }
+
+    if( ( _unblock_event_fd = ::eventfd( 0, EFD_NONBLOCK ) ) == -1 ) {
+        LOG_ERROR( "[proxy::ProxyWorker::start()] Failed to create 'event unblocking' file descriptor (worker #" << _id << ")." );
+        closeFileDescriptors();
+        return false; //EARLY RETURN
+    }
+
+    if( ( _timer_fd = ProxyWorker::createTickTimer( TIMER_TICK_MS ) ) == -1 ) {
+        closeFileDescriptors();
+        return false; //EARLY RETURN
+    }
+
+    if( !ProxyWorker::modifyEPOLL( _epoll_fd, _unblock_event_fd, EPOLL_CTL_ADD, EPOLLIN ) ||
+        !ProxyWorker::modifyEPOLL( _epoll_fd, _timer_fd, EPOLL_CTL_ADD, EPOLLIN ) )
+    {
+        closeFileDescriptors();
+        return false; //EARLY RETURN
+    }
+
+    if( _options.io_backend == IoBackend::IO_URING ) {
+        _ring = std::make_unique<IoUring>( URING_QUEUE_DEPTH );
+
+        if( !_ring->valid() || !_ring->registerBufferRing( URING_BUFFER_GROUP, URING_BUFFER_COUNT, URING_BUFFER_SIZE ) ) {
+            LOG_WARNING( "[proxy::ProxyWorker::start()] io_uring not available, falling back to epoll (worker #" << _id << ")." );
+            _ring.reset();
+            _options.io_backend = IoBackend::EPOLL;
+        } else {
+            _received_at.resize( URING_BUFFER_COUNT );
+            _received_length.resize( URING_BUFFER_COUNT );
+        }
+    }
+
+    _run_flag  = true;
+
+    if( _options.io_backend == IoBackend::IO_URING ) {
+        _worker_th = std::thread( [this]() { CpuAffinity::pin( _cpu ); this->runUringEventLoop(); } );
+    } else {
+        _worker_th = std::thread( [this]() { CpuAffinity::pin( _cpu ); this->runEventLoop(); } );
+    }
+
+    return true;
+}
+
+/**
+ * Stops the worker thread
+ */
+void ProxyWorker::stop() {
+    if( _run_flag ) {
+        _run_flag = false;
+        ProxyWorker::signalEvent( _unblock_event_fd );
+        _worker_th.join();
+    }
+}
+
+/**
+ * Hands over a client pairing to the worker (lock-free, callable from any thread)
+ * @param fd1 Client file descriptor
+ * @param fd2 Counterpart client file descriptor
+ * @param secret Handle of the secret the clients were matched on (1 reference per client, given back with each)
+ * @param framed Flag for clients using the framed protocol
+ * @param compressed Flag for framed clients compressing their payloads
+ * @return Success (false when the worker's hand-over queue is full)
+ */
+bool ProxyWorker::addPairing( FileDescriptor_t fd1, FileDescriptor_t fd2, Secret_t secret, bool framed, bool compressed ) {
+    if( !_incoming_pairings.tryPush( PairingRequest_t { fd1, fd2, secret, framed, compressed } ) ) {
+        return false; //EARLY RETURN
+    }
+
+    ++_pair_count;
+    ProxyWorker::signalEvent( _unblock_event_fd );
+
+    return true;
+}
+
+/**
+ * Hands over a client pairing taken over from the previous process along with the bytes it had in flight
+ * (callable from any thread - epoll only). Waits for the worker to make room when its hand-over queue is full
+ * since a snapshot can hold many more pairings than the queue.
+ * @param pairing Pairing handed over (`fds[0]` -> `fds[1]` direction first)
+ * @param secret Handle of the secret the clients were matched on (1 reference per client)
+ * @return Success (false when the worker isn't running)
+ */
+bool ProxyWorker::resumePairing( Handoff::Pairing_t pairing, Secret_t secret ) {
+    const auto fd1        = pairing.fds[0];
+    const auto fd2        = pairing.fds[1];
+    const bool framed     = pairing.framed;
+    const bool compressed = pairing.compressed;
+
+    auto request = PairingRequest_t { fd1, fd2, secret, framed, compressed, std::make_unique<Handoff::Pairing_t>( std::move( pairing ) ) };
+
+    while( !_incoming_pairings.tryPush( std::move( request ) ) ) { //left untouched when full
+        if( !_run_flag ) {
+            return false; //EARLY RETURN
+        }
+
+        ProxyWorker::signalEvent( _unblock_event_fd ); //drains the queue
+        std::this_thread::sleep_for( std::chrono::microseconds( RESUME_RETRY_US ) );
+    }
+
+    ++_pair_count;
+    ProxyWorker::signalEvent( _unblock_event_fd );
+
+    return true;
+}
+
+/**
+ * Exports the worker's pairings with the bytes they have in flight (i.e. for a hot restart)
+ * Called once the worker is stopped: the clients are left open for the next process to pick up.
+ * @param export_fn Callback taking each pairing (once per pairing)
+ * @return Number of pairings exported
+ */
+size_t ProxyWorker::exportPairings( const Export_t & export_fn ) {
+    if( _run_flag ) {
+        return 0; //EARLY RETURN
+    }
+
+    PairingRequest_t request {};
+    size_t           count   = 0;
+
+    _pairings.forEach( [&]( FileDescriptor_t fd, Pairing_t & client ) {
+        if( client.member || fd > client.counterpart_fd ) {
+            return; //EARLY RETURN (group member, or exported along with its counterpart)
+        }
+
+        auto &       counterpart = _pairings.at( client.counterpart_fd );
+        auto         pairing     = Handoff::Pairing_t();
+        const auto & leaving     = ( client.notice.empty() ? counterpart : client );
+
+        if( !leaving.notice.empty() && leaving.notice != ( leaving.forwarder.framed() ? *_disconnected : std::string( PEER_LEFT_NOTICE ) ) ) {
+            LOG_WARNING( "[proxy::ProxyWorker::exportPairings(..)] "
+                         << "Dropped client " << leaving.counterpart_fd << " (caught in the middle of its `DISCONNECTED` notice)" );
+            return; //EARLY RETURN (else: the next process sees the disconnection again)
+        }
+
+        pairing.fds[0]     = fd;
+        pairing.fds[1]     = client.counterpart_fd;
+        pairing.framed     = client.forwarder.framed();
+        pairing.compressed = client.compressed;
+        pairing.pending[0] = client.forwarder.extract();
+        pairing.pending[1] = counterpart.forwarder.extract();
+        pairing.frames[0]  = client.forwarder.frames();
+        pairing.frames[1]  = counterpart.forwarder.frames();
+
+        export_fn( pairing, client.secret );
+        ++count;
+    } );
+
+    while( _incoming_pairings.tryPop( request ) ) { //never picked up
+        auto pairing = ( request.resumed ? std::move( *request.resumed ) : Handoff::Pairing_t() );
+
+        pairing.fds[0]     = request.fd1;
+        pairing.fds[1]     = request.fd2;
+        pairing.framed     = request.framed;
+        pairing.compressed = request.compressed;
+
+        export_fn( pairing, request.secret );
+        ++count;
+    }
+
+    _pair_count = 0;
+
+    return count;
+}
+
+/**
+ * Hands over a client joining the group channel of its secret (lock-free, callable from any thread - epoll only)
+ * @param fd Client file descriptor (framed protocol, handshake done)
+ * @param secret Handle of the client's secret, naming the channel (the client's reference, given back with it)
+ * @return Success (false when the worker's hand-over queue is full)
+ */
+bool ProxyWorker::addMember( FileDescriptor_t fd, Secret_t secret ) {
+    if( !_incoming_members.tryPush( MemberRequest_t { fd, secret } ) ) {
+        return false; //EARLY RETURN
+    }
+
+    ++_member_count;
+    ProxyWorker::signalEvent( _unblock_event_fd );
+
+    return true;
+}
+
+/**
+ * Exports the worker's group members (i.e. for a hot restart) so that they join their channel again in the next process
+ * Called once the worker is stopped. Messages not yet started are dropped; the rest of a frame being written to a
+ * member is sent first, and members that can't take it or are in the middle of sending a frame are closed instead.
+ * @param export_fn Callback taking each member
+ * @return Number of members exported
+ */
+size_t ProxyWorker::exportMembers( const ExportMember_t & export_fn ) {
+    if( _run_flag ) {
+        return 0; //EARLY RETURN
+    }
+
+    size_t count = 0;
+
+    _pairings.forEach( [&]( FileDescriptor_t fd, Pairing_t & client ) {
+        if( !client.member ) {
+            return; //EARLY RETURN
+        }
+
+        auto & member    = *client.member;
+        bool   resumable = member.inbound.empty();
+
+        if( resumable && member.outbound_offset > 0 ) {
+            const auto & message = *member.outbound.front();
+            size_t       end     = 0;
+            auto         type    = FrameType::DATA;
+            uint32_t     length  = 0;
+
+            while( end < member.outbound_offset && FrameCursor::decodeHeader( message.data() + end, type, length ) ) {
+                end += FrameCursor::HEADER_SIZE + length;
+            }
+
+            const auto rest = end - member.outbound_offset;
+
+            resumable = ( ::send( fd, message.data() + member.outbound_offset, rest, MSG_DONTWAIT | MSG_NOSIGNAL ) == static_cast<ssize_t>( rest ) );
+        }
+
+        if( !resumable ) {
+            LOG_WARNING( "[proxy::ProxyWorker::exportMembers(..)] "
+                         << "Closed group member " << fd << " (in the middle of a frame)" );
+
+            ::close( fd );
+            return; //EARLY RETURN
+        }
+
+        auto pending = Handoff::Pending_t { fd };
+
+        export_fn( pending, client.secret );
+        ++count;
+    } );
+
+    MemberRequest_t request {};
+
+    while( _incoming_members.tryPop( request ) ) { //never picked up
+        auto pending = Handoff::Pending_t { request.fd };
+
+        export_fn( pending, request.secret );
+        ++count;
+    }
+
+    _member_count = 0;
+
+    return count;
+}
+
+/**
+ * Gets the worker's ID
+ * @return ID
+ */
+size_t ProxyWorker::id() const {
+    return _id;
+}
+
+/**
+ * Gets the CPU the worker's thread is pinned to
+ * @return CPU (-1 when unpinned)
+ */
+int ProxyWorker::cpu() const {
+    return _cpu;
+}
+
+/**
+ * Gets the worker's current load
+ * @return Number of client pairings and group members handled (a member fanning out weighs as much as a pairing)
+ */
+size_t ProxyWorker::load() const {
+    return _pair_count + _member_count;
+}
+
+/**
+ * Gets the number of client pairings handled
+ * @return Pairing count
+ */
+size_t ProxyWorker::pairs() const {
+    return _pair_count;
+}
+
+/**
+ * Gets the worker's metrics (readable from any thread)
+ * @return Metrics
+ */
+const fwd_proxy::metrics::WorkerMetrics & ProxyWorker::metrics() const {
+    return _metrics;
+}
+
+/**
+ * [PRIVATE] Runs the proxy event loop (message forwarding)
+ */
+void ProxyWorker::runEventLoop() {
+    while( _run_flag ) {
+        struct epoll_event event_buff[EPOLL_ARRAY_SIZE];
+
+        int event_count = waitForEvents( event_buff, EPOLL_ARRAY_SIZE );
+
+        _wake_time = metrics::Histogram::now();
+        _now       = _wake_time / 1000;
+
+        for( int i = 0; i < event_count; ++i ) {
+            if( event_buff[i].data.fd == _unblock_event_fd ) {
+                acceptPairings();
+                continue;
+            }
+
+            if( event_buff[i].data.fd == _timer_fd ) {
+                if( ::read( _timer_fd, &_timer_expirations, sizeof( _timer_expirations ) ) == -1 && errno != EAGAIN ) {
+                    LOG_ERROR( "[proxy::ProxyWorker::runEventLoop()] error: " << ::strerror( errno ) );
+                }
+
+                expireIdlePairings();
+                expireStalledMembers();
+                retryReleases();
+                continue;
+            }
+
+            const FileDescriptor_t client_fd  = static_cast<FileDescriptor_t>( event_buff[i].data.u64 & 0xFFFFFFFF );
+            const uint32_t         generation = static_cast<uint32_t>( event_buff[i].data.u64 >> 32 );
+            auto *                 client_ptr = _pairings.find( { client_fd, generation } );
+
+            if( client_ptr == nullptr ) {
+                continue; //i.e.: counterpart closed earlier in the same batch of events (and maybe the fd re-used since)
+            }
+
+            if( client_ptr->member ) {
+                onMemberEvent( client_fd, *client_ptr, event_buff[i].events );
+                continue;
+            }
+
+            auto &     client      = *client_ptr;
+            auto &     counterpart = _pairings.at( client.counterpart_fd ); //always added/removed together
+            const auto events      = event_buff[i].events;
+
+            if( !client.notice.empty() || !counterpart.notice.empty() ) { //closing, the counterpart of the client that left being told
+                if( !counterpart.notice.empty() ) {
+                    closePairing( ( events & ( EPOLLHUP | EPOLLERR ) ? client_fd : client.counterpart_fd ), true );
+                } //else: stale event of the client that left
+
+                continue;
+            }
+
+            if( ( events & EPOLLOUT ) && !flush( counterpart, client_fd ) ) { //`counterpart -> client` direction
+                closePairing( client_fd, true );
+                continue;
+            }
+
+            if( counterpart.eof && counterpart.forwarder.pending() == 0 ) { //all the disconnected counterpart sent is through
+                closePairing( client.counterpart_fd, true );
+                continue;
+            }
+
+            if( ( events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) ) ) { //`client -> counterpart` direction
+                const auto hold   = ( client.forwarder.framed() && _options.coalesce_us > 0 ? COALESCE_MAX_BYTES : 0 );
+                const auto result = client.forwarder.forward( client_fd, client.counterpart_fd, FORWARD_BUDGET, hold ); //level-triggered so any rest is picked up next round
+                const auto total  = result.bytes;
+
+                _metrics.write_eagain.add( result.write_eagain );
+
+                if( total > 0 ) {
+                    client.last_active  = _now;
+                    client.bytes       += total;
+
+                    _metrics.bytes.add( total );
+                    _metrics.messages.add( result.reads );
+                    _metrics.forward_latency.record( metrics::Histogram::now() - _wake_time );
+
+                    LOG_PER_SECOND( LogLevel::TRACE, TRACE_LOGS_PER_SECOND,
+                                    "[proxy::ProxyWorker::runEventLoop()] "
+                                    << "#" << _id << " " << client_fd << " -> " << client.counterpart_fd << ": " << total << " bytes" );
+                }
+
+                if( result.malformed ) {
+                    LOG_WARNING( "[proxy::ProxyWorker::runEventLoop()] "
+                                 << "Client " << client_fd << " sent a malformed frame" );
+
+                    _metrics.malformed_frames.add();
+                    client.forwarder.discard();
+                    closePairing( client_fd, true );
+                    continue;
+
+                } else if( result.last_read == 0 && client.forwarder.pending() > 0 ) { //counterpart is behind: flush before closing
+                    LOG_INFO( "[proxy::ProxyWorker::runEventLoop()] "
+                              << "Client " << client_fd << " disconnected (" << client.forwarder.pending() << " bytes left to forward)" );
+
+                    client.eof = true;
+
+                } else if( result.last_read == 0 ) {
+                    LOG_INFO( "[proxy::ProxyWorker::runEventLoop()] "
+                              << "Client " << client_fd << " disconnected" );
+
+                    closePairing( client_fd, true );
+                    continue;
+
+                } else if( result.last_read < 0 && result.read_errno != EAGAIN && result.read_errno != EWOULDBLOCK ) {
+                    LOG_ERROR( "[proxy::ProxyWorker::runEventLoop()] error: " << ::strerror( result.read_errno ) );
+                    _metrics.errors.add();
+                    closePairing( client_fd, true );
+                    continue;
+
+                } else if( result.last_read < 0 ) { //drained (or back-pressure)
+                    _metrics.read_eagain.add();
+                }
+
+                if( result.write_errno != 0 ) {
+                    LOG_ERROR( "[proxy::ProxyWorker::runEventLoop()] error: " << ::strerror( result.write_errno ) );
+                    _metrics.errors.add();
+                    closePairing( client.counterpart_fd, true );
+                    continue;
+                }
+
+                if( hold > 0 ) {
+                    holdBack( client_fd, client );
+                }
+            }
+
+            updateEvents( client_fd, client, counterpart );
+            updateEvents( client.counterpart_fd, counterpart, client );
+        }
+
+        flushCoalesced();
+    }
+
+    LOG_DEBUG( "Exiting ProxyWorker::runEventLoop() #" << _id );
+}
+
+/**
+ * [PRIVATE] Runs the proxy event loop (message forwarding) via io_uring
+ * (multishot receives into provided buffers which are then sent as linked chains per direction)
+ */
+void ProxyWorker::runUringEventLoop() {
+    auto & ring = *_ring;
+
+    ring.prepareRead( _unblock_event_fd, &_wake_count, sizeof( _wake_count ), uringUserData( UringOp::WAKE, _unblock_event_fd ) );
+    ring.prepareRead( _timer_fd, &_timer_expirations, sizeof( _timer_expirations ), uringUserData( UringOp::TIMER, _timer_fd ) );
+
+    while( _run_flag ) {
+        if( ring.submit( 1 ) < 0 ) {
+            LOG_ERROR( "[proxy::ProxyWorker::runUringEventLoop()] error: " << ::strerror( errno ) );
+            continue;
+        }
+
+        _wake_time = metrics::Histogram::now();
+        _now       = _wake_time / 1000;
+
+        ring.processCompletions( [this]( const struct io_uring_cqe & cqe ) {
+            const auto op        = static_cast<UringOp>( cqe.user_data >> 56 );
+            const auto buffer_id = static_cast<uint16_t>( ( cqe.user_data >> 32 ) & 0xFFFF );
+            const auto fd        = static_cast<FileDescriptor_t>( cqe.user_data & 0xFFFFFFFF );
+
+            switch( op ) {
+                case UringOp::WAKE: {
+                    if( _run_flag ) {
+                        acceptUringPairings();
+                        _ring->prepareRead( _unblock_event_fd, &_wake_count, sizeof( _wake_count ), uringUserData( UringOp::WAKE, _unblock_event_fd ) );
+                    }
+                } break;
+
+                case UringOp::TIMER: {
+                    if( _run_flag ) {
+                        expireIdlePairings();
+                        retryReleases();
+                        _ring->prepareRead( _timer_fd, &_timer_expirations, sizeof( _timer_expirations ), uringUserData( UringOp::TIMER, _timer_fd ) );
+                    }
+                } break;
+
+                case UringOp::RECV  : { onUringRecv( fd, cqe );            } break;
+                case UringOp::SEND  : { onUringSend( fd, buffer_id, cqe ); } break;
+                case UringOp::NOTICE: { onUringNotice( fd, cqe );          } break;
+                default             : {                                    } break;
+            }
+        } );
+    }
+
+    LOG_DEBUG( "Exiting ProxyWorker::runUringEventLoop() #" << _id );
+}
+
+/**
+ * [PRIVATE] Writes as much as possible of a client's outgoing pipe/buffer to its counterpart
+ * @param src Client pairing
+ * @param dst_fd Counterpart client file descriptor
+ * @return Success (false when the destination errored)
+ */
+bool ProxyWorker::flush( Pairing_t & src, FileDescriptor_t dst_fd ) {
+    if( src.forwarder.flush( dst_fd ) != -1 ) {
+        return true; //EARLY RETURN
+    }
+
+    if( errno != EAGAIN && errno != EWOULDBLOCK ) {
+        LOG_ERROR( "[proxy::ProxyWorker::flush(..)] error: " << ::strerror( errno ) );
+        _metrics.errors.add();
+        return false; //EARLY RETURN
+    }
+
+    _metrics.write_eagain.add();
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Holds what a framed client sent back for the coalescing latency budget so that small frames go out in
+ * fewer writes (bytes go as soon as `COALESCE_MAX_BYTES` are held or the client disconnects)
+ * @param fd Client file descriptor
+ * @param client Client pairing
+ */
+void ProxyWorker::holdBack( FileDescriptor_t fd, Pairing_t & client ) {
+    const auto pending = client.forwarder.pending();
+
+    if( pending == 0 || pending >= COALESCE_MAX_BYTES || client.forwarder.saturated() || client.eof ) {
+        client.flush_at = 0; //nothing held back, or the counterpart has to catch up first (`EPOLLOUT`)
+
+    } else if( client.flush_at == 0 ) {
+        client.flush_at = _wake_time + _options.coalesce_us;
+        _coalesced.push_back( Coalesced_t { _pairings.handle( fd ), client.flush_at } );
+    }
+}
+
+/**
+ * [PRIVATE] Writes the bytes held back by framed clients whose latency budget ran out
+ * (deadlines are queued in order as the budget is the same for every pairing)
+ */
+void ProxyWorker::flushCoalesced() {
+    const auto now = metrics::Histogram::now();
+
+    while( !_coalesced.empty() && _coalesced.front().flush_at <= now ) {
+        const auto entry  = _coalesced.front();
+        auto *     client = _pairings.find( entry.handle );
+
+        _coalesced.pop_front();
+
+        if( client == nullptr || client->flush_at != entry.flush_at ) {
+            continue; //pairing closed, or its held bytes went out already
+        }
+
+        const auto counterpart_fd = client->counterpart_fd;
+
+        client->flush_at = 0;
+        _metrics.coalesced_flushes.add();
+
+        if( !flush( *client, counterpart_fd ) ) {
+            closePairing( counterpart_fd, true );
+            continue;
+        }
+
+        updateEvents( counterpart_fd, _pairings.at( counterpart_fd ), *client ); //`EPOLLOUT` for any rest
+    }
+}
+
+/**
+ * [PRIVATE] Waits for epoll events, up to the earliest deadline of the bytes held back by framed clients
+ * @param events Event buffer
+ * @param max_events Size of the event buffer
+ * @return Number of events (-1 on error with `errno` set)
+ */
+int ProxyWorker::waitForEvents( struct epoll_event * events, int max_events ) {
+    if( _coalesced.empty() ) {
+        return ::epoll_wait( _epoll_fd, events, max_events, -1 ); //EARLY RETURN
+    }
+
+    const auto      now     = metrics::Histogram::now();
+    const auto      wait_us = ( _coalesced.front().flush_at > now ? _coalesced.front().flush_at - now : 0 );
+    struct timespec timeout { static_cast<time_t>( wait_us / 1000000 ), static_cast<long>( ( wait_us % 1000000 ) * 1000 ) };
+
+    const int count = ::epoll_pwait2( _epoll_fd, events, max_events, &timeout, nullptr );
+
+    if( count == -1 && errno == ENOSYS ) { //before Linux 5.11: ms resolution
+        return ::epoll_wait( _epoll_fd, events, max_events, static_cast<int>( ( wait_us + 999 ) / 1000 ) ); //EARLY RETURN
+    }
+
+    return count;
+}
+
+/**
+ * [PRIVATE] Updates the epoll events registered for a client based on its pairing's buffers
+ * @param fd Client file descriptor
+ * @param client Client pairing (`fd -> counterpart` direction)
+ * @param counterpart Counterpart pairing (`counterpart -> fd` direction)
+ */
+void ProxyWorker::updateEvents( FileDescriptor_t fd, Pairing_t & client, const Pairing_t & counterpart ) {
+    uint32_t events = 0;
+
+    if( !client.forwarder.saturated() && !client.eof ) {
+        events |= EPOLLIN; //else: back-pressure until the counterpart catches up
+    }
+
+    if( counterpart.forwarder.pending() > 0 && counterpart.flush_at == 0 ) {
+        events |= EPOLLOUT; //else: held back until its deadline
+    }
+
+    if( events != client.events && ProxyWorker::modifyEPOLL( _epoll_fd, fd, EPOLL_CTL_MOD, events, _pairings.handle( fd ).generation ) ) {
+        client.events = events;
+    }
+}
+
+/**
+ * [PRIVATE] Tears down a pairing after one of its clients disconnected
+ * When the counterpart is to be handed back it is first sent what is left for it and `DISCONNECTED` (see `notifyOrphan(..)`).
+ * @param dcn_fd Disconnected client file descriptor
+ * @param orphan Flag to hand the counterpart back to the server so it can be paired again (closed otherwise)
+ */
+void ProxyWorker::closePairing( FileDescriptor_t dcn_fd, bool orphan ) {
+    auto * client = _pairings.find( dcn_fd );
+
+    if( client == nullptr ) {
+        return; //EARLY RETURN
+    }
+
+    const FileDescriptor_t counterpart_fd = client->counterpart_fd;
+    auto &                 counterpart    = _pairings.at( counterpart_fd );
+
+    if( !client->notice.empty() ) { //counterpart being told already
+        if( orphan ) {
+            notifyOrphan( dcn_fd, *client );
+        } else {
+            releasePairing( dcn_fd, false );
+        }
+
+        return; //EARLY RETURN
+    }
+
+    if( !counterpart.notice.empty() ) { //client being told failed meanwhile
+        releasePairing( counterpart_fd, false );
+        return; //EARLY RETURN
+    }
+
+    flush( *client, counterpart_fd ); //best effort for what is left
+
+    _metrics.pairs_closed.add();
+    _metrics.pair_bytes.record( client->bytes + counterpart.bytes );
+
+    const bool resumable = client->forwarder.atFrameBoundary() && counterpart.forwarder.atFrameBoundary(); //neither way cut mid-frame (always for raw)
+
+    if( !orphan || !resumable || _options.orphan_grace_ms == 0 || !ProxyWorker::modifyEPOLL( _epoll_fd, dcn_fd, EPOLL_CTL_DEL, 0 ) ) {
+        releasePairing( dcn_fd, false );
+        return; //EARLY RETURN
+    }
+
+    client->notice   = ( client->forwarder.framed() ? *_disconnected : std::string( PEER_LEFT_NOTICE ) );
+    client->eof      = true;
+    client->events   = 0;
+    client->flush_at = 0; //anything held back goes now
+
+    notifyOrphan( dcn_fd, *client );
+}
+
+/**
+ * [PRIVATE] Writes what is left for the counterpart of a client that disconnected, then its `DISCONNECTED` notice,
+ * and hands it back once all of it went out (it is only polled for `EPOLLOUT` meanwhile so that whatever it sends
+ * is left in its socket for the server)
+ * @param dcn_fd Disconnected client file descriptor (out of epoll, still open so that its slot isn't re-used)
+ * @param client Disconnected client pairing (`notice` set)
+ */
+void ProxyWorker::notifyOrphan( FileDescriptor_t dcn_fd, Pairing_t & client ) {
+    const FileDescriptor_t orphan_fd = client.counterpart_fd;
+    auto &                 orphan    = _pairings.at( orphan_fd );
+
+    if( !flush( client, orphan_fd ) ) {
+        releasePairing( dcn_fd, false );
+        return; //EARLY RETURN
+    }
+
+    if( client.forwarder.pending() == 0 ) {
+        const auto sent = ::send( orphan_fd, client.notice.data(), client.notice.size(), MSG_DONTWAIT | MSG_NOSIGNAL );
+
+        if( sent == -1 && errno != EAGAIN && errno != EWOULDBLOCK ) {
+            LOG_ERROR( "[proxy::ProxyWorker::notifyOrphan(..)] error: " << ::strerror( errno ) );
+            _metrics.errors.add();
+            releasePairing( dcn_fd, false );
+            return; //EARLY RETURN
+        }
+
+        if( sent > 0 ) {
+            client.notice.erase( 0, static_cast<size_t>( sent ) );
+        }
+
+        if( client.notice.empty() ) {
+            releasePairing( dcn_fd, true );
+            return; //EARLY RETURN
+        }
+    }
+
+    if( orphan.events != EPOLLOUT && ProxyWorker::modifyEPOLL( _epoll_fd, orphan_fd, EPOLL_CTL_MOD, EPOLLOUT, _pairings.handle( orphan_fd ).generation ) ) {
+        orphan.events = EPOLLOUT;
+    }
+}
+
+/**
+ * [PRIVATE] Forgets a pairing after one of its clients disconnected, closing that client
+ * @param dcn_fd Disconnected client file descriptor
+ * @param requeue Flag to hand the counterpart back to the server (closed otherwise)
+ */
+void ProxyWorker::releasePairing( FileDescriptor_t dcn_fd, bool requeue ) {
+    const auto &           client         = _pairings.at( dcn_fd );
+    const FileDescriptor_t counterpart_fd = client.counterpart_fd;
+    const Secret_t         secret         = client.secret;
+    const bool             framed         = client.forwarder.framed();
+    const bool             compressed     = client.compressed;
+
+    requeue = requeue && ProxyWorker::modifyEPOLL( _epoll_fd, counterpart_fd, EPOLL_CTL_DEL, 0 );
+
+    _idle_timers.cancel( dcn_fd );
+    _idle_timers.cancel( counterpart_fd );
+    _pairings.erase( dcn_fd );
+    _pairings.erase( counterpart_fd );
+
+    --_pair_count;
+    closeClient( dcn_fd, secret );
+
+    if( requeue ) {
+        handBack( counterpart_fd, secret, framed, compressed );
+
+        LOG_INFO( "[proxy::ProxyWorker::releasePairing(..)] "
+                  << "Re-queued client " << counterpart_fd );
+
+    } else {
+        closeClient( counterpart_fd, secret );
+
+        LOG_INFO( "[proxy::ProxyWorker::releasePairing(..)] "
+                  << "Disconnected client " << counterpart_fd );
+    }
+}
+
+/**
+ * [PRIVATE] Closes the pairings that went without traffic for longer than the idle timeout
+ * (activity only stamps the pairing so the timer is pushed back lazily when it fires)
+ */
+void ProxyWorker::expireIdlePairings() {
+    _now = container::TimerWheel::now();
+
+    _idle_timers.advance( _now, [this]( container::TimerWheel::TimerId_t id ) {
+        const auto   fd     = static_cast<FileDescriptor_t>( id );
+        const auto * client = _pairings.find( fd );
+
+        if( client == nullptr || client->uring.closing ) {
+            return; //EARLY RETURN
+        }
+
+        const auto last_active = std::max( client->last_active, _pairings.at( client->counterpart_fd ).last_active );
+
+        if( _now < last_active + _options.idle_timeout_ms ) {
+            scheduleIdleTimeout( fd, last_active );
+            return; //EARLY RETURN
+        }
+
+        LOG_INFO( "[proxy::ProxyWorker::expireIdlePairings()] "
+                  << "Pairing " << fd << " <-> " << client->counterpart_fd << " idle timeout (worker #" << _id << ")" );
+
+        _metrics.idle_timeouts.add();
+
+        if( _options.io_backend == IoBackend::IO_URING ) {
+            closeUringPairing( fd, false, false );
+            finalizeUringPairing( fd );
+        } else {
+            closePairing( fd, false );
+        }
+    } );
+}
+
+/**
+ * [PRIVATE] Sets the idle deadline of a pairing
+ * @param fd Client file descriptor (either side of the pairing)
+ * @param last_active Last time there was traffic on the pairing (ms)
+ */
+void ProxyWorker::scheduleIdleTimeout( FileDescriptor_t fd, uint64_t last_active ) {
+    if( _options.idle_timeout_ms > 0 ) {
+        _idle_timers.schedule( fd, last_active + _options.idle_timeout_ms );
+    }
+}
+
+/**
+ * [PRIVATE] Moves the pairings queued by `addPairing(..)` into the worker's pairing table (and the members queued by `addMember(..)`)
+ */
+void ProxyWorker::acceptPairings() {
+    uint64_t count = 0;
+
+    if( ::read( _unblock_event_fd, &count, sizeof( uint64_t ) ) == -1 && errno != EAGAIN ) { //reset before draining so no signal is missed
+        LOG_ERROR( "[proxy::ProxyWorker::acceptPairings()] error: " << ::strerror( errno ) );
+    }
+
+    PairingRequest_t request {};
+
+    _now = container::TimerWheel::now();
+
+    while( _incoming_pairings.tryPop( request ) ) {
+        for( const auto & [ fd, counterpart_fd ] : { std::pair( request.fd1, request.fd2 ), std::pair( request.fd2, request.fd1 ) } ) {
+            auto & client = _pairings.insert( fd, Pairing_t { counterpart_fd, Forwarder( _options.forwarding_mode, request.framed ), EPOLLIN, _now } );
+
+            client.secret     = request.secret;
+            client.compressed = request.compressed;
+        }
+
+        if( !ProxyWorker::modifyEPOLL( _epoll_fd, request.fd1, EPOLL_CTL_ADD, EPOLLIN, _pairings.handle( request.fd1 ).generation ) ||
+            !ProxyWorker::modifyEPOLL( _epoll_fd, request.fd2, EPOLL_CTL_ADD, EPOLLIN, _pairings.handle( request.fd2 ).generation ) )
+        {
+            LOG_ERROR( "[proxy::ProxyWorker::acceptPairings()] "
+                       << "Failed to add pairing " << request.fd1 << " <-> " << request.fd2 << " (worker #" << _id << ")" );
+
+            _pairings.erase( request.fd1 );
+            _pairings.erase( request.fd2 );
+            closeClient( request.fd1, request.secret );
+            closeClient( request.fd2, request.secret );
+            --_pair_count;
+            continue;
+        }
+
+        if( request.resumed ) {
+            auto & client      = _pairings.at( request.fd1 );
+            auto & counterpart = _pairings.at( request.fd2 );
+
+            if( !client.forwarder.preload( request.resumed->pending[0], request.resumed->frames[0] ) ||
+                !counterpart.forwarder.preload( request.resumed->pending[1], request.resumed->frames[1] ) )
+            {
+                LOG_ERROR( "[proxy::ProxyWorker::acceptPairings()] "
+                           << "Failed to restore the bytes in flight of pairing " << request.fd1 << " <-> " << request.fd2 << " (worker #" << _id << ")" );
+
+                closePairing( request.fd1, false );
+                continue;
+            }
+
+            updateEvents( request.fd1, client, counterpart ); //`EPOLLOUT` for the bytes in flight
+            updateEvents( request.fd2, counterpart, client );
+        }
+
+        _metrics.pairs_opened.add();
+        scheduleIdleTimeout( request.fd1, _now );
+    }
+
+    acceptMembers();
+}
+
+/**
+ * [PRIVATE] Moves the pairings queued by `addPairing(..)` into the worker's pairing table and starts receiving (io_uring)
+ */
+void ProxyWorker::acceptUringPairings() {
+    PairingRequest_t request {};
+
+    while( _incoming_pairings.tryPop( request ) ) {
+        for( const auto & [ fd, counterpart_fd ] : { std::pair( request.fd1, request.fd2 ), std::pair( request.fd2, request.fd1 ) } ) {
+            auto & pairing = _pairings.insert( fd, Pairing_t { counterpart_fd } ); //buffers come from the provided buffer ring instead
+
+            if( request.framed ) {
+                pairing.forwarder = Forwarder( ForwardingMode::COPY, true ); //frame tracking only (its buffer is never allocated)
+            }
+
+            pairing.last_active      = _now;
+            pairing.secret           = request.secret;
+            pairing.compressed       = request.compressed;
+            pairing.uring.recv_armed = true;
+            _ring->prepareRecvMultishot( fd, uringUserData( UringOp::RECV, fd ) );
+        }
+
+        _metrics.pairs_opened.add();
+        scheduleIdleTimeout( request.fd1, _now );
+    }
+}
+
+/**
+ * [PRIVATE] Handles a receive completion (io_uring)
+ * @param fd Client file descriptor
+ * @param cqe Completion
+ */
+void ProxyWorker::onUringRecv( FileDescriptor_t fd, const struct io_uring_cqe & cqe ) {
+    auto * client_ptr = _pairings.find( fd );
+
+    if( client_ptr == nullptr ) {
+        if( cqe.flags & IORING_CQE_F_BUFFER ) {
+            _ring->returnBuffer( cqe.flags >> IORING_CQE_BUFFER_SHIFT );
+        }
+
+        return; //EARLY RETURN
+    }
+
+    auto & client = *client_ptr;
+
+    if( !( cqe.flags & IORING_CQE_F_MORE ) ) {
+        client.uring.recv_armed = false;
+    }
+
+    if( cqe.res > 0 ) {
+        const auto buffer_id = static_cast<uint16_t>( cqe.flags >> IORING_CQE_BUFFER_SHIFT );
+
+        if( client.uring.closing || client.uring.eof ) {
+            _ring->returnBuffer( buffer_id );
+
+        } else if( !client.forwarder.track( _ring->buffer( buffer_id ), static_cast<size_t>( cqe.res ) ) ) {
+            LOG_WARNING( "[proxy::ProxyWorker::onUringRecv(..)] "
+                         << "Client " << fd << " sent a malformed frame" );
+
+            _ring->returnBuffer( buffer_id );
+            _metrics.malformed_frames.add();
+            closeUringPairing( fd, false, true );
+
+        } else {
+            LOG_PER_SECOND( LogLevel::TRACE, TRACE_LOGS_PER_SECOND,
+                            "[proxy::ProxyWorker::onUringRecv(..)] "
+                            << "#" << _id << " " << fd << " -> " << client.counterpart_fd << ": " << cqe.res << " bytes" );
+
+            client.last_active          = _now;
+            client.bytes               += cqe.res;
+            _received_at[buffer_id]     = _wake_time;
+            _received_length[buffer_id] = static_cast<uint32_t>( cqe.res );
+            _metrics.bytes.add( cqe.res );
+            _metrics.messages.add();
+
+            client.uring.queued.push_back( UringChunk_t { buffer_id, static_cast<uint32_t>( cqe.res ) } );
+            flushUring( fd, client );
+        }
+
+    } else if( cqe.res == 0 ) {
+        if( !client.uring.closing ) {
+            LOG_INFO( "[proxy::ProxyWorker::onUringRecv(..)] "
+                      << "Client " << fd << " disconnected" );
+
+            closeUringPairing( fd, true, true );
+        }
+
+    } else if( cqe.res == -ENOBUFS ) { //resumes once buffers are given back
+        client.uring.recv_stalled = true;
+        _stalled_fds.emplace_back( fd );
+        _metrics.buffer_stalls.add();
+
+    } else if( cqe.res != -ECANCELED && !client.uring.closing ) {
+        LOG_ERROR( "[proxy::ProxyWorker::onUringRecv(..)] error: " << ::strerror( -cqe.res ) );
+        _metrics.errors.add();
+        closeUringPairing( fd, false, true );
+    }
+
+    if( !client.uring.recv_armed && !client.uring.recv_stalled && !client.uring.closing && !client.uring.eof ) { //multishot ended early
+        client.uring.recv_armed = true;
+        _ring->prepareRecvMultishot( fd, uringUserData( UringOp::RECV, fd ) );
+    }
+
+    finalizeUringPairing( fd );
+}
+
+/**
+ * [PRIVATE] Handles a send completion (io_uring)
+ * @param src_fd File descriptor of the client the bytes were received from
+ * @param buffer_id Provided buffer that was sent
+ * @param cqe Completion
+ */
+void ProxyWorker::onUringSend( FileDescriptor_t src_fd, uint16_t buffer_id, const struct io_uring_cqe & cqe ) {
+    _ring->returnBuffer( buffer_id );
+    rearmStalledUring();
+
+    auto * src_ptr = _pairings.find( src_fd );
+
+    if( src_ptr == nullptr ) {
+        return; //EARLY RETURN
+    }
+
+    auto & src = *src_ptr;
+
+    --src.uring.sends_in_flight;
+
+    if( cqe.res < 0 || static_cast<uint32_t>( cqe.res ) != _received_length[buffer_id] ) { //short count: the rest of the chain is cut
+        if( !src.uring.closing ) {
+            if( cqe.res < 0 ) {
+                LOG_ERROR( "[proxy::ProxyWorker::onUringSend(..)] error: " << ::strerror( -cqe.res ) );
+            } else {
+                LOG_ERROR( "[proxy::ProxyWorker::onUringSend(..)] "
+                           << "Short send to client " << src.counterpart_fd << " (" << cqe.res << "/" << _received_length[buffer_id] << " bytes)" );
+            }
+
+            _metrics.errors.add();
+            closeUringPairing( src.counterpart_fd, false, true );
+        }
+
+    } else {
+        _metrics.forward_latency.record( metrics::Histogram::now() - _received_at[buffer_id] );
+
+        if( src.uring.sends_in_flight == 0 ) {
+            if( src.uring.eof && src.uring.queued.empty() ) {
+                closeUringPairing( src_fd, true, true );
+            } else {
+                flushUring( src_fd, src );
+            }
+        }
+    }
+
+    finalizeUringPairing( src_fd );
+}
+
+/**
+ * [PRIVATE] Sends the chunks received from a client to its counterpart as a linked chain (io_uring)
+ * (only 1 chain per direction is in flight at any time so the byte order is preserved)
+ * @param src_fd Client file descriptor
+ * @param src Client pairing
+ */
+void ProxyWorker::flushUring( FileDescriptor_t src_fd, Pairing_t & src ) {
+    if( src.uring.sends_in_flight > 0 || src.uring.queued.empty() || src.uring.closing ) {
+        return; //EARLY RETURN
+    }
+
+    if( _ring->freeSQEs() < src.uring.queued.size() ) {
+        _ring->submit(); //a chain split across submissions loses its ordering
+    }
+
+    const auto count = std::min( src.uring.queued.size(), static_cast<size_t>( _ring->freeSQEs() ) );
+
+    for( size_t i = 0; i < count; ++i ) {
+        const auto chunk = src.uring.queued[i];
+
+        _ring->prepareSend( src.counterpart_fd,
+                            _ring->buffer( chunk.buffer_id ),
+                            chunk.length,
+                            uringUserData( UringOp::SEND, src_fd, chunk.buffer_id ),
+                            ( i + 1 < count ) );
+
+        ++src.uring.sends_in_flight;
+    }
+
+    src.uring.queued.erase( src.uring.queued.begin(), src.uring.queued.begin() + count ); //rest goes once this chain completes
+}
+
+/**
+ * [PRIVATE] Starts tearing down a pairing after one of its clients disconnected (io_uring)
+ * @param dcn_fd Disconnected client file descriptor
+ * @param graceful Flag to send what was received from the disconnected client first
+ * @param orphan Flag to hand the counterpart back to the server so it can be paired again (closed otherwise)
+ */
+void ProxyWorker::closeUringPairing( FileDescriptor_t dcn_fd, bool graceful, bool orphan ) {
+    auto & client      = _pairings.at( dcn_fd );
+    auto & counterpart = _pairings.at( client.counterpart_fd );
+
+    if( client.uring.closing ) {
+        return; //EARLY RETURN
+    }
+
+    if( graceful && ( client.uring.sends_in_flight > 0 || !client.uring.queued.empty() ) ) {
+        client.uring.eof = true; //called again once sent
+        flushUring( dcn_fd, client );
+        return; //EARLY RETURN
+    }
+
+    client.uring.closing      = true;
+    counterpart.uring.closing = true;
+
+    const auto notice    = ( client.forwarder.framed() ? std::string_view( *_disconnected ) : std::string_view( PEER_LEFT_NOTICE ) );
+    const bool resumable = orphan && _options.orphan_grace_ms > 0
+                        && client.uring.sends_in_flight == 0 && client.uring.queued.empty()                 //all the client sent is through
+                        && client.forwarder.atFrameBoundary() && counterpart.forwarder.atFrameBoundary(); //neither way cut mid-frame (always for raw)
+    auto       sent      = ( resumable ? ::send( client.counterpart_fd, notice.data(), notice.size(), MSG_DONTWAIT | MSG_NOSIGNAL ) : -1 );
+
+    if( sent == -1 && resumable && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) {
+        sent = 0; //all of it goes through the ring
+    }
+
+    counterpart.uring.orphaned = ( sent >= 0 );
+
+    for( auto * pairing : { &client, &counterpart } ) {
+        for( const auto & chunk : pairing->uring.queued ) {
+            _ring->returnBuffer( chunk.buffer_id );
+        }
+
+        pairing->uring.queued.clear();
+    }
+
+    ::shutdown( dcn_fd, SHUT_RDWR ); //completes anything still pending on the sockets
+
+    if( !counterpart.uring.orphaned ) {
+        ::shutdown( client.counterpart_fd, SHUT_RDWR );
+    } //else: only its operations are cancelled so it stays usable
+    _ring->prepareCancel( dcn_fd, uringUserData( UringOp::CANCEL, dcn_fd ) );
+    _ring->prepareCancel( client.counterpart_fd, uringUserData( UringOp::CANCEL, client.counterpart_fd ) );
+
+    if( counterpart.uring.orphaned && static_cast<size_t>( sent ) < notice.size() ) { //after the cancellation so that it isn't caught by it
+        counterpart.uring.notice_left = static_cast<uint32_t>( notice.size() - sent );
+        ++counterpart.uring.sends_in_flight;
+
+        _ring->prepareSend( client.counterpart_fd, notice.data() + sent, counterpart.uring.notice_left, uringUserData( UringOp::NOTICE, client.counterpart_fd ), false );
+    }
+}
+
+/**
+ * [PRIVATE] Handles the completion of the rest of a `DISCONNECTED` notice the socket didn't take right away (io_uring)
+ * (the client is only handed back when all of it went out)
+ * @param fd File descriptor of the client whose counterpart left
+ * @param cqe Completion
+ */
+void ProxyWorker::onUringNotice( FileDescriptor_t fd, const struct io_uring_cqe & cqe ) {
+    auto * client = _pairings.find( fd );
+
+    if( client == nullptr ) {
+        return; //EARLY RETURN
+    }
+
+    --client->uring.sends_in_flight;
+
+    if( cqe.res != static_cast<int>( client->uring.notice_left ) ) {
+        LOG_ERROR( "[proxy::ProxyWorker::onUringNotice(..)] "
+                   << "Failed to tell client " << fd << " its counterpart left: " << ( cqe.res < 0 ? ::strerror( -cqe.res ) : "short send" ) );
+
+        client->uring.orphaned = false;
+    }
+
+    finalizeUringPairing( fd );
+}
+
+/**
+ * [PRIVATE] Closes (or hands back when orphaned) and forgets a pairing being torn down once nothing is in flight for either client (io_uring)
+ * @param fd Client file descriptor
+ */
+void ProxyWorker::finalizeUringPairing( FileDescriptor_t fd ) {
+    const auto * client_ptr = _pairings.find( fd );
+
+    if( client_ptr == nullptr || !client_ptr->uring.closing ) {
+        return; //EARLY RETURN
+    }
+
+    const auto   counterpart_fd = client_ptr->counterpart_fd;
+    const auto & client         = *client_ptr;
+    const auto & counterpart    = _pairings.at( counterpart_fd );
+
+    if( client.uring.recv_armed || client.uring.sends_in_flight > 0 || counterpart.uring.recv_armed || counterpart.uring.sends_in_flight > 0 ) {
+        return; //EARLY RETURN
+    }
+
+    const std::pair<FileDescriptor_t, bool> clients[]  = { { fd, client.uring.orphaned }, { counterpart_fd, counterpart.uring.orphaned } };
+    const Secret_t                          secret     = client.secret;
+    const bool                              framed     = client.forwarder.framed();
+    const bool                              compressed = client.compressed;
+
+    _metrics.pairs_closed.add();
+    _metrics.pair_bytes.record( client.bytes + counterpart.bytes );
+
+    _idle_timers.cancel( fd );
+    _idle_timers.cancel( counterpart_fd );
+    _pairings.erase( fd );
+    _pairings.erase( counterpart_fd );
+
+    --_pair_count;
+
+    for( const auto & [ client_fd, orphaned ] : clients ) {
+        if( orphaned ) {
+            handBack( client_fd, secret, framed, compressed );
+
+            LOG_INFO( "[proxy::ProxyWorker::finalizeUringPairing(..)] "
+                      << "Re-queued client " << client_fd );
+
+        } else {
+            closeClient( client_fd, secret );
+        }
+    }
+
+    LOG_INFO( "[proxy::ProxyWorker::finalizeUringPairing(..)] "
+              << "Disconnected pairing " << fd << " <-> " << counterpart_fd );
+}
+
+/**
+ * [PRIVATE] Resumes receiving on clients that ran out of provided buffers (io_uring)
+ */
+void ProxyWorker::rearmStalledUring() {
+    for( const auto fd : _stalled_fds ) {
+        auto * client = _pairings.find( fd );
+
+        if( client != nullptr && client->uring.recv_stalled ) {
+            client->uring.recv_stalled = false;
+
+            if( !client->uring.recv_armed && !client->uring.closing && !client->uring.eof ) {
+                client->uring.recv_armed = true;
+                _ring->prepareRecvMultishot( fd, uringUserData( UringOp::RECV, fd ) );
+            }
+        }
+    }
+
+    _stalled_fds.clear();
+}
+
+/**
+ * [PRIVATE] Adds the members queued by `addMember(..)` to their channel
+ * (`READY` goes to a member once there is someone else in the channel)
+ */
+void ProxyWorker::acceptMembers() {
+    MemberRequest_t request {};
+
+    while( _incoming_members.tryPop( request ) ) {
+        auto & client = _pairings.insert( request.fd, Pairing_t { -1, Forwarder(), EPOLLIN, _now } );
+
+        client.secret = request.secret;
+        client.member = std::make_unique<Member_t>();
+
+        if( !ProxyWorker::modifyEPOLL( _epoll_fd, request.fd, EPOLL_CTL_ADD, EPOLLIN, _pairings.handle( request.fd ).generation ) ) {
+            LOG_ERROR( "[proxy::ProxyWorker::acceptMembers()] "
+                       << "Failed to add group member " << request.fd << " (worker #" << _id << ")" );
+
+            _pairings.erase( request.fd );
+            closeClient( request.fd, request.secret );
+            --_member_count;
+            continue;
+        }
+
+        auto &     members  = _channels[ request.secret ].members;
+        const auto first_fd = members.empty() ? -1 : members.front();
+
+        members.emplace_back( request.fd );
+        _metrics.members_joined.add();
+
+        LOG_INFO( "[proxy::ProxyWorker::acceptMembers()] "
+                  << "Client " << request.fd << " joined a group channel (" << members.size() << " members, worker #" << _id << ")" );
+
+        if( members.size() >= 2 && !enqueue( request.fd, client, _ready ) ) {
+            closeMember( request.fd );
+            continue;
+        }
+
+        if( members.size() == 2 && !enqueue( first_fd, _pairings.at( first_fd ), _ready ) ) { //not alone anymore
+            closeMember( first_fd );
+        }
+    }
+}
+
+/**
+ * [PRIVATE] Handles the epoll events of a group member
+ * @param fd Member file descriptor
+ * @param client Member's entry in the pairing table
+ * @param events Epoll events
+ */
+void ProxyWorker::onMemberEvent( FileDescriptor_t fd, Pairing_t & client, uint32_t events ) {
+    if( ( events & EPOLLOUT ) && !flushMember( fd, *client.member ) ) {
+        closeMember( fd );
+        return; //EARLY RETURN
+    }
+
+    const bool readable = ( events & ( EPOLLHUP | EPOLLERR ) ) || ( ( events & EPOLLIN ) && _channels.at( client.secret ).stalled == 0 );
+
+    if( readable && !receiveFrames( fd, client ) ) { //not while the channel waits on a member (events of the same batch)
+        return; //EARLY RETURN (closed)
+    }
+
+    updateMemberEvents( fd, client );
+}
+
+/**
+ * [PRIVATE] Reads what a group member sent and fans the complete frames out to the rest of its channel
+ * (all the complete frames of a read go as 1 message: the bytes are copied once whatever the number of recipients)
+ * @param fd Member file descriptor
+ * @param client Member's entry in the pairing table
+ * @return Open state (false once the member was closed)
+ */
+bool ProxyWorker::receiveFrames( FileDescriptor_t fd, Pairing_t & client ) {
+    auto &     member = *client.member;
+    const auto bytes  = ::read( fd, _member_buffer.data(), _member_buffer.size() );
+
+    if( bytes == -1 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) {
+        _metrics.read_eagain.add();
+        return true; //EARLY RETURN
+    }
+
+    if( bytes <= 0 ) {
+        if( bytes == -1 ) {
+            LOG_ERROR( "[proxy::ProxyWorker::receiveFrames(..)] error: " << ::strerror( errno ) );
+            _metrics.errors.add();
+        }
+
+        closeMember( fd );
+        return false; //EARLY RETURN
+    }
+
+    client.last_active  = _now;
+    client.bytes       += bytes;
+
+    _metrics.bytes.add( bytes );
+    _metrics.messages.add();
+
+    member.inbound.append( _member_buffer.data(), bytes );
+
+    size_t   end    = 0;
+    auto     type   = FrameType::DATA;
+    uint32_t length = 0;
+
+    while( member.inbound.size() - end >= FrameCursor::HEADER_SIZE ) {
+        if( !FrameCursor::decodeHeader( member.inbound.data() + end, type, length ) || type != FrameType::DATA ) {
+            LOG_WARNING( "[proxy::ProxyWorker::receiveFrames(..)] "
+                         << "Client " << fd << " sent a malformed frame" );
+
+            _metrics.malformed_frames.add();
+            closeMember( fd );
+            return false; //EARLY RETURN
+        }
+
+        if( member.inbound.size() - end - FrameCursor::HEADER_SIZE < length ) {
+            break; //rest of the frame still to come
+        }
+
+        end += FrameCursor::HEADER_SIZE + length;
+    }
+
+    if( end == 0 ) {
+        return true; //EARLY RETURN
+    }
+
+    Message_t message;
+
+    if( end == member.inbound.size() ) { //usual case: the bytes move into the message
+        message = std::make_shared<const std::string>( std::move( member.inbound ) );
+        member.inbound.clear();
+    } else {
+        message = std::make_shared<const std::string>( member.inbound, 0, end );
+        member.inbound.erase( 0, end );
+    }
+
+    fanOut( fd, client.secret, message );
+    _metrics.forward_latency.record( metrics::Histogram::now() - _wake_time );
+
+    return _pairings.find( fd ) == &client; //i.e.: not dropped for falling behind on the way
+}
+
+/**
+ * [PRIVATE] Queues a message to every member of a channel but its sender (no recipient: the message is dropped)
+ * @param src_fd Sender file descriptor
+ * @param secret Handle of the channel's secret
+ * @param message Message
+ */
+void ProxyWorker::fanOut( FileDescriptor_t src_fd, Secret_t secret, const Message_t & message ) {
+    for( const auto fd : _channels.at( secret ).members ) {
+        if( fd != src_fd && !enqueue( fd, _pairings.at( fd ), message ) ) {
+            _closing.emplace_back( fd ); //not while iterating over the members
+        }
+    }
+
+    for( const auto fd : _closing ) {
+        closeMember( fd );
+    }
+
+    _closing.clear();
+}
+
+/**
+ * [PRIVATE] Queues a message to a group member and writes what the socket takes when nothing was queued before
+ * @param fd Member file descriptor
+ * @param client Member's entry in the pairing table
+ * @param message Message (shared)
+ * @return Success (false when the member errored or fell more than `MEMBER_QUEUE_MAX` bytes behind - left to the caller to close)
+ */
+bool ProxyWorker::enqueue( FileDescriptor_t fd, Pairing_t & client, const Message_t & message ) {
+    auto & member = *client.member;
+
+    member.outbound.emplace_back( message );
+    member.queued += message->size();
+
+    if( member.queued > MEMBER_QUEUE_MAX && member.outbound.size() > 1 ) {
+        LOG_WARNING( "[proxy::ProxyWorker::enqueue(..)] "
+                     << "Dropped group member " << fd << " (" << member.queued << " bytes behind)" );
+
+        _metrics.slow_members.add();
+        return false; //EARLY RETURN
+    }
+
+    if( member.outbound.size() == 1 && !flushMember( fd, member ) ) { //else: waiting on `EPOLLOUT` already
+        return false; //EARLY RETURN
+    }
+
+    updateMemberEvents( fd, client );
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Writes as much of a group member's queue as its socket takes, several messages per `writev`
+ * (a message is freed once written to its last recipient)
+ * @param fd Member file descriptor
+ * @param member Member
+ * @return Success (false on socket error)
+ */
+bool ProxyWorker::flushMember( FileDescriptor_t fd, Member_t & member ) {
+    while( !member.outbound.empty() ) {
+        struct iovec iov[MEMBER_WRITEV_MAX];
+        int          iov_count = 0;
+        size_t       offset    = member.outbound_offset;
+
+        for( auto it = member.outbound.begin(); it != member.outbound.end() && iov_count < MEMBER_WRITEV_MAX; ++it, ++iov_count ) {
+            iov[iov_count].iov_base = const_cast<char *>( ( *it )->data() ) + offset;
+            iov[iov_count].iov_len  = ( *it )->size() - offset;
+            offset                  = 0;
+        }
+
+        const auto out_bytes = ::writev( fd, iov, iov_count );
+
+        if( out_bytes == -1 ) {
+            if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+                _metrics.write_eagain.add();
+                return true; //EARLY RETURN
+            }
+
+            LOG_ERROR( "[proxy::ProxyWorker::flushMember(..)] error: " << ::strerror( errno ) );
+            _metrics.errors.add();
+            return false; //EARLY RETURN
+        }
+
+        auto written = static_cast<size_t>( out_bytes );
+
+        member.queued -= written;
+
+        while( written > 0 ) { //drop what was fully written, remember where the first partially written message is at
+            const auto left = member.outbound.front()->size() - member.outbound_offset;
+
+            if( written < left ) {
+                member.outbound_offset += written;
+                return true; //EARLY RETURN (socket full)
+            }
+
+            written                -= left;
+            member.outbound_offset  = 0;
+            member.outbound.pop_front();
+        }
+    }
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Updates the epoll events registered for a group member based on its queue
+ * Backpressure is per channel: while a member is `MEMBER_QUEUE_HIGH` bytes behind none of its channel's
+ * members is read from, so the senders wait for it rather than its queue growing (see `expireStalledMembers()`).
+ * @param fd Member file descriptor
+ * @param client Member's entry in the pairing table
+ */
+void ProxyWorker::updateMemberEvents( FileDescriptor_t fd, Pairing_t & client ) {
+    auto &     member  = *client.member;
+    auto &     channel = _channels.at( client.secret );
+    const bool stalled = ( member.queued >= MEMBER_QUEUE_HIGH );
+
+    if( stalled != ( member.stalled_since != 0 ) ) { //crossed the high-water mark
+        if( stalled ) {
+            member.stalled_since = std::max<uint64_t>( _now, 1 );
+            ++channel.stalled;
+        } else {
+            member.stalled_since = 0;
+            --channel.stalled;
+        }
+
+        if( channel.stalled == ( stalled ? 1 : 0 ) ) { //1st to fall behind or last to catch up: the channel pauses/resumes
+            for( const auto member_fd : channel.members ) {
+                if( member_fd != fd ) {
+                    setMemberEvents( member_fd, _pairings.at( member_fd ), channel );
+                }
+            }
+        }
+    }
+
+    setMemberEvents( fd, client, channel );
+}
+
+/**
+ * [PRIVATE] Registers the epoll events of a group member (reads while its channel isn't stalled, writes while it has a queue)
+ * @param fd Member file descriptor
+ * @param client Member's entry in the pairing table
+ * @param channel Member's channel
+ */
+void ProxyWorker::setMemberEvents( FileDescriptor_t fd, Pairing_t & client, const Channel_t & channel ) {
+    uint32_t events = 0;
+
+    if( channel.stalled == 0 ) {
+        events |= EPOLLIN;
+    }
+
+    if( client.member->queued > 0 ) {
+        events |= EPOLLOUT;
+    }
+
+    if( events != client.events && ProxyWorker::modifyEPOLL( _epoll_fd, fd, EPOLL_CTL_MOD, events, _pairings.handle( fd ).generation ) ) {
+        client.events = events;
+    }
+}
+
+/**
+ * [PRIVATE] Removes a member from its channel and closes it (the last member left is sent `DISCONNECTED`)
+ * @param fd Member file descriptor
+ */
+void ProxyWorker::closeMember( FileDescriptor_t fd ) {
+    auto * client = _pairings.find( fd );
+
+    if( client == nullptr || !client->member ) {
+        return; //EARLY RETURN
+    }
+
+    const auto secret  = client->secret;
+    auto &     channel = _channels.at( secret );
+    auto &     members = channel.members;
+    const bool resumed = ( client->member->stalled_since != 0 && --channel.stalled == 0 );
+
+    members.erase( std::find( members.begin(), members.end(), fd ) );
+    _pairings.erase( fd );
+    closeClient( fd, secret );
+    --_member_count;
+
+    if( resumed ) { //the channel was waiting on it
+        for( const auto member_fd : members ) {
+            setMemberEvents( member_fd, _pairings.at( member_fd ), channel );
+        }
+    }
+
+    LOG_INFO( "[proxy::ProxyWorker::closeMember(..)] "
+              << "Client " << fd << " left a group channel (" << members.size() << " members, worker #" << _id << ")" );
+
+    if( members.empty() ) {
+        _channels.erase( secret );
+
+    } else if( members.size() == 1 && !enqueue( members.front(), _pairings.at( members.front() ), _disconnected ) ) {
+        closeMember( members.front() );
+    }
+}
+
+/**
+ * [PRIVATE] Drops the group members that have held their channel back for longer than `MEMBER_STALL_MS`
+ */
+void ProxyWorker::expireStalledMembers() {
+    for( const auto & [ secret, channel ] : _channels ) {
+        if( channel.stalled == 0 ) {
+            continue;
+        }
+
+        for( const auto fd : channel.members ) {
+            const auto stalled_since = _pairings.at( fd ).member->stalled_since;
+
+            if( stalled_since != 0 && _now - stalled_since >= MEMBER_STALL_MS ) {
+                _closing.emplace_back( fd ); //not while iterating over the channels
+            }
+        }
+    }
+
+    for( const auto fd : _closing ) {
+        if( _pairings.contains( fd ) ) {
+            LOG_WARNING( "[proxy::ProxyWorker::expireStalledMembers()] "
+                         << "Dropped group member " << fd << " (held its channel back for " << MEMBER_STALL_MS << "ms)" );
+
+            _metrics.slow_members.add();
+            closeMember( fd );
+        }
+    }
+
+    _closing.clear();
+}
+
+/**
+ * [PRIVATE] Gives a client whose counterpart left back to the server (along with its secret's reference)
+ * The client is closed instead when the hand-over queue is full, its reference still being released.
+ * @param fd Client file descriptor (removed from the worker)
+ * @param secret Handle of the client's secret
+ * @param framed Flag for a client using the framed protocol
+ * @param compressed Flag for a framed client compressing its payloads
+ */
+void ProxyWorker::handBack( FileDescriptor_t fd, Secret_t secret, bool framed, bool compressed ) {
+    if( !_hand_back || !_hand_back( fd, secret, framed, compressed ) ) {
+        LOG_ERROR( "[proxy::ProxyWorker::handBack(..)] "
+                   << "Failed to hand client " << fd << " back to the server (worker #" << _id << ")" );
+
+        closeClient( fd, secret );
+    }
+}
+
+/**
+ * [PRIVATE] Closes a client and gives its secret's reference back to the server
+ * The reference is kept by the worker and handed back on a later tick when the hand-over queue is full.
+ * @param fd Client file descriptor (removed from the worker)
+ * @param secret Handle of the client's secret
+ */
+void ProxyWorker::closeClient( FileDescriptor_t fd, Secret_t secret ) {
+    ::close( fd );
+
+    if( !_hand_back ) {
+        return; //EARLY RETURN
+    }
+
+    if( !_unreleased.empty() || !_hand_back( -1, secret, false, false ) ) { //kept in order behind earlier failures
+        LOG_WARNING( "[proxy::ProxyWorker::closeClient(..)] "
+                     << "Hand-over queue full, secret of client " << fd << " released later (worker #" << _id << ")" );
+
+        _unreleased.push_back( secret );
+    }
+}
+
+/**
+ * [PRIVATE] Gives the server the secret references it couldn't take when their clients were closed
+ */
+void ProxyWorker::retryReleases() {
+    size_t released = 0;
+
+    while( released < _unreleased.size() && _hand_back( -1, _unreleased[ released ], false, false ) ) {
+        ++released;
+    }
+
+    _unreleased.erase( _unreleased.begin(), _unreleased.begin() + static_cast<std::ptrdiff_t>( released ) );
+}
+
+/**
+ * [PRIVATE] Closes any opened private file descriptor
+ */
+void ProxyWorker::closeFileDescriptors() {
+    if( _epoll_fd != -1 ) {
+        ::close( _epoll_fd );
+        _epoll_fd = -1;
+    }
+
+    if( _unblock_event_fd != -1 ) {
+        ::close( _unblock_event_fd );
+        _unblock_event_fd = -1;
+    }
+
+    if( _timer_fd != -1 ) {
+        ::close( _timer_fd );
+        _timer_fd = -1;
+    }
+}
+
+/**
+ * [PRIVATE] Packs an io_uring operation and its arguments into completion user data
+ * @param op Operation
+ * @param fd Client file descriptor
+ * @param buffer_id Provided buffer ID (sends only)
+ * @return User data
+ */
+uint64_t ProxyWorker::uringUserData( UringOp op, FileDescriptor_t fd, uint16_t buffer_id ) {
+    return ( static_cast<uint64_t>( op ) << 56 ) | ( static_cast<uint64_t>( buffer_id ) << 32 ) | static_cast<uint32_t>( fd );
+}
+
+/**
+ * [PRIVATE] Creates a periodic timer file descriptor (non-blocking, readable on each tick)
+ * @param interval_ms Tick interval in ms
+ * @return Timer file descriptor (-1 on failure)
+ */
+ProxyWorker::FileDescriptor_t ProxyWorker::createTickTimer( uint64_t interval_ms ) {
+    const auto fd = ::timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+
+    if( fd == -1 ) {
+        LOG_ERROR( "[proxy::ProxyWorker::createTickTimer(..)] 'timerfd_create' error: " << ::strerror( errno ) );
+        return -1; //EARLY RETURN
+    }
+
+    struct itimerspec spec {};
+
+    spec.it_interval.tv_sec  = static_cast<time_t>( interval_ms / 1000 );
+    spec.it_interval.tv_nsec = static_cast<long>( ( interval_ms % 1000 ) * 1000000 );
+    spec.it_value            = spec.it_interval;
+
+    if( ::timerfd_settime( fd, 0, &spec, nullptr ) == -1 ) {
+        LOG_ERROR( "[proxy::ProxyWorker::createTickTimer(..)] 'timerfd_settime' error: " << ::strerror( errno ) );
+        ::close( fd );
+        return -1; //EARLY RETURN
+    }
+
+    return fd;
+}
+
+/**
+ * [PRIVATE] Signal an event to unblock `epoll_wait`
+ * @param event_fd Event file descriptor
+ */
+void ProxyWorker::signalEvent( FileDescriptor_t event_fd ) {
+    const uint64_t one = 1;
+
+    if( ::write( event_fd, &one, sizeof( uint64_t ) ) != sizeof( uint64_t ) ) {
+        LOG_ERROR( "[proxy::ProxyWorker::signalEvent()] error: " << ::strerror( errno ) );
+    }
+}
+
+/**
+ * [PRIVATE] Modifies epoll file descriptor (wrapper for `epoll_ctl`)
+ * @param epoll_fd Target epoll file descriptor
+ * @param fd File descriptor to modify inside the epoll
+ * @param operation Operation
+ * @param event_flags Flags to set in the event
+ * @param generation Pairing table generation of `fd` packed alongside it in the event data (detects stale events)
+ * @return Success
+ */
+bool ProxyWorker::modifyEPOLL( FileDescriptor_t epoll_fd, FileDescriptor_t fd, int operation, uint32_t event_flags, uint32_t generation ) {
+    struct epoll_event event = {};
+
+    event.events   = event_flags;
+    event.data.u64 = ( static_cast<uint64_t>( generation ) << 32 ) | static_cast<uint32_t>( fd );
+
+    if( ::epoll_ctl( epoll_fd, operation, fd, &event ) < 0 ) {
+        LOG_ERROR( "[proxy::ProxyWorker::modifyEPOLL( " << epoll_fd << ", " << fd << ", " << operation << ", " << event_flags << " )] "
+                   << "Failed to modify epoll." );
+
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,213 @@
+#ifndef FWD_PROXY_PROXY_PROXYWORKER_H
+#define FWD_PROXY_PROXY_PROXYWORKER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include <sys/epoll.h>
+
+#include "../container/MpscQueue.h"
+#include "../container/FdTable.h"
+#include "../container/TimerWheel.h"
+#include "../container/InternTable.h"
+#include "../metrics/Metrics.h"
+#include "ServerOptions.h"
+#include "Forwarder.h"
+#include "Handoff.h"
+#include "IoUring.h"
+
+namespace fwd_proxy::proxy {
+    /**
+     * Proxy shard: forwards messages between the paired clients it owns on its own thread and epoll/io_uring
+     * (new pairings are handed over through a lock-free queue so the pairing table is only ever touched by the worker)
+     * It also relays the group channels it owns (epoll only): every complete frame a member sends is fanned out to the
+     * other members as 1 shared buffer, each member having its own bounded queue of buffers to write.
+     */
+    class ProxyWorker {
+      public:
+        typedef int                                               FileDescriptor_t;
+        typedef container::InternTable::Handle_t                  Secret_t;
+        typedef std::function<bool( FileDescriptor_t, Secret_t, bool, bool )> HandBack_t; //gives a client (or just its secret's reference when -1) back to the server, with its protocol (framed, compressed)
+        typedef std::function<void( Handoff::Pairing_t &, Secret_t )>   Export_t;   //takes a pairing exported for a hot restart (secret string left to fill)
+        typedef std::function<void( Handoff::Pending_t &, Secret_t )>   ExportMember_t; //takes a group member exported for a hot restart (handshake left to fill)
+
+        ProxyWorker( size_t id, const ServerOptions & options, HandBack_t hand_back = nullptr );
+        ProxyWorker( const ProxyWorker & ) = delete;
+        ~ProxyWorker();
+
+        ProxyWorker & operator =( const ProxyWorker & ) = delete;
+
+        bool start();
+        void stop();
+        bool addPairing( FileDescriptor_t fd1, FileDescriptor_t fd2, Secret_t secret, bool framed = false, bool compressed = false );
+        bool resumePairing( Handoff::Pairing_t pairing, Secret_t secret );
+        size_t exportPairings( const Export_t & export_fn );
+        bool addMember( FileDescriptor_t fd, Secret_t secret );
+        size_t exportMembers( const ExportMember_t & export_fn );
+
+        [[nodiscard]] size_t id() const;
+        [[nodiscard]] int cpu() const;
+        [[nodiscard]] size_t load() const;
+        [[nodiscard]] size_t pairs() const;
+        [[nodiscard]] const metrics::WorkerMetrics & metrics() const;
+
+      private:
+        struct PairingRequest_t {
+            FileDescriptor_t                    fd1        { -1 };
+            FileDescriptor_t                    fd2        { -1 };
+            Secret_t                            secret     { container::InternTable::INVALID_HANDLE };
+            bool                                framed     { false };
+            bool                                compressed { false }; //frame payloads compressed end to end (relayed as is)
+            std::unique_ptr<Handoff::Pairing_t> resumed    {};        //state carried over from the previous process (hot restart only)
+        };
+
+        struct MemberRequest_t {
+            FileDescriptor_t fd;
+            Secret_t         secret;
+        };
+
+        typedef std::shared_ptr<const std::string> Message_t; //whole frames fanned out to a channel (shared by the recipients)
+
+        struct Member_t {
+            std::string           inbound;               //bytes read from the member not fanned out yet (start of a frame)
+            std::deque<Message_t> outbound;              //messages waiting to be written to the member
+            size_t                outbound_offset { 0 }; //bytes of the front message written already
+            size_t                queued          { 0 }; //bytes waiting in `outbound`
+            uint64_t              stalled_since   { 0 }; //when it went `MEMBER_QUEUE_HIGH` bytes behind (ms, 0 when it isn't)
+        };
+
+        struct Channel_t {
+            std::vector<FileDescriptor_t> members;
+            size_t                        stalled { 0 }; //members `MEMBER_QUEUE_HIGH` bytes behind (nobody is read from meanwhile)
+        };
+
+        enum class UringOp : uint8_t {
+            WAKE = 0,
+            RECV,
+            SEND,
+            CANCEL,
+            TIMER,
+            NOTICE,
+        };
+
+        struct UringChunk_t {
+            uint16_t buffer_id;
+            uint32_t length;
+        };
+
+        struct UringState_t {
+            std::vector<UringChunk_t> queued;              //received from `fd`, waiting to be sent to `counterpart_fd`
+            unsigned                  sends_in_flight { 0 };
+            bool                      recv_armed      { false };
+            bool                      recv_stalled    { false }; //ran out of provided buffers
+            bool                      eof             { false }; //`fd` disconnected (pairing closes once `queued` is sent)
+            bool                      closing         { false };
+            bool                      orphaned        { false }; //`fd` is handed back to the server instead of closed
+            uint32_t                  notice_left     { 0 };     //bytes of `DISCONNECTED` sent to `fd` through the ring (orphaned only)
+        };
+
+        struct Pairing_t {
+            FileDescriptor_t          counterpart_fd { -1 };
+            Forwarder                 forwarder    {};    //`fd -> counterpart_fd` direction (pipe/buffer)
+            uint32_t                  events       { 0 }; //epoll events currently registered for `fd`
+            uint64_t                  last_active  { 0 }; //last time bytes were received from `fd` (ms)
+            bool                      eof          { false }; //`fd` disconnected (pairing closes once the forwarder is flushed)
+            uint64_t                  flush_at     { 0 }; //held bytes are written by then (µs, 0 when nothing is held back)
+            UringState_t              uring        {};    //used instead of the above by `IoBackend::IO_URING`
+            Secret_t                  secret       { container::InternTable::INVALID_HANDLE }; //shared by both clients (1 reference each)
+            uint64_t                  bytes        { 0 }; //received from `fd` so far
+            bool                      compressed   { false }; //protocol negotiated by both clients (see `HandshakeParser::compressed()`)
+            std::unique_ptr<Member_t> member       {};    //set for group channel members instead (no counterpart)
+            std::string               notice       {};    //`DISCONNECTED` left to write to `counterpart_fd` after the forwarder (`fd` left)
+        };
+
+        struct Coalesced_t {
+            container::FdTable<Pairing_t>::Handle_t handle;   //pairing holding bytes back
+            uint64_t                                flush_at; //µs
+        };
+
+        const size_t         _id;
+        const int            _cpu; //CPU the thread is pinned to (-1 = unpinned)
+        ServerOptions        _options;
+        HandBack_t           _hand_back;
+        std::atomic_bool     _run_flag;
+        std::atomic<size_t>  _pair_count;
+        std::atomic<size_t>  _member_count;
+        FileDescriptor_t     _epoll_fd;
+        FileDescriptor_t     _unblock_event_fd;
+        FileDescriptor_t     _timer_fd;
+        std::thread          _worker_th;
+
+        container::MpscQueue<PairingRequest_t> _incoming_pairings;
+        container::FdTable<Pairing_t>          _pairings; //owned by worker thread
+        container::TimerWheel                  _idle_timers; //1 per pairing (keyed by either of its clients)
+        uint64_t                               _now;       //time of the current batch of events (ms)
+        uint64_t                               _wake_time; //same in µs
+        metrics::WorkerMetrics                 _metrics;   //written by the worker thread only
+        std::deque<Coalesced_t>                _coalesced; //pending flushes of held bytes, by deadline
+        std::vector<Secret_t>                  _unreleased; //references of closed clients the server couldn't take yet (retried every tick)
+
+        container::MpscQueue<MemberRequest_t>    _incoming_members;
+        std::unordered_map<Secret_t, Channel_t> _channels;      //by secret (members share its references)
+        std::vector<char>                       _member_buffer; //reads from group members
+        std::vector<FileDescriptor_t>           _closing;       //members to close once a fan-out is done
+        const Message_t                         _ready;         //control frames queued to members
+        const Message_t                         _disconnected;
+
+        std::unique_ptr<IoUring>      _ring;
+        std::vector<FileDescriptor_t> _stalled_fds; //clients with a receive waiting on provided buffers
+        std::vector<uint64_t>         _received_at;     //time each provided buffer was filled (µs)
+        std::vector<uint32_t>         _received_length; //bytes each provided buffer was filled with
+        uint64_t                      _wake_count;
+        uint64_t                      _timer_expirations;
+
+        void runEventLoop();
+        void runUringEventLoop();
+        void acceptPairings();
+        bool flush( Pairing_t & src, FileDescriptor_t dst_fd );
+        void holdBack( FileDescriptor_t fd, Pairing_t & client );
+        void flushCoalesced();
+        int waitForEvents( struct epoll_event * events, int max_events );
+        void updateEvents( FileDescriptor_t fd, Pairing_t & client, const Pairing_t & counterpart );
+        void closePairing( FileDescriptor_t dcn_fd, bool orphan );
+        void notifyOrphan( FileDescriptor_t dcn_fd, Pairing_t & client );
+        void releasePairing( FileDescriptor_t dcn_fd, bool requeue );
+        void expireIdlePairings();
+        void scheduleIdleTimeout( FileDescriptor_t fd, uint64_t last_active );
+        void acceptUringPairings();
+        void onUringRecv( FileDescriptor_t fd, const struct io_uring_cqe & cqe );
+        void onUringSend( FileDescriptor_t src_fd, uint16_t buffer_id, const struct io_uring_cqe & cqe );
+        void flushUring( FileDescriptor_t src_fd, Pairing_t & src );
+        void closeUringPairing( FileDescriptor_t dcn_fd, bool graceful, bool orphan );
+        void onUringNotice( FileDescriptor_t fd, const struct io_uring_cqe & cqe );
+        void finalizeUringPairing( FileDescriptor_t fd );
+        void rearmStalledUring();
+        void handBack( FileDescriptor_t fd, Secret_t secret, bool framed, bool compressed );
+        void closeClient( FileDescriptor_t fd, Secret_t secret );
+        void retryReleases();
+        void closeFileDescriptors();
+        void acceptMembers();
+        void onMemberEvent( FileDescriptor_t fd, Pairing_t & client, uint32_t events );
+        bool receiveFrames( FileDescriptor_t fd, Pairing_t & client );
+        void fanOut( FileDescriptor_t src_fd, Secret_t secret, const Message_t & message );
+        bool enqueue( FileDescriptor_t fd, Pairing_t & client, const Message_t & message );
+        bool flushMember( FileDescriptor_t fd, Member_t & member );
+        void updateMemberEvents( FileDescriptor_t fd, Pairing_t & client );
+        void setMemberEvents( FileDescriptor_t fd, Pairing_t & client, const Channel_t & channel );
+        void expireStalledMembers();
+        void closeMember( FileDescriptor_t fd );
+
+        static uint64_t uringUserData( UringOp op, FileDescriptor_t fd, uint16_t buffer_id = 0 );
+        static FileDescriptor_t createTickTimer( uint64_t interval_ms );
+        static void signalEvent( FileDescriptor_t event_fd );
+        static bool modifyEPOLL( FileDescriptor_t epoll_fd, FileDescriptor_t fd, int operation, uint32_t event_flags, uint32_t generation = 0 );
+    };
+}
+
+#endif //FWD_PROXY_PROXY_PROXYWORKER_H
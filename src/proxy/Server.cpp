@@ -1,37 +1,66 @@
 #include "Server.h"
+#include "../logger/Logger.h"
+#include "../metrics/PrometheusText.h"
+#include "CpuAffinity.h"
 
-#include <iostream>
-#include <set>
+#include <algorithm>
+#include <cstring>
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 
 #define EPOLL_PENDING_QUEUE_LENGTH  10 //size is ignored since Linux 2.6.8
 #define EPOLL_ARRAY_SIZE            10
-#define MAX_CONNECTION_REQUESTS    100
 #define INPUT_BUFFER_SIZE          512
+#define URING_QUEUE_DEPTH          256
+#define PENDING_TABLE_SIZE        1024 //initial number of file descriptor slots (grows as needed)
+#define HANDOVER_QUEUE_SIZE       4096 //accepted/orphaned connections waiting to be picked up by the pending thread
+#define TIMER_TICK_MS              100 //timeout resolution
 
 using namespace fwd_proxy::proxy;
 
 /**
  * Constructor
  * @param port Port
+ * @param options Server options
  */
-Server::Server( int port ) :
+Server::Server( int port, ServerOptions options ) :
     _server_port( std::to_string( port ) ),
-    _server_socket_fd( -1 ),
-    _server_socket_epoll_fd( -1 ),
+    _options( options ),
     _epoll_pending_fd( -1 ),
-    _epoll_paired_fd( -1 ),
+    _next_proxy_worker( 0 ),
+    _handovers( HANDOVER_QUEUE_SIZE ),
+    _handover_event_fd( -1 ),
+    _pending_timer_fd( -1 ),
+    _pending_timers( TIMER_TICK_MS, PENDING_TABLE_SIZE ),
+    _pending_clients( PENDING_TABLE_SIZE ),
+    _secrets( PENDING_TABLE_SIZE ),
+    _matchmaker( PENDING_TABLE_SIZE ),
     _run_flag( true ),
-    _unblock_event_fd( -1 )
-{}
+    _unblock_event_fd( -1 ),
+    _handoff_fd( -1 ),
+    _handed_off( false )
+{
+    if( _options.shard_policy == ShardPolicy::INCOMING_CPU && _options.worker_cpus.empty() ) {
+        _options.worker_cpus = CpuAffinity::allowed(); //placement by CPU needs workers that stay on theirs
+    }
+
+    if( _options.proxy_workers == 0 ) {
+        _options.proxy_workers = _options.worker_cpus.empty()
+                               ? std::max( 1U, std::thread::hardware_concurrency() )
+                               : _options.worker_cpus.size();
+    }
+
+    _options.acceptors = std::max( static_cast<size_t>( 1 ), _options.acceptors );
+}
 
 /**
  * Destructor
@@ -45,97 +74,166 @@ Server::~Server() {
  * @return Success
  */
 bool Server::start() {
-    std::cout << "[proxy::Server::start()] Staring server on port " << _server_port << "..." << std::endl;
+    LOG_INFO( "[proxy::Server::start()] Staring server on port " << _server_port << " ("
+              << "forwarding: " << _options.forwarding_mode << ", "
+              << "proxy workers: " << _options.proxy_workers << ", "
+              << "sharding: " << _options.shard_policy << ", "
+              << "I/O: " << _options.io_backend << ", "
+              << "acceptors: " << _options.acceptors << ", "
+              << "metrics port: " << ( _options.metrics_port > 0 ? std::to_string( _options.metrics_port ) : "off" ) << ", "
+              << "TLS: " << ( _options.tls_cert_path.empty() ? "off" : "kTLS" )
+              << ")..." );
+
+    if( !_options.tls_cert_path.empty() ) {
+        if( _options.io_backend == IoBackend::IO_URING ) {
+            LOG_ERROR( "[proxy::Server::start()] TLS is not supported with io_uring." );
+            return false; //EARLY RETURN
+        }
 
-    struct addrinfo   hints {};
-    struct addrinfo * server_info;
-    struct addrinfo * curr_server_info;
+        if( !TlsContext::kernelSupport() ) {
+            LOG_ERROR( "[proxy::Server::start()] Kernel TLS is not available (load the 'tls' module)." );
+            return false; //EARLY RETURN
+        }
 
-    int yes     { 1 };
-    int err_val { 0 };
+        if( !( _tls = TlsContext::server( _options.tls_cert_path, _options.tls_key_path ) ) ) {
+            return false; //EARLY RETURN
+        }
+    }
 
-    hints.ai_family   = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags    = AI_PASSIVE;
+    auto snapshot = Handoff::Snapshot_t();
 
-    if( ( err_val = ::getaddrinfo( nullptr, _server_port.c_str(), &hints, &server_info ) ) != 0 ) {
-        std::cerr << "[proxy::Server::start()] " << ::gai_strerror( err_val ) << std::endl;
-        return false; //EARLY RETURN
+    if( !_options.handoff_path.empty() && _options.io_backend == IoBackend::IO_URING ) {
+        LOG_WARNING( "[proxy::Server::start()] Hot restart is not supported with io_uring (ignoring " << _options.handoff_path << ")." );
+        _options.handoff_path.clear();
     }
 
-    for( curr_server_info = server_info; curr_server_info != nullptr; curr_server_info = curr_server_info->ai_next ) {
-        if( ( _server_socket_fd = ::socket( curr_server_info->ai_family, curr_server_info->ai_socktype, curr_server_info->ai_protocol ) ) == -1 ) {
-            ::perror("[proxy::Server::start()] 'socket' error");
-            continue;
-        }
+    if( !_options.handoff_path.empty() && takeOver( snapshot ) && !snapshot.listeners.empty() ) {
+        _options.acceptors = snapshot.listeners.size(); //listeners stay bound throughout
+    }
 
-        ::fcntl( _server_socket_fd, F_SETFL, O_NONBLOCK ); //non-blocking so we can 'poll'
+    for( size_t i = 0; i < _options.acceptors; ++i ) {
+        auto & acceptor = _acceptors.emplace_back();
 
-        if( ::setsockopt( _server_socket_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int) ) == -1 ) {
-            ::perror("[proxy::Server::start()] 'setsockopt' error");
-            ::freeaddrinfo( server_info );
-            return false; //EARLY RETURN
-        }
+        acceptor.socket_fd = ( i < snapshot.listeners.size() ? adoptListener( snapshot.listeners[i] ) : createListener() );
 
-        if( ::bind( _server_socket_fd, curr_server_info->ai_addr, curr_server_info->ai_addrlen ) == -1 ) {
-            ::close( _server_socket_fd );
-            ::perror("[proxy::Server::start()] 'bind' error");
-            continue;
+        if( acceptor.socket_fd == -1 ) {
+            closeFileDescriptors();
+            return false; //EARLY RETURN
         }
 
-        break;
-    }
+        if( !_options.acceptor_cpus.empty() ) {
+            acceptor.cpu = _options.acceptor_cpus[ i % _options.acceptor_cpus.size() ];
 
-    if( curr_server_info == nullptr ) {
-        std::cerr << "[proxy::Server::start()] Failed to bind." << std::endl;
-        ::freeaddrinfo( server_info );
-        return false; //EARLY RETURN
+            //the kernel then prefers the `SO_REUSEPORT` listener on the CPU handling the connection request
+            if( _options.acceptors > 1 && ::setsockopt( acceptor.socket_fd, SOL_SOCKET, SO_INCOMING_CPU, &acceptor.cpu, sizeof( int ) ) == -1 ) {
+                LOG_WARNING( "[proxy::Server::start()] 'SO_INCOMING_CPU' error on listener " << acceptor.socket_fd << ": " << ::strerror( errno ) );
+            }
+        }
     }
 
-    ::freeaddrinfo( server_info );
-
     if( ( _epoll_pending_fd = ::epoll_create( EPOLL_PENDING_QUEUE_LENGTH ) ) == -1 ) {
-        std::cerr << "[proxy::Server::start()] Failed to create 'pending clients' epoll file descriptor." << std::endl;
+        LOG_ERROR( "[proxy::Server::start()] Failed to create 'pending clients' epoll file descriptor." );
         closeFileDescriptors();
         return false; //EARLY RETURN
     }
 
-    if( ( _epoll_paired_fd = ::epoll_create( EPOLL_PENDING_QUEUE_LENGTH ) ) == -1 ) {
-        std::cerr << "[proxy::Server::start()] Failed to create 'paired clients' epoll file descriptor." << std::endl;
+    if( ( _unblock_event_fd = ::eventfd( 0, EFD_NONBLOCK ) ) == -1 ) {
+        LOG_ERROR( "[proxy::Server::start()] Failed to create 'event unblocking' epoll file descriptor." );
         closeFileDescriptors();
         return false; //EARLY RETURN
     }
 
-    if( ( _server_socket_epoll_fd = ::epoll_create( 2 ) ) == -1 ) {
-        std::cerr << "[proxy::Server::start()] Failed to create 'server socket' epoll file descriptor." << std::endl;
+    if( ( _handover_event_fd = ::eventfd( 0, EFD_NONBLOCK ) ) == -1 ) {
+        LOG_ERROR( "[proxy::Server::start()] Failed to create 'client handover' event file descriptor." );
         closeFileDescriptors();
         return false; //EARLY RETURN
     }
 
-    if( ( _unblock_event_fd = ::eventfd( 0, EFD_NONBLOCK ) ) == -1 ) {
-        std::cerr << "[proxy::Server::start()] Failed to create 'event unblocking' epoll file descriptor." << std::endl;
+    if( ( _pending_timer_fd = Server::createTickTimer( TIMER_TICK_MS ) ) == -1 ) {
         closeFileDescriptors();
         return false; //EARLY RETURN
     }
 
-    if( !Server::modifyEPOLL( _server_socket_epoll_fd, _unblock_event_fd, EPOLL_CTL_ADD, EPOLLIN )           ||
-        !Server::modifyEPOLL( _server_socket_epoll_fd, _server_socket_fd, EPOLL_CTL_ADD, EPOLLIN | EPOLLET ) ||
-        !Server::modifyEPOLL( _epoll_pending_fd, _unblock_event_fd, EPOLL_CTL_ADD, EPOLLIN )                 ||
-        !Server::modifyEPOLL( _epoll_paired_fd, _unblock_event_fd, EPOLL_CTL_ADD, EPOLLIN ) )
+    if( !Server::modifyEPOLL( _epoll_pending_fd, _unblock_event_fd, EPOLL_CTL_ADD, EPOLLIN )  ||
+        !Server::modifyEPOLL( _epoll_pending_fd, _handover_event_fd, EPOLL_CTL_ADD, EPOLLIN ) ||
+        !Server::modifyEPOLL( _epoll_pending_fd, _pending_timer_fd, EPOLL_CTL_ADD, EPOLLIN ) )
     {
         closeFileDescriptors();
         return false; //EARLY RETURN
     }
 
-    if( ::listen( _server_socket_fd, MAX_CONNECTION_REQUESTS ) == -1 ) {
-        ::perror( "[proxy::Server::start()] error" );
-        closeFileDescriptors();
-        return false; //EARLY RETURN
+    for( auto & acceptor : _acceptors ) {
+        if( ( acceptor.epoll_fd = ::epoll_create( 2 ) ) == -1 ) {
+            LOG_ERROR( "[proxy::Server::start()] Failed to create 'server socket' epoll file descriptor." );
+            closeFileDescriptors();
+            return false; //EARLY RETURN
+        }
+
+        if( !Server::modifyEPOLL( acceptor.epoll_fd, _unblock_event_fd, EPOLL_CTL_ADD, EPOLLIN ) ||
+            !Server::modifyEPOLL( acceptor.epoll_fd, acceptor.socket_fd, EPOLL_CTL_ADD, EPOLLIN | EPOLLET ) )
+        {
+            closeFileDescriptors();
+            return false; //EARLY RETURN
+        }
+    }
+
+    if( _options.io_backend == IoBackend::IO_URING ) {
+        _pending_ring = std::make_unique<IoUring>( URING_QUEUE_DEPTH );
+
+        if( !_pending_ring->valid() ) {
+            LOG_WARNING( "[proxy::Server::start()] io_uring not available, falling back to epoll." );
+            _pending_ring.reset();
+            _options.io_backend = IoBackend::EPOLL;
+        }
+    }
+
+    if( _options.group_channels && _options.io_backend == IoBackend::IO_URING ) {
+        LOG_WARNING( "[proxy::Server::start()] Group channels are not supported with io_uring (clients are paired instead)." );
+        _options.group_channels = false;
+    }
+
+    for( size_t i = 0; i < _options.proxy_workers; ++i ) {
+        _proxy_workers.emplace_back( std::make_unique<ProxyWorker>( i, _options, [this]( FileDescriptor_t fd, Secret_t secret, bool framed, bool compressed ) {
+            return this->handBack( fd, secret, framed, compressed );
+        } ) );
+
+        if( !_proxy_workers.back()->start() ) {
+            _proxy_workers.clear();
+            closeFileDescriptors();
+            return false; //EARLY RETURN
+        }
+    }
+
+    importSnapshot( snapshot );
+
+    if( _options.metrics_port > 0 ) {
+        _admin_server = std::make_unique<metrics::AdminServer>( _options.metrics_port, [this]() { return this->renderMetrics(); } );
+
+        if( !_admin_server->start() ) {
+            _admin_server.reset();
+            _proxy_workers.clear();
+            closeFileDescriptors();
+            return false; //EARLY RETURN
+        }
+    }
+
+    if( _options.io_backend == IoBackend::IO_URING ) {
+        _pending_worker_th = std::thread( [this]() { CpuAffinity::pin( _options.pending_cpus ); this->runUringPendingEventLoop(); } );
+    } else {
+        for( auto & acceptor : _acceptors ) {
+            acceptor.thread = std::thread( [this, &acceptor]() { CpuAffinity::pin( acceptor.cpu ); this->runConnectionEventLoop( acceptor ); } );
+        }
+
+        _pending_worker_th = std::thread( [this]() { CpuAffinity::pin( _options.pending_cpus ); this->runPendingEventLoop(); } );
     }
 
-    _connection_worker_th = std::thread( [this]() { this->runConnectionEventLoop(); } );
-    _pending_worker_th    = std::thread( [this]() { this->runPendingEventLoop(); } );
-    _proxy_worker_th      = std::thread( [this]() { this->runProxyEventLoop(); } );
+    if( !_options.handoff_path.empty() ) {
+        if( ( _handoff_fd = Handoff::listen( _options.handoff_path ) ) == -1 ) {
+            LOG_WARNING( "[proxy::Server::start()] Hot restart unavailable (no hand-off socket)." );
+        } else {
+            _handoff_th = std::thread( [this]() { this->runHandoffLoop(); } );
+        }
+    }
 
     return true;
 }
@@ -145,25 +243,76 @@ bool Server::start() {
  * @return Error-less success
  */
 bool Server::stop() {
-    if( _run_flag ) {
-        std::cout << "[proxy::Server::stop()] Shutting down server..." << std::endl;
-        _run_flag = false;
+    const bool halted = halt();
+
+    if( _handoff_th.joinable() ) {
+        _handoff_th.join(); //unblocked by `halt()`, or done handing everything over
+    }
+
+    if( halted ) {
+        size_t pair_count = 0;
 
-        { //unblock any `epoll_wait`
-            const uint64_t one = 1;
+        for( auto & worker : _proxy_workers ) {
+            pair_count += worker->pairs();
+        }
+
+        LOG_INFO( "[proxy::Server::stop()] paired clients = " << ( pair_count * 2 ) );
 
-            if( ::write( _unblock_event_fd, &one, sizeof( uint64_t ) ) != sizeof( uint64_t ) ) {
-                ::perror( "[proxy::Server::stop()] error" );
+        Handover_t handover {};
+
+        while( _handovers.tryPop( handover ) ) { //never picked up
+            if( handover.fd != -1 ) {
+                ::close( handover.fd );
             }
         }
 
-        _connection_worker_th.join();
-        _pending_worker_th.join();
-        _proxy_worker_th.join();
+        if( _handoff_fd != -1 ) {
+            ::unlink( _options.handoff_path.c_str() );
+        }
+    }
 
-        std::cout << "[proxy::Server::stop()] paired clients = " << _pairings.size() << std::endl;
+    closeFileDescriptors();
 
-        closeFileDescriptors();
+    return true;
+}
+
+/**
+ * Checks if the server handed everything over to a new process (hot restart)
+ * @return Hand-off state (the server is stopped once true)
+ */
+bool Server::handedOff() const {
+    return _handed_off;
+}
+
+/**
+ * [PRIVATE] Stops the server's threads, leaving the clients and listeners open
+ * @return Success (false when already halted)
+ */
+bool Server::halt() {
+    if( !_run_flag.exchange( false ) ) {
+        return false; //EARLY RETURN
+    }
+
+    LOG_INFO( "[proxy::Server::halt()] Shutting down server..." );
+
+    Server::signalEvent( _unblock_event_fd ); //unblock any `epoll_wait`
+
+    if( _admin_server ) {
+        _admin_server->stop();
+    }
+
+    for( auto & acceptor : _acceptors ) {
+        if( acceptor.thread.joinable() ) {
+            acceptor.thread.join();
+        }
+    }
+
+    if( _pending_worker_th.joinable() ) {
+        _pending_worker_th.join();
+    }
+
+    for( auto & worker : _proxy_workers ) {
+        worker->stop();
     }
 
     return true;
@@ -173,388 +322,1266 @@ bool Server::stop() {
  * [PRIVATE] Closes any opened private file descriptor
  */
 void Server::closeFileDescriptors() {
-    if( _epoll_pending_fd != -1 ) {
-        ::close( _epoll_pending_fd );
+    for( auto * fd : { &_epoll_pending_fd, &_unblock_event_fd, &_handover_event_fd, &_pending_timer_fd, &_handoff_fd } ) {
+        if( *fd != -1 ) {
+            ::close( *fd );
+            *fd = -1;
+        }
+    }
+
+    for( auto & acceptor : _acceptors ) {
+        if( acceptor.epoll_fd != -1 ) {
+            ::close( acceptor.epoll_fd );
+            acceptor.epoll_fd = -1;
+        }
+
+        if( acceptor.socket_fd != -1 ) {
+            ::close( acceptor.socket_fd );
+            acceptor.socket_fd = -1;
+        }
+    }
+}
+
+/**
+ * [PRIVATE] Creates a listening socket bound to the server port
+ * (with `SO_REUSEPORT` when there are multiple acceptors so the kernel balances connections between them)
+ * and tuned so that the accepted sockets inherit the TCP settings
+ * @return Listening socket file descriptor (-1 on failure)
+ */
+Server::FileDescriptor_t Server::createListener() const {
+    struct addrinfo   hints {};
+    struct addrinfo * server_info;
+    struct addrinfo * curr_server_info;
+    FileDescriptor_t  socket_fd { -1 };
+    int               yes       { 1 };
+    int               err_val   { 0 };
+
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_PASSIVE;
+
+    if( ( err_val = ::getaddrinfo( nullptr, _server_port.c_str(), &hints, &server_info ) ) != 0 ) {
+        LOG_ERROR( "[proxy::Server::createListener()] " << ::gai_strerror( err_val ) );
+        return -1; //EARLY RETURN
     }
 
-    if( _epoll_paired_fd != -1 ) {
-        ::close( _epoll_paired_fd );
+    for( curr_server_info = server_info; curr_server_info != nullptr; curr_server_info = curr_server_info->ai_next ) {
+        const int type = curr_server_info->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC; //non-blocking so we can 'poll'
+
+        if( ( socket_fd = ::socket( curr_server_info->ai_family, type, curr_server_info->ai_protocol ) ) == -1 ) {
+            LOG_ERROR( "[proxy::Server::createListener()] 'socket' error: " << ::strerror( errno ) );
+            continue;
+        }
+
+        if( ::setsockopt( socket_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int) ) == -1 ||
+            ( _options.acceptors > 1 && ::setsockopt( socket_fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(int) ) == -1 ) )
+        {
+            LOG_ERROR( "[proxy::Server::createListener()] 'setsockopt' error: " << ::strerror( errno ) );
+            ::close( socket_fd );
+            ::freeaddrinfo( server_info );
+            return -1; //EARLY RETURN
+        }
+
+        if( !_options.socket_tuning.apply( socket_fd, true ) ) { //inherited by the accepted sockets
+            ::close( socket_fd );
+            ::freeaddrinfo( server_info );
+            return -1; //EARLY RETURN
+        }
+
+        if( ::bind( socket_fd, curr_server_info->ai_addr, curr_server_info->ai_addrlen ) == -1 ) {
+            ::close( socket_fd );
+            LOG_ERROR( "[proxy::Server::createListener()] 'bind' error: " << ::strerror( errno ) );
+            continue;
+        }
+
+        break;
     }
 
-    if( _server_socket_epoll_fd != -1 ) {
-        ::close( _server_socket_epoll_fd );
+    ::freeaddrinfo( server_info );
+
+    if( curr_server_info == nullptr ) {
+        LOG_ERROR( "[proxy::Server::createListener()] Failed to bind." );
+        return -1; //EARLY RETURN
     }
 
-    if( _unblock_event_fd != -1 ) {
-        ::close( _unblock_event_fd );
+    if( ::listen( socket_fd, _options.listen_backlog ) == -1 ) {
+        LOG_ERROR( "[proxy::Server::createListener()] error: " << ::strerror( errno ) );
+        ::close( socket_fd );
+        return -1; //EARLY RETURN
     }
 
-    if( _server_socket_fd != -1 ) {
-        ::close( _server_socket_fd );
+    return socket_fd;
+}
+
+/**
+ * [PRIVATE] Takes over a listening socket handed over by the previous process
+ * (re-tuned and re-listened so that the current settings apply)
+ * @param socket_fd Listening socket file descriptor
+ * @return Listening socket file descriptor (-1 on failure)
+ */
+Server::FileDescriptor_t Server::adoptListener( FileDescriptor_t socket_fd ) const {
+    if( !_options.socket_tuning.apply( socket_fd, true ) || ::listen( socket_fd, _options.listen_backlog ) == -1 ) {
+        LOG_ERROR( "[proxy::Server::adoptListener( " << socket_fd << " )] error: " << ::strerror( errno ) );
+        ::close( socket_fd );
+        return -1; //EARLY RETURN
     }
+
+    return socket_fd;
 }
 
 /**
- * [PRIVATE] Listens for new clients trying to connect
+ * [PRIVATE] Takes over from the server running on the hand-off socket, if any (hot restart)
+ * @param snapshot Container for what was handed over (kept even when the hand-off broke off)
+ * @return Success (false when no server was running or the hand-off broke off)
  */
-void Server::runConnectionEventLoop() {
-    std::cout << "[proxy::Server::runConnectionEventLoop()] Waiting for connections..." << std::endl;
+bool Server::takeOver( Handoff::Snapshot_t & snapshot ) {
+    const auto channel_fd = Handoff::connect( _options.handoff_path );
 
-    char                    address[INET6_ADDRSTRLEN];
-    struct sockaddr_storage client_socket_addr      = {};
-    socklen_t               client_socket_addr_size = sizeof client_socket_addr;
+    if( channel_fd == -1 ) {
+        LOG_INFO( "[proxy::Server::takeOver()] No server running on " << _options.handoff_path << ", starting afresh." );
+        return false; //EARLY RETURN
+    }
 
-    while( _run_flag ) {
-        struct epoll_event event_buff[EPOLL_ARRAY_SIZE];
+    LOG_INFO( "[proxy::Server::takeOver()] Taking over from the server running on " << _options.handoff_path << "..." );
 
-        int event_count = epoll_wait( _server_socket_epoll_fd, event_buff, EPOLL_ARRAY_SIZE, -1 );
+    const bool success = Handoff( channel_fd ).receive( snapshot );
 
-        for( int i = 0; i < event_count && event_buff[i].data.fd != _unblock_event_fd; ++i ) {
-            FileDescriptor_t client_fd = ::accept( _server_socket_fd, ( struct sockaddr * ) &client_socket_addr, &client_socket_addr_size );
+    LOG_INFO( "[proxy::Server::takeOver()] "
+              << "Received " << snapshot.listeners.size() << " listener(s), "
+              << snapshot.pending.size() << " pending client(s) and "
+              << snapshot.pairings.size() << " pairing(s)" << ( success ? "" : " (hand-off broke off)" ) );
 
-            if( client_fd == -1 ) {
-                ::perror( "[proxy::Server::runConnectionEventLoop()] error" );
-                continue;
-            }
+    return success;
+}
 
-            const auto & socket_addr = (struct sockaddr *) &client_socket_addr;
+/**
+ * [PRIVATE] Resumes the pairings and pending clients handed over by the previous process
+ * (called once the proxy workers are running, before the pending thread starts; deadlines start over)
+ * @param snapshot What was handed over
+ */
+void Server::importSnapshot( Handoff::Snapshot_t & snapshot ) {
+    for( auto & pairing : snapshot.pairings ) {
+        const auto fd1    = pairing.fds[0];
+        const auto fd2    = pairing.fds[1];
+        const auto secret = _secrets.acquire( pairing.secret );
 
-            if( socket_addr->sa_family == AF_INET ) { //IPv4
-                ::inet_ntop( client_socket_addr.ss_family, &((struct sockaddr_in *) socket_addr )->sin_addr, address, sizeof address );
-            } else { //IPv6
-                ::inet_ntop( client_socket_addr.ss_family, &((struct sockaddr_in6 *) socket_addr )->sin6_addr, address, sizeof address );
-            }
+        _secrets.acquire( pairing.secret ); //1 reference per client
+
+        auto & proxy_worker = selectProxyWorker( fd1, fd2 );
+
+        if( !proxy_worker.resumePairing( std::move( pairing ), secret ) ) {
+            LOG_ERROR( "[proxy::Server::importSnapshot(..)] "
+                       << "Failed to hand pairing " << fd1 << " <-> " << fd2
+                       << " to proxy worker #" << proxy_worker.id() << " (not running)" );
+
+            _secrets.release( secret );
+            _secrets.release( secret );
+            ::close( fd1 );
+            ::close( fd2 );
+        }
+    }
+
+    for( auto & pending : snapshot.pending ) { //in the order they were waiting
+        auto & client = _pending_clients.insert( pending.fd );
 
-            std::cout << "[proxy::Server::runConnectionEventLoop()] New client " << address << std::endl;
+        client.handshake.feed( pending.handshake.data(), pending.handshake.size() );
+        client.frames = pending.frames;
 
-            Server::modifyEPOLL( _epoll_pending_fd, client_fd, EPOLL_CTL_ADD, EPOLLIN );
+        if( client.handshake.failed() || !Server::modifyEPOLL( _epoll_pending_fd, pending.fd, EPOLL_CTL_ADD, EPOLLIN ) ) {
+            dropPendingClient( pending.fd );
 
-            ::fcntl( client_fd, F_SETFL, O_NONBLOCK ); //non-blocking so we can 'poll'
+        } else if( client.handshake.complete() ) {
+            internSecret( pending.fd );
+            matchPendingClient( pending.fd, _options.pairing_timeout_ms );
+
+        } else {
+            schedulePendingTimeout( pending.fd, _options.handshake_timeout_ms );
         }
     }
 
-    std::cout << "Exiting runConnectionEventLoop()" << std::endl;
+    _pending_metrics.pending_clients.set( _pending_clients.size() );
 }
 
 /**
- * [PRIVATE] Processes new and pending clients to pair them when possible
+ * [PRIVATE] Waits for a new process to connect to the hand-off socket and hands everything over to it
  */
-void Server::runPendingEventLoop() {
-    std::unordered_map<FileDescriptor_t, HandshakeState>     negotiations;
-    std::unordered_map<FileDescriptor_t, Secret_t>           fd_to_secret;
-    std::unordered_map<Secret_t, std::set<FileDescriptor_t>> ready;
+void Server::runHandoffLoop() {
+    LOG_INFO( "[proxy::Server::runHandoffLoop()] Accepting hand-offs on " << _options.handoff_path );
+
+    struct pollfd fds[2] = { { _handoff_fd, POLLIN, 0 }, { _unblock_event_fd, POLLIN, 0 } };
 
     while( _run_flag ) {
-        struct epoll_event event_buff[EPOLL_ARRAY_SIZE];
+        if( ::poll( fds, 2, -1 ) == -1 ) {
+            if( errno != EINTR ) {
+                LOG_ERROR( "[proxy::Server::runHandoffLoop()] error: " << ::strerror( errno ) );
+                break;
+            }
 
-        int event_count = epoll_wait( _epoll_pending_fd, event_buff, EPOLL_ARRAY_SIZE, -1 );
+            continue;
+        }
 
-        for( int i = 0; i < event_count && event_buff[i].data.fd != _unblock_event_fd; ++i ) {
-            if( event_buff[i].data.fd == _unblock_event_fd ) {
-                continue; //skip
-            }
+        if( !( fds[0].revents & POLLIN ) ) {
+            continue; //i.e.: `stop()` was called
+        }
 
-            FileDescriptor_t client_fd = event_buff[i].data.fd;
+        const auto channel_fd = Handoff::accept( _handoff_fd );
 
-            if( !negotiations.contains( client_fd ) ) {
-                negotiations.emplace( client_fd, HandshakeState::INIT );
-            }
+        if( channel_fd == -1 ) {
+            continue;
+        }
 
-            auto       secret               = std::string();
-            auto       negotiation_entry_it = negotiations.find( client_fd );
-            auto &     prev_handshake_state = negotiation_entry_it->second;
-            const auto new_handshake_state  = processHandshake( client_fd, prev_handshake_state, secret );
+        if( !halt() ) { //stopping already
+            ::close( channel_fd );
+            break;
+        }
 
-            switch( new_handshake_state ) {
-                case HandshakeState::READY: {
-                    auto ready_it = ready.find( secret );
+        handOff( channel_fd );
+    }
 
-                    if( ready_it != ready.end() && !ready_it->second.empty() ) {
-                        auto pairing_candidate_it = ready_it->second.begin();
+    LOG_DEBUG( "Exiting runHandoffLoop()" );
+}
 
-                        Server::modifyEPOLL( _epoll_pending_fd, client_fd, EPOLL_CTL_DEL, EPOLLIN );
-                        Server::modifyEPOLL( _epoll_pending_fd, *pairing_candidate_it, EPOLL_CTL_DEL, EPOLLIN );
+/**
+ * [PRIVATE] Hands the listeners, pending clients and pairings of the halted server over to a new process
+ * (the clients are never closed here: the process exiting only drops its references to them)
+ * @param channel_fd Hand-off channel to the new process
+ */
+void Server::handOff( FileDescriptor_t channel_fd ) {
+    auto   handoff       = Handoff( channel_fd );
+    auto   pending_fds   = std::vector<FileDescriptor_t>();
+    bool   success       = true;
+    size_t pending_count = 0;
+    size_t pairing_count = 0;
+
+    for( const auto & acceptor : _acceptors ) {
+        success = success && handoff.sendListener( acceptor.socket_fd );
+    }
 
-                        { //move client pairing to main proxy loop
-                            std::lock_guard<std::mutex> guard( _pairings_mutex );
+    Handover_t handover {};
 
-                            _pairings.emplace( client_fd, *pairing_candidate_it );
-                            _pairings.emplace( *pairing_candidate_it, client_fd );
+    while( _handovers.tryPop( handover ) ) { //never picked up
+        if( handover.fd == -1 ) {
+            continue;
+        }
 
-                            Server::modifyEPOLL( _epoll_paired_fd, client_fd, EPOLL_CTL_ADD, EPOLLIN );
-                            Server::modifyEPOLL( _epoll_paired_fd, *pairing_candidate_it, EPOLL_CTL_ADD, EPOLLIN );
-                        }
+        auto client = Handoff::Pending_t { handover.fd };
 
-                        Server::send( client_fd, "READY" );
-                        Server::send( *pairing_candidate_it, "READY" );
+        if( handover.secret != container::InternTable::INVALID_HANDLE ) { //re-queued by a proxy worker
+            client.handshake = HandshakeParser::compose( _secrets.view( handover.secret ), handover.framed, handover.compressed );
+        }
 
-                        std::cout << "[proxy::Server::runPendingEventLoop()] "
-                                  << "Client pairing created: " << client_fd << " <-> " << *pairing_candidate_it
-                                  << std::endl;
+        success = success && handoff.sendPending( client );
+        ++pending_count;
+    }
 
-                        //cleanup
-                        negotiations.erase( negotiation_entry_it );
-                        negotiations.erase( *pairing_candidate_it );
-                        fd_to_secret.erase( *pairing_candidate_it );
-                        ready_it->second.erase( pairing_candidate_it );
+    _pending_clients.forEach( [&pending_fds]( FileDescriptor_t fd, PendingClient_t & ) { pending_fds.emplace_back( fd ); } );
 
-                    } else {
-                        auto [it, inserted] = ready.try_emplace( secret, std::set<FileDescriptor_t>() );
+    std::stable_sort( pending_fds.begin(), pending_fds.end(), [this]( FileDescriptor_t a, FileDescriptor_t b ) {
+        return _pending_clients.at( a ).ready_at < _pending_clients.at( b ).ready_at; //longest waiting matched first
+    } );
 
-                        if( it != ready.end() ) {
-                            it->second.emplace( client_fd );
-                            fd_to_secret.emplace( client_fd, secret );
+    for( const auto fd : pending_fds ) {
+        const auto & client = _pending_clients.at( fd );
 
-                        } else {
-                            std::cerr << "[proxy::Server::runPendingEventLoop()] "
-                                      << "Failed to add client " << client_fd << " to 'ready' collection."
-                                      << std::endl;
-                        }
-                    }
-                } break;
+        if( client.tls ) {
+            continue; //the TLS handshake's state can't leave the process: dropped
+        }
 
-                case HandshakeState::DCN: {
-                    if( !Server::modifyEPOLL( _epoll_pending_fd, client_fd, EPOLL_CTL_DEL, EPOLLIN ) ) {
-                        std::cerr << "[proxy::Server::runPendingEventLoop()] "
-                                  << "Failed to remove client file descriptor from pending epoll: " << client_fd
-                                  << std::endl;
+        success = success && handoff.sendPending( Handoff::Pending_t {
+            fd,
+            ( client.handshake.complete() ? HandshakeParser::compose( _secrets.view( client.secret ), client.handshake.framed(), client.handshake.compressed() ) : client.handshake.received() ),
+            client.frames
+        } );
 
-                    } else if( prev_handshake_state == HandshakeState::READY ) {
-                        std::cout << "[proxy::Server::processHandshake(..)] "
-                                  << "Client " << client_fd << " disconnected"
-                                  << std::endl;
+        ++pending_count;
+    }
 
-                        auto it = fd_to_secret.find( client_fd );
+    for( auto & worker : _proxy_workers ) {
+        pairing_count += worker->exportPairings( [&]( Handoff::Pairing_t & pairing, Secret_t secret ) {
+            pairing.secret = _secrets.view( secret );
+            success        = success && handoff.sendPairing( pairing );
+        } );
 
-                        if( it != fd_to_secret.end() ) {
-                            auto ready_it = ready.find( it->second );
+        pending_count += worker->exportMembers( [&]( Handoff::Pending_t & member, Secret_t secret ) { //re-join on the other side
+            member.handshake = HandshakeParser::compose( _secrets.view( secret ), true );
+            success          = success && handoff.sendPending( member );
+        } );
+    }
 
-                            if( ready_it != ready.end() ) {
-                                ready_it->second.erase( client_fd );
-                            }
+    success = success && handoff.finish();
 
-                            if( ready_it->second.empty() ) {
-                                ready.erase( ready_it );
-                            }
-                        }
+    if( success ) {
+        LOG_INFO( "[proxy::Server::handOff(..)] "
+                  << "Handed " << _acceptors.size() << " listener(s), " << pending_count << " pending client(s) and "
+                  << pairing_count << " pairing(s) over to the new process" );
+    } else {
+        LOG_ERROR( "[proxy::Server::handOff(..)] Hand-off to the new process broke off (clients not handed over are dropped)." );
+    }
+
+    _handed_off = true;
+}
+
+/**
+ * [PRIVATE] Listens for new clients trying to connect
+ * @param acceptor Acceptor (listening socket + epoll)
+ */
+void Server::runConnectionEventLoop( Acceptor_t & acceptor ) {
+    LOG_INFO( "[proxy::Server::runConnectionEventLoop( " << acceptor.socket_fd << " )] Waiting for connections..." );
+
+    while( _run_flag ) {
+        struct epoll_event event_buff[EPOLL_ARRAY_SIZE];
+
+        int event_count = epoll_wait( acceptor.epoll_fd, event_buff, EPOLL_ARRAY_SIZE, -1 );
+
+        size_t accepted = 0;
+
+        for( int i = 0; i < event_count && event_buff[i].data.fd != _unblock_event_fd; ++i ) {
+            while( true ) { //edge-triggered: accept the whole backlog
+                struct sockaddr_storage client_socket_addr      = {};
+                socklen_t               client_socket_addr_size = sizeof client_socket_addr;
+
+                const FileDescriptor_t client_fd = ::accept4( acceptor.socket_fd,
+                                                              ( struct sockaddr * ) &client_socket_addr,
+                                                              &client_socket_addr_size,
+                                                              SOCK_NONBLOCK | SOCK_CLOEXEC ); //non-blocking so we can 'poll'
+
+                if( client_fd == -1 ) {
+                    if( errno == EINTR || errno == ECONNABORTED ) {
+                        continue;
+                    }
 
-                        fd_to_secret.erase( it );
-                        negotiations.erase( client_fd );
+                    if( errno != EAGAIN && errno != EWOULDBLOCK ) {
+                        LOG_ERROR( "[proxy::Server::runConnectionEventLoop( " << acceptor.socket_fd << " )] error: " << ::strerror( errno ) );
+                        acceptor.metrics->errors.add();
                     }
-                } break;
 
-                default: break; //i.e.: pending handshake completion
+                    break;
+                }
+
+                LOG_DEBUG( "[proxy::Server::runConnectionEventLoop( " << acceptor.socket_fd << " )] "
+                           << "New client " << client_fd << " (" << Server::toString( client_socket_addr ) << ")" );
+
+                _options.socket_tuning.applyAccepted( client_fd ); //not inherited from the listener (best effort)
+
+                if( _handovers.tryPush( Handover_t { client_fd } ) ) {
+                    ++accepted;
+
+                } else {
+                    LOG_ERROR( "[proxy::Server::runConnectionEventLoop( " << acceptor.socket_fd << " )] "
+                               << "Failed to hand client " << client_fd << " to the pending thread (queue full)" );
+                    acceptor.metrics->dropped.add();
+                    ::close( client_fd );
+                }
             }
+        }
 
-            prev_handshake_state = new_handshake_state;
+        if( accepted > 0 ) {
+            acceptor.metrics->accepted.add( accepted );
+            Server::signalEvent( _handover_event_fd ); //once per batch
         }
     }
 
-    std::cout << "Exiting runPendingEventLoop()" << std::endl;
+    LOG_DEBUG( "Exiting runConnectionEventLoop( " << acceptor.socket_fd << " )" );
 }
 
 /**
- * [PRIVATE] Runs the proxy event loop (message forwarding)
+ * [PRIVATE] Processes new and pending clients to pair them when possible
  */
-void Server::runProxyEventLoop() {
+void Server::runPendingEventLoop() {
     while( _run_flag ) {
-        char               in_buffer [INPUT_BUFFER_SIZE];
         struct epoll_event event_buff[EPOLL_ARRAY_SIZE];
-        FileDescriptor_t   counterpart_fd = -1;
 
-        int event_count = epoll_wait( _epoll_paired_fd, event_buff, EPOLL_ARRAY_SIZE, -1 );
+        int event_count = epoll_wait( _epoll_pending_fd, event_buff, EPOLL_ARRAY_SIZE, -1 );
 
         for( int i = 0; i < event_count; ++i ) {
             if( event_buff[i].data.fd == _unblock_event_fd ) {
                 continue; //skip
             }
 
-            {
-                std::lock_guard<std::mutex> guard( _pairings_mutex );
-                counterpart_fd = _pairings.at( event_buff[ i ].data.fd ); //unsafe but should be there
+            if( event_buff[i].data.fd == _handover_event_fd ) {
+                acceptHandovers();
+                continue;
             }
 
-            auto in_bytes = ::recv( event_buff[i].data.fd, in_buffer, ( INPUT_BUFFER_SIZE - 1 ), 0 );
-
-            if( in_bytes > 0 ) {
-                std::cout << "[proxy::Server::runProxyEventLoop()] "
-                          << event_buff[i].data.fd << " -> " << counterpart_fd << ": "
-                          << std::string( in_buffer, in_bytes )
-                          << std::endl;
+            if( event_buff[i].data.fd == _pending_timer_fd ) {
+                uint64_t expirations = 0;
 
-                if( ::send( counterpart_fd, in_buffer, in_bytes, 0 ) == -1 ) {
-                    ::perror( "[proxy::Server::runProxyEventLoop()] error" );
+                if( ::read( _pending_timer_fd, &expirations, sizeof( expirations ) ) == -1 && errno != EAGAIN ) {
+                    LOG_ERROR( "[proxy::Server::runPendingEventLoop()] error: " << ::strerror( errno ) );
                 }
 
-            } else if( in_bytes == 0 ) {
-                std::cout << "[proxy::Server::runProxyEventLoop(..)] "
-                          << "Client " << event_buff[i].data.fd << " disconnected"
-                          << std::endl;
+                expirePendingClients();
+                continue;
+            }
 
-                send( counterpart_fd, "DISCONNECTED" );
-                _pairings.erase( event_buff[i].data.fd );
-                _pairings.erase( counterpart_fd );
-                ::close( event_buff[i].data.fd );
-                ::close( counterpart_fd );
+            const FileDescriptor_t client_fd = event_buff[i].data.fd;
+            auto *                 client    = _pending_clients.find( client_fd );
 
-                std::cout << "[proxy::Server::runProxyEventLoop(..)] "
-                          << "Disconnected client" << counterpart_fd
-                          << std::endl;
+            if( client == nullptr ) {
+                continue; //i.e.: dropped earlier in the same batch of events
+            }
 
-            } else {
-                ::perror( "[proxy::Server::runProxyEventLoop()] error" );
+            if( client->tls && !secureClient( client_fd, *client, event_buff[i].events ) ) {
+                continue; //TLS handshake in progress (or failed)
             }
+
+            const bool was_ready           = client->handshake.complete();
+            const auto new_handshake_state = Handshake::receive( client_fd, client->handshake, client->frames );
+
+            countHandshakeEnd( client->handshake, new_handshake_state, was_ready );
+
+            if( new_handshake_state == HandshakeState::READY && !was_ready ) {
+                internSecret( client_fd );
+                matchPendingClient( client_fd, _options.pairing_timeout_ms );
+
+            } else if( new_handshake_state == HandshakeState::DCN ) {
+                if( !Server::modifyEPOLL( _epoll_pending_fd, client_fd, EPOLL_CTL_DEL, EPOLLIN ) ) {
+                    LOG_ERROR( "[proxy::Server::runPendingEventLoop()] "
+                               << "Failed to remove client file descriptor from pending epoll: " << client_fd );
+                }
+
+                dropPendingClient( client_fd );
+            } //else: pending handshake completion
         }
+
+        _pending_metrics.pending_clients.set( _pending_clients.size() );
     }
 
-    std::cout << "Exiting runProxyEventLoop()" << std::endl;
+    LOG_DEBUG( "Exiting runPendingEventLoop()" );
 }
 
 /**
- * [PRIVATE] Process connection handshake for a client
- * @param client_fd Client file descriptor
- * @param cxn_state Client connection handshake state
- * @param secret    Reference to string to store secret into
- * @return Handshake state post-processing
+ * [PRIVATE] Accepts, processes new and pending clients to pair them when possible via io_uring
+ * (replaces both `runConnectionEventLoop()` and `runPendingEventLoop()`)
  */
-fwd_proxy::HandshakeState Server::processHandshake( FileDescriptor_t client_fd, HandshakeState cxn_state, Secret_t & secret  ) {
-    auto new_cxn_state = cxn_state;
+void Server::runUringPendingEventLoop() {
+    LOG_INFO( "[proxy::Server::runUringPendingEventLoop()] Waiting for connections..." );
 
-    switch( cxn_state ) {
-        case HandshakeState::INIT: {
-            static const size_t AUTH_MSG_LEN = 5;
+    struct UringClient_t {
+        std::unique_ptr<char[]> buffer;            //allocated apart so it doesn't move under an in-flight receive when `clients` grows
+        FileDescriptor_t        handoff_fd { -1 }; //client waiting for this one's receive to be cancelled before pairing
+    };
 
-            char buffer[AUTH_MSG_LEN];
-            auto bytes = Server::rcv( client_fd, buffer, AUTH_MSG_LEN );
+    auto &   ring           = *_pending_ring;
+    uint64_t wake_count     = 0;
+    uint64_t expirations    = 0;
+    uint64_t handover_count = 0;
+    auto     clients        = container::FdTable<UringClient_t>( PENDING_TABLE_SIZE );
 
-            if( bytes == 5 ) {
-                const auto str = std::string( buffer, bytes );
+    const auto armRecv = [&]( FileDescriptor_t fd ) {
+        auto & client = clients.at( fd );
 
-                if( str == "AUTH0" ) {
-                    new_cxn_state = HandshakeState::READY;
+        if( !client.buffer ) {
+            client.buffer = std::make_unique<char[]>( INPUT_BUFFER_SIZE );
+        }
 
-                } else if( str == "AUTH1" ) {
-                    new_cxn_state = HandshakeState::AUTH1;
+        ring.prepareRecv( fd, client.buffer.get(), INPUT_BUFFER_SIZE, uringUserData( UringOp::RECV, fd ) );
+    };
 
-                } else {
-                    std::cerr << "[proxy::Server::processHandshake(..)] "
-                              << "Unexpected AUTH bytes sent from client " << client_fd << ": " << str
-                              << std::endl;
-                    Server::send( client_fd, "WTF?" );
-                    new_cxn_state = HandshakeState::DCN;
-                }
+    const auto dropClient = [&]( FileDescriptor_t fd ) {
+        clients.erase( fd );
+        dropPendingClient( fd );
+    };
 
-            } else if( bytes == 0 ) {
-                std::cout << "[proxy::Server::processHandshake(..)] "
-                          << "Client " << client_fd << " disconnected"
-                          << std::endl;
-                new_cxn_state = HandshakeState::DCN;
+    const auto onReady = [&]( FileDescriptor_t fd, uint64_t timeout_ms ) {
+        const auto candidate_fd = takeCandidate( fd, []( FileDescriptor_t dropped_fd ) {
+            ::shutdown( dropped_fd, SHUT_RDWR ); //pending receive completes empty and the client is dropped from there
+        } );
 
-            } else {
-                std::cerr << "[proxy::Server::processHandshake(..)] "
-                          << "Unexpected content (" << bytes << " bytes) sent from client " << client_fd << ": "
-                          << std::string( buffer, bytes )
-                          << std::endl;
-                Server::send( client_fd, "WTF?" );
-                new_cxn_state = HandshakeState::DCN;
-            }
-        } break;
+        if( candidate_fd != -1 ) { //candidate's pending receive needs to be cancelled first
+            _pending_timers.cancel( fd );
+            _pending_timers.cancel( candidate_fd );
+            clients.at( candidate_fd ).handoff_fd = fd;
+            ring.prepareCancel( candidate_fd, uringUserData( UringOp::CANCEL, candidate_fd ) );
 
-        case HandshakeState::AUTH1: { //connection with secret
-            static const size_t SECRET_MAX_LEN = 64;
+        } else {
+            schedulePendingTimeout( fd, timeout_ms );
+            armRecv( fd ); //to catch disconnections
+        }
+    };
 
-            char buffer[SECRET_MAX_LEN];
-            auto bytes = Server::rcvUntil( client_fd, buffer, SECRET_MAX_LEN, isspace );
+    const auto acceptHandovers = [&]() { //orphaned clients only (new clients come from the multishot accepts)
+        Handover_t handover {};
 
-            if( bytes > 0 ) {
-                secret = std::string( buffer, bytes );
-                std::cout << "[proxy::Server::processHandshake(..)] "
-                          << "Client " << client_fd << " secret: " << secret
-                          << std::endl;
-                new_cxn_state = HandshakeState::READY;
+        while( _handovers.tryPop( handover ) ) {
+            if( handover.fd == -1 ) {
+                _secrets.release( handover.secret );
 
             } else {
-                std::cout << "[proxy::Server::processHandshake(..)] "
-                          << "Client " << client_fd << " disconnected"
-                          << std::endl;
-                new_cxn_state = HandshakeState::DCN;
+                restorePendingClient( handover.fd, handover.secret, handover.framed, handover.compressed );
+                clients.insert( handover.fd );
+                onReady( handover.fd, _options.orphan_grace_ms );
             }
-        } break;
-
-        case HandshakeState::READY: {
-            char buffer[INPUT_BUFFER_SIZE];
-            auto bytes = Server::rcv( client_fd, buffer, INPUT_BUFFER_SIZE );
+        }
+    };
 
-            if( bytes == 0 ) {
-                new_cxn_state = HandshakeState::DCN;
-            } //else: drop
-        } break;
+    ring.prepareRead( _unblock_event_fd, &wake_count, sizeof( wake_count ), uringUserData( UringOp::WAKE, _unblock_event_fd ) );
+    ring.prepareRead( _pending_timer_fd, &expirations, sizeof( expirations ), uringUserData( UringOp::TIMER, _pending_timer_fd ) );
+    ring.prepareRead( _handover_event_fd, &handover_count, sizeof( handover_count ), uringUserData( UringOp::HANDOVER, _handover_event_fd ) );
 
-        default: {
-            new_cxn_state = HandshakeState::READY;
-        } break;
+    for( const auto & acceptor : _acceptors ) {
+        ring.prepareAcceptMultishot( acceptor.socket_fd, uringUserData( UringOp::ACCEPT, acceptor.socket_fd ) );
     }
 
-    if( new_cxn_state != cxn_state ) {
-        std::cout << "[proxy::Server::processHandshake(..)] Client " << client_fd << " handshake state: " << new_cxn_state << std::endl;
-    }
+    while( _run_flag ) {
+        if( ring.submit( 1 ) < 0 ) {
+            LOG_ERROR( "[proxy::Server::runUringPendingEventLoop()] error: " << ::strerror( errno ) );
+            continue;
+        }
 
-    return new_cxn_state;
-}
+        ring.processCompletions( [&]( const struct io_uring_cqe & cqe ) {
+            const auto op = uringOp( cqe.user_data );
+            const auto fd = uringFd( cqe.user_data );
+
+            switch( op ) {
+                case UringOp::ACCEPT: {
+                    auto & acceptor_metrics = *std::find_if( _acceptors.begin(), _acceptors.end(), [fd]( const auto & acceptor ) {
+                        return acceptor.socket_fd == fd;
+                    } )->metrics;
+
+                    if( cqe.res >= 0 ) {
+                        acceptor_metrics.accepted.add();
+                        LOG_DEBUG( "[proxy::Server::runUringPendingEventLoop()] New client " << cqe.res );
+                        _options.socket_tuning.applyAccepted( cqe.res ); //not inherited from the listener (best effort)
+                        _pending_clients.insert( cqe.res );
+                        clients.insert( cqe.res );
+                        schedulePendingTimeout( cqe.res, _options.handshake_timeout_ms );
+                        armRecv( cqe.res );
 
+                    } else {
+                        LOG_ERROR( "[proxy::Server::runUringPendingEventLoop()] accept error: " << ::strerror( -cqe.res ) );
+                        acceptor_metrics.errors.add();
+                    }
+
+                    if( !( cqe.flags & IORING_CQE_F_MORE ) && _run_flag ) {
+                        ring.prepareAcceptMultishot( fd, uringUserData( UringOp::ACCEPT, fd ) );
+                    }
+                } break;
+
+                case UringOp::RECV: {
+                    auto * client = clients.find( fd );
+
+                    if( client == nullptr ) {
+                        break; //i.e.: not tracked
+                    }
+
+                    if( client->handoff_fd != -1 ) { //cancelled for pairing
+                        const auto partner_fd = client->handoff_fd;
+
+                        auto &     pending = _pending_clients.at( fd );
+                        const bool torn    = ( cqe.res > 0 && ( Handshake::process( fd, pending.handshake, pending.frames, client->buffer.get(), cqe.res ) != HandshakeState::READY
+                                                             || !pending.frames.boundary() ) ); //framed candidate caught in the middle of a frame
+
+                        if( cqe.res == 0 || ( cqe.res < 0 && cqe.res != -ECANCELED ) || torn ) { //candidate left in the meantime
+                            LOG_INFO( "[proxy::Server::runUringPendingEventLoop()] "
+                                      << "Client " << fd << ( torn ? " dropped (sent part of a frame before being paired)" : " disconnected" ) );
+
+                            dropClient( fd );
+                            onReady( partner_fd, _options.pairing_timeout_ms );
+
+                        } else { //anything received before the pairing is dropped
+                            clients.erase( fd );
+                            clients.erase( partner_fd );
+                            pairClients( partner_fd, fd );
+                        }
+
+                        break;
+                    }
+
+                    if( cqe.res < 0 ) {
+                        errno = -cqe.res;
+                    }
+
+                    auto &     pending   = _pending_clients.at( fd );
+                    const bool was_ready = pending.handshake.complete();
+                    const auto new_state = Handshake::process( fd, pending.handshake, pending.frames, client->buffer.get(), ( cqe.res < 0 ? -1 : cqe.res ) );
+
+                    countHandshakeEnd( pending.handshake, new_state, was_ready );
+
+                    if( new_state == HandshakeState::READY && !was_ready ) {
+                        internSecret( fd );
+                        onReady( fd, _options.pairing_timeout_ms );
+
+                    } else if( new_state == HandshakeState::DCN ) {
+                        dropClient( fd );
+
+                    } else {
+                        armRecv( fd );
+                    }
+                } break;
+
+                case UringOp::TIMER: {
+                    expirePendingClients();
+
+                    if( _run_flag ) {
+                        ring.prepareRead( _pending_timer_fd, &expirations, sizeof( expirations ), uringUserData( UringOp::TIMER, _pending_timer_fd ) );
+                    }
+                } break;
+
+                case UringOp::HANDOVER: {
+                    acceptHandovers();
+
+                    if( _run_flag ) {
+                        ring.prepareRead( _handover_event_fd, &handover_count, sizeof( handover_count ), uringUserData( UringOp::HANDOVER, _handover_event_fd ) );
+                    }
+                } break;
+
+                case UringOp::WAKE:   [[fallthrough]]; //i.e.: `stop()` was called
+                case UringOp::CANCEL: [[fallthrough]];
+                default: break;
+            }
+        } );
+
+        _pending_metrics.pending_clients.set( _pending_clients.size() );
+    }
+
+    clients.forEach( []( FileDescriptor_t fd, UringClient_t & ) { ::close( fd ); } );
+
+    LOG_DEBUG( "Exiting runUringPendingEventLoop()" );
+}
 
 /**
- * [PRIVATE] Sends a message to a client file descriptor
+ * [PRIVATE] Starts tracking the clients handed over by the connection threads (new) and the proxy workers (orphaned)
+ */
+void Server::acceptHandovers() {
+    uint64_t count = 0;
+
+    if( ::read( _handover_event_fd, &count, sizeof( uint64_t ) ) == -1 && errno != EAGAIN ) { //reset before draining so no signal is missed
+        LOG_ERROR( "[proxy::Server::acceptHandovers()] error: " << ::strerror( errno ) );
+    }
+
+    Handover_t handover {};
+
+    while( _handovers.tryPop( handover ) ) {
+        const auto client_fd = handover.fd;
+
+        if( client_fd == -1 ) { //client closed by a proxy worker
+            _secrets.release( handover.secret );
+            continue;
+        }
+
+        if( handover.secret == container::InternTable::INVALID_HANDLE ) {
+            auto & client = _pending_clients.insert( client_fd );
+
+            if( _tls && !( client.tls = _tls->accept( client_fd ) ) ) {
+                dropPendingClient( client_fd );
+                continue;
+            }
+
+        } else {
+            restorePendingClient( client_fd, handover.secret, handover.framed, handover.compressed );
+        }
+
+        if( !Server::modifyEPOLL( _epoll_pending_fd, client_fd, EPOLL_CTL_ADD, EPOLLIN ) ) {
+            dropPendingClient( client_fd );
+            continue;
+        }
+
+        if( handover.secret == container::InternTable::INVALID_HANDLE ) {
+            schedulePendingTimeout( client_fd, _options.handshake_timeout_ms );
+        } else {
+            matchPendingClient( client_fd, _options.orphan_grace_ms );
+        }
+    }
+}
+
+/**
+ * [PRIVATE] Disconnects the pending clients whose handshake or pairing deadline has passed
+ */
+void Server::expirePendingClients() {
+    _pending_timers.advance( container::TimerWheel::now(), [this]( container::TimerWheel::TimerId_t id ) {
+        const auto   client_fd = static_cast<FileDescriptor_t>( id );
+        const auto * client    = _pending_clients.find( client_fd );
+
+        if( client == nullptr ) {
+            return; //EARLY RETURN
+        }
+
+        LOG_INFO( "[proxy::Server::expirePendingClients()] "
+                  << "Client " << client_fd << ( client->handshake.complete() ? " pairing" : " handshake" ) << " timed out" );
+
+        if( client->handshake.complete() ) {
+            _pending_metrics.pairing_timeouts.add();
+        } else {
+            _pending_metrics.handshakes_timed_out.add();
+        }
+
+        if( _options.io_backend == IoBackend::IO_URING ) {
+            ::shutdown( client_fd, SHUT_RDWR ); //pending receive completes empty and the client is dropped from there
+        } else {
+            Server::modifyEPOLL( _epoll_pending_fd, client_fd, EPOLL_CTL_DEL, EPOLLIN );
+            dropPendingClient( client_fd );
+        }
+    } );
+}
+
+/**
+ * [PRIVATE] Gives a client back to the pending thread once its counterpart left (called from the proxy workers)
+ * @param client_fd Client file descriptor (-1 to only release the secret's reference of a client that was closed)
+ * @param secret Handle of the client's secret (reference handed over along with the client)
+ * @param framed Flag for a client using the framed protocol
+ * @param compressed Flag for a framed client compressing its payloads
+ * @return Success (false when the hand-over queue is full)
+ */
+bool Server::handBack( FileDescriptor_t client_fd, Secret_t secret, bool framed, bool compressed ) {
+    if( !_handovers.tryPush( Handover_t { client_fd, secret, framed, compressed } ) ) {
+        return false; //EARLY RETURN
+    }
+
+    Server::signalEvent( _handover_event_fd );
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Adds a client handed back by a proxy worker to the pending store, its handshake being already done
  * @param client_fd Client file descriptor
- * @param msg Message string to send
- * @return Success
+ * @param secret Handle of the client's secret (reference handed over along with the client)
+ * @param framed Flag for a client using the framed protocol
+ * @param compressed Flag for a framed client compressing its payloads
  */
-bool Server::send( FileDescriptor_t client_fd, const std::string &msg ) {
-    if( ::send( client_fd, msg.c_str(), msg.size(), 0 ) == -1 ) {
-        ::perror( "[proxy::Server::send(..)] error" );
-        return false;
+void Server::restorePendingClient( FileDescriptor_t client_fd, Secret_t secret, bool framed, bool compressed ) {
+    auto & client = _pending_clients.insert( client_fd );
+
+    client.handshake.skip( framed, compressed );
+    client.secret   = secret;
+    client.ready_at = metrics::Histogram::now();
+
+    _pending_metrics.requeued.add();
+
+    LOG_DEBUG( "[proxy::Server::restorePendingClient(..)] "
+               << "Client " << client_fd << " re-queued (counterpart left)" );
+}
+
+/**
+ * [PRIVATE] Moves the TLS handshake of a new client forward
+ * (once the kernel took the records over, the client goes on with the proxy's handshake as in cleartext)
+ * @param client_fd Client file descriptor (in the pending epoll)
+ * @param client Pending client (with a TLS session)
+ * @param events Epoll events the client was woken up with
+ * @return Secured state (false while the TLS handshake is in progress or when it failed and the client was dropped)
+ */
+bool Server::secureClient( FileDescriptor_t client_fd, PendingClient_t & client, uint32_t events ) {
+    const auto state = TlsContext::handshake( client.tls );
+
+    if( state == TlsState::FAILED ) {
+        _pending_metrics.handshakes_tls_failed.add();
+
+        if( !Server::modifyEPOLL( _epoll_pending_fd, client_fd, EPOLL_CTL_DEL, EPOLLIN ) ) {
+            LOG_ERROR( "[proxy::Server::secureClient(..)] "
+                       << "Failed to remove client file descriptor from pending epoll: " << client_fd );
+        }
+
+        dropPendingClient( client_fd );
+        return false; //EARLY RETURN
     }
 
+    if( state == TlsState::WANT_WRITE ) { //i.e.: socket buffer full (rare)
+        Server::modifyEPOLL( _epoll_pending_fd, client_fd, EPOLL_CTL_MOD, EPOLLOUT );
+        return false; //EARLY RETURN
+    }
+
+    if( events & EPOLLOUT ) { //back from waiting to write
+        Server::modifyEPOLL( _epoll_pending_fd, client_fd, EPOLL_CTL_MOD, EPOLLIN );
+    }
+
+    if( state == TlsState::WANT_READ ) {
+        return false; //EARLY RETURN
+    }
+
+    LOG_DEBUG( "[proxy::Server::secureClient(..)] TLS established with client " << client_fd << " (offloaded to the kernel)" );
+
+    client.tls.reset();
+
     return true;
 }
 
 /**
- * [PRIVATE] Receive characters from stream
+ * [PRIVATE] Interns the secret of a client that completed its handshake
+ * @param client_fd Client file descriptor
+ * @return Handle of the client's secret (empty when anonymous)
+ */
+Server::Secret_t Server::internSecret( FileDescriptor_t client_fd ) {
+    auto & client = _pending_clients.at( client_fd );
+
+    client.secret   = _secrets.acquire( client.handshake.secret() );
+    client.ready_at = metrics::Histogram::now();
+
+    return client.secret;
+}
+
+/**
+ * [PRIVATE] Pairs a client that completed its handshake with the longest waiting client sharing its secret
+ * (or adds it to the pool of clients waiting to be paired when there is none)
+ * @param client_fd Client file descriptor (in the pending epoll, with its secret interned)
+ * @param timeout_ms Time allowed to wait for a counterpart in ms (0 for no deadline)
+ */
+void Server::matchPendingClient( FileDescriptor_t client_fd, uint64_t timeout_ms ) {
+    if( _options.group_channels ) {
+        const auto & client = _pending_clients.at( client_fd );
+
+        if( client.handshake.framed() && !client.handshake.compressed() && !_secrets.view( client.secret ).empty() ) { //a compressed stream only decodes from its start
+            joinChannel( client_fd );
+            return; //EARLY RETURN
+        }
+    }
+
+    const auto candidate_fd = takeCandidate( client_fd, [this]( FileDescriptor_t fd ) { dropPendingClient( fd ); } );
+
+    if( candidate_fd != -1 ) {
+        Server::modifyEPOLL( _epoll_pending_fd, client_fd, EPOLL_CTL_DEL, EPOLLIN );
+        Server::modifyEPOLL( _epoll_pending_fd, candidate_fd, EPOLL_CTL_DEL, EPOLLIN );
+        pairClients( client_fd, candidate_fd );
+
+    } else {
+        schedulePendingTimeout( client_fd, timeout_ms );
+    }
+}
+
+/**
+ * [PRIVATE] Takes the longest waiting client sharing the secret and protocol of a client that completed its handshake
+ * (or queues the client when there is none). Framed candidates caught in the middle of sending a frame are dropped
+ * since the rest of that frame would reach their new counterpart without its header.
+ * @param client_fd Client file descriptor (with its secret interned)
+ * @param drop Callback to drop a candidate
+ * @return Candidate file descriptor (-1 when the client was queued instead)
+ */
+Server::FileDescriptor_t Server::takeCandidate( FileDescriptor_t client_fd, const std::function<void( FileDescriptor_t )> & drop ) {
+    const auto & client       = _pending_clients.at( client_fd );
+    auto         candidate_fd = _matchmaker.match( client_fd, client.secret, client.handshake.framed(), client.handshake.compressed() );
+
+    while( candidate_fd != -1 && !_pending_clients.at( candidate_fd ).frames.boundary() ) {
+        LOG_WARNING( "[proxy::Server::takeCandidate(..)] "
+                     << "Dropped client " << candidate_fd << " (sent part of a frame before being paired)" );
+
+        drop( candidate_fd );
+        candidate_fd = _matchmaker.match( client_fd, client.secret, client.handshake.framed(), client.handshake.compressed() );
+    }
+
+    return candidate_fd;
+}
+
+/**
+ * [PRIVATE] Sets the deadline of a pending client (replaces the current one)
  * @param client_fd Client file descriptor
- * @param buffer Buffer
- * @param buffer_size Buffer length
- * @return Number of bytes
+ * @param timeout_ms Time left in ms (0 for no deadline)
  */
-ssize_t Server::rcv( FileDescriptor_t client_fd, char * buffer, size_t buffer_size ) {
-    auto bytes = ::recv( client_fd, buffer, buffer_size, 0 );
+void Server::schedulePendingTimeout( FileDescriptor_t client_fd, uint64_t timeout_ms ) {
+    if( timeout_ms == 0 ) {
+        _pending_timers.cancel( client_fd );
+    } else {
+        _pending_timers.schedule( client_fd, container::TimerWheel::now() + timeout_ms );
+    }
+}
 
-    if( bytes < 0 ) {
-        ::perror( "[proxy::Server::rcv(..)] error" );
+/**
+ * [PRIVATE] Removes a client from the pending store
+ * @param client_fd Client file descriptor
+ * @return Handle of the client's secret (`INVALID_HANDLE` when not interned) whose reference now belongs to the caller
+ */
+Server::Secret_t Server::forgetPendingClient( FileDescriptor_t client_fd ) {
+    auto * client = _pending_clients.find( client_fd );
+
+    if( client == nullptr ) {
+        return container::InternTable::INVALID_HANDLE; //EARLY RETURN
     }
 
-    return bytes;
+    const auto secret = client->secret;
+
+    _matchmaker.remove( client_fd );
+    _pending_timers.cancel( client_fd );
+    _pending_clients.erase( client_fd );
+
+    return secret;
 }
 
 /**
- * [PRIVATE] Receive characters from stream until predicate is true
+ * [PRIVATE] Forgets about and closes a disconnected pending client (releasing its secret)
  * @param client_fd Client file descriptor
- * @param buffer Buffer
- * @param buffer_size Buffer length
- * @param predicate_fn Predicate function the stops when true
- * @return Number of bytes fetched before reaching end of buffer or byte covered by predicate (byte is dropped in that case)
  */
-size_t Server::rcvUntil( Server::FileDescriptor_t client_fd, char * buffer, size_t buffer_size, std::function<int( int )> predicate_fn ) {
-    size_t bytes = 0;
+void Server::dropPendingClient( FileDescriptor_t client_fd ) {
+    const auto secret = forgetPendingClient( client_fd );
 
-    while( bytes < buffer_size && read( client_fd, &buffer[bytes], 1 ) == 1 ) {
-        if( predicate_fn( buffer[bytes] ) ) {
-            break;
+    if( secret != container::InternTable::INVALID_HANDLE ) {
+        _secrets.release( secret );
+    }
+
+    ::close( client_fd );
+}
+
+/**
+ * [PRIVATE] Pairs 2 clients and hands them over to a proxy worker
+ * (the references each holds on the shared secret go along so that the worker can give them back)
+ * @param fd1 Client file descriptor
+ * @param fd2 Counterpart client file descriptor
+ */
+void Server::pairClients( FileDescriptor_t fd1, FileDescriptor_t fd2 ) {
+    const auto now = metrics::Histogram::now();
+
+    for( const auto fd : { fd1, fd2 } ) {
+        _pending_metrics.handshake_to_pair.record( now - _pending_clients.at( fd ).ready_at );
+    }
+
+    const bool framed     = _pending_clients.at( fd1 ).handshake.framed(); //same protocol
+    const bool compressed = _pending_clients.at( fd1 ).handshake.compressed();
+    const auto secret = forgetPendingClient( fd1 );
+
+    forgetPendingClient( fd2 ); //same secret
+
+    const auto ready = ( framed ? FrameCursor::encode( FrameType::READY ) : std::string( "READY" ) );
+
+    if( !Server::send( fd1, ready ) || !Server::send( fd2, ready ) ) { //a partial `READY` frame would corrupt the stream
+        LOG_WARNING( "[proxy::Server::pairClients(..)] "
+                     << "Dropped pairing " << fd1 << " <-> " << fd2 << " (`READY` not sent)" );
+
+        _secrets.release( secret );
+        _secrets.release( secret );
+        ::close( fd1 );
+        ::close( fd2 );
+        return; //EARLY RETURN
+    }
+
+    auto & proxy_worker = selectProxyWorker( fd1, fd2 );
+
+    if( proxy_worker.addPairing( fd1, fd2, secret, framed, compressed ) ) { //move client pairing to a proxy worker
+        LOG_INFO( "[proxy::Server::pairClients(..)] "
+                  << "Client pairing created: " << fd1 << " <-> " << fd2
+                  << " (proxy worker #" << proxy_worker.id() << ")" );
+
+        _pending_metrics.pairs.add();
+
+    } else {
+        LOG_ERROR( "[proxy::Server::pairClients(..)] "
+                   << "Failed to hand pairing " << fd1 << " <-> " << fd2
+                   << " to proxy worker #" << proxy_worker.id() << " (queue full)" );
+
+        _secrets.release( secret );
+        _secrets.release( secret );
+        ::close( fd1 );
+        ::close( fd2 );
+    }
+}
+
+/**
+ * [PRIVATE] Hands a client that completed its handshake over to the proxy worker holding its secret's group channel
+ * (a channel lives on 1 worker picked by hashing its secret so that no state is shared between the workers)
+ * @param client_fd Client file descriptor (in the pending epoll, with its secret interned)
+ */
+void Server::joinChannel( FileDescriptor_t client_fd ) {
+    if( !_pending_clients.at( client_fd ).frames.boundary() ) {
+        LOG_WARNING( "[proxy::Server::joinChannel(..)] "
+                     << "Dropped client " << client_fd << " (sent part of a frame before joining its channel)" );
+
+        dropPendingClient( client_fd );
+        return; //EARLY RETURN
+    }
+
+    _pending_metrics.handshake_to_pair.record( metrics::Histogram::now() - _pending_clients.at( client_fd ).ready_at );
+
+    Server::modifyEPOLL( _epoll_pending_fd, client_fd, EPOLL_CTL_DEL, EPOLLIN );
+
+    const auto secret = forgetPendingClient( client_fd );
+    const auto hash   = std::hash<std::string_view>()( _secrets.view( secret ) );
+    auto &     worker = *_proxy_workers[ hash % _proxy_workers.size() ];
+
+    if( !worker.addMember( client_fd, secret ) ) {
+        LOG_ERROR( "[proxy::Server::joinChannel(..)] "
+                   << "Failed to hand client " << client_fd << " to proxy worker #" << worker.id() << " (queue full)" );
+
+        _secrets.release( secret );
+        ::close( client_fd );
+    }
+}
+
+/**
+ * [PRIVATE] Picks the proxy worker to hand a new client pairing to
+ * @param fd1 Client file descriptor
+ * @param fd2 Counterpart client file descriptor
+ * @return Proxy worker
+ */
+ProxyWorker & Server::selectProxyWorker( FileDescriptor_t fd1, FileDescriptor_t fd2 ) {
+    switch( _options.shard_policy ) {
+        case ShardPolicy::HASH: {
+            const auto hash = std::hash<uint64_t>()( ( static_cast<uint64_t>( std::min( fd1, fd2 ) ) << 32 ) | std::max( fd1, fd2 ) );
+            return *_proxy_workers[ hash % _proxy_workers.size() ]; //EARLY RETURN
         }
 
-        ++bytes;
+        case ShardPolicy::ROUND_ROBIN: {
+            return *_proxy_workers[ _next_proxy_worker++ % _proxy_workers.size() ]; //EARLY RETURN
+        }
+
+        case ShardPolicy::INCOMING_CPU: {
+            if( auto * worker = selectLocalProxyWorker( fd1, fd2 ) ) {
+                return *worker; //EARLY RETURN
+            }
+        } [[fallthrough]];
+
+        case ShardPolicy::LEAST_LOADED: [[fallthrough]];
+        default: {
+            auto it = std::min_element( _proxy_workers.begin(),
+                                        _proxy_workers.end(),
+                                        []( const auto & a, const auto & b ) { return a->load() < b->load(); } );
+            return **it; //EARLY RETURN
+        }
+    }
+}
+
+/**
+ * [PRIVATE] Picks the proxy worker closest to where a new client pairing's packets are received
+ * i.e. the worker pinned to the CPU processing the packets of either client (first client first)
+ * or else the least loaded one on the same NUMA node as the first client's
+ * @param fd1 Client file descriptor
+ * @param fd2 Counterpart client file descriptor
+ * @return Proxy worker (nullptr when the CPUs are unknown or no worker is on their node)
+ */
+ProxyWorker * Server::selectLocalProxyWorker( FileDescriptor_t fd1, FileDescriptor_t fd2 ) {
+    const int     cpus[2] = { CpuAffinity::incomingCpu( fd1 ), CpuAffinity::incomingCpu( fd2 ) };
+    ProxyWorker * local   = nullptr;
+
+    for( const auto cpu : cpus ) {
+        for( auto & worker : _proxy_workers ) {
+            if( cpu >= 0 && worker->cpu() == cpu ) {
+                return worker.get(); //EARLY RETURN
+            }
+        }
+    }
+
+    if( cpus[0] < 0 ) {
+        return nullptr; //EARLY RETURN
+    }
+
+    for( auto & worker : _proxy_workers ) {
+        if( worker->cpu() >= 0 && CpuAffinity::node( worker->cpu() ) == CpuAffinity::node( cpus[0] ) &&
+            ( local == nullptr || worker->load() < local->load() ) )
+        {
+            local = worker.get();
+        }
+    }
+
+    return local;
+}
+
+/**
+ * [PRIVATE] Counts the outcome of a client's handshake once it's over
+ * @param handshake Client's handshake parser
+ * @param new_state Handshake state post-processing
+ * @param was_ready Handshake completion state pre-processing
+ */
+void Server::countHandshakeEnd( const HandshakeParser & handshake, HandshakeState new_state, bool was_ready ) {
+    if( was_ready ) {
+        return; //EARLY RETURN (over already)
+    }
+
+    if( new_state == HandshakeState::READY ) {
+        _pending_metrics.handshakes_ready.add();
+
+    } else if( new_state == HandshakeState::DCN ) {
+        if( handshake.failed() ) {
+            _pending_metrics.handshakes_malformed.add();
+        } else {
+            _pending_metrics.handshakes_disconnected.add();
+        }
+    }
+}
+
+/**
+ * [PRIVATE] Renders the metrics of all the server's threads (called from the admin server's thread)
+ * @return Metrics in the Prometheus text format
+ */
+std::string Server::renderMetrics() const {
+    typedef metrics::Counter metrics::AcceptorMetrics::* AcceptorCounter_t;
+    typedef metrics::Counter metrics::WorkerMetrics::*   WorkerCounter_t;
+
+    static constexpr double US_TO_SECONDS = 1e-6;
+
+    auto text = metrics::PrometheusText();
+
+    const auto acceptorCounter = [&]( const char * name, const char * help, AcceptorCounter_t counter ) {
+        text.family( name, "counter", help );
+
+        for( size_t i = 0; i < _acceptors.size(); ++i ) {
+            text.sample( name, "acceptor=\"" + std::to_string( i ) + "\"", ( ( *_acceptors[i].metrics ).*counter ).value() );
+        }
+    };
+
+    const auto workerCounter = [&]( const char * name, const char * help, std::initializer_list<std::pair<const char *, WorkerCounter_t>> counters ) {
+        text.family( name, "counter", help );
+
+        for( const auto & worker : _proxy_workers ) {
+            for( const auto & [ labels, counter ] : counters ) {
+                text.sample( name, "worker=\"" + std::to_string( worker->id() ) + "\"" + labels, ( worker->metrics().*counter ).value() );
+            }
+        }
+    };
+
+    acceptorCounter( "fwd_proxy_accepted_total", "Connections accepted.", &metrics::AcceptorMetrics::accepted );
+    acceptorCounter( "fwd_proxy_accept_dropped_total", "Connections closed because the pending thread's queue was full.", &metrics::AcceptorMetrics::dropped );
+    acceptorCounter( "fwd_proxy_accept_errors_total", "Failed accepts.", &metrics::AcceptorMetrics::errors );
+
+    text.family( "fwd_proxy_handshakes_total", "counter", "Handshakes over, by outcome." )
+        .sample( "fwd_proxy_handshakes_total", "outcome=\"ready\"", _pending_metrics.handshakes_ready.value() )
+        .sample( "fwd_proxy_handshakes_total", "outcome=\"malformed\"", _pending_metrics.handshakes_malformed.value() )
+        .sample( "fwd_proxy_handshakes_total", "outcome=\"tls_failed\"", _pending_metrics.handshakes_tls_failed.value() )
+        .sample( "fwd_proxy_handshakes_total", "outcome=\"disconnected\"", _pending_metrics.handshakes_disconnected.value() )
+        .sample( "fwd_proxy_handshakes_total", "outcome=\"timeout\"", _pending_metrics.handshakes_timed_out.value() );
+
+    text.family( "fwd_proxy_pending_clients", "gauge", "Clients in the pending store (handshaking or waiting for a counterpart)." )
+        .sample( "fwd_proxy_pending_clients", "", _pending_metrics.pending_clients.value() );
+
+    text.family( "fwd_proxy_pairing_timeouts_total", "counter", "Clients disconnected for lack of a counterpart." )
+        .sample( "fwd_proxy_pairing_timeouts_total", "", _pending_metrics.pairing_timeouts.value() );
+
+    text.family( "fwd_proxy_pairs_total", "counter", "Pairings handed to the proxy workers." )
+        .sample( "fwd_proxy_pairs_total", "", _pending_metrics.pairs.value() );
+
+    text.family( "fwd_proxy_requeued_total", "counter", "Clients re-queued after their counterpart left." )
+        .sample( "fwd_proxy_requeued_total", "", _pending_metrics.requeued.value() );
+
+    text.family( "fwd_proxy_handshake_to_pair_seconds", "summary", "Time from handshake completion (or re-queue) to pairing." )
+        .summary( "fwd_proxy_handshake_to_pair_seconds", "", _pending_metrics.handshake_to_pair.snapshot(), US_TO_SECONDS );
+
+    text.family( "fwd_proxy_worker_pairs", "gauge", "Pairings currently handled." );
+
+    for( const auto & worker : _proxy_workers ) {
+        text.sample( "fwd_proxy_worker_pairs", "worker=\"" + std::to_string( worker->id() ) + "\"", worker->pairs() );
+    }
+
+    workerCounter( "fwd_proxy_worker_pairs_opened_total", "Pairings taken over.", { { "", &metrics::WorkerMetrics::pairs_opened } } );
+    workerCounter( "fwd_proxy_worker_pairs_closed_total", "Pairings torn down.", { { "", &metrics::WorkerMetrics::pairs_closed } } );
+    workerCounter( "fwd_proxy_worker_idle_timeouts_total", "Pairings closed for inactivity.", { { "", &metrics::WorkerMetrics::idle_timeouts } } );
+    workerCounter( "fwd_proxy_worker_bytes_total", "Bytes forwarded.", { { "", &metrics::WorkerMetrics::bytes } } );
+    workerCounter( "fwd_proxy_worker_messages_total", "Reads (epoll) or receive completions (io_uring) that returned data.", { { "", &metrics::WorkerMetrics::messages } } );
+    workerCounter( "fwd_proxy_worker_eagain_total", "Reads and writes that would have blocked.", { { ",op=\"read\"", &metrics::WorkerMetrics::read_eagain },
+                                                                                                 { ",op=\"write\"", &metrics::WorkerMetrics::write_eagain } } );
+    workerCounter( "fwd_proxy_worker_buffer_stalls_total", "Receives that ran out of provided buffers (io_uring).", { { "", &metrics::WorkerMetrics::buffer_stalls } } );
+    workerCounter( "fwd_proxy_worker_coalesced_flushes_total", "Held writes flushed once their latency budget ran out (framed pairings).", { { "", &metrics::WorkerMetrics::coalesced_flushes } } );
+    workerCounter( "fwd_proxy_worker_malformed_frames_total", "Framed pairings closed because a client sent a malformed frame.", { { "", &metrics::WorkerMetrics::malformed_frames } } );
+    workerCounter( "fwd_proxy_worker_members_joined_total", "Clients that joined a group channel.", { { "", &metrics::WorkerMetrics::members_joined } } );
+    workerCounter( "fwd_proxy_worker_slow_members_total", "Group members dropped for falling too far behind.", { { "", &metrics::WorkerMetrics::slow_members } } );
+    workerCounter( "fwd_proxy_worker_errors_total", "Socket errors.", { { "", &metrics::WorkerMetrics::errors } } );
+
+    text.family( "fwd_proxy_worker_forward_latency_seconds", "summary", "Time from the wake-up with data to it being written to the counterpart." );
+
+    for( const auto & worker : _proxy_workers ) {
+        text.summary( "fwd_proxy_worker_forward_latency_seconds", "worker=\"" + std::to_string( worker->id() ) + "\"", worker->metrics().forward_latency.snapshot(), US_TO_SECONDS );
+    }
+
+    text.family( "fwd_proxy_worker_pair_bytes", "summary", "Bytes forwarded over the lifetime of each pairing (both ways)." );
+
+    for( const auto & worker : _proxy_workers ) {
+        text.summary( "fwd_proxy_worker_pair_bytes", "worker=\"" + std::to_string( worker->id() ) + "\"", worker->metrics().pair_bytes.snapshot() );
+    }
+
+    return text.str();
+}
+
+/**
+ * [PRIVATE] Packs an io_uring operation and its file descriptor into completion user data
+ * @param op Operation
+ * @param fd File descriptor
+ * @return User data
+ */
+uint64_t Server::uringUserData( UringOp op, FileDescriptor_t fd ) {
+    return ( static_cast<uint64_t>( op ) << 32 ) | static_cast<uint32_t>( fd );
+}
+
+/**
+ * [PRIVATE] Unpacks the io_uring operation from completion user data
+ * @param user_data User data
+ * @return Operation
+ */
+Server::UringOp Server::uringOp( uint64_t user_data ) {
+    return static_cast<UringOp>( user_data >> 32 );
+}
+
+/**
+ * [PRIVATE] Unpacks the file descriptor from completion user data
+ * @param user_data User data
+ * @return File descriptor
+ */
+Server::FileDescriptor_t Server::uringFd( uint64_t user_data ) {
+    return static_cast<FileDescriptor_t>( user_data & 0xFFFFFFFF );
+}
+
+/**
+ * [PRIVATE] Signal an event to unblock `epoll_wait`
+ * @param event_fd Event file descriptor
+ */
+void Server::signalEvent( FileDescriptor_t event_fd ) {
+    const uint64_t one = 1;
+
+    if( ::write( event_fd, &one, sizeof( uint64_t ) ) != sizeof( uint64_t ) ) {
+        LOG_ERROR( "[proxy::Server::signalEvent()] error: " << ::strerror( errno ) );
+    }
+}
+
+/**
+ * [PRIVATE] Sends a message to a client file descriptor
+ * @param client_fd Client file descriptor
+ * @param msg Message string to send
+ * @return Success (false unless the whole message was written)
+ */
+bool Server::send( FileDescriptor_t client_fd, const std::string &msg ) {
+    const auto sent = ::send( client_fd, msg.c_str(), msg.size(), 0 );
+
+    if( sent == -1 ) {
+        LOG_ERROR( "[proxy::Server::send(..)] error: " << ::strerror( errno ) );
+        return false; //EARLY RETURN
+    }
+
+    if( static_cast<size_t>( sent ) != msg.size() ) {
+        LOG_ERROR( "[proxy::Server::send(..)] "
+                   << "Short write to client " << client_fd << " (" << sent << "/" << msg.size() << " bytes)" );
+        return false; //EARLY RETURN
+    }
+
+    return true;
+}
+
+/**
+ * [PRIVATE] Creates a periodic timer file descriptor (non-blocking, readable on each tick)
+ * @param interval_ms Tick interval in ms
+ * @return Timer file descriptor (-1 on failure)
+ */
+Server::FileDescriptor_t Server::createTickTimer( uint64_t interval_ms ) {
+    const auto fd = ::timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+
+    if( fd == -1 ) {
+        LOG_ERROR( "[proxy::Server::createTickTimer(..)] 'timerfd_create' error: " << ::strerror( errno ) );
+        return -1; //EARLY RETURN
+    }
+
+    struct itimerspec spec {};
+
+    spec.it_interval.tv_sec  = static_cast<time_t>( interval_ms / 1000 );
+    spec.it_interval.tv_nsec = static_cast<long>( ( interval_ms % 1000 ) * 1000000 );
+    spec.it_value            = spec.it_interval;
+
+    if( ::timerfd_settime( fd, 0, &spec, nullptr ) == -1 ) {
+        LOG_ERROR( "[proxy::Server::createTickTimer(..)] 'timerfd_settime' error: " << ::strerror( errno ) );
+        ::close( fd );
+        return -1; //EARLY RETURN
+    }
+
+    return fd;
+}
+
+/**
+ * [PRIVATE] Converts a socket address to its printable form
+ * @param address Socket address (IPv4 or IPv6)
+ * @return Address string
+ */
+std::string Server::toString( const struct sockaddr_storage & address ) {
+    char         buffer[INET6_ADDRSTRLEN] = {};
+    const void * src                      = ( address.ss_family == AF_INET
+                                              ? static_cast<const void *>( &reinterpret_cast<const struct sockaddr_in *>( &address )->sin_addr )
+                                              : static_cast<const void *>( &reinterpret_cast<const struct sockaddr_in6 *>( &address )->sin6_addr ) );
+
+    if( ::inet_ntop( address.ss_family, src, buffer, sizeof buffer ) == nullptr ) {
+        return "?"; //EARLY RETURN
     }
 
-    return bytes;
+    return buffer;
 }
 
 /**
@@ -572,9 +1599,8 @@ bool Server::modifyEPOLL( Server::FileDescriptor_t epoll_fd, Server::FileDescrip
     event.data.fd = fd;
 
     if( ::epoll_ctl( epoll_fd, operation, fd, &event ) < 0 ) {
-        std::cerr << "[proxy::Server::modifyEPOLL( " << epoll_fd << ", " << fd << ", " << operation << ", " << event_flags << " )] "
-                  << "Failed to modify epoll."
-                  << std::endl;
+        LOG_ERROR( "[proxy::Server::modifyEPOLL( " << epoll_fd << ", " << fd << ", " << operation << ", " << event_flags << " )] "
+                   << "Failed to modify epoll." );
 
         return false;
     }
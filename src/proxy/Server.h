@@ -3,54 +3,146 @@
 
 #include <string>
 #include <vector>
-#include <deque>
-#include <unordered_map>
+#include <memory>
 #include <thread>
-#include <mutex>
-#include <condition_variable>
+#include <atomic>
 #include <functional>
 
+#include <sys/socket.h>
+
 #include "../enum/HandshakeState.h"
+#include "../container/FdTable.h"
+#include "../container/InternTable.h"
+#include "../container/TimerWheel.h"
+#include "../container/MpscQueue.h"
+#include "../metrics/Metrics.h"
+#include "../metrics/AdminServer.h"
+#include "ServerOptions.h"
+#include "ProxyWorker.h"
+#include "HandshakeParser.h"
+#include "Handshake.h"
+#include "Handoff.h"
+#include "FrameCursor.h"
+#include "Matchmaker.h"
+#include "IoUring.h"
+#include "TlsContext.h"
 
 namespace fwd_proxy::proxy {
     class Server {
       public:
-        explicit Server( int port );
+        explicit Server( int port, ServerOptions options = {} );
         ~Server();
 
         bool start();
         bool stop();
 
+        [[nodiscard]] bool handedOff() const;
+
       private:
-        typedef std::string Secret_t;
-        typedef int         FileDescriptor_t;
-
-        const std::string _server_port;
-        FileDescriptor_t  _server_socket_fd;
-        FileDescriptor_t  _server_socket_epoll_fd;
-        FileDescriptor_t  _unblock_event_fd;
-        std::atomic_bool  _run_flag;
-        std::thread       _connection_worker_th;
-        std::thread       _pending_worker_th;
-        std::thread       _proxy_worker_th;
-
-        FileDescriptor_t                                       _epoll_pending_fd;
-        FileDescriptor_t                                       _epoll_paired_fd;
-        std::mutex                                             _pairings_mutex; //use for both `_epoll_paired_fd` and `_pairings`
-        std::unordered_map<FileDescriptor_t, FileDescriptor_t> _pairings;
+        typedef container::InternTable::Handle_t Secret_t;
+        typedef int                              FileDescriptor_t;
+
+        struct Acceptor_t {
+            FileDescriptor_t                          socket_fd { -1 }; //listener
+            FileDescriptor_t                          epoll_fd  { -1 };
+            int                                       cpu       { -1 }; //CPU the thread is pinned to (-1 = unpinned)
+            std::thread                               thread;
+            std::unique_ptr<metrics::AcceptorMetrics> metrics   { std::make_unique<metrics::AcceptorMetrics>() };
+        };
+
+        struct Handover_t {
+            FileDescriptor_t fd     { -1 };
+            Secret_t         secret { container::InternTable::INVALID_HANDLE }; //set when re-queued by a proxy worker (`fd` is -1 to only release it)
+            bool             framed     { false }; //re-queued client uses the framed protocol
+            bool             compressed { false }; //re-queued framed client compresses its payloads
+        };
+
+        struct PendingClient_t {
+            TlsContext::Session_t tls;      //TLS handshake in progress (empty once offloaded to the kernel, or in cleartext)
+            HandshakeParser       handshake;
+            FrameCursor           frames;   //dropped whilst waiting (framed clients only)
+            Secret_t              secret   { container::InternTable::INVALID_HANDLE }; //interned once the handshake completes
+            uint64_t              ready_at { 0 }; //when the handshake completed or the client was re-queued (µs)
+        };
+
+        enum class UringOp : uint32_t {
+            WAKE = 0,
+            ACCEPT,
+            RECV,
+            CANCEL,
+            TIMER,
+            HANDOVER,
+        };
 
+        const std::string       _server_port;
+        ServerOptions           _options;
+        std::vector<Acceptor_t> _acceptors;
+        FileDescriptor_t        _unblock_event_fd;
+        std::atomic_bool        _run_flag;
+        std::thread             _pending_worker_th;
+        FileDescriptor_t        _handoff_fd; //hot restart socket (listener)
+        std::thread             _handoff_th;
+        std::atomic_bool        _handed_off; //everything went to the next process
+
+        FileDescriptor_t                          _epoll_pending_fd;
+        std::unique_ptr<IoUring>                  _pending_ring; //used instead of epoll by `IoBackend::IO_URING`
+        std::unique_ptr<TlsContext>               _tls;          //nullptr when clients connect in cleartext
+        std::vector<std::unique_ptr<ProxyWorker>> _proxy_workers;
+        size_t                                    _next_proxy_worker; //used by `ShardPolicy::ROUND_ROBIN`
+
+        container::MpscQueue<Handover_t>          _handovers; //from the connection threads (new clients) and the proxy workers (orphaned clients)
+        FileDescriptor_t                          _handover_event_fd;
+        FileDescriptor_t                          _pending_timer_fd;
+
+        //pending worker thread only
+        container::TimerWheel               _pending_timers; //handshake then pairing deadline, per client
+        container::FdTable<PendingClient_t> _pending_clients;
+        container::InternTable              _secrets; //secrets of the clients that completed their handshake
+        Matchmaker                          _matchmaker; //clients waiting for a counterpart
+        metrics::PendingMetrics             _pending_metrics;
+
+        std::unique_ptr<metrics::AdminServer> _admin_server;
+
+        bool halt();
         void closeFileDescriptors();
 
-        void runConnectionEventLoop();
+        FileDescriptor_t createListener() const;
+        FileDescriptor_t adoptListener( FileDescriptor_t socket_fd ) const;
+        bool takeOver( Handoff::Snapshot_t & snapshot );
+        void importSnapshot( Handoff::Snapshot_t & snapshot );
+        void runHandoffLoop();
+        void handOff( FileDescriptor_t channel_fd );
+        void runConnectionEventLoop( Acceptor_t & acceptor );
         void runPendingEventLoop();
-        void runProxyEventLoop();
+        void runUringPendingEventLoop();
+        void acceptHandovers();
+        void expirePendingClients();
+        bool handBack( FileDescriptor_t client_fd, Secret_t secret, bool framed, bool compressed );
+        void restorePendingClient( FileDescriptor_t client_fd, Secret_t secret, bool framed, bool compressed );
+        bool secureClient( FileDescriptor_t client_fd, PendingClient_t & client, uint32_t events );
+
+        Secret_t internSecret( FileDescriptor_t client_fd );
+        void matchPendingClient( FileDescriptor_t client_fd, uint64_t timeout_ms );
+        FileDescriptor_t takeCandidate( FileDescriptor_t client_fd, const std::function<void( FileDescriptor_t )> & drop );
+        void schedulePendingTimeout( FileDescriptor_t client_fd, uint64_t timeout_ms );
+        Secret_t forgetPendingClient( FileDescriptor_t client_fd );
+        void dropPendingClient( FileDescriptor_t client_fd );
+        void pairClients( FileDescriptor_t fd1, FileDescriptor_t fd2 );
+        void joinChannel( FileDescriptor_t client_fd );
+        ProxyWorker & selectProxyWorker( FileDescriptor_t fd1, FileDescriptor_t fd2 );
+        ProxyWorker * selectLocalProxyWorker( FileDescriptor_t fd1, FileDescriptor_t fd2 );
+        void countHandshakeEnd( const HandshakeParser & handshake, HandshakeState new_state, bool was_ready );
+        [[nodiscard]] std::string renderMetrics() const;
 
-        static HandshakeState processHandshake( FileDescriptor_t client_fd, HandshakeState cxn_state, Secret_t & secret );
+        static uint64_t uringUserData( UringOp op, FileDescriptor_t fd );
+        static UringOp uringOp( uint64_t user_data );
+        static FileDescriptor_t uringFd( uint64_t user_data );
+        static FileDescriptor_t createTickTimer( uint64_t interval_ms );
+        static std::string toString( const struct sockaddr_storage & address );
+        static void signalEvent( FileDescriptor_t event_fd );
         static bool send( FileDescriptor_t client_fd, const std::string & msg );
-        static ssize_t rcv( FileDescriptor_t client_fd, char * buffer, size_t buffer_size );
-        static size_t rcvUntil( FileDescriptor_t client_fd, char * buffer, size_t buffer_size, std::function<int( int )> predicate_fn ) ;
         static bool modifyEPOLL( FileDescriptor_t epoll_fd, FileDescriptor_t fd, int operation, uint32_t  event_flags );
     };
 }
 
-#endif //FWD_PROXY_PROXY_SERVER_H
\ No newline at end of file
+#endif //FWD_PROXY_PROXY_SERVER_H
@@ -0,0 +1,42 @@
+#ifndef FWD_PROXY_PROXY_SERVEROPTIONS_H
+#define FWD_PROXY_PROXY_SERVEROPTIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../enum/ForwardingMode.h"
+#include "../enum/ShardPolicy.h"
+#include "../enum/IoBackend.h"
+#include "SocketTuning.h"
+
+namespace fwd_proxy::proxy {
+    /**
+     * Tunable server settings
+     */
+    struct ServerOptions {
+        ForwardingMode   forwarding_mode      { ForwardingMode::SPLICE };
+        size_t           proxy_workers        { 0 };       //0 = 1 per hardware thread
+        ShardPolicy      shard_policy         { ShardPolicy::LEAST_LOADED };
+        IoBackend        io_backend           { IoBackend::EPOLL };
+        size_t           acceptors            { 1 };       //connection threads (each with its own `SO_REUSEPORT` listener when > 1)
+        uint64_t         handshake_timeout_ms { 10000 };   //connection to handshake completion (0 = none)
+        uint64_t         pairing_timeout_ms   { 300000 };  //handshake completion to pairing (0 = none)
+        uint64_t         idle_timeout_ms      { 3600000 }; //pairing without traffic either way (0 = none)
+        uint64_t         orphan_grace_ms      { 30000 };   //re-queued client waiting for a new counterpart (0 = closed instead)
+        uint64_t         coalesce_us          { 0 };       //latency budget for holding small writes of framed pairings back (0 = none)
+        int              metrics_port         { 0 };       //Prometheus endpoint on 127.0.0.1 (0 = disabled)
+        int              listen_backlog       { 100 };     //connections the kernel queues up per listener until accepted
+        SocketTuning     socket_tuning;                    //TCP settings of the client sockets (set on the listeners)
+        std::vector<int> acceptor_cpus;                    //CPUs the acceptors are pinned to, 1 each in turn (empty = unpinned)
+        std::vector<int> pending_cpus;                     //CPUs the pending thread may run on (empty = unpinned)
+        std::vector<int> worker_cpus;                      //CPUs the proxy workers are pinned to, 1 each in turn (empty = unpinned)
+        std::string      handoff_path;                     //Unix socket to take over from a running server and hand over to the next (empty = no hot restart)
+        bool             group_channels       { false };   //framed clients sharing a secret join 1 channel (each message goes to every other member)
+        std::string      tls_cert_path;                    //PEM certificate (chain) clients connect over TLS with (empty = cleartext)
+        std::string      tls_key_path;                     //PEM private key of the certificate
+    };
+}
+
+#endif //FWD_PROXY_PROXY_SERVEROPTIONS_H
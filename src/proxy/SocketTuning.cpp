@@ -0,0 +1,178 @@
+#include "SocketTuning.h"
+#include "../logger/Logger.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define LATENCY_NOTSENT_LOWAT 16384   //bytes left unsent in the kernel before the socket stops being writable
+#define BULK_BUFFER_SIZE      4194304 //socket buffer size (the kernel caps it to `net.core.[rw]mem_max`)
+
+using namespace fwd_proxy::proxy;
+
+/**
+ * Gets the settings of a profile
+ * @param profile TCP profile
+ * @return Settings
+ */
+SocketTuning SocketTuning::profile( TcpProfile profile ) {
+    auto tuning = SocketTuning();
+
+    switch( profile ) {
+        case TcpProfile::KERNEL: {
+        } break;
+
+        case TcpProfile::LATENCY: {
+            tuning.no_delay      = true;
+            tuning.quick_ack     = true;
+            tuning.notsent_lowat = LATENCY_NOTSENT_LOWAT;
+        } break;
+
+        case TcpProfile::BULK: {
+            tuning.recv_buffer = BULK_BUFFER_SIZE;
+            tuning.send_buffer = BULK_BUFFER_SIZE;
+        } break;
+    }
+
+    return tuning;
+}
+
+/**
+ * Overrides a setting
+ * @param option Setting as `<name>=<value>` (nodelay=0|1, quickack=0|1, rcvbuf=<bytes>, sndbuf=<bytes>,
+ *               notsent-lowat=<bytes>, keepalive=<idle s>[:<interval s>[:<count>]])
+ * @return Success (false for an unknown name or invalid value)
+ */
+bool SocketTuning::set( const std::string & option ) {
+    const auto separator = option.find( '=' );
+
+    if( separator == std::string::npos || separator + 1 == option.size() ) {
+        return false; //EARLY RETURN
+    }
+
+    const auto   name  = option.substr( 0, separator );
+    const char * value = option.c_str() + separator + 1;
+    char       * end   = nullptr;
+    const auto   parse = [&value, &end]() {
+        const auto number = std::strtol( value, &end, 10 );
+        return ( end != value && number >= 0 && number <= INT_MAX ) ? static_cast<int>( number ) : -1;
+    };
+
+    if( name == "keepalive" ) {
+        int fields[3] = { 0, 0, 0 }; //idle, interval, count
+
+        for( auto & field : fields ) {
+            if( ( field = parse() ) == -1 ) {
+                return false; //EARLY RETURN
+            }
+
+            if( *end != ':' ) {
+                break;
+            }
+
+            value = end + 1;
+        }
+
+        if( *end != '\0' ) {
+            return false; //EARLY RETURN
+        }
+
+        keepalive_idle_s     = fields[0];
+        keepalive_interval_s = fields[1];
+        keepalive_count      = fields[2];
+        return true; //EARLY RETURN
+    }
+
+    const auto number = parse();
+
+    if( number == -1 || *end != '\0' ) {
+        return false; //EARLY RETURN
+    }
+
+    if( name == "nodelay" ) {
+        no_delay = ( number != 0 );
+    } else if( name == "quickack" ) {
+        quick_ack = ( number != 0 );
+    } else if( name == "rcvbuf" ) {
+        recv_buffer = number;
+    } else if( name == "sndbuf" ) {
+        send_buffer = number;
+    } else if( name == "notsent-lowat" ) {
+        notsent_lowat = number;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Applies the settings that differ from the kernel defaults to a socket
+ * @param socket_fd Socket file descriptor
+ * @param listening Flag for a listening socket (settings the accepted sockets don't inherit are left out)
+ * @return Success
+ */
+bool SocketTuning::apply( int socket_fd, bool listening ) const {
+    struct Option_t {
+        int          level;
+        int          name;
+        int          value;
+        const char * label;
+    };
+
+    const Option_t options[] = {
+        { IPPROTO_TCP, TCP_NODELAY,       no_delay ? 1 : 0,         "TCP_NODELAY"       },
+        { IPPROTO_TCP, TCP_QUICKACK,      quick_ack && !listening,  "TCP_QUICKACK"      },
+        { SOL_SOCKET,  SO_RCVBUF,         recv_buffer,              "SO_RCVBUF"         },
+        { SOL_SOCKET,  SO_SNDBUF,         send_buffer,              "SO_SNDBUF"         },
+        { IPPROTO_TCP, TCP_NOTSENT_LOWAT, notsent_lowat,            "TCP_NOTSENT_LOWAT" },
+        { SOL_SOCKET,  SO_KEEPALIVE,      keepalive_idle_s > 0,     "SO_KEEPALIVE"      },
+        { IPPROTO_TCP, TCP_KEEPIDLE,      keepalive_idle_s,         "TCP_KEEPIDLE"      },
+        { IPPROTO_TCP, TCP_KEEPINTVL,     keepalive_interval_s,     "TCP_KEEPINTVL"     },
+        { IPPROTO_TCP, TCP_KEEPCNT,       keepalive_count,          "TCP_KEEPCNT"       },
+    };
+
+    for( const auto & option : options ) {
+        if( option.value == 0 ) { //kernel default
+            continue;
+        }
+
+        if( ::setsockopt( socket_fd, option.level, option.name, &option.value, sizeof( int ) ) == -1 ) {
+            LOG_ERROR( "[proxy::SocketTuning::apply( " << socket_fd << " )] '" << option.label << "' error: " << ::strerror( errno ) );
+            return false; //EARLY RETURN
+        }
+
+        if( option.level == SOL_SOCKET && ( option.name == SO_RCVBUF || option.name == SO_SNDBUF ) ) {
+            int       actual = 0;
+            socklen_t length = sizeof( int );
+
+            //the kernel doubles the size asked for (bookkeeping overhead) unless it is capped
+            if( ::getsockopt( socket_fd, option.level, option.name, &actual, &length ) == 0 && actual / 2 < option.value ) {
+                LOG_WARNING( "[proxy::SocketTuning::apply( " << socket_fd << " )] '" << option.label << "' capped to "
+                             << actual / 2 << " bytes (see `net.core." << ( option.name == SO_RCVBUF ? "rmem_max" : "wmem_max" ) << "`)" );
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Applies the settings an accepted socket doesn't inherit from its listening socket (`TCP_QUICKACK`)
+ * @param socket_fd Accepted socket file descriptor
+ * @return Success
+ */
+bool SocketTuning::applyAccepted( int socket_fd ) const {
+    const int yes = 1;
+
+    if( quick_ack && ::setsockopt( socket_fd, IPPROTO_TCP, TCP_QUICKACK, &yes, sizeof( int ) ) == -1 ) {
+        LOG_ERROR( "[proxy::SocketTuning::applyAccepted( " << socket_fd << " )] 'TCP_QUICKACK' error: " << ::strerror( errno ) );
+        return false; //EARLY RETURN
+    }
+
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef FWD_PROXY_PROXY_SOCKETTUNING_H
+#define FWD_PROXY_PROXY_SOCKETTUNING_H
+
+#include <string>
+
+#include "../enum/TcpProfile.h"
+
+namespace fwd_proxy::proxy {
+    /**
+     * TCP settings for the client sockets
+     * The server applies them to its listening sockets, which the accepted sockets inherit them from
+     * (no extra syscalls per connection, and the buffer sizes are in place for the window negotiated
+     * by the handshake), except for `TCP_QUICKACK` which is set on each accepted socket. Clients apply
+     * them before connecting for the same reason.
+     */
+    struct SocketTuning {
+        bool no_delay             { false }; //TCP_NODELAY (no Nagle's algorithm)
+        bool quick_ack            { false }; //TCP_QUICKACK (the kernel leaves quick ACK mode on its own after a while)
+        int  recv_buffer          { 0 };     //SO_RCVBUF in bytes (0 = auto-tuned)
+        int  send_buffer          { 0 };     //SO_SNDBUF in bytes (0 = auto-tuned)
+        int  notsent_lowat        { 0 };     //TCP_NOTSENT_LOWAT in bytes (0 = kernel default)
+        int  keepalive_idle_s     { 0 };     //SO_KEEPALIVE + TCP_KEEPIDLE (0 = no keepalive)
+        int  keepalive_interval_s { 0 };     //TCP_KEEPINTVL (0 = kernel default)
+        int  keepalive_count      { 0 };     //TCP_KEEPCNT (0 = kernel default)
+
+        static SocketTuning profile( TcpProfile profile );
+
+        bool set( const std::string & option );
+        bool apply( int socket_fd, bool listening = false ) const;
+        bool applyAccepted( int socket_fd ) const;
+    };
+}
+
+#endif //FWD_PROXY_PROXY_SOCKETTUNING_H
@@ -0,0 +1,213 @@
+#include "SplicePipe.h"
+
+#include <algorithm>
+#include <utility>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#define SPLICE_PIPE_SIZE 65536 //default pipe capacity on Linux
+
+using namespace fwd_proxy::proxy;
+
+/**
+ * Default constructor (no pipe)
+ */
+SplicePipe::SplicePipe() :
+    _read_fd( -1 ),
+    _write_fd( -1 ),
+    _capacity( 0 ),
+    _buffered( 0 )
+{}
+
+/**
+ * Constructor (check `valid()` for success)
+ * @param capacity Pipe capacity in bytes (best effort: the default size is kept when it can't be set)
+ */
+SplicePipe::SplicePipe( size_t capacity ) :
+    SplicePipe()
+{
+    int fds[2];
+
+    if( ::pipe2( fds, O_NONBLOCK | O_CLOEXEC ) == 0 ) {
+        _read_fd  = fds[0];
+        _write_fd = fds[1];
+
+        const auto size = ::fcntl( _write_fd, F_GETPIPE_SZ );
+        _capacity = ( size > 0 ? size : SPLICE_PIPE_SIZE );
+
+        resize( capacity );
+    }
+}
+
+/**
+ * Move-constructor
+ * @param pipe SplicePipe to move over
+ */
+SplicePipe::SplicePipe( SplicePipe && pipe ) noexcept :
+    _read_fd( std::exchange( pipe._read_fd, -1 ) ),
+    _write_fd( std::exchange( pipe._write_fd, -1 ) ),
+    _capacity( std::exchange( pipe._capacity, 0 ) ),
+    _buffered( std::exchange( pipe._buffered, 0 ) )
+{}
+
+/**
+ * Destructor
+ */
+SplicePipe::~SplicePipe() {
+    close();
+}
+
+/**
+ * Move-assignment operator
+ * @param pipe SplicePipe to move over
+ * @return Moved-to SplicePipe
+ */
+SplicePipe & SplicePipe::operator =( SplicePipe && pipe ) noexcept {
+    if( this != &pipe ) {
+        close();
+        _read_fd  = std::exchange( pipe._read_fd, -1 );
+        _write_fd = std::exchange( pipe._write_fd, -1 );
+        _capacity = std::exchange( pipe._capacity, 0 );
+        _buffered = std::exchange( pipe._buffered, 0 );
+    }
+
+    return *this;
+}
+
+/**
+ * Checks the pipe is usable
+ * @return Valid state
+ */
+bool SplicePipe::valid() const {
+    return _read_fd != -1 && _write_fd != -1;
+}
+
+/**
+ * Gets the number of bytes sitting in the pipe waiting to be drained
+ * @return Byte count
+ */
+size_t SplicePipe::buffered() const {
+    return _buffered;
+}
+
+/**
+ * Gets the pipe's capacity
+ * @return Capacity in bytes
+ */
+size_t SplicePipe::capacity() const {
+    return _capacity;
+}
+
+/**
+ * Moves bytes available from a source socket into the pipe
+ * @param src_fd Source file descriptor
+ * @return Bytes moved (0 on EOF, -1 on error with `errno` set)
+ */
+ssize_t SplicePipe::fill( int src_fd ) {
+    if( _buffered >= _capacity ) {
+        errno = EAGAIN;
+        return -1; //EARLY RETURN
+    }
+
+    auto bytes = ::splice( src_fd, nullptr, _write_fd, nullptr, ( _capacity - _buffered ), SPLICE_F_MOVE | SPLICE_F_NONBLOCK );
+
+    if( bytes > 0 ) {
+        _buffered += bytes;
+    }
+
+    return bytes;
+}
+
+/**
+ * Moves bytes buffered in the pipe into a destination socket
+ * @param dst_fd Destination file descriptor
+ * @return Bytes moved (-1 on error with `errno` set)
+ */
+ssize_t SplicePipe::drain( int dst_fd ) {
+    ssize_t total = 0;
+
+    while( _buffered > 0 ) {
+        auto bytes = ::splice( _read_fd, nullptr, dst_fd, nullptr, _buffered, SPLICE_F_MOVE | SPLICE_F_NONBLOCK );
+
+        if( bytes <= 0 ) {
+            return ( total > 0 ? total : bytes ); //EARLY RETURN
+        }
+
+        _buffered -= bytes;
+        total     += bytes;
+    }
+
+    return total;
+}
+
+/**
+ * Copies bytes buffered in the pipe out to user space (i.e. to hand them over)
+ * @param data Destination
+ * @param length Max number of bytes
+ * @return Bytes read (-1 on error with `errno` set)
+ */
+ssize_t SplicePipe::read( char * data, size_t length ) {
+    const auto bytes = ::read( _read_fd, data, std::min( length, _buffered ) );
+
+    if( bytes > 0 ) {
+        _buffered -= bytes;
+    }
+
+    return bytes;
+}
+
+/**
+ * Copies bytes from user space into the pipe (i.e. when they were handed over)
+ * @param data Source
+ * @param length Number of bytes
+ * @return Bytes written (-1 on error with `errno` set - EAGAIN when full)
+ */
+ssize_t SplicePipe::write( const char * data, size_t length ) {
+    const auto bytes = ::write( _write_fd, data, std::min( length, _capacity - std::min( _capacity, _buffered ) ) );
+
+    if( bytes > 0 ) {
+        _buffered += bytes;
+    }
+
+    return bytes;
+}
+
+/**
+ * Changes the pipe's capacity (`F_SETPIPE_SZ`)
+ * @param capacity New capacity in bytes (the kernel rounds it up to a power of 2 number of pages)
+ * @return Success (false when the bytes buffered don't fit or the size is over the system limit)
+ */
+bool SplicePipe::resize( size_t capacity ) {
+    if( !valid() || capacity < _buffered ) {
+        return false; //EARLY RETURN
+    }
+
+    const auto size = ::fcntl( _write_fd, F_SETPIPE_SZ, static_cast<int>( capacity ) );
+
+    if( size == -1 ) {
+        return false; //EARLY RETURN
+    }
+
+    _capacity = size;
+
+    return true;
+}
+
+/**
+ * Closes the pipe (any buffered bytes are lost)
+ */
+void SplicePipe::close() {
+    if( _read_fd != -1 ) {
+        ::close( _read_fd );
+        _read_fd = -1;
+    }
+
+    if( _write_fd != -1 ) {
+        ::close( _write_fd );
+        _write_fd = -1;
+    }
+
+    _buffered = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef FWD_PROXY_PROXY_SPLICEPIPE_H
+#define FWD_PROXY_PROXY_SPLICEPIPE_H
+
+#include <cstddef>
+#include <sys/types.h>
+
+namespace fwd_proxy::proxy {
+    /**
+     * Kernel pipe used to move bytes between 2 sockets with `splice(..)` without them crossing into user space
+     */
+    class SplicePipe {
+      public:
+        SplicePipe();
+        explicit SplicePipe( size_t capacity );
+        SplicePipe( const SplicePipe & ) = delete;
+        SplicePipe( SplicePipe && pipe ) noexcept;
+        ~SplicePipe();
+
+        SplicePipe & operator =( const SplicePipe & ) = delete;
+        SplicePipe & operator =( SplicePipe && pipe ) noexcept;
+
+        [[nodiscard]] bool valid() const;
+        [[nodiscard]] size_t buffered() const;
+        [[nodiscard]] size_t capacity() const;
+
+        ssize_t fill( int src_fd );
+        ssize_t drain( int dst_fd );
+        ssize_t read( char * data, size_t length );
+        ssize_t write( const char * data, size_t length );
+        bool resize( size_t capacity );
+        void close();
+
+      private:
+        int    _read_fd;
+        int    _write_fd;
+        size_t _capacity;
+        size_t _buffered;
+    };
+}
+
+#endif //FWD_PROXY_PROXY_SPLICEPIPE_H
@@ -0,0 +1,252 @@
+#include "TlsContext.h"
+#include "../logger/Logger.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+
+#define TLS_CIPHERS "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"     \
+                    "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:"     \
+                    "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305" //AEAD ciphers the kernel can offload
+#define ERROR_STRING_SIZE 256
+
+using namespace fwd_proxy::proxy;
+
+/**
+ * Frees an OpenSSL session (nothing is sent: the connection itself belongs to whoever owns the socket)
+ * @param ssl OpenSSL session
+ */
+void TlsContext::SessionDeleter_t::operator ()( struct ssl_st * ssl ) const {
+    ::SSL_free( ssl );
+}
+
+/**
+ * [PRIVATE] Constructor
+ * @param ctx OpenSSL context (owned)
+ */
+TlsContext::TlsContext( struct ssl_ctx_st * ctx ) :
+    _ctx( ctx )
+{}
+
+/**
+ * Destructor
+ */
+TlsContext::~TlsContext() {
+    ::SSL_CTX_free( _ctx );
+}
+
+/**
+ * Starts the server side of a TLS handshake on an accepted socket
+ * @param socket_fd Socket file descriptor
+ * @return Session to drive with `handshake(..)` (empty on failure)
+ */
+TlsContext::Session_t TlsContext::accept( FileDescriptor_t socket_fd ) const {
+    auto session = open( socket_fd );
+
+    if( session ) {
+        ::SSL_set_accept_state( session.get() );
+    }
+
+    return session;
+}
+
+/**
+ * Starts the client side of a TLS handshake on a connected socket
+ * @param socket_fd Socket file descriptor
+ * @param peer_name Host name or IP address the server's certificate has to be issued for
+ * @return Session to drive with `handshake(..)` (empty on failure)
+ */
+TlsContext::Session_t TlsContext::connect( FileDescriptor_t socket_fd, const std::string & peer_name ) const {
+    auto session = open( socket_fd );
+
+    if( !session ) {
+        return session; //EARLY RETURN
+    }
+
+    auto * param = ::SSL_get0_param( session.get() );
+
+    if( ::X509_VERIFY_PARAM_set1_ip_asc( param, peer_name.c_str() ) != 1 ) { //not an IP address: a host name, also sent as SNI
+        if( ::SSL_set1_host( session.get(), peer_name.c_str() ) != 1 || ::SSL_set_tlsext_host_name( session.get(), peer_name.c_str() ) != 1 ) {
+            LOG_ERROR( "[proxy::TlsContext::connect(..)] Failed to set the peer name '" << peer_name << "': " << TlsContext::lastError() );
+            return {}; //EARLY RETURN
+        }
+    }
+
+    ::SSL_set_connect_state( session.get() );
+
+    return session;
+}
+
+/**
+ * Creates the context used by a server
+ * @param cert_path PEM file with the server's certificate (followed by the rest of its chain, if any)
+ * @param key_path PEM file with the certificate's private key
+ * @return Context (nullptr on failure)
+ */
+std::unique_ptr<TlsContext> TlsContext::server( const std::string & cert_path, const std::string & key_path ) {
+    auto * ctx = TlsContext::create( true );
+
+    if( ctx == nullptr ) {
+        return nullptr; //EARLY RETURN
+    }
+
+    auto context = std::unique_ptr<TlsContext>( new TlsContext( ctx ) );
+
+    if( ::SSL_CTX_use_certificate_chain_file( ctx, cert_path.c_str() ) != 1 ) {
+        LOG_ERROR( "[proxy::TlsContext::server(..)] Failed to load the certificate '" << cert_path << "': " << TlsContext::lastError() );
+        return nullptr; //EARLY RETURN
+    }
+
+    if( ::SSL_CTX_use_PrivateKey_file( ctx, key_path.c_str(), SSL_FILETYPE_PEM ) != 1 || ::SSL_CTX_check_private_key( ctx ) != 1 ) {
+        LOG_ERROR( "[proxy::TlsContext::server(..)] Failed to load the private key '" << key_path << "': " << TlsContext::lastError() );
+        return nullptr; //EARLY RETURN
+    }
+
+    return context;
+}
+
+/**
+ * Creates the context used by a client (the server's certificate has to be issued by the given CA)
+ * @param ca_path PEM file with the certificate(s) of the CA(s) trusted to issue the server's certificate
+ * @return Context (nullptr on failure)
+ */
+std::unique_ptr<TlsContext> TlsContext::client( const std::string & ca_path ) {
+    auto * ctx = TlsContext::create( false );
+
+    if( ctx == nullptr ) {
+        return nullptr; //EARLY RETURN
+    }
+
+    auto context = std::unique_ptr<TlsContext>( new TlsContext( ctx ) );
+
+    if( ::SSL_CTX_load_verify_locations( ctx, ca_path.c_str(), nullptr ) != 1 ) {
+        LOG_ERROR( "[proxy::TlsContext::client(..)] Failed to load the CA '" << ca_path << "': " << TlsContext::lastError() );
+        return nullptr; //EARLY RETURN
+    }
+
+    ::SSL_CTX_set_verify( ctx, SSL_VERIFY_PEER, nullptr );
+
+    return context;
+}
+
+/**
+ * Moves a handshake forward as far as the socket allows (call again once the socket is ready as requested)
+ * @param session Session
+ * @return State (`OFFLOADED` once the kernel took the records over both ways: the session can be freed)
+ */
+fwd_proxy::TlsState TlsContext::handshake( Session_t & session ) {
+    ::ERR_clear_error();
+    errno = 0;
+
+    const int result = ::SSL_do_handshake( session.get() );
+
+    if( result != 1 ) {
+        switch( ::SSL_get_error( session.get(), result ) ) {
+            case SSL_ERROR_WANT_READ : { return TlsState::WANT_READ;  } //EARLY RETURN
+            case SSL_ERROR_WANT_WRITE: { return TlsState::WANT_WRITE; } //EARLY RETURN
+            default                  : {                              } break;
+        }
+
+        LOG_WARNING( "[proxy::TlsContext::handshake(..)] "
+                     << "Handshake on socket " << ::SSL_get_fd( session.get() ) << " failed: " << TlsContext::lastError() );
+
+        return TlsState::FAILED; //EARLY RETURN
+    }
+
+    if( !BIO_get_ktls_send( ::SSL_get_wbio( session.get() ) ) || !BIO_get_ktls_recv( ::SSL_get_rbio( session.get() ) ) ) {
+        LOG_ERROR( "[proxy::TlsContext::handshake(..)] "
+                   << "Kernel TLS offload not available for socket " << ::SSL_get_fd( session.get() )
+                   << " (cipher: " << ::SSL_get_cipher_name( session.get() ) << ")" );
+
+        return TlsState::FAILED; //EARLY RETURN
+    }
+
+    return TlsState::OFFLOADED;
+}
+
+/**
+ * Checks that the kernel has TLS offload (the `tls` module is loaded or can be)
+ * @return Support
+ */
+bool TlsContext::kernelSupport() {
+    const auto socket_fd = ::socket( AF_INET, SOCK_STREAM, 0 );
+
+    if( socket_fd == -1 ) {
+        return false; //EARLY RETURN
+    }
+
+    //not connected: the module is found (and loaded if needed) but refuses to attach with `ENOTCONN`
+    const bool supported = ( ::setsockopt( socket_fd, SOL_TCP, TCP_ULP, "tls", sizeof( "tls" ) ) == 0 || errno == ENOTCONN );
+
+    ::close( socket_fd );
+
+    return supported;
+}
+
+/**
+ * [PRIVATE] Creates a session on a socket
+ * @param socket_fd Socket file descriptor
+ * @return Session (empty on failure)
+ */
+TlsContext::Session_t TlsContext::open( FileDescriptor_t socket_fd ) const {
+    auto session = Session_t( ::SSL_new( _ctx ) );
+
+    if( !session || ::SSL_set_fd( session.get(), socket_fd ) != 1 ) {
+        LOG_ERROR( "[proxy::TlsContext::open( " << socket_fd << " )] Failed to create the session: " << TlsContext::lastError() );
+        return {}; //EARLY RETURN
+    }
+
+    return session;
+}
+
+/**
+ * [PRIVATE] Creates an OpenSSL context restricted to what the kernel can offload
+ * @param server Flag for the server side
+ * @return OpenSSL context (nullptr on failure)
+ */
+struct ssl_ctx_st * TlsContext::create( bool server ) {
+    auto * ctx = ::SSL_CTX_new( server ? ::TLS_server_method() : ::TLS_client_method() );
+
+    if( ctx == nullptr ) {
+        LOG_ERROR( "[proxy::TlsContext::create(..)] Failed to create the context: " << TlsContext::lastError() );
+        return nullptr; //EARLY RETURN
+    }
+
+    if( ::SSL_CTX_set_min_proto_version( ctx, TLS1_2_VERSION ) != 1 ||
+        ::SSL_CTX_set_max_proto_version( ctx, TLS1_2_VERSION ) != 1 ||
+        ::SSL_CTX_set_cipher_list( ctx, TLS_CIPHERS ) != 1 )
+    {
+        LOG_ERROR( "[proxy::TlsContext::create(..)] Failed to restrict the context to offloadable ciphers: " << TlsContext::lastError() );
+        ::SSL_CTX_free( ctx );
+        return nullptr; //EARLY RETURN
+    }
+
+    ::SSL_CTX_set_options( ctx, SSL_OP_ENABLE_KTLS | SSL_OP_NO_RENEGOTIATION | SSL_OP_NO_COMPRESSION );
+
+    return ctx;
+}
+
+/**
+ * [PRIVATE] Pops the last OpenSSL error of the thread
+ * @return Description
+ */
+std::string TlsContext::lastError() {
+    const auto code = ::ERR_get_error();
+
+    if( code == 0 ) { //i.e.: socket error
+        return ( errno == 0 ? "connection closed" : ::strerror( errno ) ); //EARLY RETURN
+    }
+
+    char buffer[ERROR_STRING_SIZE];
+
+    ::ERR_error_string_n( code, buffer, sizeof( buffer ) );
+
+    return buffer;
+}
@@ -0,0 +1,55 @@
+#ifndef FWD_PROXY_PROXY_TLSCONTEXT_H
+#define FWD_PROXY_PROXY_TLSCONTEXT_H
+
+#include <string>
+#include <memory>
+
+#include "../enum/TlsState.h"
+
+struct ssl_st;
+struct ssl_ctx_st;
+
+namespace fwd_proxy::proxy {
+    /**
+     * TLS on the proxy hop with the record layer offloaded to the kernel (kTLS)
+     * OpenSSL only runs the handshake. Once it is done the keys are in the socket (`TLS_TX`/`TLS_RX`) and the
+     * OpenSSL session is freed: from there on the socket is used as in cleartext (`read`/`write`, `splice`,
+     * `sendfile`, passed to another process on hot restart). Only TLS 1.2 with AES-GCM or ChaCha20-Poly1305 is
+     * negotiated since that is what the kernel and OpenSSL 3.0 can offload both ways, with nothing but application
+     * data records going over the wire after the handshake (no TLS 1.3 session tickets nor key updates).
+     */
+    class TlsContext {
+      public:
+        struct SessionDeleter_t {
+            void operator ()( struct ssl_st * ssl ) const;
+        };
+
+        typedef int                                               FileDescriptor_t;
+        typedef std::unique_ptr<struct ssl_st, SessionDeleter_t> Session_t;
+
+        TlsContext( const TlsContext & ) = delete;
+        ~TlsContext();
+
+        TlsContext & operator =( const TlsContext & ) = delete;
+
+        [[nodiscard]] Session_t accept( FileDescriptor_t socket_fd ) const;
+        [[nodiscard]] Session_t connect( FileDescriptor_t socket_fd, const std::string & peer_name ) const;
+
+        static std::unique_ptr<TlsContext> server( const std::string & cert_path, const std::string & key_path );
+        static std::unique_ptr<TlsContext> client( const std::string & ca_path );
+        static TlsState handshake( Session_t & session );
+        static bool kernelSupport();
+
+      private:
+        struct ssl_ctx_st * _ctx;
+
+        explicit TlsContext( struct ssl_ctx_st * ctx );
+
+        [[nodiscard]] Session_t open( FileDescriptor_t socket_fd ) const;
+
+        static struct ssl_ctx_st * create( bool server );
+        static std::string lastError();
+    };
+}
+
+#endif //FWD_PROXY_PROXY_TLSCONTEXT_H